@@ -25,11 +25,12 @@
 #include "adjustablearrowcap-private.h"
 #include "general-private.h"
 #include "graphics-private.h"
+#include "graphics-path-private.h"
 
 static GpStatus gdip_adjust_arrowcap_setup (GpGraphics *graphics, GpCustomLineCap *cap);
 static GpStatus gdip_adjust_arrowcap_clone_cap (GpCustomLineCap *cap, GpCustomLineCap **clonedCap);
 static GpStatus gdip_adjust_arrowcap_destroy (GpCustomLineCap *cap);
-static GpStatus gdip_adjust_arrowcap_draw (GpGraphics *graphics, GpPen *pen, GpCustomLineCap *Cap, float x, float y, float otherend_x, float otherend_y);
+static GpStatus gdip_adjust_arrowcap_compile (GpCustomLineCap *cap, float penwidth, cairo_path_t **fill, cairo_path_t **stroke);
 
 /*
  * we have a single copy of vtable for
@@ -40,7 +41,7 @@ static CapClass vtable = { CustomLineCapTypeAdjustableArrow,
 			   gdip_adjust_arrowcap_setup,
 			   gdip_adjust_arrowcap_clone_cap,
 			   gdip_adjust_arrowcap_destroy,
-			   gdip_adjust_arrowcap_draw };
+			   gdip_adjust_arrowcap_compile };
 
 static void
 gdip_adjust_arrowcap_init (GpAdjustableArrowCap *arrow)
@@ -76,6 +77,10 @@ gdip_adjust_arrowcap_clone_cap (GpCustomLineCap *cap, GpCustomLineCap **clonedCa
 		return OutOfMemory;
 
 	memcpy (newcap, cap, sizeof (GpAdjustableArrowCap));
+	/* the compiled geometry isn't shared */
+	newcap->base.cache_width = 0.0;
+	newcap->base.fill_cache = NULL;
+	newcap->base.stroke_cache = NULL;
 	*clonedCap = (GpCustomLineCap *) newcap;
 
 	return Ok;
@@ -87,6 +92,7 @@ gdip_adjust_arrowcap_destroy (GpCustomLineCap *cap)
 	if (!cap)
 		return InvalidParameter;
 
+	gdip_linecap_invalidate (cap);
 	GdipFree (cap);
 	return Ok;
 }
@@ -102,49 +108,44 @@ gdip_adjust_arrowcap_setup (GpGraphics *graphics, GpCustomLineCap *customCap)
 }
 
 GpStatus
-gdip_adjust_arrowcap_draw (GpGraphics *graphics, GpPen *pen, GpCustomLineCap *customCap, float x, float y, float otherend_x, float otherend_y)
+gdip_adjust_arrowcap_compile (GpCustomLineCap *customCap, float penwidth, cairo_path_t **fill, cairo_path_t **stroke)
 {
-	double angle;
-	GpAdjustableArrowCap *arrowcap;
-	float w;
-	float h;
-	float penwidth;
+	GpAdjustableArrowCap *arrowcap = (GpAdjustableArrowCap *)customCap;
+	GpPointF points [4];
+	BYTE types [4] = { PathPointTypeStart, PathPointTypeLine, PathPointTypeLine, PathPointTypeLine };
+	GpPath path;
+	float w = arrowcap->width / 2;
+	float h = arrowcap->height;
 
-	if (!graphics || !customCap)
-		return InvalidParameter;
-
-	penwidth = pen->width;
 	if (penwidth < 2.0) {
 		/* Seems to be a minimum */
 		penwidth = 2.0;
 	}
 
-	arrowcap = (GpAdjustableArrowCap *)customCap;
-	w = arrowcap->width / 2;
-	h = arrowcap->height;
-
-	angle = gdip_custom_linecap_angle (x, y, otherend_x, otherend_y);
-
-	cairo_save (graphics->ct);
-
-	/* FIXME: handle base_inset (including set/get!) */
-	cairo_translate (graphics->ct, x, y);
-	cairo_rotate (graphics->ct, angle);
-
-	gdip_cairo_move_to (graphics, 0, 0, TRUE, TRUE);
-	gdip_cairo_line_to (graphics, (double)-w * penwidth, (double)-h * penwidth, TRUE, TRUE);
-	gdip_cairo_line_to (graphics, (double)w * penwidth, (double)-h * penwidth, TRUE, TRUE);
-	gdip_cairo_line_to (graphics, 0, 0, TRUE, TRUE);
+	points [0].X = 0;
+	points [0].Y = 0;
+	points [1].X = -w;
+	points [1].Y = -h;
+	points [2].X = w;
+	points [2].Y = -h;
+	points [3].X = 0;
+	points [3].Y = 0;
+
+	path.count = 4;
+	path.points = points;
+	path.types = types;
+
+	*stroke = gdip_linecap_compile_path (&path, penwidth);
+	if (!*stroke)
+		return OutOfMemory;
 
 	if (arrowcap->fill_state) {
 		/* FIXME: handle middle_inset */
-		cairo_fill_preserve (graphics->ct);
+		*fill = gdip_linecap_compile_path (&path, penwidth);
+		if (!*fill)
+			return OutOfMemory;
 	}
 
-	cairo_stroke (graphics->ct);
-
-	cairo_restore (graphics->ct);
-
 	return Ok;
 }
 
@@ -158,6 +159,7 @@ update_adjustablearrowcap (GpAdjustableArrowCap *cap)
 	}
 
 	cap->base.base_cap = LineCapTriangle;
+	gdip_linecap_invalidate (&cap->base);
 }
 
 /* AdjustableArrowCap functions */
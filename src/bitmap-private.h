@@ -117,6 +117,10 @@ typedef struct _Image {
 	/* Internal fields */
 	int             cairo_format;
 	cairo_surface_t *surface;
+	/* Frames decoded on demand, when they are selected (e.g. GIF) */
+	void		*decoder;		/* codec data, NULL once every frame is decoded */
+	GpStatus	(*decode_frame) (struct _Image *bitmap, int frame, int index);
+	void		(*dispose_decoder) (void *decoder);
 } GpBitmap;
 
 
@@ -129,6 +133,7 @@ ActiveBitmapData *gdip_frame_add_bitmapdata(FrameData *frame) GDIP_INTERNAL;
 GpStatus gdip_bitmap_dispose (GpBitmap *bitmap) GDIP_INTERNAL;
 GpStatus gdip_bitmap_clone (GpBitmap *bitmap, GpBitmap **clonedbitmap) GDIP_INTERNAL;
 GpStatus gdip_bitmap_setactive (GpBitmap *bitmap, const GUID *dimension, int index) GDIP_INTERNAL;
+GpStatus gdip_bitmap_decode_frames (GpBitmap *bitmap) GDIP_INTERNAL;
 GpStatus gdip_bitmapdata_clone (ActiveBitmapData *src, ActiveBitmapData **dest, int count) GDIP_INTERNAL;
 ColorPalette *gdip_palette_clone(ColorPalette *original) GDIP_INTERNAL;
 GpStatus gdip_property_get_short (int offset, void *value, unsigned short *result) GDIP_INTERNAL;
@@ -580,10 +580,62 @@ gdip_palette_clone (ColorPalette *original)
 	return result;
 }
 
+/* Frames of codecs decoding on demand (see gifcodec.c) get their pixels when selected, which may be shared */
+static GpStatus
+gdip_bitmap_decode_frame (GpBitmap *bitmap, int frame, int index)
+{
+	if (!bitmap->decoder || bitmap->frames[frame].bitmap[index].scan0)
+		return Ok;
+
+	return bitmap->decode_frame (bitmap, frame, index);
+}
+
+/* For the code using every frame at once, e.g. encoders, the frames get their own pixels */
+GpStatus
+gdip_bitmap_decode_frames (GpBitmap *bitmap)
+{
+	ActiveBitmapData	*data;
+	GpStatus	status;
+	BYTE		*scan0;
+	int		frame;
+	int		i;
+
+	if (!bitmap->decoder)
+		return Ok;
+
+	/* the surface may use the pixels of the decoder */
+	gdip_bitmap_flush_surface (bitmap);
+	gdip_bitmap_invalidate_surface (bitmap);
+
+	for (frame = 0; frame < bitmap->num_of_frames; frame++) {
+		for (i = 0; i < bitmap->frames[frame].count; i++) {
+			status = gdip_bitmap_decode_frame (bitmap, frame, i);
+			if (status != Ok)
+				return status;
+
+			data = &bitmap->frames[frame].bitmap[i];
+			if ((data->reserved & GBD_OWN_SCAN0) == 0) {
+				scan0 = GdipAlloc ((size_t) data->stride * data->height);
+				if (!scan0)
+					return OutOfMemory;
+
+				memcpy (scan0, data->scan0, (size_t) data->stride * data->height);
+				data->scan0 = scan0;
+				data->reserved |= GBD_OWN_SCAN0;
+			}
+		}
+	}
+
+	bitmap->dispose_decoder (bitmap->decoder);
+	bitmap->decoder = NULL;
+	return Ok;
+}
+
 GpStatus
 gdip_bitmap_setactive(GpBitmap *bitmap, const GUID *dimension, int index)
 {
-	int	i;
+	GpStatus	status;
+	int		i;
 
 	if (bitmap == NULL) {
 		return InvalidParameter;
@@ -604,6 +656,10 @@ gdip_bitmap_setactive(GpBitmap *bitmap, const GUID *dimension, int index)
 		if (bitmap->frames[0].count <= index) {
 			return InvalidParameter;
 		}
+		status = gdip_bitmap_decode_frame (bitmap, 0, index);
+		if (status != Ok) {
+			return status;
+		}
 		bitmap->active_frame = 0;
 		bitmap->active_bitmap_no = index;
 		bitmap->active_bitmap = &bitmap->frames[0].bitmap[index];
@@ -615,6 +671,10 @@ gdip_bitmap_setactive(GpBitmap *bitmap, const GUID *dimension, int index)
 			if (bitmap->frames[i].count <= index) {
 				return Win32Error;
 			}
+			status = gdip_bitmap_decode_frame (bitmap, i, index);
+			if (status != Ok) {
+				return status;
+			}
 			bitmap->active_frame = i;
 			bitmap->active_bitmap_no = index;
 			bitmap->active_bitmap = &bitmap->frames[i].bitmap[index];
@@ -635,6 +695,12 @@ gdip_bitmap_clone (GpBitmap *bitmap, GpBitmap **clonedbitmap)
 	int		frame;
 	GpStatus	status;
 
+	/* the clone doesn't share the decoder */
+	status = gdip_bitmap_decode_frames (bitmap);
+	if (status != Ok) {
+		return status;
+	}
+
 	result = (GpBitmap *) GdipAlloc (sizeof (GpBitmap));
 	if (result == NULL) {
 		return OutOfMemory;
@@ -651,6 +717,9 @@ gdip_bitmap_clone (GpBitmap *bitmap, GpBitmap **clonedbitmap)
 	result->active_bitmap = NULL;
 	result->cairo_format = bitmap->cairo_format;
 	result->surface = NULL;
+	result->decoder = NULL;
+	result->decode_frame = NULL;
+	result->dispose_decoder = NULL;
 
 	/* Allocate and copy frames, properties and bitmap data */
 	if (bitmap->frames != NULL) {
@@ -731,6 +800,11 @@ gdip_bitmap_dispose (GpBitmap *bitmap)
 
 	gdip_bitmap_invalidate_surface (bitmap);
 
+	if (bitmap->decoder) {
+		bitmap->dispose_decoder (bitmap->decoder);
+		bitmap->decoder = NULL;
+	}
+
 	if (bitmap->frames) {
 		int frame;
 		for (frame = 0; frame < bitmap->num_of_frames; frame++) {
@@ -216,6 +216,86 @@ gdip_bitmap_fill_info_header (GpBitmap *bitmap, PBITMAPINFOHEADER bmi)
 #endif
 }                                                           
 
+#define BMP_RLE_WINDOW_SIZE	4096
+
+/* Window over the compressed data, so that RLE codes, pixels and deltas don't each go through the source dispatch */
+typedef struct {
+	void		*pointer;
+	ImageSource	source;
+	const BYTE	*data;
+	int		available;
+	BYTE		buffer[BMP_RLE_WINDOW_SIZE];
+} BmpRleInput;
+
+static void
+gdip_bmp_rle_input_init (BmpRleInput *input, void *pointer, ImageSource source)
+{
+	input->pointer = pointer;
+	input->source = source;
+	input->data = NULL;
+	input->available = 0;
+
+	/* memory sources are used in place, the rest of the data being the window */
+	if (source == Memory) {
+		MemorySource *ms = (MemorySource *) pointer;
+
+		if (ms->pos < ms->size) {
+			input->data = ms->ptr + ms->pos;
+			input->available = ms->size - ms->pos;
+			ms->pos = ms->size;
+		}
+	}
+}
+
+static BOOL
+gdip_bmp_rle_fill (BmpRleInput *input)
+{
+	int size_read;
+
+	if (input->available > 0)
+		return TRUE;
+	if (input->source == Memory)
+		return FALSE;
+
+	/* the compressed data is the last thing read from the source, reading ahead is harmless */
+	size_read = gdip_read_bmp_data (input->pointer, input->buffer, BMP_RLE_WINDOW_SIZE, input->source);
+	if (size_read <= 0)
+		return FALSE;
+
+	input->data = input->buffer;
+	input->available = size_read;
+	return TRUE;
+}
+
+/* Same contract as gdip_read_bmp_data, returns the number of bytes copied */
+static int
+gdip_bmp_rle_read (BmpRleInput *input, BYTE *data, int size)
+{
+	int total = 0;
+
+	while ((total < size) && gdip_bmp_rle_fill (input)) {
+		int len = MIN (size - total, input->available);
+
+		memcpy (data + total, input->data, len);
+		input->data += len;
+		input->available -= len;
+		total += len;
+	}
+
+	return total;
+}
+
+static inline int
+gdip_bmp_rle_byte (BmpRleInput *input, BYTE *data)
+{
+	if ((input->available <= 0) && !gdip_bmp_rle_fill (input))
+		return 0;
+
+	*data = *input->data++;
+	input->available--;
+	return 1;
+}
+
 static void
 gdip_read_bmp_rle_8bit (void *pointer, BYTE *scan0, BOOL upsidedown, int stride, int scanWidth, int scanCount, ImageSource source)
 {
@@ -228,6 +308,7 @@ gdip_read_bmp_rle_8bit (void *pointer, BYTE *scan0, BOOL upsidedown, int stride,
 	int rows_remaining = scanCount;
 	int size = scanCount * stride;
 	BOOL new_row = FALSE;
+	BmpRleInput input;
 
 	if (!upsidedown)
 		return; /* top to bottom images can't be compressed */
@@ -235,15 +316,17 @@ gdip_read_bmp_rle_8bit (void *pointer, BYTE *scan0, BOOL upsidedown, int stride,
 	if (scanWidth > stride)
 		return;
 
+	gdip_bmp_rle_input_init (&input, pointer, source);
+
 	while ((rows_remaining > 0)
 	    || ((row_offset == 0) && (col_offset < scanWidth))) {
-		bytes_read = gdip_read_bmp_data (pointer, &code, 1, source);
+		bytes_read = gdip_bmp_rle_byte (&input, &code);
 
 		if (bytes_read < 1)
 			return; /* TODO?: Add an "unexpected end of file" error code */
 
 		if (code == 0) { /* RLE escape code */
-			bytes_read = gdip_read_bmp_data (pointer, &code, 1, source);
+			bytes_read = gdip_bmp_rle_byte (&input, &code);
 
 			if (bytes_read < 1)
 				return; /* TODO?: Add an "unexpected end of file" error code */
@@ -269,8 +352,8 @@ gdip_read_bmp_rle_8bit (void *pointer, BYTE *scan0, BOOL upsidedown, int stride,
 				{
 					BYTE dx, dy;
 
-					bytes_read  = gdip_read_bmp_data (pointer, &dx, 1, source);
-					bytes_read += gdip_read_bmp_data (pointer, &dy, 1, source);
+					bytes_read  = gdip_bmp_rle_byte (&input, &dx);
+					bytes_read += gdip_bmp_rle_byte (&input, &dy);
 
 					if (bytes_read < 2)
 						return; /* TODO?: Add an "unexpected end of file" error code */
@@ -305,11 +388,7 @@ gdip_read_bmp_rle_8bit (void *pointer, BYTE *scan0, BOOL upsidedown, int stride,
 						if (pixel_index < 0 || pixel_index >= size)
 							return;
 
-						bytes_read = gdip_read_bmp_data (
-							pointer,
-							&scan0[pixel_index],
-							bytes_to_read_this_scan,
-							source);
+						bytes_read = gdip_bmp_rle_read (&input, &scan0[pixel_index], bytes_to_read_this_scan);
 
 						if (bytes_read < bytes_to_read_this_scan)
 							return; /* TODO?: Add an "unexpected end of file" error code */
@@ -333,7 +412,7 @@ gdip_read_bmp_rle_8bit (void *pointer, BYTE *scan0, BOOL upsidedown, int stride,
 					}
 
 					if (pad_byte_present) {
-						bytes_read = gdip_read_bmp_data(pointer, &code, 1, source);
+						bytes_read = gdip_bmp_rle_byte (&input, &code);
 
 						if (bytes_read < 1)
 							return; /* TODO?: Add an "unexpected end of file" error code */
@@ -348,7 +427,7 @@ gdip_read_bmp_rle_8bit (void *pointer, BYTE *scan0, BOOL upsidedown, int stride,
 			int run_length = code;
 			BYTE pixel_value;
 
-			bytes_read = gdip_read_bmp_data(pointer, &pixel_value, 1, source);
+			bytes_read = gdip_bmp_rle_byte (&input, &pixel_value);
 
 			if (bytes_read < 1)
 				return; /* TODO?: Add an "unexpected end of file" error code */
@@ -434,6 +513,7 @@ gdip_read_bmp_rle_4bit (void *pointer, BYTE *scan0, BOOL upsidedown, int stride,
 	int rows_remaining = scanCount;
 	int size = scanCount * stride;
 	BOOL new_row = FALSE;
+	BmpRleInput input;
 
 	if (!upsidedown)
 		return; /* top to bottom images can't be compressed */
@@ -444,14 +524,16 @@ gdip_read_bmp_rle_4bit (void *pointer, BYTE *scan0, BOOL upsidedown, int stride,
 	if (scanWidth > stride * 2)
 		return;
 
+	gdip_bmp_rle_input_init (&input, pointer, source);
+
 	while (rows_remaining > 0) {
-		bytes_read = gdip_read_bmp_data (pointer, &code, 1, source);
+		bytes_read = gdip_bmp_rle_byte (&input, &code);
 
 		if (bytes_read < 1)
 			return; /* TODO?: Add an "unexpected end of file" error code */
 
 		if (code == 0) { /* RLE escape code */
-			bytes_read = gdip_read_bmp_data (pointer, &code, 1, source);
+			bytes_read = gdip_bmp_rle_byte (&input, &code);
 
 			if (bytes_read < 1)
 				return; /* TODO?: Add an "unexpected end of file" error code */
@@ -477,8 +559,8 @@ gdip_read_bmp_rle_4bit (void *pointer, BYTE *scan0, BOOL upsidedown, int stride,
 				{
 					BYTE dx, dy;
 
-					bytes_read  = gdip_read_bmp_data (pointer, &dx, 1, source);
-					bytes_read += gdip_read_bmp_data (pointer, &dy, 1, source);
+					bytes_read  = gdip_bmp_rle_byte (&input, &dx);
+					bytes_read += gdip_bmp_rle_byte (&input, &dy);
 
 					if (bytes_read < 2)
 						return; /* TODO?: Add an "unexpected end of file" error code */
@@ -516,7 +598,7 @@ gdip_read_bmp_rle_4bit (void *pointer, BYTE *scan0, BOOL upsidedown, int stride,
 							if (pixel_index < 0 || pixel_index >= size)
 								return;
 
-							bytes_read = gdip_read_bmp_data (pointer, &pixels, 1, source);
+							bytes_read = gdip_bmp_rle_byte (&input, &pixels);
 
 							if (bytes_read < 1)
 								return; /* TODO?: Add an "unexpected end of file" error code */
@@ -563,11 +645,7 @@ gdip_read_bmp_rle_4bit (void *pointer, BYTE *scan0, BOOL upsidedown, int stride,
 							if (pixel_index < 0 || pixel_index >= size)
 								return;
 
-							bytes_read = gdip_read_bmp_data (
-								pointer,
-								&scan0[pixel_index],
-								bytes_to_read_this_scan,
-								source);
+							bytes_read = gdip_bmp_rle_read (&input, &scan0[pixel_index], bytes_to_read_this_scan);
 
 							if (bytes_read < bytes_to_read_this_scan)
 								return; /* TODO?: Add an "unexpected end of file" error code */
@@ -594,7 +672,7 @@ gdip_read_bmp_rle_4bit (void *pointer, BYTE *scan0, BOOL upsidedown, int stride,
 							while (bytes_to_read_this_scan >= 0) {
 								BYTE pixels;
 
-								bytes_read = gdip_read_bmp_data (pointer, &pixels, 1, source);
+								bytes_read = gdip_bmp_rle_byte (&input, &pixels);
 
 								if (bytes_read < 1)
 									return; /* TODO?: Add an "unexpected end of file" error code */
@@ -635,7 +713,7 @@ gdip_read_bmp_rle_4bit (void *pointer, BYTE *scan0, BOOL upsidedown, int stride,
 						if (pixel_index < 0 || pixel_index >= size)
 							return;
 
-						bytes_read = gdip_read_bmp_data (pointer, &pixel, 1, source);
+						bytes_read = gdip_bmp_rle_byte (&input, &pixel);
 
 						if (bytes_read < 1)
 							return; /* TODO?: Add an "unexpected end of file" error code */
@@ -666,7 +744,7 @@ gdip_read_bmp_rle_4bit (void *pointer, BYTE *scan0, BOOL upsidedown, int stride,
 					}
 
 					if (pad_byte_present) {
-						bytes_read = gdip_read_bmp_data(pointer, &code, 1, source);
+						bytes_read = gdip_bmp_rle_byte (&input, &code);
 
 						if (bytes_read < 1)
 							return; /* TODO?: Add an "unexpected end of file" error code */
@@ -689,7 +767,7 @@ gdip_read_bmp_rle_4bit (void *pointer, BYTE *scan0, BOOL upsidedown, int stride,
 			BYTE pixel_values;
 			BYTE inverted_pixel_values;
 
-			bytes_read = gdip_read_bmp_data(pointer, &pixel_values, 1, source);
+			bytes_read = gdip_bmp_rle_byte (&input, &pixel_values);
 
 			if (bytes_read < 1)
 				return; /* TODO?: Add an "unexpected end of file" error code */
@@ -1044,71 +1122,145 @@ gdip_readbmp_palette (void *pointer, ImageSource source, const BITMAPV5HEADER *b
 	return Ok;
 }
 
+/* Returns the next size bytes of a memory source in place, NULL for other sources or if they are not all there */
+static const BYTE *
+gdip_bmp_data_pointer (void *pointer, int size, ImageSource source)
+{
+	MemorySource *ms;
+
+	if (source != Memory)
+		return NULL;
+
+	ms = (MemorySource *) pointer;
+	if (size > ms->size - ms->pos)
+		return NULL;
+
+	ms->pos += size;
+	return ms->ptr + ms->pos - size;
+}
+
+/* The row converters below are plain loops over independent pixels so the compiler can vectorize them. */
+static void
+gdip_bmp_convert_16bppRGB555 (const BYTE *src, BYTE *dest, int width)
+{
+	ARGB *pixel = (ARGB *) dest;
+
+	for (int x = 0; x < width; x++) {
+		unsigned int value = src[x * 2] | (src[x * 2 + 1] << 8);
+		unsigned int r = (value >> 10) & 0x1F;
+		unsigned int g = (value >> 5) & 0x1F;
+		unsigned int b = value & 0x1F;
+
+		pixel[x] = 0xFF000000 | (((r << 3) | (r >> 2)) << 16) | (((g << 3) | (g >> 2)) << 8) | (b << 3) | (b >> 2);
+	}
+}
+
+static void
+gdip_bmp_convert_16bppRGB565 (const BYTE *src, BYTE *dest, int width)
+{
+	ARGB *pixel = (ARGB *) dest;
+
+	for (int x = 0; x < width; x++) {
+		unsigned int value = src[x * 2] | (src[x * 2 + 1] << 8);
+		unsigned int r = (value >> 11) & 0x1F;
+		unsigned int g = (value >> 5) & 0x3F;
+		unsigned int b = value & 0x1F;
+
+		pixel[x] = 0xFF000000 | (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | (b << 3) | (b >> 2);
+	}
+}
+
+static void
+gdip_bmp_convert_24bppRGB (const BYTE *src, BYTE *dest, int width)
+{
+	ARGB *pixel = (ARGB *) dest;
+
+	for (int x = 0; x < width; x++)
+		pixel[x] = 0xFF000000 | (src[x * 3 + 2] << 16) | (src[x * 3 + 1] << 8) | src[x * 3];
+}
+
+static void
+gdip_bmp_convert_32bppRGB (const BYTE *src, BYTE *dest, int width)
+{
+	ARGB *pixel = (ARGB *) dest;
+
+	for (int x = 0; x < width; x++)
+		pixel[x] = 0xFF000000 | (src[x * 4 + 2] << 16) | (src[x * 4 + 1] << 8) | src[x * 4];
+}
+
+#define BMP_READ_BLOCK_SIZE	65536
+
 static GpStatus
 gdip_read_bmp_scans (void *pointer, BYTE *pixels, BOOL upsidedown, PixelFormat format, INT srcStride, INT destStride, INT width, INT height, ImageSource source)
 {
-	BYTE *scan = (BYTE *) GdipAlloc (srcStride);
-	if (!scan)
-		return OutOfMemory;
+	void (*convert) (const BYTE *src, BYTE *dest, int width);
+	BYTE *block = NULL;
+	int blockRows = 0;
+	int blockRow = 0;
+	BYTE *destScan;
+	INT destStep;
 
-	for (int y = 0; y < height; y++) {
-		int currentLine = upsidedown ? height - y - 1 : y;
-		int size_read = gdip_read_bmp_data (pointer, scan, srcStride, source);
-		if (size_read < srcStride) {
-			GdipFree (scan);
-			return OutOfMemory;
-		}
+	switch (format) {
+	case PixelFormat1bppIndexed:
+	case PixelFormat4bppIndexed:
+	case PixelFormat8bppIndexed:
+		convert = NULL;
+		break;
+	case PixelFormat16bppRGB555:
+		convert = gdip_bmp_convert_16bppRGB555;
+		break;
+	case PixelFormat16bppRGB565:
+		convert = gdip_bmp_convert_16bppRGB565;
+		break;
+	case PixelFormat24bppRGB:
+		convert = gdip_bmp_convert_24bppRGB;
+		break;
+	case PixelFormat32bppRGB:
+		convert = gdip_bmp_convert_32bppRGB;
+		break;
+	default:
+		return NotImplemented;
+	}
 
-		BYTE *destScan = pixels + currentLine * destStride;
-		switch (format) {
-			case PixelFormat1bppIndexed:
-			case PixelFormat4bppIndexed:
-			case PixelFormat8bppIndexed:
-				memcpy (destScan, scan, srcStride);
-				continue;
-			case PixelFormat16bppRGB555: {
-				for (int x = 0; x < width; x++) {
-					ARGB argb = gdip_getpixel_16bppRGB555 (scan, x);
-
-					BYTE a = (argb & 0xFF000000) >> 24;
-					BYTE r = (argb & 0x00FF0000) >> 16;
-					BYTE g = (argb & 0x0000FF00) >> 8;
-					BYTE b = (argb & 0x000000FF);
-					gdip_setpixel_32bppARGB (destScan, x, a, r, g, b);
-				}
-				continue;
-			}
-			case PixelFormat16bppRGB565: {
-				for (int x = 0; x < width; x++) {
-					ARGB argb = gdip_getpixel_16bppRGB565 (scan, x);
-
-					BYTE a = (argb & 0xFF000000) >> 24;
-					BYTE r = (argb & 0x00FF0000) >> 16;
-					BYTE g = (argb & 0x0000FF00) >> 8;
-					BYTE b = (argb & 0x000000FF);
-					gdip_setpixel_32bppARGB (destScan, x, a, r, g, b);
-				}
-				continue;
-			}
-			case PixelFormat24bppRGB: {
-				for (int x = 0; x < width; x++) {
-					gdip_setpixel_32bppARGB (destScan, x, 0xFF, scan[x * 3 + 2], scan[x * 3 + 1], scan[x * 3]);
+	/* bottom-up images are stored last line first, walk the destination with a negative stride */
+	if (upsidedown) {
+		destScan = pixels + (height - 1) * destStride;
+		destStep = -destStride;
+	} else {
+		destScan = pixels;
+		destStep = destStride;
+	}
+
+	for (int y = 0; y < height; y++, destScan += destStep) {
+		/* memory sources are converted in place, files and streams are read a block of lines at a time */
+		const BYTE *scan = gdip_bmp_data_pointer (pointer, srcStride, source);
+		if (!scan) {
+			if (blockRow == blockRows) {
+				int rows = MIN (height - y, MAX (1, BMP_READ_BLOCK_SIZE / srcStride));
+
+				if (!block) {
+					block = GdipAlloc ((size_t) srcStride * rows);
+					if (!block)
+						return OutOfMemory;
 				}
-				continue;
-			}
-			case PixelFormat32bppRGB: {
-				for (int x = 0; x < width; x++) {
-					gdip_setpixel_32bppARGB (destScan, x, 0xFF, scan[x * 4 + 2], scan[x * 4 + 1], scan[x * 4]);
+
+				if (gdip_read_bmp_data (pointer, block, srcStride * rows, source) < srcStride * rows) {
+					GdipFree (block);
+					return OutOfMemory;
 				}
-				continue;
+				blockRows = rows;
+				blockRow = 0;
 			}
-			default:
-				GdipFree(scan);
-				return NotImplemented;
+			scan = block + blockRow++ * srcStride;
 		}
+
+		if (convert)
+			convert (scan, destScan, width);
+		else
+			memcpy (destScan, scan, srcStride);
 	}
 
-	GdipFree(scan);
+	GdipFree (block);
 	return Ok;
 }
 
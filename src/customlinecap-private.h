@@ -42,7 +42,7 @@ typedef struct _CapClass {
 	GpStatus (*setup) (GpGraphics *graphics, GpCustomLineCap *cap);
 	GpStatus (*clone_cap) (GpCustomLineCap *cap, GpCustomLineCap **clonedCap);
 	GpStatus (*destroy) (GpCustomLineCap *cap);
-	GpStatus (*draw) (GpGraphics *graphics, GpPen *pen, GpCustomLineCap *cap, float x, float y, float otherend_x, float otherend_y);
+	GpStatus (*compile) (GpCustomLineCap *cap, float penwidth, cairo_path_t **fill, cairo_path_t **stroke);
 } CapClass;
 
 typedef struct _CustomLineCap {
@@ -55,11 +55,17 @@ typedef struct _CustomLineCap {
 	GpLineJoin stroke_join;
 	float base_inset;
 	float width_scale;
+	/* geometry compiled for the last pen width, in the cap coordinates */
+	float cache_width;
+	cairo_path_t *fill_cache;
+	cairo_path_t *stroke_cache;
 } CustomLineCap;
 
 void gdip_custom_linecap_init (GpCustomLineCap *cap, CapClass *vt) GDIP_INTERNAL;
 GpStatus gdip_linecap_setup (GpGraphics *graphics, GpCustomLineCap *customCap) GDIP_INTERNAL;
-GpStatus gdip_linecap_draw (GpGraphics *graphics, GpPen *pen, GpCustomLineCap *customCap, float x, float y, float otherend_x, float otherend_y) GDIP_INTERNAL;
+BOOL gdip_linecap_append (GpGraphics *graphics, GpPen *pen, GpCustomLineCap *customCap, BOOL fill, float x, float y, float otherend_x, float otherend_y) GDIP_INTERNAL;
+void gdip_linecap_invalidate (GpCustomLineCap *customCap) GDIP_INTERNAL;
+cairo_path_t *gdip_linecap_compile_path (GpPath *path, float scale) GDIP_INTERNAL;
 double gdip_custom_linecap_angle (float x, float y, float otherend_x, float otherend_y);
 
 #include "customlinecap.h"
@@ -33,7 +33,7 @@
 static GpStatus gdip_custom_linecap_setup (GpGraphics *graphics, GpCustomLineCap *cap);
 static GpStatus gdip_custom_linecap_clone_cap (GpCustomLineCap *cap, GpCustomLineCap **clonedCap);
 static GpStatus gdip_custom_linecap_destroy (GpCustomLineCap *cap);
-static GpStatus gdip_custom_linecap_draw (GpGraphics *graphics, GpPen *pen, GpCustomLineCap *cap, float x, float y, float otherend_x, float otherend_y);
+static GpStatus gdip_custom_linecap_compile (GpCustomLineCap *cap, float penwidth, cairo_path_t **fill, cairo_path_t **stroke);
 
 /*
  * we have a single copy of vtable for
@@ -44,7 +44,7 @@ static CapClass vtable = { CustomLineCapTypeDefault,
 			   gdip_custom_linecap_setup,
 			   gdip_custom_linecap_clone_cap,
 			   gdip_custom_linecap_destroy,
-			   gdip_custom_linecap_draw };
+			   gdip_custom_linecap_compile };
 
 void
 gdip_custom_linecap_init (GpCustomLineCap *cap, CapClass *vt)
@@ -58,6 +58,9 @@ gdip_custom_linecap_init (GpCustomLineCap *cap, CapClass *vt)
 	cap->width_scale = 1.0;
 	cap->fill_path = NULL;
 	cap->stroke_path = NULL;
+	cap->cache_width = 0.0;
+	cap->fill_cache = NULL;
+	cap->stroke_cache = NULL;
 }
 
 static GpCustomLineCap*
@@ -91,6 +94,9 @@ gdip_custom_linecap_clone_cap (GpCustomLineCap *cap, GpCustomLineCap **clonedCap
 	newcap->stroke_join = cap->stroke_join;
 	newcap->base_inset = cap->base_inset;
 	newcap->width_scale = cap->width_scale;
+	newcap->cache_width = 0.0;
+	newcap->fill_cache = NULL;
+	newcap->stroke_cache = NULL;
 
 	if (cap->fill_path) {
 		if (GdipClonePath (cap->fill_path, &fillpath) != Ok) {
@@ -132,6 +138,7 @@ gdip_custom_linecap_destroy (GpCustomLineCap *cap)
 		GdipDeletePath (cap->stroke_path);
 		cap->stroke_path = NULL;
 	}
+	gdip_linecap_invalidate (cap);
 	GdipFree (cap);
 
 	return Ok;
@@ -186,81 +193,178 @@ gdip_custom_linecap_angle (float x, float y, float otherend_x, float otherend_y)
 	return angle;
 }
 
-GpStatus
-gdip_custom_linecap_draw (GpGraphics *graphics, GpPen *pen, GpCustomLineCap *customCap, float x, float y, float otherend_x, float otherend_y)
+/* converts the path, scaled, into cairo path data that can be appended at each end point */
+cairo_path_t *
+gdip_linecap_compile_path (GpPath *path, float scale)
 {
-	double angle;
-	int points;
-	int i, idx = 0;
-	float penwidth;
-
-	if (!graphics || !pen || !customCap)
-		return InvalidParameter;
+	cairo_path_t *result;
+	cairo_path_data_t *data;
+	int i, length = 0;
+
+	for (i = 0; i < path->count; i++) {
+		BYTE type = path->types [i];
+
+		switch (type & PathPointTypePathTypeMask) {
+		case PathPointTypeStart:
+		case PathPointTypeLine:
+			length += 2;
+			break;
+		case PathPointTypeBezier:
+			/* each curve is made of 3 bezier points */
+			if (i + 2 < path->count)
+				length += 4;
+			i += 2;
+			type = path->types [MIN (i, path->count - 1)];
+			break;
+		default:
+			break;
+		}
 
-	penwidth = pen->width;
-	angle = gdip_custom_linecap_angle (x, y, otherend_x, otherend_y);
+		if (type & PathPointTypeCloseSubpath)
+			length++;
+	}
 
-	cairo_save (graphics->ct);
+	result = GdipAlloc (sizeof (cairo_path_t));
+	if (!result)
+		return NULL;
+
+	result->status = CAIRO_STATUS_SUCCESS;
+	result->num_data = 0;
+	result->data = data = GdipAlloc (MAX (length, 1) * sizeof (cairo_path_data_t));
+	if (!data) {
+		GdipFree (result);
+		return NULL;
+	}
 
-	/* FIXME: handle base_inset (including set/get!) */
-	cairo_translate (graphics->ct, x, y);
-	cairo_rotate (graphics->ct, angle);
-
-	if (customCap->stroke_path) {
-		GpPath *path = customCap->stroke_path;
-		points = path->count;
-
-		for (i = 0; i < points; i++) {
-			/* Adapted from gdip_plot_path() */
-			GpPointF point = path->points[i];
-			BYTE type = path->types[i];
-			GpPointF pts [3];
-
-			/* mask the bits so that we get only the type value not the other flags */
-			switch (type & PathPointTypePathTypeMask) {
-			case PathPointTypeStart:
-				gdip_cairo_move_to (graphics, (double)point.X * penwidth, (double)point.Y * penwidth, TRUE, TRUE);
-				break;
-
-			case PathPointTypeLine:
-				gdip_cairo_line_to (graphics, (double)point.X * penwidth, (double)point.Y * penwidth, TRUE, TRUE);
-				break;
-
-			case PathPointTypeBezier:
-				/* make sure we only add at most 3 points to pts */
-				if (idx < 3) {
-					pts [idx] = point;
-					idx ++;
+	for (i = 0; i < path->count; i++) {
+		GpPointF *point = &path->points [i];
+		BYTE type = path->types [i];
+
+		switch (type & PathPointTypePathTypeMask) {
+		case PathPointTypeStart:
+		case PathPointTypeLine:
+			data->header.type = ((type & PathPointTypePathTypeMask) == PathPointTypeStart) ? CAIRO_PATH_MOVE_TO : CAIRO_PATH_LINE_TO;
+			data->header.length = 2;
+			data [1].point.x = point->X * scale;
+			data [1].point.y = point->Y * scale;
+			data += 2;
+			break;
+		case PathPointTypeBezier:
+			if (i + 2 < path->count) {
+				int j;
+
+				data->header.type = CAIRO_PATH_CURVE_TO;
+				data->header.length = 4;
+				for (j = 0; j < 3; j++) {
+					data [j + 1].point.x = point [j].X * scale;
+					data [j + 1].point.y = point [j].Y * scale;
 				}
+				data += 4;
+			}
+			i += 2;
+			type = path->types [MIN (i, path->count - 1)];
+			break;
+		default:
+			break;
+		}
 
-				/* once we've added 3 pts, we can draw the curve */
-				if (idx == 3) {
-					gdip_cairo_curve_to (graphics, (double)pts[0].X * penwidth, (double)pts[0].Y * penwidth, (double)pts[1].X * penwidth, (double)pts[1].Y * penwidth, (double)pts[2].X * penwidth, (double)pts[2].Y * penwidth, TRUE, TRUE);
-					idx = 0;
-				}
-				break;
+		if (type & PathPointTypeCloseSubpath) {
+			data->header.type = CAIRO_PATH_CLOSE_PATH;
+			data->header.length = 1;
+			data++;
+		}
+	}
 
-			default:
-				g_warning ("Unknown PathPointType %d", type);
-				return NotImplemented;
-			}
+	result->num_data = data - result->data;
+	return result;
+}
 
-			/* close the subpath */
-			if (type & PathPointTypeCloseSubpath) {
-				cairo_close_path (graphics->ct);
-			}
+static void
+gdip_linecap_free_path (cairo_path_t *path)
+{
+	if (path) {
+		GdipFree (path->data);
+		GdipFree (path);
+	}
+}
+
+void
+gdip_linecap_invalidate (GpCustomLineCap *customCap)
+{
+	gdip_linecap_free_path (customCap->fill_cache);
+	gdip_linecap_free_path (customCap->stroke_cache);
+	customCap->fill_cache = NULL;
+	customCap->stroke_cache = NULL;
+	customCap->cache_width = 0.0;
+}
+
+static GpStatus
+gdip_custom_linecap_compile (GpCustomLineCap *cap, float penwidth, cairo_path_t **fill, cairo_path_t **stroke)
+{
+	if (cap->fill_path) {
+		*fill = gdip_linecap_compile_path (cap->fill_path, penwidth);
+		if (!*fill)
+			return OutOfMemory;
+	}
+
+	if (cap->stroke_path) {
+		*stroke = gdip_linecap_compile_path (cap->stroke_path, penwidth);
+		if (!*stroke)
+			return OutOfMemory;
+	}
+
+	return Ok;
+}
+
+/*
+ * Appends the cap fill (or stroke) geometry at the end point (x, y) to the current path,
+ * without stroking it, so all the caps of a line can be filled and stroked at once.
+ * The geometry is compiled once per pen width and kept by the cap.
+ */
+BOOL
+gdip_linecap_append (GpGraphics *graphics, GpPen *pen, GpCustomLineCap *customCap, BOOL fill, float x, float y, float otherend_x, float otherend_y)
+{
+	cairo_path_t *path;
+
+	if (!graphics || !pen || !customCap)
+		return FALSE;
+
+	if ((customCap->cache_width != pen->width) || (!customCap->fill_cache && !customCap->stroke_cache)) {
+		cairo_path_t *fillPath = NULL, *strokePath = NULL;
+
+		if (customCap->vtable->compile (customCap, pen->width, &fillPath, &strokePath) != Ok) {
+			gdip_linecap_free_path (fillPath);
+			gdip_linecap_free_path (strokePath);
+			return FALSE;
 		}
 
-		gdip_pen_setup (graphics, pen);
-		cairo_stroke (graphics->ct);
-		gdip_cairo_set_matrix (graphics, graphics->copy_of_ctm);
+		gdip_linecap_invalidate (customCap);
+		customCap->fill_cache = fillPath;
+		customCap->stroke_cache = strokePath;
+		customCap->cache_width = pen->width;
 	}
 
-	/* FIXME: handle fill_path */
+	path = fill ? customCap->fill_cache : customCap->stroke_cache;
+	if (!path || (path->num_data == 0))
+		return FALSE;
 
-	cairo_restore (graphics->ct);
+	cairo_save (graphics->ct);
+
+	/* FIXME: handle base_inset (including set/get!) */
+	cairo_translate (graphics->ct, x, y);
+	cairo_rotate (graphics->ct, gdip_custom_linecap_angle (x, y, otherend_x, otherend_y));
+
+	/* same offset and unit conversion as gdip_cairo_move_to, in the cap coordinates */
+	if (!gdip_is_scaled (graphics))
+		cairo_translate (graphics->ct, graphics->aa_offset_x, graphics->aa_offset_y);
+	if (!OPTIMIZE_CONVERSION (graphics))
+		cairo_scale (graphics->ct, gdip_unitx_convgr (graphics, 1.0), gdip_unity_convgr (graphics, 1.0));
 
-	return gdip_get_status (cairo_status (graphics->ct));
+	cairo_append_path (graphics->ct, path);
+
+	/* the appended path keeps the device coordinates */
+	cairo_restore (graphics->ct);
+	return TRUE;
 }
 
 /* this setup function gets called from pen */
@@ -274,17 +378,6 @@ gdip_linecap_setup (GpGraphics *graphics, GpCustomLineCap *customCap)
 	return customCap->vtable->setup (graphics, customCap);
 }
 
-/* this draw function gets called from pen */
-
-GpStatus
-gdip_linecap_draw (GpGraphics *graphics, GpPen *pen, GpCustomLineCap *customCap, float x, float y, float otherend_x, float otherend_y)
-{
-	if (!graphics || !pen || !customCap)
-		return InvalidParameter;
-
-	return customCap->vtable->draw (graphics, pen, customCap, x, y, otherend_x, otherend_y);
-}
-
 /* CustomLineCap functions */
 
 // coverity[+alloc : arg-*4]
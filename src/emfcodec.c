@@ -104,13 +104,37 @@ GetColor (DWORD color)
 	return color;
 }
 
+/* read @num points, compact (16 bits) or not, starting at parameter @n */
+static void
+ReadPoints (BYTE *data, int n, GpPointF *pt, DWORD num, BOOL compact)
+{
+	int p;
+
+	for (p = 0; p < num; p++, pt++) {
+		if (compact) {
+			DWORD xy = GETDW(DWP(n));
+			n++;
+			pt->X = (xy & 0x0000FFFF);
+			pt->Y = (xy >> 16);
+		} else {
+			pt->X = GETDW(DWP(n));
+			n++;
+			pt->Y = GETDW(DWP(n));
+			n++;
+		}
+#ifdef DEBUG_EMF_3
+		printf ("\n\t\tpoint %g,%g", pt->X, pt->Y);
+#endif
+	}
+}
+
 static GpStatus
-PolyBezier (MetafilePlayContext *context, BYTE *data, int len, BOOL compact)
+PolyBezier (MetafileProgram *program, BYTE *data, int len, BOOL compact)
 {
 	DWORD num;
-	GpPointF *points, *pt;
-	GpStatus status;
-	int p, n = 0;
+	MetafileOp *op;
+	GpPointF *points;
+	int n = 0;
 	RECTL bounds;
 	bounds.left = GETDW(DWP(n));
 	n++;
@@ -141,56 +165,27 @@ PolyBezier (MetafilePlayContext *context, BYTE *data, int len, BOOL compact)
 	(void) bounds; // Avoid an unused variable warning.
 #endif
 
-	/* we need to supply the current x,y position */
-	points = (GpPointF*) GdipAlloc ((num + 1) * sizeof (GpPointF));
-	if (!points)
+	op = gdip_metafile_program_add (program, MetafileOpPolyBezier);
+	if (!op)
 		return OutOfMemory;
 
-	pt = points;
-	pt->X = context->current_x;
-	pt->Y = context->current_y;
-#ifdef DEBUG_EMF_2
-	printf ("\n\tmoveto to %g,%g", pt->X, pt->Y);
-#endif
-	context->path_x = pt->X;
-	context->path_y = pt->Y;
-	pt++;
-	for (p = 0; p < num; p++, pt++) {
-		if (compact) {
-			DWORD xy = GETDW(DWP(n));
-			n++;
-			pt->X = (xy & 0x0000FFFF);
-			pt->Y = (xy >> 16);
-		} else {
-			pt->X = GETDW(DWP(n));
-			n++;
-			pt->Y = GETDW(DWP(n));
-			n++;
-		}
-#ifdef DEBUG_EMF_2
-		printf ("\n\tbezier to %g,%g", pt->X, pt->Y);
-#endif
-	}
-	/* keep last point of the path so we can close the figure as GDI does (line) */
-	pt--;
-	context->current_x = pt->X;
-	context->current_y = pt->Y;
-
-	/* PolyBezier doesn't use the current point (GDI wise) but metafiles seems different */
-	status = gdip_metafile_PolyBezier (context, points, num + 1);
+	/* the first point is the current x,y position, only known when playing */
+	points = gdip_metafile_program_add_points (program, op, num + 1);
+	if (!points)
+		return OutOfMemory;
 
-	GdipFree (points);
-	return status;
+	ReadPoints (data, n, points + 1, num, compact);
+	return Ok;
 }
 
 /* the structure is different from WMF (16 or 32bits, RECTL bounds) */
 static GpStatus
-Polygon (MetafilePlayContext *context, BYTE *data, int len, BOOL compact)
+Polygon (MetafileProgram *program, BYTE *data, int len, BOOL compact)
 {
 	DWORD num;
-	GpPointF *points, *pt;
-	GpStatus status;
-	int p, n = 0;
+	MetafileOp *op;
+	GpPointF *points;
+	int n = 0;
 	RECTL bounds;
 	bounds.left = GETDW(DWP(n));
 	n++;
@@ -221,41 +216,30 @@ Polygon (MetafilePlayContext *context, BYTE *data, int len, BOOL compact)
 	(void) bounds; // Avoid an unused variable warning.
 #endif
 
-	points = (GpPointF*) GdipAlloc (num * sizeof (GpPointF));
-	if (!points)
+	op = gdip_metafile_program_add (program, MetafileOpPolygon);
+	if (!op)
 		return OutOfMemory;
 
-	for (p = 0, pt = points; p < num; p++, pt++) {
-		if (compact) {
-			DWORD xy = GETDW(DWP(n));
-			n++;
-			pt->X = (xy & 0x0000FFFF);
-			pt->Y = (xy >> 16);
-		} else {
-			pt->X = GETDW(DWP(n));
-			n++;
-			pt->Y = GETDW(DWP(n));
-			n++;
-		}
-#ifdef DEBUG_EMF_2
-		printf ("\n\tpoly to %g,%g", pt->X, pt->Y);
-#endif
-	}
-
-	status = gdip_metafile_Polygon (context, points, num);
+	points = gdip_metafile_program_add_points (program, op, num);
+	if (!points)
+		return OutOfMemory;
 
-	GdipFree (points);
-	return status;
+	ReadPoints (data, n, points, num, compact);
+	return Ok;
 }
 
-/* the structure is different from WMF */
+/* the structure is different from WMF, each polygon becomes its own operation */
 static GpStatus
-PolyPolygon (MetafilePlayContext *context, BYTE *data, BOOL compact)
+PolyPolygon (MetafileProgram *program, BYTE *data, int len, BOOL compact)
 {
-	GpStatus status = Ok;
-	int poly_num;
+	DWORD poly_num, total;
 	int n = 0;
+	int i, offset;
 	RECTL bounds;
+
+	if (len < 6 * (int) sizeof (DWORD))
+		return InvalidParameter;
+
 	bounds.left = GETDW(DWP(n));
 	n++;
 	bounds.top = GETDW(DWP(n));
@@ -270,14 +254,15 @@ PolyPolygon (MetafilePlayContext *context, BYTE *data, BOOL compact)
 	n++;
 
 	/* total number of points (in all polygons)*/
-	// int total = GETDW(DWP(n));
+	total = GETDW(DWP(n));
 	n++;
-	int i, j;
-	PointFList *list = GdipAlloc (poly_num * sizeof (PointFList));
-	if (!list)
-		return OutOfMemory;
 
-	PointFList *current = list;
+	/* make sure the sizes, and all the points, are available in this record */
+	if (poly_num > (len >> 2) || total > (len >> 2))
+		return InvalidParameter;
+	if (len < (6 + poly_num) * sizeof (DWORD) + total * (compact ? sizeof (DWORD) : 2 * sizeof (DWORD)))
+		return InvalidParameter;
+
 #ifdef DEBUG_EMF
 	printf ("PolyPolygon%s bounds [%d, %d, %d, %d] with %d polygons", (compact ? "16" : ""), 
 		bounds.left, bounds.top, bounds.right, bounds.bottom, poly_num);
@@ -285,59 +270,32 @@ PolyPolygon (MetafilePlayContext *context, BYTE *data, BOOL compact)
 	(void) bounds; // Avoid an unused variable warning.
 #endif
 
-	/* read size of each polygon and allocate the required memory */
+	/* points follow the size of each polygon */
+	offset = n + poly_num;
 	for (i = 0; i < poly_num; i++) {
-		current->num = GETDW(DWP(n));
-		n++;
-		current->points = (GpPointF*) GdipAlloc (current->num * sizeof (GpPointF));
-		if (!current->points) {
-			for (j = 0; j < i; j++) {
-				GdipFree (list[j].points);
-			}
+		DWORD num = GETDW(DWP(n + i));
+		MetafileOp *op;
+		GpPointF *points;
 
-			GdipFree (list);
-			return OutOfMemory;
-		}
+		if (num > total)
+			return InvalidParameter;
+		total -= num;
 
 #ifdef DEBUG_EMF_2
-		printf ("\n\tSub Polygon #%d has %d points", i, current->num);
+		printf ("\n\tSub Polygon #%d has %d points", i, num);
 #endif
-		current++;
-	}
-	/* read the points for each polygons */
-	current = list;
-	for (i = 0; i < poly_num; i++) {
-		GpPointF *pt = current->points;
-		int p;
-		for (p = 0; p < current->num; p++) {
-			if (compact) {
-				DWORD xy = GETDW(DWP(n));
-				n++;
-				pt->X = (xy & 0x0000FFFF);
-				pt->Y = (xy >> 16);
-			} else {
-				pt->X = GETDW(DWP(n));
-				n++;
-				pt->Y = GETDW(DWP(n));
-				n++;
-			}
-#ifdef DEBUG_EMF_3
-			printf ("\n\t\tpoly to %g,%g", pt->X, pt->Y);
-#endif
-			pt++;
-		}
+		op = gdip_metafile_program_add (program, MetafileOpPolygon);
+		if (!op)
+			return OutOfMemory;
 
-		GpStatus s = gdip_metafile_Polygon (context, current->points, current->num);
-		if (s != Ok)
-			status = s;
+		points = gdip_metafile_program_add_points (program, op, num);
+		if (!points)
+			return OutOfMemory;
 
-		/* free points */
-		GdipFree (current->points);
-		current++;
+		ReadPoints (data, offset, points, num, compact);
+		offset += compact ? num : num * 2;
 	}
-	/* all points were freed, after being drawn, so we just have to free the polygon list*/
-	GdipFree (list);
-	return status;
+	return Ok;
 }
 
 /* http://wvware.sourceforge.net/caolan/ora-wmf.html */
@@ -347,10 +305,17 @@ GdiComment (MetafilePlayContext *context, BYTE* data, DWORD size)
 #ifdef DEBUG_EMF
 	printf ("GdiComment record size %d", size);
 #endif
-	DWORD length = GETDW(DWP1);
+	DWORD length;
+
+	/* func, size, comment length and EMF+ signature */
+	if (size < 16)
+		return Ok;
+
+	/* the comment can't be longer than its record */
+	length = MIN (GETDW(DWP1), size - 12);
 	if (length >= 4) {
 		DWORD header = GETDW(DWP2);
-		if ((header == 0x2B464D45) && (size >= 8)) {
+		if (header == 0x2B464D45) {
 #ifdef DEBUG_EMF_2
 			printf (", EMF+ length %d", length);
 #endif
@@ -372,9 +337,36 @@ GdiComment (MetafilePlayContext *context, BYTE* data, DWORD size)
 	return Ok;
 }
 
+/* EMF+ blocks are played from the metafile data, other comments are dropped */
+static GpStatus
+CompileGdiComment (MetafileProgram *program, BYTE* data, DWORD size)
+{
+	MetafileOp *op;
+	DWORD length;
+
+	/* func, size, comment length and EMF+ signature */
+	if (size < 16)
+		return Ok;
+
+	/* the EMF+ block is played from the record, it can't extend past it */
+	length = MIN (GETDW(DWP1), size - 12);
+	if ((length < 4) || (GETDW(DWP2) != 0x2B464D45))
+		return Ok;
+
+	op = gdip_metafile_program_add (program, MetafileOpEmfPlus);
+	if (!op)
+		return OutOfMemory;
+
+	/* move past func, size, comment length, remove EMF+ comment header */
+	op->data = data + sizeof (DWORD) * 4;
+	op->count = length - sizeof (DWORD);
+	return Ok;
+}
+
 static GpStatus
-ExtCreatePen (MetafilePlayContext *context, BYTE *data, int size)
+ExtCreatePen (MetafileProgram *program, MetafilePlayContext *compiler, BYTE *data, int size)
 {
+	GpStatus status;
 	LOGBRUSH lb;
 #ifdef DEBUG_EMF
 	printf ("EMR_EXTCREATEPEN");
@@ -385,21 +377,63 @@ ExtCreatePen (MetafilePlayContext *context, BYTE *data, int size)
 	lb.lbStyle = GETDW(DWP8);
 	lb.lbColor = GetColor(GETDW(DWP9));
 	lb.lbHatch = GETDW(DWP10);
-	return gdip_metafile_ExtCreatePen (context, GETDW(DWP6), GETDW(DWP7), &lb, GETDW(DWP11), NULL);
+	status = gdip_metafile_ExtCreatePen (compiler, GETDW(DWP6), GETDW(DWP7), &lb, GETDW(DWP11), NULL);
+	if (status != Ok)
+		return status;
+
+	return gdip_metafile_program_add_created (program, compiler);
 }
 
 static GpStatus
-ModifyWorldTransform (MetafilePlayContext *context, float eM11, float eM12, float eM21, float eM22, 
+ModifyWorldTransform (MetafileProgram *program, float eM11, float eM12, float eM21, float eM22, 
 	float eDx, float eDy, DWORD iMode)
 {
-	XFORM xf;
-	xf.eM11 = eM11;
-	xf.eM12 = eM12;
-	xf.eM21 = eM21;
-	xf.eM22 = eM22;
-	xf.eDx  = eDx;
-	xf.eDy  = eDy;
-	return gdip_metafile_ModifyWorldTransform (context, &xf, iMode);
+	MetafileOp *op = gdip_metafile_program_add (program, MetafileOpModifyWorldTransform);
+	if (!op)
+		return OutOfMemory;
+
+	op->args.f [0] = eM11;
+	op->args.f [1] = eM12;
+	op->args.f [2] = eM21;
+	op->args.f [3] = eM22;
+	op->args.f [4] = eDx;
+	op->args.f [5] = eDy;
+	op->args.i [6] = iMode;
+	return Ok;
+}
+
+static GpStatus
+StretchDIBits (MetafileProgram *program, BYTE *data, DWORD size)
+{
+	MetafileOp *op;
+	DWORD offBmi = GETDW(DWP(10));
+	DWORD cbBmi = GETDW(DWP(11));
+	DWORD offBits = GETDW(DWP(12));
+	DWORD cbBits = GETDW(DWP(13));
+#ifdef DEBUG_EMF
+	printf ("EMR_STRETCHDIBITS");
+#endif
+	/* the header and the pixels must both be inside the record */
+	if ((offBmi > size) || (cbBmi > size - offBmi) || (offBits > size) || (cbBits > size - offBits))
+		return InvalidParameter;
+	if ((cbBmi == 0) || (cbBits == 0))
+		return Ok;
+
+	op = gdip_metafile_program_add (program, MetafileOpStretchDIBits);
+	if (!op)
+		return OutOfMemory;
+
+	op->args.i [0] = GETDW(DWP5);	/* xDest */
+	op->args.i [1] = GETDW(DWP6);	/* yDest */
+	op->args.i [2] = GETDW(DWP(16));	/* cxDest */
+	op->args.i [3] = GETDW(DWP(17));	/* cyDest */
+	op->args.i [4] = GETDW(DWP7);	/* xSrc */
+	op->args.i [5] = GETDW(DWP8);	/* ySrc */
+	op->args.i [6] = GETDW(DWP9);	/* cxSrc */
+	op->args.i [7] = GETDW(DWP10);	/* cySrc */
+	op->args.i [8] = GETDW(DWP(14));	/* iUsageSrc */
+	op->args.i [9] = GETDW(DWP(15));	/* dwRop */
+	return gdip_metafile_program_add_dib (program, op, data + offBmi, cbBmi, data + offBits, cbBits);
 }
 
 /*
@@ -410,12 +444,14 @@ ModifyWorldTransform (MetafilePlayContext *context, float eM11, float eM12, floa
  * - The size parameter is represented in bytes (not in WORD like WMF);
  * - Minimum record size is 8 bytes (function DWORD + size DWORD);
  * - There are now a record types to start (1) and end (14) the metafiles;
+ *
+ * The records are compiled into @program, which gdip_metafile_play runs on every draw.
  */
 GpStatus
-gdip_metafile_play_emf (MetafilePlayContext *context)
+gdip_metafile_compile_emf (GpMetafile *metafile, MetafileProgram *program)
 {
 	GpStatus status = Ok;
-	GpMetafile *metafile = context->metafile;
+	MetafilePlayContext compiler;
 	BYTE *data = metafile->data;
 	BYTE *end = data + metafile->length;
 #ifdef DEBUG_EMF
@@ -425,6 +461,11 @@ gdip_metafile_play_emf (MetafilePlayContext *context)
 	if (!data)
 		return Ok;
 
+	/* tracks the state the compilation depends on, and receives the pens and brushes as they are created */
+	memset (&compiler, 0, sizeof (MetafilePlayContext));
+	compiler.metafile = metafile;
+	compiler.map_mode = MM_TEXT;
+
 	/* reality check - each record is, at minimum, 8 bytes long (when size == 0) */
 	while (data < end - EMF_MIN_RECORD_SIZE) {
 		/* record */
@@ -436,21 +477,21 @@ gdip_metafile_play_emf (MetafilePlayContext *context)
 #endif
 		switch (func) {
 		case EMR_POLYBEZIER:
-			status = PolyBezier (context, data, size - EMF_MIN_RECORD_SIZE, FALSE);
+			status = PolyBezier (program, data, size - EMF_MIN_RECORD_SIZE, FALSE);
 			break;
 		case EMR_POLYGON:
-			status = Polygon (context, data, size - EMF_MIN_RECORD_SIZE, FALSE);
+			status = Polygon (program, data, size - EMF_MIN_RECORD_SIZE, FALSE);
 			break;
 		case EMR_POLYPOLYGON:
-			status = PolyPolygon (context, data, FALSE);
+			status = PolyPolygon (program, data, size - EMF_MIN_RECORD_SIZE, FALSE);
 			break;
 		case EMR_SETWINDOWEXTEX:
 			EMF_CHECK_PARAMS(2);
-			status = gdip_metafile_SetWindowExt (context, GETDW(DWP1), GETDW(DWP2));
+			status = gdip_metafile_program_window_ext (program, &compiler, GETDW(DWP1), GETDW(DWP2));
 			break;
 		case EMR_SETWINDOWORGEX:
 			EMF_CHECK_PARAMS(2);
-			status = gdip_metafile_SetWindowOrg (context, GETDW(DWP1), GETDW(DWP2));
+			status = gdip_metafile_program_add_simple (program, MetafileOpSetWindowOrg, GETDW(DWP1), GETDW(DWP2));
 			break;
 		case EMR_SETVIEWPORTEXTEX:
 			EMF_CHECK_PARAMS(2);
@@ -475,26 +516,26 @@ gdip_metafile_play_emf (MetafilePlayContext *context)
 			goto cleanup;
 		case EMR_SETMAPMODE:
 			EMF_CHECK_PARAMS(1);
-			status = gdip_metafile_SetMapMode (context, GETDW(DWP1));
+			status = gdip_metafile_program_map_mode (program, &compiler, GETDW(DWP1));
 			break;
 		case EMR_SETBKMODE:
 			EMF_CHECK_PARAMS(1);
-			status = gdip_metafile_SetBkMode (context, GETDW(DWP1));
+			status = gdip_metafile_program_add_simple (program, MetafileOpSetBkMode, GETDW(DWP1), 0);
 			break;
 		case EMR_SETPOLYFILLMODE:
 			EMF_CHECK_PARAMS(1);
-			status = gdip_metafile_SetPolyFillMode (context, GETDW(DWP1));
+			status = gdip_metafile_program_add_simple (program, MetafileOpSetPolyFillMode, GETDW(DWP1), 0);
 			break;
 		case EMR_SETROP2:
 			EMF_CHECK_PARAMS(1);
-			status = gdip_metafile_SetROP2 (context, GETDW(DWP1));
+			status = gdip_metafile_program_add_simple (program, MetafileOpSetROP2, GETDW(DWP1), 0);
 			break;
 		case EMR_SETSTRETCHBLTMODE:
 			NOTIMPLEMENTED("EMR_SETSTRETCHBLTMODE not implemented");
 			break;
 		case EMR_SETTEXTALIGN:
 			EMF_CHECK_PARAMS(1);
-			status = gdip_metafile_SetTextAlign (context, GETDW(DWP1));
+			status = gdip_metafile_program_add_simple (program, MetafileOpSetTextAlign, GETDW(DWP1), 0);
 			break;
 		case EMR_SETTEXTCOLOR:
 			EMF_CHECK_PARAMS(1);
@@ -502,7 +543,7 @@ gdip_metafile_play_emf (MetafilePlayContext *context)
 			break;
 		case EMR_MOVETOEX:
 			EMF_CHECK_PARAMS(2);
-			status = gdip_metafile_MoveTo (context, GETDW(DWP1), GETDW(DWP2));
+			status = gdip_metafile_program_add_simple (program, MetafileOpMoveTo, GETDW(DWP1), GETDW(DWP2));
 			break;
 		case EMR_INTERSECTCLIPRECT:
 			EMF_CHECK_PARAMS(4);
@@ -522,60 +563,70 @@ gdip_metafile_play_emf (MetafilePlayContext *context)
 			break;
 		case EMR_MODIFYWORLDTRANSFORM:
 			EMF_CHECK_PARAMS(7);
-			status = ModifyWorldTransform (context, GETFLOAT(DWP1), GETFLOAT(DWP2), GETFLOAT(DWP3), 
+			status = ModifyWorldTransform (program, GETFLOAT(DWP1), GETFLOAT(DWP2), GETFLOAT(DWP3), 
 				GETFLOAT(DWP4), GETFLOAT(DWP5), GETFLOAT(DWP6), GETDW(DWP7));
 			break;
 		case EMR_SELECTOBJECT:
 			EMF_CHECK_PARAMS(1);
-			status = gdip_metafile_SelectObject (context, GETDW(DWP1));
+			status = gdip_metafile_program_add_simple (program, MetafileOpSelectObject, GETDW(DWP1), 0);
 			break;
 		case EMR_CREATEPEN:
 			EMF_CHECK_PARAMS(5);
-			status = gdip_metafile_CreatePenIndirect (context, GETDW(DWP2), GETDW(DWP3), GETDW(DWP4));
+			status = gdip_metafile_CreatePenIndirect (&compiler, GETDW(DWP2), GETDW(DWP3), GETDW(DWP4));
+			if (status == Ok)
+				status = gdip_metafile_program_add_created (program, &compiler);
 			break;
 		case EMR_CREATEBRUSHINDIRECT:
 			EMF_CHECK_PARAMS(4);
 			/* 4 parameters provided, only 3 required in LOGBRUSH structure used in CreateBrushIndirect */
-			status = gdip_metafile_CreateBrushIndirect (context, GETDW(DWP4), GetColor(GETDW(DWP3)), GETDW(DWP2));
+			status = gdip_metafile_CreateBrushIndirect (&compiler, GETDW(DWP4), GetColor(GETDW(DWP3)), GETDW(DWP2));
+			if (status == Ok)
+				status = gdip_metafile_program_add_created (program, &compiler);
 			break;
 		case EMR_DELETEOBJECT:
 			EMF_CHECK_PARAMS(1);
-			status = gdip_metafile_DeleteObject (context, GETDW(DWP1));
+			status = gdip_metafile_program_add_simple (program, MetafileOpDeleteObject, GETDW(DWP1), 0);
 			break;
 		case EMR_LINETO:
 			EMF_CHECK_PARAMS(2);
-			status = gdip_metafile_LineTo (context, GETDW(DWP1), GETDW(DWP2));
+			status = gdip_metafile_program_add_simple (program, MetafileOpLineTo, GETDW(DWP1), GETDW(DWP2));
 			break;
-		case EMR_SETMITERLIMIT:
+		case EMR_SETMITERLIMIT: {
+			MetafileOp *op;
 			EMF_CHECK_PARAMS(1);
-			status = gdip_metafile_SetMiterLimit (context, GETDW(DWP1), NULL);
+			op = gdip_metafile_program_add (program, MetafileOpSetMiterLimit);
+			if (op)
+				op->args.f [0] = GETDW(DWP1);
+			else
+				status = OutOfMemory;
 			break;
+		}
 		case EMR_BEGINPATH:
 			EMF_CHECK_PARAMS(0);
-			status = gdip_metafile_BeginPath (context);
+			status = gdip_metafile_program_add_simple (program, MetafileOpBeginPath, 0, 0);
 			break;
 		case EMR_ENDPATH:
 			EMF_CHECK_PARAMS(0);
-			status = gdip_metafile_EndPath (context);
+			status = gdip_metafile_program_add_simple (program, MetafileOpEndPath, 0, 0);
 			break;
 		case EMR_CLOSEFIGURE:
 			EMF_CHECK_PARAMS(0);
-			status = gdip_metafile_CloseFigure (context);
+			status = gdip_metafile_program_add_simple (program, MetafileOpCloseFigure, 0, 0);
 			break;
 		case EMR_FILLPATH:
 			EMF_CHECK_PARAMS(4);
 			/* TODO - deal with all parameters, we have what looks like a rectangle (bounds?) */
-			status = gdip_metafile_FillPath (context);
+			status = gdip_metafile_program_add_simple (program, MetafileOpFillPath, 0, 0);
 			break;
 		case EMR_STROKEANDFILLPATH:
 			EMF_CHECK_PARAMS(4);
 			/* TODO - deal with all parameters, we have what looks like a rectangle (bounds?) */
-			status = gdip_metafile_StrokeAndFillPath (context);
+			status = gdip_metafile_program_add_simple (program, MetafileOpStrokeAndFillPath, 0, 0);
 			break;
 		case EMR_STROKEPATH:
 			EMF_CHECK_PARAMS(4);
 			/* TODO - deal with all parameters, we have what looks like a rectangle (bounds?) */
-			status = gdip_metafile_StrokePath (context);
+			status = gdip_metafile_program_add_simple (program, MetafileOpStrokePath, 0, 0);
 			break;
 		case EMR_SELECTCLIPPATH:
 			EMF_CHECK_PARAMS(1);
@@ -583,7 +634,11 @@ gdip_metafile_play_emf (MetafilePlayContext *context)
 			break;
 		case EMR_GDICOMMENT:
 			EMF_CHECK_PARAMS(1); /* record contains at least the size of the comment */
-			status = GdiComment (context, data, size);
+			if (size > (DWORD) (end - data)) {
+				status = InvalidParameter;
+				break;
+			}
+			status = CompileGdiComment (program, data, size);
 			break;
 		case EMR_EXTSELECTCLIPRGN:
 			EMF_CHECK_PARAMS(2);
@@ -598,18 +653,26 @@ gdip_metafile_play_emf (MetafilePlayContext *context)
 		case EMR_EXTTEXTOUTW:
 			NOTIMPLEMENTED("EMR_EXTTEXTOUTW");
 			break;
+		case EMR_STRETCHDIBITS:
+			EMF_CHECK_PARAMS(18);
+			if (size > (DWORD) (end - data)) {
+				status = InvalidParameter;
+				break;
+			}
+			status = StretchDIBits (program, data, size);
+			break;
 		case EMR_POLYGON16:
-			status = Polygon (context, data, size - EMF_MIN_RECORD_SIZE, TRUE);
+			status = Polygon (program, data, size - EMF_MIN_RECORD_SIZE, TRUE);
 			break;
 		case EMR_POLYBEZIERTO16:
-			status = PolyBezier (context, data, size - EMF_MIN_RECORD_SIZE, TRUE);
+			status = PolyBezier (program, data, size - EMF_MIN_RECORD_SIZE, TRUE);
 			break;
 		case EMR_POLYPOLYGON16:
-			status = PolyPolygon (context, data, TRUE);
+			status = PolyPolygon (program, data, size - EMF_MIN_RECORD_SIZE, TRUE);
 			break;
 		case EMR_EXTCREATEPEN:
 			EMF_CHECK_PARAMS(11);
-			status = ExtCreatePen (context, data, size);
+			status = ExtCreatePen (program, &compiler, data, size);
 			break;
 		default:
 			/* unprocessed records, ignore the data */
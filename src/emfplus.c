@@ -21,6 +21,20 @@
  */
 
 #include "emfplus.h"
+#include "bitmap-private.h"
+#include "font-private.h"
+#include "fontfamily-private.h"
+#include "graphics-path-private.h"
+#include "hatchbrush-private.h"
+#include "imageattributes-private.h"
+#include "lineargradientbrush-private.h"
+#include "matrix-private.h"
+#include "pathgradientbrush-private.h"
+#include "pen-private.h"
+#include "region-private.h"
+#include "stringformat-private.h"
+#include "texturebrush-private.h"
+#include "text.h"
 
 //#define DEBUG_EMFPLUS_ALL
 #ifdef DEBUG_EMFPLUS_ALL
@@ -30,8 +44,1233 @@
 #define DEBUG_EMFPLUS_NOTIMPLEMENTED
 #endif
 
+/*
+ * The record and object fields are read through a reader which never goes past the end of its data.
+ * Fields missing at the end read as 0 and mark the reader as failed, the record is then ignored.
+ */
+typedef struct {
+	const BYTE *data;
+	int size;
+	int pos;
+	BOOL failed;
+} EmfPlusReader;
+
+static void
+reader_init (EmfPlusReader *reader, const BYTE *data, int size)
+{
+	reader->data = data;
+	reader->size = size;
+	reader->pos = 0;
+	reader->failed = FALSE;
+}
+
+static const BYTE*
+read_bytes (EmfPlusReader *reader, int length)
+{
+	const BYTE *p;
+
+	if ((length < 0) || (length > reader->size - reader->pos)) {
+		reader->pos = reader->size;
+		reader->failed = TRUE;
+		return NULL;
+	}
+
+	p = reader->data + reader->pos;
+	reader->pos += length;
+	return p;
+}
+
+/* check that @count elements of at least @size bytes can follow, before allocating anything for them */
+static BOOL
+reader_has (EmfPlusReader *reader, DWORD count, int size)
+{
+	if (count <= (DWORD) ((reader->size - reader->pos) / size))
+		return TRUE;
+
+	reader->failed = TRUE;
+	return FALSE;
+}
+
+/* EMF+ is little endian, whatever the host is */
+static DWORD
+get_dword (const BYTE *p)
+{
+	return p [0] | (p [1] << 8) | (p [2] << 16) | ((DWORD) p [3] << 24);
+}
+
+static float
+get_float (const BYTE *p)
+{
+	union {
+		float f;
+		DWORD d;
+	} u;
+
+	u.d = get_dword (p);
+	return u.f;
+}
+
+static DWORD
+read_dword (EmfPlusReader *reader)
+{
+	const BYTE *p = read_bytes (reader, sizeof (DWORD));
+	return p ? get_dword (p) : 0;
+}
+
+static float
+read_float (EmfPlusReader *reader)
+{
+	const BYTE *p = read_bytes (reader, sizeof (float));
+	return p ? get_float (p) : 0;
+}
+
+static BOOL
+read_floats (EmfPlusReader *reader, float *values, int count)
+{
+	const BYTE *p = read_bytes (reader, count * sizeof (float));
+	int i;
+
+	if (!p)
+		return FALSE;
+
+	for (i = 0; i < count; i++, p += sizeof (float))
+		values [i] = get_float (p);
+	return TRUE;
+}
+
+static BOOL
+read_colors (EmfPlusReader *reader, ARGB *colors, int count)
+{
+	const BYTE *p = read_bytes (reader, count * sizeof (ARGB));
+	int i;
+
+	if (!p)
+		return FALSE;
+
+	for (i = 0; i < count; i++, p += sizeof (ARGB))
+		colors [i] = get_dword (p);
+	return TRUE;
+}
+
+static void
+read_matrix (EmfPlusReader *reader, GpMatrix *matrix)
+{
+	float m [6];
+
+	if (!read_floats (reader, m, 6)) {
+		cairo_matrix_init_identity (matrix);
+		return;
+	}
+
+	cairo_matrix_init (matrix, m [0], m [1], m [2], m [3], m [4], m [5]);
+}
+
+/* smallest encoding of a point, see read_points */
+static int
+point_size (WORD flags)
+{
+	if (flags & EMFPLUS_FLAGS_RELATIVE)
+		return 2;
+	if (flags & EMFPLUS_FLAGS_USE_INT16)
+		return 2 * sizeof (gint16);
+	return sizeof (GpPointF);
+}
+
+/* EmfPlusInteger7 (one byte) or EmfPlusInteger15 (two bytes, high byte first) */
+static int
+read_integer (EmfPlusReader *reader)
+{
+	const BYTE *p = read_bytes (reader, 1);
+	int value;
+
+	if (!p)
+		return 0;
+
+	if (!(p [0] & 0x80))
+		return (p [0] & 0x40) ? p [0] - 0x80 : p [0];
+
+	value = (p [0] & 0x7F) << 8;
+	p = read_bytes (reader, 1);
+	if (!p)
+		return 0;
+
+	value |= p [0];
+	return (value & 0x4000) ? value - 0x8000 : value;
+}
+
+/* points are stored as floats, 16 bits integers (EMFPLUS_FLAGS_USE_INT16) or offsets from the previous point */
+static BOOL
+read_points (EmfPlusReader *reader, WORD flags, GpPointF *points, int count)
+{
+	const BYTE *p;
+	int i;
+
+	if (flags & EMFPLUS_FLAGS_RELATIVE) {
+		int x = 0, y = 0;
+
+		for (i = 0; i < count; i++) {
+			x += read_integer (reader);
+			y += read_integer (reader);
+			points [i].X = x;
+			points [i].Y = y;
+		}
+		return !reader->failed;
+	}
+
+	p = read_bytes (reader, count * point_size (flags));
+	if (!p)
+		return FALSE;
+
+	if (flags & EMFPLUS_FLAGS_USE_INT16) {
+		for (i = 0; i < count; i++, p += 2 * sizeof (gint16)) {
+			points [i].X = (gint16) (p [0] | (p [1] << 8));
+			points [i].Y = (gint16) (p [2] | (p [3] << 8));
+		}
+	} else {
+		for (i = 0; i < count; i++, p += sizeof (GpPointF)) {
+			points [i].X = get_float (p);
+			points [i].Y = get_float (p + sizeof (float));
+		}
+	}
+	return TRUE;
+}
+
+/* rectangles are stored as floats or, with EMFPLUS_FLAGS_USE_INT16, as 16 bits integers */
+static BOOL
+read_rects (EmfPlusReader *reader, WORD flags, GpRectF *rects, int count)
+{
+	BOOL int16 = (flags & EMFPLUS_FLAGS_USE_INT16);
+	const BYTE *p = read_bytes (reader, count * (int16 ? 4 * sizeof (gint16) : sizeof (GpRectF)));
+	int i;
+
+	if (!p)
+		return FALSE;
+
+	for (i = 0; i < count; i++) {
+		if (int16) {
+			rects [i].X = (gint16) (p [0] | (p [1] << 8));
+			rects [i].Y = (gint16) (p [2] | (p [3] << 8));
+			rects [i].Width = (gint16) (p [4] | (p [5] << 8));
+			rects [i].Height = (gint16) (p [6] | (p [7] << 8));
+			p += 4 * sizeof (gint16);
+		} else {
+			rects [i].X = get_float (p);
+			rects [i].Y = get_float (p + 4);
+			rects [i].Width = get_float (p + 8);
+			rects [i].Height = get_float (p + 12);
+			p += sizeof (GpRectF);
+		}
+	}
+	return TRUE;
+}
+
+/* memory for the points, rectangles or string of the current record, reused by the next records */
+static void*
+get_scratch (EmfPlusContext *emfplus, int size)
+{
+	if (size > emfplus->scratch_size) {
+		void *scratch = gdip_realloc (emfplus->scratch, size);
+		if (!scratch)
+			return NULL;
+
+		emfplus->scratch = scratch;
+		emfplus->scratch_size = size;
+	}
+	return emfplus->scratch;
+}
+
+/*
+ * Objects - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/Object.html
+ */
+
+static GpStatus
+read_path (EmfPlusReader *reader, GpPath **path)
+{
+	GpStatus status;
+	GpPointF *points;
+	BYTE *types;
+	DWORD count, flags;
+
+	/* version */
+	read_dword (reader);
+	count = read_dword (reader);
+	flags = read_dword (reader);
+
+	/* the fill mode isn't part of the path, FillPath records carry it */
+	if (count == 0)
+		return reader->failed ? InvalidParameter : GdipCreatePath (FillModeAlternate, path);
+	/* the types are checked as they are read, RLE runs describe up to 63 points in two bytes */
+	if (!reader_has (reader, count, point_size (flags)))
+		return InvalidParameter;
+
+	points = GdipAlloc (count * (sizeof (GpPointF) + 1));
+	if (!points)
+		return OutOfMemory;
+	types = (BYTE *) (points + count);
+
+	if (!read_points (reader, flags, points, count)) {
+		status = InvalidParameter;
+	} else if (flags & EMFPLUS_PATH_RLE) {
+		DWORD i = 0;
+
+		/* runs of (bezier flag and length, type) */
+		while (i < count) {
+			const BYTE *run = read_bytes (reader, 2);
+			int length;
+
+			if (!run)
+				break;
+
+			length = run [0] & 0x3F;
+			if (length > count - i)
+				length = count - i;
+			memset (types + i, run [1], length);
+			i += length;
+			if (length == 0)
+				break;
+		}
+		status = (i == count) ? Ok : InvalidParameter;
+	} else {
+		const BYTE *p = read_bytes (reader, count);
+
+		if (p)
+			memcpy (types, p, count);
+		status = p ? Ok : InvalidParameter;
+	}
+
+	if (status == Ok)
+		status = GdipCreatePath2 (points, types, count, FillModeAlternate, path);
+
+	GdipFree (points);
+	return status;
+}
+
+/* an object embedded in another one, preceded by its size */
+static GpStatus
+read_embedded_path (EmfPlusReader *reader, GpPath **path)
+{
+	EmfPlusReader embedded;
+	DWORD size = read_dword (reader);
+	const BYTE *p = read_bytes (reader, size);
+
+	if (!p)
+		return InvalidParameter;
+
+	reader_init (&embedded, p, size);
+	return read_path (&embedded, path);
+}
+
+/* only uncompressed bitmaps are supported, the others (PNG, JPEG... or metafiles) leave their slot empty */
+static GpStatus
+read_image (EmfPlusReader *reader, GpImage **image)
+{
+	GpStatus status;
+	GpBitmap *bitmap;
+	ColorPalette *palette = NULL;
+	ActiveBitmapData *data;
+	const BYTE *pixels;
+	int width, height, stride, y;
+	PixelFormat format;
+
+	/* version */
+	read_dword (reader);
+	if (read_dword (reader) != EMFPLUS_IMAGE_BITMAP)
+		return NotImplemented;
+
+	width = read_dword (reader);
+	height = read_dword (reader);
+	stride = read_dword (reader);
+	format = read_dword (reader);
+	if (read_dword (reader) != EMFPLUS_BITMAP_PIXEL)
+		return NotImplemented;
+
+	if (reader->failed || (width <= 0) || (height <= 0) || (stride <= 0))
+		return InvalidParameter;
+
+	if (gdip_is_an_indexed_pixelformat (format)) {
+		DWORD count;
+
+		palette = GdipAlloc (sizeof (ColorPalette) + 256 * sizeof (ARGB));
+		if (!palette)
+			return OutOfMemory;
+
+		palette->Flags = read_dword (reader);
+		count = read_dword (reader);
+		if (count > 256 || !read_colors (reader, palette->Entries, count)) {
+			GdipFree (palette);
+			return InvalidParameter;
+		}
+		palette->Count = count;
+	}
+
+	if (!reader_has (reader, height, stride)) {
+		status = InvalidParameter;
+		goto cleanup;
+	}
+	pixels = read_bytes (reader, height * stride);
+
+	status = GdipCreateBitmapFromScan0 (width, height, 0, format, NULL, &bitmap);
+	if (status != Ok)
+		goto cleanup;
+
+	data = bitmap->active_bitmap;
+	for (y = 0; y < height; y++)
+		memcpy (data->scan0 + y * data->stride, pixels + y * stride, MIN (stride, data->stride));
+
+	if (palette)
+		status = GdipSetImagePalette ((GpImage *) bitmap, palette);
+
+	if (status == Ok)
+		*image = (GpImage *) bitmap;
+	else
+		GdipDisposeImage ((GpImage *) bitmap);
+
+cleanup:
+	if (palette)
+		GdipFree (palette);
+	return status;
+}
+
+/*
+ * preset colors or blend factors of gradient brushes, returned in a single block where @positions
+ * is followed by the colors, or the factors, in @values
+ */
+static GpStatus
+read_blend (EmfPlusReader *reader, DWORD flags, float **positions, void **values, int *count)
+{
+	DWORD n = read_dword (reader);
+
+	if (!reader_has (reader, n, 2 * sizeof (float)) || n == 0)
+		return InvalidParameter;
+
+	*positions = GdipAlloc (n * 2 * sizeof (float));
+	if (!*positions)
+		return OutOfMemory;
+
+	*values = *positions + n;
+	*count = n;
+	read_floats (reader, *positions, n);
+	if (flags & EMFPLUS_BRUSH_DATA_PRESET_COLORS)
+		read_colors (reader, (ARGB *) *values, n);
+	else
+		read_floats (reader, (float *) *values, n);
+	return Ok;
+}
+
+static GpStatus
+read_linear_gradient (EmfPlusReader *reader, GpBrush **brush)
+{
+	GpStatus status;
+	GpLineGradient *linear;
+	GpMatrix matrix;
+	GpRectF rect;
+	ARGB colors [2];
+	DWORD flags;
+	GpWrapMode wrap;
+	float *positions;
+	void *values;
+	int count;
+
+	flags = read_dword (reader);
+	wrap = read_dword (reader);
+	read_rects (reader, 0, &rect, 1);
+	read_colors (reader, colors, 2);
+	/* reserved */
+	read_dword (reader);
+	read_dword (reader);
+	if (flags & EMFPLUS_BRUSH_DATA_TRANSFORM)
+		read_matrix (reader, &matrix);
+	if (reader->failed)
+		return InvalidParameter;
+
+	status = GdipCreateLineBrushFromRect (&rect, colors [0], colors [1], LinearGradientModeHorizontal, wrap, &linear);
+	if (status != Ok)
+		return status;
+
+	if (flags & EMFPLUS_BRUSH_DATA_TRANSFORM)
+		status = GdipSetLineTransform (linear, &matrix);
+
+	/* horizontal factors, when both are present, are the ones applying to a linear gradient */
+	if ((status == Ok) && (flags & (EMFPLUS_BRUSH_DATA_PRESET_COLORS | EMFPLUS_BRUSH_DATA_BLEND_FACTORS_H |
+		EMFPLUS_BRUSH_DATA_BLEND_FACTORS_V))) {
+		status = read_blend (reader, flags, &positions, &values, &count);
+		if (status == Ok) {
+			if (flags & EMFPLUS_BRUSH_DATA_PRESET_COLORS)
+				status = GdipSetLinePresetBlend (linear, (ARGB *) values, positions, count);
+			else
+				status = GdipSetLineBlend (linear, (float *) values, positions, count);
+			GdipFree (positions);
+		}
+	}
+
+	if ((status == Ok) && (flags & EMFPLUS_BRUSH_DATA_GAMMA_CORRECTED))
+		status = GdipSetLineGammaCorrection (linear, TRUE);
+
+	if (status != Ok) {
+		GdipDeleteBrush ((GpBrush *) linear);
+		return status;
+	}
+
+	*brush = (GpBrush *) linear;
+	return Ok;
+}
+
+static GpStatus
+read_path_gradient (EmfPlusReader *reader, GpBrush **brush)
+{
+	GpStatus status;
+	GpPathGradient *pg;
+	GpMatrix matrix;
+	GpPointF center;
+	ARGB centerColor, *colors;
+	DWORD flags, count;
+	GpWrapMode wrap;
+	float *positions;
+	void *values;
+	int n;
+
+	flags = read_dword (reader);
+	wrap = read_dword (reader);
+	centerColor = read_dword (reader);
+	read_points (reader, 0, &center, 1);
+	count = read_dword (reader);
+	if (!reader_has (reader, count, sizeof (ARGB)) || count == 0)
+		return InvalidParameter;
+
+	colors = GdipAlloc (count * sizeof (ARGB));
+	if (!colors)
+		return OutOfMemory;
+	read_colors (reader, colors, count);
+
+	if (flags & EMFPLUS_BRUSH_DATA_PATH) {
+		GpPath *path;
+
+		status = read_embedded_path (reader, &path);
+		if (status == Ok) {
+			status = GdipCreatePathGradientFromPath (path, &pg);
+			GdipDeletePath (path);
+		}
+	} else {
+		DWORD points_count = read_dword (reader);
+		GpPointF *points;
+
+		if (!reader_has (reader, points_count, sizeof (GpPointF))) {
+			status = InvalidParameter;
+		} else if (!(points = GdipAlloc (points_count * sizeof (GpPointF)))) {
+			status = OutOfMemory;
+		} else {
+			read_points (reader, 0, points, points_count);
+			status = GdipCreatePathGradient (points, points_count, wrap, &pg);
+			GdipFree (points);
+		}
+	}
+
+	if (status != Ok) {
+		GdipFree (colors);
+		return status;
+	}
+
+	n = count;
+	status = GdipSetPathGradientWrapMode (pg, wrap);
+	if (status == Ok)
+		status = GdipSetPathGradientCenterColor (pg, centerColor);
+	if (status == Ok)
+		status = GdipSetPathGradientCenterPoint (pg, &center);
+	if (status == Ok)
+		status = GdipSetPathGradientSurroundColorsWithCount (pg, colors, &n);
+	GdipFree (colors);
+
+	if (flags & EMFPLUS_BRUSH_DATA_TRANSFORM) {
+		read_matrix (reader, &matrix);
+		if (status == Ok)
+			status = GdipSetPathGradientTransform (pg, &matrix);
+	}
+
+	if ((status == Ok) && (flags & (EMFPLUS_BRUSH_DATA_PRESET_COLORS | EMFPLUS_BRUSH_DATA_BLEND_FACTORS_H))) {
+		status = read_blend (reader, flags, &positions, &values, &n);
+		if (status == Ok) {
+			if (flags & EMFPLUS_BRUSH_DATA_PRESET_COLORS)
+				status = GdipSetPathGradientPresetBlend (pg, (ARGB *) values, positions, n);
+			else
+				status = GdipSetPathGradientBlend (pg, (float *) values, positions, n);
+			GdipFree (positions);
+		}
+	}
+
+	if ((status == Ok) && (flags & EMFPLUS_BRUSH_DATA_FOCUS_SCALES)) {
+		float scales [2];
+
+		/* count, always 2 */
+		read_dword (reader);
+		status = read_floats (reader, scales, 2) ? GdipSetPathGradientFocusScales (pg, scales [0], scales [1]) :
+			InvalidParameter;
+	}
+
+	if ((status == Ok) && (flags & EMFPLUS_BRUSH_DATA_GAMMA_CORRECTED))
+		status = GdipSetPathGradientGammaCorrection (pg, TRUE);
+
+	if (status != Ok) {
+		GdipDeleteBrush ((GpBrush *) pg);
+		return status;
+	}
+
+	*brush = (GpBrush *) pg;
+	return Ok;
+}
+
+static GpStatus
+read_texture (EmfPlusReader *reader, GpBrush **brush)
+{
+	GpStatus status;
+	GpTexture *texture;
+	GpImage *image;
+	GpMatrix matrix;
+	DWORD flags;
+	GpWrapMode wrap;
+
+	flags = read_dword (reader);
+	wrap = read_dword (reader);
+	if (flags & EMFPLUS_BRUSH_DATA_TRANSFORM)
+		read_matrix (reader, &matrix);
+
+	status = read_image (reader, &image);
+	if (status != Ok)
+		return status;
+
+	/* the texture keeps its own copy of the image */
+	status = GdipCreateTexture (image, wrap, &texture);
+	GdipDisposeImage (image);
+	if (status != Ok)
+		return status;
+
+	if (flags & EMFPLUS_BRUSH_DATA_TRANSFORM) {
+		status = GdipSetTextureTransform (texture, &matrix);
+		if (status != Ok) {
+			GdipDeleteBrush ((GpBrush *) texture);
+			return status;
+		}
+	}
+
+	*brush = (GpBrush *) texture;
+	return Ok;
+}
+
+/* http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileObjects/Brush.html */
+static GpStatus
+read_brush (EmfPlusReader *reader, GpBrush **brush)
+{
+	DWORD type;
+
+	/* version */
+	read_dword (reader);
+	type = read_dword (reader);
+
+	switch (type) {
+	case BrushTypeSolidColor: {
+		ARGB color = read_dword (reader);
+
+		if (reader->failed)
+			return InvalidParameter;
+		return GdipCreateSolidFill (color, (GpSolidFill **) brush);
+	}
+	case BrushTypeHatchFill: {
+		GpHatchStyle style = read_dword (reader);
+		ARGB foreColor = read_dword (reader);
+		ARGB backColor = read_dword (reader);
+
+		if (reader->failed)
+			return InvalidParameter;
+		return GdipCreateHatchBrush (style, foreColor, backColor, (GpHatch **) brush);
+	}
+	case BrushTypeTextureFill:
+		return read_texture (reader, brush);
+	case BrushTypePathGradient:
+		return read_path_gradient (reader, brush);
+	case BrushTypeLinearGradient:
+		return read_linear_gradient (reader, brush);
+	default:
+		return NotImplemented;
+	}
+}
+
+/* the serialized custom line caps are skipped, such ends are drawn flat */
+static void
+skip_custom_cap (EmfPlusReader *reader)
+{
+	DWORD size = read_dword (reader);
+
+	read_bytes (reader, size);
+}
+
+/* http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileObjects/Pen.html */
+static GpStatus
+read_pen (EmfPlusReader *reader, GpPen **pen)
+{
+	GpStatus status;
+	GpBrush *brush;
+	GpMatrix matrix;
+	GpPen *result;
+	DWORD flags;
+	GpUnit unit;
+	float width;
+	GpLineCap startCap = LineCapFlat, endCap = LineCapFlat;
+	GpLineJoin join = LineJoinMiter;
+	float miterLimit = 10.0f;
+	GpDashStyle dashStyle = DashStyleSolid;
+	GpDashCap dashCap = DashCapFlat;
+	float dashOffset = 0;
+	const BYTE *dashes = NULL, *compounds = NULL;
+	int dashCount = 0, compoundCount = 0;
+	GpPenAlignment alignment = PenAlignmentCenter;
+
+	/* version and type (always 0) */
+	read_dword (reader);
+	read_dword (reader);
+	flags = read_dword (reader);
+	unit = read_dword (reader);
+	width = read_float (reader);
+
+	if (flags & EMFPLUS_PEN_DATA_TRANSFORM)
+		read_matrix (reader, &matrix);
+	if (flags & EMFPLUS_PEN_DATA_START_CAP)
+		startCap = read_dword (reader);
+	if (flags & EMFPLUS_PEN_DATA_END_CAP)
+		endCap = read_dword (reader);
+	if (flags & EMFPLUS_PEN_DATA_JOIN)
+		join = read_dword (reader);
+	if (flags & EMFPLUS_PEN_DATA_MITER_LIMIT)
+		miterLimit = read_float (reader);
+	if (flags & EMFPLUS_PEN_DATA_LINE_STYLE)
+		dashStyle = read_dword (reader);
+	if (flags & EMFPLUS_PEN_DATA_DASHED_LINE_CAP)
+		dashCap = read_dword (reader);
+	if (flags & EMFPLUS_PEN_DATA_DASHED_LINE_OFFSET)
+		dashOffset = read_float (reader);
+	if (flags & EMFPLUS_PEN_DATA_DASHED_LINE) {
+		dashCount = read_dword (reader);
+		if (reader_has (reader, dashCount, sizeof (float)))
+			dashes = read_bytes (reader, dashCount * sizeof (float));
+	}
+	if (flags & EMFPLUS_PEN_DATA_NON_CENTER)
+		alignment = read_dword (reader);
+	if (flags & EMFPLUS_PEN_DATA_COMPOUND_LINE) {
+		compoundCount = read_dword (reader);
+		if (reader_has (reader, compoundCount, sizeof (float)))
+			compounds = read_bytes (reader, compoundCount * sizeof (float));
+	}
+	if (flags & EMFPLUS_PEN_DATA_CUSTOM_START_CAP) {
+		skip_custom_cap (reader);
+		startCap = LineCapFlat;
+	}
+	if (flags & EMFPLUS_PEN_DATA_CUSTOM_END_CAP) {
+		skip_custom_cap (reader);
+		endCap = LineCapFlat;
+	}
+	if (reader->failed)
+		return InvalidParameter;
+
+	status = read_brush (reader, &brush);
+	if (status != Ok)
+		return status;
+
+	/* the pen keeps its own copy of the brush */
+	status = GdipCreatePen2 (brush, width, unit, &result);
+	GdipDeleteBrush (brush);
+	if (status != Ok)
+		return status;
+
+	if (flags & EMFPLUS_PEN_DATA_TRANSFORM)
+		status = GdipSetPenTransform (result, &matrix);
+	if ((status == Ok) && (startCap != LineCapFlat || endCap != LineCapFlat || dashCap != DashCapFlat))
+		status = GdipSetPenLineCap197819 (result, startCap, endCap, dashCap);
+	if ((status == Ok) && (join != LineJoinMiter))
+		status = GdipSetPenLineJoin (result, join);
+	if ((status == Ok) && (flags & EMFPLUS_PEN_DATA_MITER_LIMIT))
+		status = GdipSetPenMiterLimit (result, miterLimit);
+	if ((status == Ok) && (dashStyle != DashStyleSolid) && (dashStyle != DashStyleCustom))
+		status = GdipSetPenDashStyle (result, dashStyle);
+	if ((status == Ok) && dashes && dashCount > 0) {
+		float *values = GdipAlloc (dashCount * sizeof (float));
+
+		if (!values) {
+			status = OutOfMemory;
+		} else {
+			EmfPlusReader array;
+
+			reader_init (&array, dashes, dashCount * sizeof (float));
+			read_floats (&array, values, dashCount);
+			status = GdipSetPenDashArray (result, values, dashCount);
+			GdipFree (values);
+		}
+	}
+	if ((status == Ok) && (flags & EMFPLUS_PEN_DATA_DASHED_LINE_OFFSET))
+		status = GdipSetPenDashOffset (result, dashOffset);
+	if ((status == Ok) && (alignment != PenAlignmentCenter))
+		status = GdipSetPenMode (result, alignment);
+	if ((status == Ok) && compounds && compoundCount > 0) {
+		float *values = GdipAlloc (compoundCount * sizeof (float));
+
+		if (!values) {
+			status = OutOfMemory;
+		} else {
+			EmfPlusReader array;
+
+			reader_init (&array, compounds, compoundCount * sizeof (float));
+			read_floats (&array, values, compoundCount);
+			status = GdipSetPenCompoundArray (result, values, compoundCount);
+			GdipFree (values);
+		}
+	}
+
+	if (status != Ok) {
+		GdipDeletePen (result);
+		return status;
+	}
+
+	*pen = result;
+	return Ok;
+}
+
+/* the combine modes and the EMF+ region node types share the same values */
+static GpStatus
+read_region_node (EmfPlusReader *reader, int *nodes, int depth, GpRegion **region)
+{
+	GpStatus status;
+	GpRegion *second;
+	DWORD type;
+
+	/* more nodes than the region announced, or the data is corrupted */
+	if ((--(*nodes) < 0) || (depth > EMFPLUS_MAX_REGION_DEPTH))
+		return InvalidParameter;
+
+	type = read_dword (reader);
+	switch (type) {
+	case RegionDataRect: {
+		GpRectF rect;
+
+		if (!read_rects (reader, 0, &rect, 1))
+			return InvalidParameter;
+		return GdipCreateRegionRect (&rect, region);
+	}
+	case RegionDataPath: {
+		GpPath *path;
+
+		status = read_embedded_path (reader, &path);
+		if (status != Ok)
+			return status;
+		status = GdipCreateRegionPath (path, region);
+		GdipDeletePath (path);
+		return status;
+	}
+	case RegionDataEmptyRect:
+		status = GdipCreateRegion (region);
+		if (status == Ok)
+			GdipSetEmpty (*region);
+		return status;
+	case RegionDataInfiniteRect:
+		return GdipCreateRegion (region);
+	case CombineModeIntersect:
+	case CombineModeUnion:
+	case CombineModeXor:
+	case CombineModeExclude:
+	case CombineModeComplement:
+		status = read_region_node (reader, nodes, depth + 1, region);
+		if (status != Ok)
+			return status;
+
+		status = read_region_node (reader, nodes, depth + 1, &second);
+		if (status == Ok) {
+			status = GdipCombineRegionRegion (*region, second, type);
+			GdipDeleteRegion (second);
+		}
+
+		if (status != Ok)
+			GdipDeleteRegion (*region);
+		return status;
+	default:
+		return InvalidParameter;
+	}
+}
+
+/* http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileObjects/Region.html */
+static GpStatus
+read_region (EmfPlusReader *reader, GpRegion **region)
+{
+	int nodes;
+
+	/* version */
+	read_dword (reader);
+	/* child nodes, the root is not counted */
+	nodes = read_dword (reader) + 1;
+	if (!reader_has (reader, nodes, sizeof (DWORD)))
+		return InvalidParameter;
+
+	return read_region_node (reader, &nodes, 0, region);
+}
+
+/* the family is looked up by name, falling back on the generic sans serif one */
+static GpStatus
+read_font (EmfPlusReader *reader, EmfPlusContext *emfplus, GpFont **font)
+{
+	GpStatus status;
+	GpFontFamily *family;
+	const BYTE *p;
+	WCHAR *name;
+	float emSize;
+	GpUnit unit;
+	int style;
+	DWORD length, i;
+
+	/* version */
+	read_dword (reader);
+	emSize = read_float (reader);
+	unit = read_dword (reader);
+	style = read_dword (reader);
+	/* reserved */
+	read_dword (reader);
+	length = read_dword (reader);
+	if (!reader_has (reader, length, sizeof (WCHAR)))
+		return InvalidParameter;
+
+	name = get_scratch (emfplus, (length + 1) * sizeof (WCHAR));
+	if (!name)
+		return OutOfMemory;
+
+	p = read_bytes (reader, length * sizeof (WCHAR));
+	for (i = 0; i < length; i++, p += sizeof (WCHAR))
+		name [i] = p [0] | (p [1] << 8);
+	name [length] = 0;
+
+	status = GdipCreateFontFamilyFromName (name, NULL, &family);
+	if (status != Ok)
+		status = GdipGetGenericFontFamilySansSerif (&family);
+	if (status != Ok)
+		return status;
+
+	/* the font keeps its own copy of the family */
+	status = GdipCreateFont (family, emSize, style, unit, font);
+	GdipDeleteFontFamily (family);
+	return status;
+}
+
+static GpStatus
+read_string_format (EmfPlusReader *reader, GpStringFormat **format)
+{
+	GpStatus status;
+	GpStringFormat *result;
+	INT flags, hotkeyPrefix;
+	LANGID language, digitLanguage;
+	StringAlignment align, lineAlign;
+	StringDigitSubstitute digitSubstitution;
+	StringTrimming trimming;
+	float firstTabOffset, *tabStops = NULL;
+	DWORD tabStopCount, rangeCount;
+
+	/* version */
+	read_dword (reader);
+	flags = read_dword (reader);
+	language = read_dword (reader);
+	align = read_dword (reader);
+	lineAlign = read_dword (reader);
+	digitSubstitution = read_dword (reader);
+	digitLanguage = read_dword (reader);
+	firstTabOffset = read_float (reader);
+	hotkeyPrefix = read_dword (reader);
+	/* leading and trailing margins, tracking */
+	read_float (reader);
+	read_float (reader);
+	read_float (reader);
+	trimming = read_dword (reader);
+	tabStopCount = read_dword (reader);
+	rangeCount = read_dword (reader);
+	if (reader->failed)
+		return InvalidParameter;
+
+	status = GdipCreateStringFormat (flags, language, &result);
+	if (status != Ok)
+		return status;
+
+	status = GdipSetStringFormatAlign (result, align);
+	if (status == Ok)
+		status = GdipSetStringFormatLineAlign (result, lineAlign);
+	if (status == Ok)
+		status = GdipSetStringFormatHotkeyPrefix (result, hotkeyPrefix);
+	if (status == Ok)
+		status = GdipSetStringFormatTrimming (result, trimming);
+	if (status == Ok)
+		status = GdipSetStringFormatDigitSubstitution (result, digitLanguage, digitSubstitution);
+
+	if ((status == Ok) && (tabStopCount > 0) && reader_has (reader, tabStopCount, sizeof (float))) {
+		tabStops = GdipAlloc (tabStopCount * sizeof (float));
+		if (!tabStops) {
+			status = OutOfMemory;
+		} else {
+			read_floats (reader, tabStops, tabStopCount);
+			status = GdipSetStringFormatTabStops (result, firstTabOffset, tabStopCount, tabStops);
+			GdipFree (tabStops);
+		}
+	}
+
+	if ((status == Ok) && (rangeCount > 0) && reader_has (reader, rangeCount, sizeof (CharacterRange))) {
+		CharacterRange *ranges = GdipAlloc (rangeCount * sizeof (CharacterRange));
+		DWORD i;
+
+		if (!ranges) {
+			status = OutOfMemory;
+		} else {
+			for (i = 0; i < rangeCount; i++) {
+				ranges [i].First = read_dword (reader);
+				ranges [i].Length = read_dword (reader);
+			}
+			status = GdipSetStringFormatMeasurableCharacterRanges (result, rangeCount, ranges);
+			GdipFree (ranges);
+		}
+	}
+
+	if (status != Ok) {
+		GdipDeleteStringFormat (result);
+		return status;
+	}
+
+	*format = result;
+	return Ok;
+}
+
+static GpStatus
+read_image_attributes (EmfPlusReader *reader, GpImageAttributes **imageAttributes)
+{
+	GpStatus status;
+	WrapMode wrap;
+	ARGB color;
+	BOOL clamp;
+
+	/* version and reserved */
+	read_dword (reader);
+	read_dword (reader);
+	wrap = read_dword (reader);
+	color = read_dword (reader);
+	clamp = read_dword (reader);
+	if (reader->failed)
+		return InvalidParameter;
+
+	status = GdipCreateImageAttributes (imageAttributes);
+	if (status != Ok)
+		return status;
+
+	status = GdipSetImageAttributesWrapMode (*imageAttributes, wrap, color, clamp);
+	if (status != Ok)
+		GdipDisposeImageAttributes (*imageAttributes);
+	return status;
+}
+
+static void
+delete_object (EmfPlusObjectSlot *slot)
+{
+	switch (slot->type) {
+	case EmfPlusObjectTypeBrush:
+		GdipDeleteBrush ((GpBrush *) slot->ptr);
+		break;
+	case EmfPlusObjectTypePen:
+		GdipDeletePen ((GpPen *) slot->ptr);
+		break;
+	case EmfPlusObjectTypePath:
+		GdipDeletePath ((GpPath *) slot->ptr);
+		break;
+	case EmfPlusObjectTypeRegion:
+		GdipDeleteRegion ((GpRegion *) slot->ptr);
+		break;
+	case EmfPlusObjectTypeImage:
+		GdipDisposeImage ((GpImage *) slot->ptr);
+		break;
+	case EmfPlusObjectTypeFont:
+		GdipDeleteFont ((GpFont *) slot->ptr);
+		break;
+	case EmfPlusObjectTypeStringFormat:
+		GdipDeleteStringFormat ((GpStringFormat *) slot->ptr);
+		break;
+	case EmfPlusObjectTypeImageAttributes:
+		GdipDisposeImageAttributes ((GpImageAttributes *) slot->ptr);
+		break;
+	default:
+		break;
+	}
+
+	slot->type = EmfPlusObjectTypeInvalid;
+	slot->ptr = NULL;
+}
+
+/* the object of type @type in slot @id, or NULL if there's none */
+static void*
+get_object (MetafilePlayContext *context, DWORD id, EmfPlusObjectType type)
+{
+	EmfPlusObjectSlot *slot;
+
+	if (id >= EMFPLUS_MAX_OBJECTS)
+		return NULL;
+
+	slot = &context->emfplus->objects [id];
+	return (slot->type == type) ? slot->ptr : NULL;
+}
+
+/* the brush of a fill record, either an object or, with EMFPLUS_FLAGS_USE_ARGB, a color */
+static GpBrush*
+get_brush (MetafilePlayContext *context, WORD flags, DWORD brushId)
+{
+	if (flags & EMFPLUS_FLAGS_USE_ARGB) {
+		GdipSetSolidFillColor (context->emfplus->solid, brushId);
+		return (GpBrush *) context->emfplus->solid;
+	}
+
+	return get_object (context, brushId, EmfPlusObjectTypeBrush);
+}
+
+static GpStatus
+EmfPlusObject (MetafilePlayContext *context, WORD flags, EmfPlusReader *reader)
+{
+	EmfPlusContext *emfplus = context->emfplus;
+	EmfPlusObjectType type = (flags & EMFPLUS_FLAGS_OBJECT_TYPE) >> 8;
+	DWORD id = flags & EMFPLUS_FLAGS_OBJECT_ID;
+	EmfPlusReader object;
+	GpStatus status;
+	void *ptr = NULL;
+
+	if (flags & EMFPLUS_OBJECT_CONTINUED) {
+		/* the parts are gathered until the last one, which has no total size */
+		DWORD total = read_dword (reader);
+		int length = reader->size - reader->pos;
+
+		if (!emfplus->continued) {
+			if (total > context->metafile->length)
+				return Ok;
+
+			emfplus->continued = GdipAlloc (total);
+			if (!emfplus->continued)
+				return OutOfMemory;
+			emfplus->continued_size = total;
+			emfplus->continued_length = 0;
+		}
+
+		length = MIN (length, emfplus->continued_size - emfplus->continued_length);
+		memcpy (emfplus->continued + emfplus->continued_length, read_bytes (reader, length), length);
+		emfplus->continued_length += length;
+		return Ok;
+	}
+
+	if (emfplus->continued) {
+		int length = MIN (reader->size, emfplus->continued_size - emfplus->continued_length);
+
+		memcpy (emfplus->continued + emfplus->continued_length, reader->data, length);
+		emfplus->continued_length += length;
+		reader_init (&object, emfplus->continued, emfplus->continued_length);
+	} else {
+		object = *reader;
+	}
 
-/* http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/Header.html */
+#ifdef DEBUG_EMFPLUS_2
+	printf ("\n\tObject type %d, slot %d, size %d", type, id, object.size);
+#endif
+	switch (type) {
+	case EmfPlusObjectTypeBrush:
+		status = read_brush (&object, (GpBrush **) &ptr);
+		break;
+	case EmfPlusObjectTypePen:
+		status = read_pen (&object, (GpPen **) &ptr);
+		break;
+	case EmfPlusObjectTypePath:
+		status = read_path (&object, (GpPath **) &ptr);
+		break;
+	case EmfPlusObjectTypeRegion:
+		status = read_region (&object, (GpRegion **) &ptr);
+		break;
+	case EmfPlusObjectTypeImage:
+		status = read_image (&object, (GpImage **) &ptr);
+		break;
+	case EmfPlusObjectTypeFont:
+		status = read_font (&object, emfplus, (GpFont **) &ptr);
+		break;
+	case EmfPlusObjectTypeStringFormat:
+		status = read_string_format (&object, (GpStringFormat **) &ptr);
+		break;
+	case EmfPlusObjectTypeImageAttributes:
+		status = read_image_attributes (&object, (GpImageAttributes **) &ptr);
+		break;
+	default:
+		/* custom line caps */
+		status = NotImplemented;
+		break;
+	}
+
+	if (emfplus->continued) {
+		GdipFree (emfplus->continued);
+		emfplus->continued = NULL;
+	}
+
+	if (id < EMFPLUS_MAX_OBJECTS) {
+		delete_object (&emfplus->objects [id]);
+		if (status == Ok) {
+			emfplus->objects [id].type = type;
+			emfplus->objects [id].ptr = ptr;
+			ptr = NULL;
+		}
+	}
+
+	if (ptr) {
+		EmfPlusObjectSlot unused = { type, ptr };
+		delete_object (&unused);
+	}
+
+	/* objects which can't be read leave their slot empty and the records using them are skipped */
+	return (status == OutOfMemory) ? status : Ok;
+}
+
+/* the points of a record, preceded by their count */
+static GpStatus
+read_counted_points (MetafilePlayContext *context, WORD flags, EmfPlusReader *reader, GpPointF **points, int *count)
+{
+	DWORD n = read_dword (reader);
+
+	if ((n == 0) || !reader_has (reader, n, point_size (flags)))
+		return InvalidParameter;
+
+	*points = get_scratch (context->emfplus, n * sizeof (GpPointF));
+	if (!*points)
+		return OutOfMemory;
+
+	*count = n;
+	return read_points (reader, flags, *points, n) ? Ok : InvalidParameter;
+}
+
+/* the rectangles of a record, preceded by their count */
+static GpStatus
+read_counted_rects (MetafilePlayContext *context, WORD flags, EmfPlusReader *reader, GpRectF **rects, int *count)
+{
+	DWORD n = read_dword (reader);
+
+	if ((n == 0) || !reader_has (reader, n, (flags & EMFPLUS_FLAGS_USE_INT16) ? 4 * sizeof (gint16) : sizeof (GpRectF)))
+		return InvalidParameter;
+
+	*rects = get_scratch (context->emfplus, n * sizeof (GpRectF));
+	if (!*rects)
+		return OutOfMemory;
+
+	*count = n;
+	return read_rects (reader, flags, *rects, n) ? Ok : InvalidParameter;
+}
+
+/* device = world * page * base */
+static GpStatus
+apply_transform (MetafilePlayContext *context)
+{
+	EmfPlusContext *emfplus = context->emfplus;
+	GpMatrix matrix;
+
+	gdip_cairo_matrix_copy (&matrix, &emfplus->world);
+	GdipScaleMatrix (&matrix, emfplus->page_x, emfplus->page_y, MatrixOrderAppend);
+	GdipMultiplyMatrix (&matrix, &emfplus->base, MatrixOrderAppend);
+	return GdipSetWorldTransform (context->graphics, &matrix);
+}
+
+/* Header - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/Header.html */
 static GpStatus
 EmfPlusHeader (MetafilePlayContext *context, WORD flags, BYTE* data, int size)
 {
@@ -48,10 +1287,19 @@ EmfPlusHeader (MetafilePlayContext *context, WORD flags, BYTE* data, int size)
 	/* ObjectHeader, not Version, is returned to be compatible with GDI+ */
 	context->metafile->metafile_header.Version = GETDW(DWP2);
 	/* Horizontal and Vertical Resolution aren't reported correctly by GDI+ (generally 0) */
+
+	/* but they are the resolution of the page units used by the records */
+	if (context->emfplus && (size >= EMFPLUS_HEADER_SIZE)) {
+		context->emfplus->dual = (flags & EMFPLUS_FLAGS_DUAL);
+		if (GETDW(DWP4) > 0)
+			context->emfplus->dpi_x = GETDW(DWP4);
+		if (GETDW(DWP5) > 0)
+			context->emfplus->dpi_y = GETDW(DWP5);
+	}
 	return Ok;
 }
 
-/* http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/EndOfFile.html */
+/* EndOfFile - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/EndOfFile.html */
 static GpStatus
 EmfPlusEndOfFile (MetafilePlayContext *context, WORD flags, BYTE* data, int size)
 {
@@ -61,73 +1309,576 @@ EmfPlusEndOfFile (MetafilePlayContext *context, WORD flags, BYTE* data, int size
 	return Ok;
 }
 
-/* http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/FillRects.html */
+/* FillRects - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/FillRects.html */
 static GpStatus
-EmfPlusFillRects (MetafilePlayContext *context, WORD flags, BYTE* data, int size)
+EmfPlusFillRects (MetafilePlayContext *context, WORD flags, EmfPlusReader *reader)
+{
+	GpBrush *brush = get_brush (context, flags, read_dword (reader));
+	GpStatus status;
+	GpRectF *rects;
+	int count;
+
+	status = read_counted_rects (context, flags, reader, &rects, &count);
+	if ((status != Ok) || !brush)
+		return status;
+
+	return GdipFillRectangles (context->graphics, brush, rects, count);
+}
+
+/* DrawRects - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/DrawRects.html */
+static GpStatus
+EmfPlusDrawRects (MetafilePlayContext *context, WORD flags, EmfPlusReader *reader)
+{
+	GpPen *pen = get_object (context, flags & EMFPLUS_FLAGS_OBJECT_ID, EmfPlusObjectTypePen);
+	GpStatus status;
+	GpRectF *rects;
+	int count;
+
+	status = read_counted_rects (context, flags, reader, &rects, &count);
+	if ((status != Ok) || !pen)
+		return status;
+
+	return GdipDrawRectangles (context->graphics, pen, rects, count);
+}
+
+/* FillPolygon - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/FillPolygon.html */
+static GpStatus
+EmfPlusFillPolygon (MetafilePlayContext *context, WORD flags, EmfPlusReader *reader)
+{
+	GpBrush *brush = get_brush (context, flags, read_dword (reader));
+	GpStatus status;
+	GpPointF *points;
+	int count;
+
+	status = read_counted_points (context, flags, reader, &points, &count);
+	if ((status != Ok) || !brush)
+		return status;
+
+	return GdipFillPolygon (context->graphics, brush, points, count, FillModeAlternate);
+}
+
+/* DrawLines - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/DrawLines.html */
+static GpStatus
+EmfPlusDrawLines (MetafilePlayContext *context, WORD flags, EmfPlusReader *reader)
+{
+	GpPen *pen = get_object (context, flags & EMFPLUS_FLAGS_OBJECT_ID, EmfPlusObjectTypePen);
+	GpStatus status;
+	GpPointF *points;
+	int count;
+
+	status = read_counted_points (context, flags, reader, &points, &count);
+	if ((status != Ok) || !pen)
+		return status;
+
+	if (flags & EMFPLUS_FLAGS_CLOSED)
+		return GdipDrawPolygon (context->graphics, pen, points, count);
+	return GdipDrawLines (context->graphics, pen, points, count);
+}
+
+/* FillEllipse and DrawEllipse - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/FillEllipse.html */
+static GpStatus
+EmfPlusEllipse (MetafilePlayContext *context, WORD func, WORD flags, EmfPlusReader *reader)
 {
-	GpStatus status = Ok;
-	GpSolidFill *solid = NULL;
 	GpBrush *brush = NULL;
+	GpPen *pen = NULL;
+	GpRectF rect;
 
-#ifdef DEBUG_EMFPLUS
-	printf ("EmfPlusRecordTypeFillRects flags %X", flags, size);
-	printf ("\n\tColor: 0x%X", GETDW(DWP2));
-	printf ("\n\t#rect: %d", GETDW(DWP3));
-#endif
-	BOOL use_int16 = (flags & 0x4000);
-	BOOL use_color = (flags & 0x8000);
-	DWORD num = GETDW(DWP3);
-	int i = 0;
-	int n = 3;
-
-	if (use_color) {
-		status = GdipCreateSolidFill (GETDW(DWP2), &solid);
+	if (func == EmfPlusRecordTypeFillEllipse)
+		brush = get_brush (context, flags, read_dword (reader));
+	else
+		pen = get_object (context, flags & EMFPLUS_FLAGS_OBJECT_ID, EmfPlusObjectTypePen);
+
+	if (!read_rects (reader, flags, &rect, 1))
+		return InvalidParameter;
+
+	if (brush)
+		return GdipFillEllipse (context->graphics, brush, rect.X, rect.Y, rect.Width, rect.Height);
+	if (pen)
+		return GdipDrawEllipse (context->graphics, pen, rect.X, rect.Y, rect.Width, rect.Height);
+	return Ok;
+}
+
+/* FillPie, DrawPie and DrawArc - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/FillPie.html */
+static GpStatus
+EmfPlusPie (MetafilePlayContext *context, WORD func, WORD flags, EmfPlusReader *reader)
+{
+	GpBrush *brush = NULL;
+	GpPen *pen = NULL;
+	float startAngle, sweepAngle;
+	GpRectF rect;
+
+	if (func == EmfPlusRecordTypeFillPie)
+		brush = get_brush (context, flags, read_dword (reader));
+	else
+		pen = get_object (context, flags & EMFPLUS_FLAGS_OBJECT_ID, EmfPlusObjectTypePen);
+
+	startAngle = read_float (reader);
+	sweepAngle = read_float (reader);
+	if (!read_rects (reader, flags, &rect, 1))
+		return InvalidParameter;
+
+	switch (func) {
+	case EmfPlusRecordTypeFillPie:
+		if (!brush)
+			return Ok;
+		return GdipFillPie (context->graphics, brush, rect.X, rect.Y, rect.Width, rect.Height, startAngle, sweepAngle);
+	case EmfPlusRecordTypeDrawPie:
+		if (!pen)
+			return Ok;
+		return GdipDrawPie (context->graphics, pen, rect.X, rect.Y, rect.Width, rect.Height, startAngle, sweepAngle);
+	default:
+		if (!pen)
+			return Ok;
+		return GdipDrawArc (context->graphics, pen, rect.X, rect.Y, rect.Width, rect.Height, startAngle, sweepAngle);
+	}
+}
+
+/* FillRegion - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/FillRegion.html */
+static GpStatus
+EmfPlusFillRegion (MetafilePlayContext *context, WORD flags, EmfPlusReader *reader)
+{
+	GpRegion *region = get_object (context, flags & EMFPLUS_FLAGS_OBJECT_ID, EmfPlusObjectTypeRegion);
+	GpBrush *brush = get_brush (context, flags, read_dword (reader));
+
+	if (reader->failed)
+		return InvalidParameter;
+	if (!region || !brush)
+		return Ok;
+
+	return GdipFillRegion (context->graphics, brush, region);
+}
+
+/* FillPath - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/FillPath.html */
+static GpStatus
+EmfPlusFillPath (MetafilePlayContext *context, WORD flags, EmfPlusReader *reader)
+{
+	GpPath *path = get_object (context, flags & EMFPLUS_FLAGS_OBJECT_ID, EmfPlusObjectTypePath);
+	GpBrush *brush = get_brush (context, flags, read_dword (reader));
+
+	if (reader->failed)
+		return InvalidParameter;
+	if (!path || !brush)
+		return Ok;
+
+	GdipSetPathFillMode (path, (flags & EMFPLUS_FLAGS_FILLMODE_WINDING) ? FillModeWinding : FillModeAlternate);
+	return GdipFillPath (context->graphics, brush, path);
+}
+
+/* DrawPath - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/DrawPath.html */
+static GpStatus
+EmfPlusDrawPath (MetafilePlayContext *context, WORD flags, EmfPlusReader *reader)
+{
+	GpPath *path = get_object (context, flags & EMFPLUS_FLAGS_OBJECT_ID, EmfPlusObjectTypePath);
+	GpPen *pen = get_object (context, read_dword (reader), EmfPlusObjectTypePen);
+
+	if (reader->failed)
+		return InvalidParameter;
+	if (!path || !pen)
+		return Ok;
+
+	return GdipDrawPath (context->graphics, pen, path);
+}
+
+/* FillClosedCurve - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/FillClosedCurve.html */
+static GpStatus
+EmfPlusFillClosedCurve (MetafilePlayContext *context, WORD flags, EmfPlusReader *reader)
+{
+	GpBrush *brush = get_brush (context, flags, read_dword (reader));
+	float tension = read_float (reader);
+	GpStatus status;
+	GpPointF *points;
+	int count;
+
+	status = read_counted_points (context, flags, reader, &points, &count);
+	if ((status != Ok) || !brush)
+		return status;
+
+	return GdipFillClosedCurve2 (context->graphics, brush, points, count, tension,
+		(flags & EMFPLUS_FLAGS_FILLMODE_WINDING) ? FillModeWinding : FillModeAlternate);
+}
+
+/* DrawClosedCurve, DrawCurve and DrawBeziers, drawn with the pen in the record flags */
+static GpStatus
+EmfPlusDrawCurve (MetafilePlayContext *context, WORD func, WORD flags, EmfPlusReader *reader)
+{
+	GpPen *pen = get_object (context, flags & EMFPLUS_FLAGS_OBJECT_ID, EmfPlusObjectTypePen);
+	float tension = 0;
+	int offset = 0, segments = 0;
+	GpStatus status;
+	GpPointF *points;
+	int count;
+
+	if (func != EmfPlusRecordTypeDrawBeziers)
+		tension = read_float (reader);
+	if (func == EmfPlusRecordTypeDrawCurve) {
+		offset = read_dword (reader);
+		segments = read_dword (reader);
+	}
+
+	status = read_counted_points (context, flags, reader, &points, &count);
+	if ((status != Ok) || !pen)
+		return status;
+
+	switch (func) {
+	case EmfPlusRecordTypeDrawClosedCurve:
+		return GdipDrawClosedCurve2 (context->graphics, pen, points, count, tension);
+	case EmfPlusRecordTypeDrawCurve:
+		return GdipDrawCurve3 (context->graphics, pen, points, count, offset, segments, tension);
+	default:
+		return GdipDrawBeziers (context->graphics, pen, points, count);
+	}
+}
+
+/* DrawImage and DrawImagePoints - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/DrawImage.html */
+static GpStatus
+EmfPlusDrawImage (MetafilePlayContext *context, WORD func, WORD flags, EmfPlusReader *reader)
+{
+	GpImage *image = get_object (context, flags & EMFPLUS_FLAGS_OBJECT_ID, EmfPlusObjectTypeImage);
+	GpImageAttributes *attributes = get_object (context, read_dword (reader), EmfPlusObjectTypeImageAttributes);
+	GpUnit unit = read_dword (reader);
+	GpStatus status;
+	GpRectF src, dest;
+	GpPointF *points;
+	int count;
+
+	if (!read_rects (reader, 0, &src, 1))
+		return InvalidParameter;
+
+	if (func == EmfPlusRecordTypeDrawImagePoints) {
+		status = read_counted_points (context, flags, reader, &points, &count);
+		if ((status != Ok) || !image)
+			return status;
+
+		return GdipDrawImagePointsRect (context->graphics, image, points, count, src.X, src.Y, src.Width, src.Height,
+			unit, attributes, NULL, NULL);
+	}
+
+	if (!read_rects (reader, flags, &dest, 1))
+		return InvalidParameter;
+	if (!image)
+		return Ok;
+
+	return GdipDrawImageRectRect (context->graphics, image, dest.X, dest.Y, dest.Width, dest.Height,
+		src.X, src.Y, src.Width, src.Height, unit, attributes, NULL, NULL);
+}
+
+/* DrawString - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/DrawString.html */
+static GpStatus
+EmfPlusDrawString (MetafilePlayContext *context, WORD flags, EmfPlusReader *reader)
+{
+	GpFont *font = get_object (context, flags & EMFPLUS_FLAGS_OBJECT_ID, EmfPlusObjectTypeFont);
+	GpBrush *brush = get_brush (context, flags, read_dword (reader));
+	GpStringFormat *format = get_object (context, read_dword (reader), EmfPlusObjectTypeStringFormat);
+	DWORD length = read_dword (reader);
+	const BYTE *p;
+	WCHAR *string;
+	GpRectF rect;
+	DWORD i;
+
+	if (!read_rects (reader, 0, &rect, 1) || !reader_has (reader, length, sizeof (WCHAR)))
+		return InvalidParameter;
+	if (!font || !brush || (length == 0))
+		return Ok;
+
+	string = get_scratch (context->emfplus, length * sizeof (WCHAR));
+	if (!string)
+		return OutOfMemory;
+
+	p = read_bytes (reader, length * sizeof (WCHAR));
+	for (i = 0; i < length; i++, p += sizeof (WCHAR))
+		string [i] = p [0] | (p [1] << 8);
+
+	return GdipDrawString (context->graphics, string, length, font, &rect, format, brush);
+}
+
+/* Save and BeginContainer keep the graphics state, the world and page transforms */
+static GpStatus
+push_state (MetafilePlayContext *context, DWORD index)
+{
+	EmfPlusContext *emfplus = context->emfplus;
+	EmfPlusState *state;
+	GpStatus status;
+
+	if (emfplus->states_count == emfplus->states_capacity) {
+		int capacity = emfplus->states_capacity ? emfplus->states_capacity * 2 : 8;
+		EmfPlusState *states = gdip_realloc (emfplus->states, capacity * sizeof (EmfPlusState));
+
+		if (!states)
+			return OutOfMemory;
+		emfplus->states = states;
+		emfplus->states_capacity = capacity;
+	}
+
+	state = &emfplus->states [emfplus->states_count];
+	status = GdipSaveGraphics (context->graphics, &state->state);
+	if (status != Ok)
+		return status;
+
+	state->index = index;
+	gdip_cairo_matrix_copy (&state->base, &emfplus->base);
+	gdip_cairo_matrix_copy (&state->world, &emfplus->world);
+	state->page_x = emfplus->page_x;
+	state->page_y = emfplus->page_y;
+	emfplus->states_count++;
+	return Ok;
+}
+
+/* Restore and EndContainer also drop the states pushed after @index */
+static GpStatus
+pop_state (MetafilePlayContext *context, DWORD index)
+{
+	EmfPlusContext *emfplus = context->emfplus;
+	EmfPlusState *state;
+	GpStatus status;
+	int i;
+
+	for (i = emfplus->states_count - 1; i >= 0; i--) {
+		if (emfplus->states [i].index == index)
+			break;
+	}
+
+	/* like GdipRestoreGraphics, unknown states are ignored */
+	if (i < 0)
+		return Ok;
+
+	state = &emfplus->states [i];
+	status = GdipRestoreGraphics (context->graphics, state->state);
+	gdip_cairo_matrix_copy (&emfplus->base, &state->base);
+	gdip_cairo_matrix_copy (&emfplus->world, &state->world);
+	emfplus->page_x = state->page_x;
+	emfplus->page_y = state->page_y;
+	emfplus->states_count = i;
+
+	if (status != Ok)
+		return status;
+	return apply_transform (context);
+}
+
+/* BeginContainer - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/BeginContainer.html */
+static GpStatus
+EmfPlusBeginContainer (MetafilePlayContext *context, WORD func, WORD flags, EmfPlusReader *reader)
+{
+	EmfPlusContext *emfplus = context->emfplus;
+	GpRectF rects [2];
+	GpStatus status;
+	DWORD index;
+
+	if ((func == EmfPlusRecordTypeBeginContainer) && !read_rects (reader, 0, rects, 2))
+		return InvalidParameter;
+
+	index = read_dword (reader);
+	if (reader->failed)
+		return InvalidParameter;
+
+	status = push_state (context, index);
+	if (status != Ok)
+		return status;
+
+	/* the records inside the container are transformed by the current transform */
+	if (func == EmfPlusRecordTypeBeginContainerNoParams)
+		GdipScaleMatrix (&emfplus->world, emfplus->page_x, emfplus->page_y, MatrixOrderAppend);
+	GdipMultiplyMatrix (&emfplus->world, &emfplus->base, MatrixOrderAppend);
+	gdip_cairo_matrix_copy (&emfplus->base, &emfplus->world);
+	cairo_matrix_init_identity (&emfplus->world);
+	emfplus->page_x = 1.0f;
+	emfplus->page_y = 1.0f;
+
+	/* and, with parameters, the source rectangle is mapped onto the destination one (in the flags unit) */
+	if ((func == EmfPlusRecordTypeBeginContainer) && (rects [1].Width != 0) && (rects [1].Height != 0)) {
+		GpUnit unit = (flags >> 8) & 0xFF;
+		GpRectF *dest = &rects [0];
+		GpRectF *src = &rects [1];
+
+		cairo_matrix_init_translate (&emfplus->world,
+			gdip_unit_conversion (unit, UnitPixel, emfplus->dpi_x, gtMemoryBitmap, dest->X),
+			gdip_unit_conversion (unit, UnitPixel, emfplus->dpi_y, gtMemoryBitmap, dest->Y));
+		cairo_matrix_scale (&emfplus->world,
+			gdip_unit_conversion (unit, UnitPixel, emfplus->dpi_x, gtMemoryBitmap, dest->Width) / src->Width,
+			gdip_unit_conversion (unit, UnitPixel, emfplus->dpi_y, gtMemoryBitmap, dest->Height) / src->Height);
+		cairo_matrix_translate (&emfplus->world, -src->X, -src->Y);
+	}
+
+	return apply_transform (context);
+}
+
+/* SetWorldTransform, ResetWorldTransform and the Multiply, Translate, Scale and Rotate records */
+static GpStatus
+EmfPlusWorldTransform (MetafilePlayContext *context, WORD func, WORD flags, EmfPlusReader *reader)
+{
+	GpMatrix *world = &context->emfplus->world;
+	GpMatrixOrder order = (flags & EMFPLUS_FLAGS_APPEND) ? MatrixOrderAppend : MatrixOrderPrepend;
+	GpMatrix matrix;
+	float x, y;
+
+	switch (func) {
+	case EmfPlusRecordTypeSetWorldTransform:
+		read_matrix (reader, world);
+		break;
+	case EmfPlusRecordTypeResetWorldTransform:
+		cairo_matrix_init_identity (world);
+		break;
+	case EmfPlusRecordTypeMultiplyWorldTransform:
+		read_matrix (reader, &matrix);
+		GdipMultiplyMatrix (world, &matrix, order);
+		break;
+	case EmfPlusRecordTypeRotateWorldTransform:
+		x = read_float (reader);
+		GdipRotateMatrix (world, x, order);
+		break;
+	default:
+		x = read_float (reader);
+		y = read_float (reader);
+		if (func == EmfPlusRecordTypeScaleWorldTransform)
+			GdipScaleMatrix (world, x, y, order);
+		else
+			GdipTranslateMatrix (world, x, y, order);
+		break;
+	}
+
+	return apply_transform (context);
+}
+
+/* SetPageTransform - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/SetPageTransform.html */
+static GpStatus
+EmfPlusSetPageTransform (MetafilePlayContext *context, WORD flags, EmfPlusReader *reader)
+{
+	EmfPlusContext *emfplus = context->emfplus;
+	GpUnit unit = flags & 0xFF;
+	float scale = read_float (reader);
+
+	if (reader->failed || (unit == UnitWorld) || (unit > UnitMillimeter) || (scale <= 0))
+		return InvalidParameter;
+
+	emfplus->page_x = gdip_unit_conversion (unit, UnitPixel, emfplus->dpi_x, gtMemoryBitmap, scale);
+	emfplus->page_y = gdip_unit_conversion (unit, UnitPixel, emfplus->dpi_y, gtMemoryBitmap, scale);
+	return apply_transform (context);
+}
+
+/* ResetClip, SetClipRect, SetClipPath, SetClipRegion and OffsetClip */
+static GpStatus
+EmfPlusClip (MetafilePlayContext *context, WORD func, WORD flags, EmfPlusReader *reader)
+{
+	CombineMode mode = (flags & EMFPLUS_FLAGS_COMBINE_MODE) >> 8;
+	GpStatus status;
+	GpRectF rect;
+	void *object;
+	float dx, dy;
+
+	switch (func) {
+	case EmfPlusRecordTypeResetClip:
+		/* back to the destination clip, which is in device units */
+		GdipResetWorldTransform (context->graphics);
+		status = GdipSetClipRegion (context->graphics, context->emfplus->clip, CombineModeReplace);
 		if (status != Ok)
 			return status;
-		brush = (GpBrush*)solid;
-	} else {
-		/* TODO - get brush from index */
-	}
-
-	while ((i++ < num) && (status == Ok)) {
-		float x, y, w, h;
-		if (use_int16) {
-			DWORD xy = GETDW(DWP(n));
-			n++;
-			x = (xy >> 16);
-			y = (WORD)xy;
-			DWORD wh = GETDW(DWP(n));
-			n++;
-			w = (wh >> 16);
-			h = (WORD)wh;
-		} else {
-			x = (float) GETDW(DWP(n));
-			n++;
-			y = (float) GETDW(DWP(n));
-			n++;
-			w = (float) GETDW(DWP(n));
-			n++;
-			h = (float) GETDW(DWP(n));
-			n++;
-		}
-#ifdef DEBUG_EMFPLUS_2
-		printf ("\n\t\t%d - x %g, y %g, w %g, h %g", i, x, y, w, h);
-#endif
-		status = GdipFillRectangle (context->graphics, brush, x, y, w, h);
+		return apply_transform (context);
+	case EmfPlusRecordTypeSetClipRect:
+		if (!read_rects (reader, 0, &rect, 1))
+			return InvalidParameter;
+		return GdipSetClipRect (context->graphics, rect.X, rect.Y, rect.Width, rect.Height, mode);
+	case EmfPlusRecordTypeSetClipPath:
+		object = get_object (context, flags & EMFPLUS_FLAGS_OBJECT_ID, EmfPlusObjectTypePath);
+		return object ? GdipSetClipPath (context->graphics, (GpPath *) object, mode) : Ok;
+	case EmfPlusRecordTypeSetClipRegion:
+		object = get_object (context, flags & EMFPLUS_FLAGS_OBJECT_ID, EmfPlusObjectTypeRegion);
+		return object ? GdipSetClipRegion (context->graphics, (GpRegion *) object, mode) : Ok;
+	default:
+		dx = read_float (reader);
+		dy = read_float (reader);
+		if (reader->failed)
+			return InvalidParameter;
+		return GdipTranslateClip (context->graphics, dx, dy);
 	}
+}
 
-	if (solid)
-		GdipDeleteBrush (brush); /* brush == a GpBrush* typecasted solid, if used */
-	return status;
+/* the EMF+ state lives as long as the playback, see gdip_metafile_play_emfplus_cleanup */
+static GpStatus
+emfplus_context_create (MetafilePlayContext *context)
+{
+	EmfPlusContext *emfplus;
+	GpStatus status;
+	float dpi = gdip_get_display_dpi ();
+
+	emfplus = GdipAlloc (sizeof (EmfPlusContext));
+	if (!emfplus)
+		return OutOfMemory;
+
+	memset (emfplus, 0, sizeof (EmfPlusContext));
+	status = GdipCreateSolidFill (0, &emfplus->solid);
+	if (status == Ok)
+		status = GdipCreateRegion (&emfplus->clip);
+	if (status == Ok) {
+		GpMatrix world;
+
+		/* the destination clip in device units, then its whole state */
+		GdipGetWorldTransform (context->graphics, &world);
+		GdipResetWorldTransform (context->graphics);
+		status = GdipGetClip (context->graphics, emfplus->clip);
+		GdipSetWorldTransform (context->graphics, &world);
+	}
+	if (status == Ok)
+		status = GdipSaveGraphics (context->graphics, &emfplus->outer);
+
+	if (status != Ok) {
+		if (emfplus->solid)
+			GdipDeleteBrush ((GpBrush *) emfplus->solid);
+		if (emfplus->clip)
+			GdipDeleteRegion (emfplus->clip);
+		GdipFree (emfplus);
+		return status;
+	}
+
+	gdip_cairo_matrix_copy (&emfplus->base, &context->matrix);
+	cairo_matrix_init_identity (&emfplus->world);
+	emfplus->page_x = 1.0f;
+	emfplus->page_y = 1.0f;
+	emfplus->dpi_x = dpi;
+	emfplus->dpi_y = dpi;
+	context->emfplus = emfplus;
+	return Ok;
+}
+
+void
+gdip_metafile_play_emfplus_cleanup (MetafilePlayContext *context)
+{
+	EmfPlusContext *emfplus = context->emfplus;
+	int i;
+
+	if (!emfplus)
+		return;
+
+	for (i = 0; i < EMFPLUS_MAX_OBJECTS; i++)
+		delete_object (&emfplus->objects [i]);
+
+	/* the clip, modes and saved states of the destination */
+	if (context->graphics)
+		GdipRestoreGraphics (context->graphics, emfplus->outer);
+
+	GdipDeleteBrush ((GpBrush *) emfplus->solid);
+	GdipDeleteRegion (emfplus->clip);
+	if (emfplus->scratch)
+		GdipFree (emfplus->scratch);
+	if (emfplus->states)
+		GdipFree (emfplus->states);
+	if (emfplus->continued)
+		GdipFree (emfplus->continued);
+	GdipFree (emfplus);
+	context->emfplus = NULL;
 }
 
+/*
+ * Records that can't be played, e.g. their data is truncated or their objects couldn't be created,
+ * are skipped. Only a lack of memory stops the playback.
+ */
 GpStatus
 gdip_metafile_play_emfplus_block (MetafilePlayContext *context, BYTE* data, int length)
 {
 	GpStatus status = Ok;
 	BYTE *end = data + length;
+	EmfPlusReader reader;
+	GpMatrix gdi;
 #ifdef DEBUG_EMFPLUS
-	int i = 1, j;
+	int i = 1;
 #endif
 
 	/* special case to update the header informations (we're not really playing the metafile) */
@@ -143,43 +1894,182 @@ gdip_metafile_play_emfplus_block (MetafilePlayContext *context, BYTE* data, int
 		return Ok;
 	}
 
-	/* reality check - each record is, at minimum, 8 bytes long (when size == 0) */
-	while (data < end - EMF_MIN_RECORD_SIZE) {
+	if (!context->emfplus) {
+		status = emfplus_context_create (context);
+		if (status != Ok)
+			return status;
+	}
+
+	/* the GDI records around the block use their own transform */
+	GdipGetWorldTransform (context->graphics, &gdi);
+	context->emfplus->get_dc = FALSE;
+	status = apply_transform (context);
+
+	while ((status == Ok) && (data <= end - EMFPLUS_RECORD_HEADER_SIZE)) {
 		DWORD record = GETDW(EMF_FUNCTION);
 		WORD func = (WORD)record;
 		WORD flags = (record >> 16);
 		DWORD size = GETDW(EMF_RECORDSIZE);
+
+		if ((size < EMFPLUS_RECORD_HEADER_SIZE) || (size > (DWORD) (end - data)))
+			break;
 #ifdef DEBUG_EMFPLUS
-		printf ("\n\tEMF+[#%d] size %d ", i++, size);
+		printf ("\n\tEMF+[#%d] type %X flags %X size %d ", i++, func, flags, size);
 #endif
+		/* the data size can't be trusted more than the record size */
+		reader_init (&reader, data + EMFPLUS_RECORD_HEADER_SIZE, MIN (GETDW(DWP1), size - EMFPLUS_RECORD_HEADER_SIZE));
+
 		switch (func) {
 		case EmfPlusRecordTypeHeader:
 			status = EmfPlusHeader (context, flags, data, size);
 			break;
 		case EmfPlusRecordTypeEndOfFile:
-			return EmfPlusEndOfFile (context, flags, data, size);
+			status = EmfPlusEndOfFile (context, flags, data, size);
+			goto cleanup;
+		case EmfPlusRecordTypeGetDC:
+			context->emfplus->get_dc = TRUE;
+			break;
+		case EmfPlusRecordTypeObject:
+			status = EmfPlusObject (context, flags, &reader);
+			break;
+		case EmfPlusRecordTypeClear: {
+			ARGB color = read_dword (&reader);
+			status = reader.failed ? InvalidParameter : GdipGraphicsClear (context->graphics, color);
+			break;
+		}
 		case EmfPlusRecordTypeFillRects:
-			status = EmfPlusFillRects (context, flags, data, size);
+			status = EmfPlusFillRects (context, flags, &reader);
+			break;
+		case EmfPlusRecordTypeDrawRects:
+			status = EmfPlusDrawRects (context, flags, &reader);
+			break;
+		case EmfPlusRecordTypeFillPolygon:
+			status = EmfPlusFillPolygon (context, flags, &reader);
+			break;
+		case EmfPlusRecordTypeDrawLines:
+			status = EmfPlusDrawLines (context, flags, &reader);
+			break;
+		case EmfPlusRecordTypeFillEllipse:
+		case EmfPlusRecordTypeDrawEllipse:
+			status = EmfPlusEllipse (context, func, flags, &reader);
+			break;
+		case EmfPlusRecordTypeFillPie:
+		case EmfPlusRecordTypeDrawPie:
+		case EmfPlusRecordTypeDrawArc:
+			status = EmfPlusPie (context, func, flags, &reader);
+			break;
+		case EmfPlusRecordTypeFillRegion:
+			status = EmfPlusFillRegion (context, flags, &reader);
+			break;
+		case EmfPlusRecordTypeFillPath:
+			status = EmfPlusFillPath (context, flags, &reader);
+			break;
+		case EmfPlusRecordTypeDrawPath:
+			status = EmfPlusDrawPath (context, flags, &reader);
+			break;
+		case EmfPlusRecordTypeFillClosedCurve:
+			status = EmfPlusFillClosedCurve (context, flags, &reader);
+			break;
+		case EmfPlusRecordTypeDrawClosedCurve:
+		case EmfPlusRecordTypeDrawCurve:
+		case EmfPlusRecordTypeDrawBeziers:
+			status = EmfPlusDrawCurve (context, func, flags, &reader);
+			break;
+		case EmfPlusRecordTypeDrawImage:
+		case EmfPlusRecordTypeDrawImagePoints:
+			status = EmfPlusDrawImage (context, func, flags, &reader);
+			break;
+		case EmfPlusRecordTypeDrawString:
+			status = EmfPlusDrawString (context, flags, &reader);
+			break;
+		case EmfPlusRecordTypeSetRenderingOrigin: {
+			int x = read_dword (&reader);
+			int y = read_dword (&reader);
+			status = reader.failed ? InvalidParameter : GdipSetRenderingOrigin (context->graphics, x, y);
+			break;
+		}
+		case EmfPlusRecordTypeSetAntiAliasMode: {
+			/* bit 0 is set when antialiasing, the smoothing mode itself follows when the writer gave it */
+			SmoothingMode mode = (flags >> 1) & 0x7F;
+
+			if ((mode > SmoothingModeAntiAlias + 1) || ((mode == SmoothingModeDefault) && (flags & 1)))
+				mode = (flags & 1) ? SmoothingModeAntiAlias : SmoothingModeNone;
+			status = GdipSetSmoothingMode (context->graphics, mode);
+			break;
+		}
+		case EmfPlusRecordTypeSetTextRenderingHint:
+			status = GdipSetTextRenderingHint (context->graphics, flags & 0xFF);
+			break;
+		case EmfPlusRecordTypeSetTextContrast:
+			status = GdipSetTextContrast (context->graphics, flags & 0x0FFF);
+			break;
+		case EmfPlusRecordTypeSetInterpolationMode:
+			status = GdipSetInterpolationMode (context->graphics, flags & 0xFF);
+			break;
+		case EmfPlusRecordTypeSetPixelOffsetMode:
+			status = GdipSetPixelOffsetMode (context->graphics, flags & 0xFF);
+			break;
+		case EmfPlusRecordTypeSetCompositingMode:
+			status = GdipSetCompositingMode (context->graphics, flags & 0xFF);
+			break;
+		case EmfPlusRecordTypeSetCompositingQuality:
+			status = GdipSetCompositingQuality (context->graphics, flags & 0xFF);
+			break;
+		case EmfPlusRecordTypeSave: {
+			DWORD index = read_dword (&reader);
+			status = reader.failed ? InvalidParameter : push_state (context, index);
+			break;
+		}
+		case EmfPlusRecordTypeRestore:
+		case EmfPlusRecordTypeEndContainer: {
+			DWORD index = read_dword (&reader);
+			status = reader.failed ? InvalidParameter : pop_state (context, index);
+			break;
+		}
+		case EmfPlusRecordTypeBeginContainer:
+		case EmfPlusRecordTypeBeginContainerNoParams:
+			status = EmfPlusBeginContainer (context, func, flags, &reader);
+			break;
+		case EmfPlusRecordTypeSetWorldTransform:
+		case EmfPlusRecordTypeResetWorldTransform:
+		case EmfPlusRecordTypeMultiplyWorldTransform:
+		case EmfPlusRecordTypeTranslateWorldTransform:
+		case EmfPlusRecordTypeScaleWorldTransform:
+		case EmfPlusRecordTypeRotateWorldTransform:
+			status = EmfPlusWorldTransform (context, func, flags, &reader);
+			break;
+		case EmfPlusRecordTypeSetPageTransform:
+			status = EmfPlusSetPageTransform (context, flags, &reader);
+			break;
+		case EmfPlusRecordTypeResetClip:
+		case EmfPlusRecordTypeSetClipRect:
+		case EmfPlusRecordTypeSetClipPath:
+		case EmfPlusRecordTypeSetClipRegion:
+		case EmfPlusRecordTypeOffsetClip:
+			status = EmfPlusClip (context, func, flags, &reader);
 			break;
 		default:
-			/* unprocessed records, ignore the data */
+			/* unprocessed records (comments, multi-format sections, driver strings), ignore the data */
 #ifdef DEBUG_EMFPLUS_NOTIMPLEMENTED
-			printf ("Unimplemented_%d (", func);
-			for (j = 0; j < params; j++) {
-				printf (" %d", GETDW(DWP(j)));
-			}
-			printf (" )");
+			printf ("Unimplemented_%X (size %d)", func, size);
 #endif
 			break;
 		}
 
 		if (status != Ok) {
-			g_warning ("EMF+ parsing interupted, status %d returned from function %d.", status, func);
-			goto cleanup;
+#ifdef DEBUG_EMFPLUS
+			printf (" - skipped, status %d", status);
+#endif
+			if (status == OutOfMemory) {
+				g_warning ("EMF+ parsing interupted, status %d returned from function %d.", status, func);
+				goto cleanup;
+			}
+			status = Ok;
 		}
 
 		data += size;
 	}
 cleanup:
+	GdipSetWorldTransform (context->graphics, &gdi);
 	return status;
 }
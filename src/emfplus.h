@@ -29,6 +29,132 @@
 #include "graphics.h"
 #include "solidbrush-private.h"
 
+/* identifies an EMR_GDICOMMENT record carrying EMF+ records */
+#define EMFPLUS_COMMENT_SIGNATURE	0x2B464D45
+/* metafile signature (0xDBC01) and graphics version, found in the header and every object */
+#define EMFPLUS_VERSION			0xDBC01002
+/* type/flags, size and data size */
+#define EMFPLUS_RECORD_HEADER_SIZE	12
+/* size of the EmfPlusHeader record */
+#define EMFPLUS_HEADER_SIZE		28
+/* objects are referenced by an 8 bits identifier, but only 64 slots exist */
+#define EMFPLUS_MAX_OBJECTS		64
+
+/* region nodes are read recursively, deeper (e.g. corrupted) trees are rejected */
+#define EMFPLUS_MAX_REGION_DEPTH	1024
+
+/* record flags */
+#define EMFPLUS_FLAGS_USE_SINGLE	0x0000
+#define EMFPLUS_FLAGS_DUAL		0x0001
+#define EMFPLUS_FLAGS_RELATIVE		0x0800
+#define EMFPLUS_FLAGS_FILLMODE_WINDING	0x2000
+#define EMFPLUS_FLAGS_CLOSED		0x2000
+#define EMFPLUS_FLAGS_APPEND		0x2000
+#define EMFPLUS_FLAGS_USE_INT16		0x4000
+#define EMFPLUS_FLAGS_USE_ARGB		0x8000
+#define EMFPLUS_FLAGS_OBJECT_ID		0x00FF
+#define EMFPLUS_FLAGS_OBJECT_TYPE	0x7F00
+#define EMFPLUS_FLAGS_COMBINE_MODE	0x0F00
+
+/* header flags */
+#define EMFPLUS_HEADER_VIDEO_DISPLAY	0x00000001
+
+typedef enum {
+	EmfPlusObjectTypeInvalid,
+	EmfPlusObjectTypeBrush,
+	EmfPlusObjectTypePen,
+	EmfPlusObjectTypePath,
+	EmfPlusObjectTypeRegion,
+	EmfPlusObjectTypeImage,
+	EmfPlusObjectTypeFont,
+	EmfPlusObjectTypeStringFormat,
+	EmfPlusObjectTypeImageAttributes,
+	EmfPlusObjectTypeCustomLineCap
+} EmfPlusObjectType;
+
+/* optional data present in gradient and texture brushes */
+#define EMFPLUS_BRUSH_DATA_PATH			0x00000001
+#define EMFPLUS_BRUSH_DATA_TRANSFORM		0x00000002
+#define EMFPLUS_BRUSH_DATA_PRESET_COLORS	0x00000004
+#define EMFPLUS_BRUSH_DATA_BLEND_FACTORS_H	0x00000008
+#define EMFPLUS_BRUSH_DATA_BLEND_FACTORS_V	0x00000010
+#define EMFPLUS_BRUSH_DATA_FOCUS_SCALES		0x00000040
+#define EMFPLUS_BRUSH_DATA_GAMMA_CORRECTED	0x00000080
+
+/* optional data present in pens, in the order they are serialized */
+#define EMFPLUS_PEN_DATA_TRANSFORM		0x00000001
+#define EMFPLUS_PEN_DATA_START_CAP		0x00000002
+#define EMFPLUS_PEN_DATA_END_CAP		0x00000004
+#define EMFPLUS_PEN_DATA_JOIN			0x00000008
+#define EMFPLUS_PEN_DATA_MITER_LIMIT		0x00000010
+#define EMFPLUS_PEN_DATA_LINE_STYLE		0x00000020
+#define EMFPLUS_PEN_DATA_DASHED_LINE_CAP	0x00000040
+#define EMFPLUS_PEN_DATA_DASHED_LINE_OFFSET	0x00000080
+#define EMFPLUS_PEN_DATA_DASHED_LINE		0x00000100
+#define EMFPLUS_PEN_DATA_NON_CENTER		0x00000200
+#define EMFPLUS_PEN_DATA_COMPOUND_LINE		0x00000400
+#define EMFPLUS_PEN_DATA_CUSTOM_START_CAP	0x00000800
+#define EMFPLUS_PEN_DATA_CUSTOM_END_CAP		0x00001000
+
+/* path point flags */
+#define EMFPLUS_PATH_COMPRESSED			0x4000
+#define EMFPLUS_PATH_RLE			0x1000
+#define EMFPLUS_PATH_RELATIVE			0x0800
+
+/* images */
+#define EMFPLUS_IMAGE_BITMAP			1
+#define EMFPLUS_IMAGE_METAFILE			2
+#define EMFPLUS_BITMAP_PIXEL			0
+#define EMFPLUS_BITMAP_COMPRESSED		1
+
+/* object split over several Object records */
+#define EMFPLUS_OBJECT_CONTINUED		0x8000
+
+/* an object defined by an Object record, referenced by its slot in the following records */
+typedef struct {
+	EmfPlusObjectType type;
+	void *ptr;
+} EmfPlusObjectSlot;
+
+/* a graphics state pushed by the Save and BeginContainer records */
+typedef struct {
+	DWORD index;		/* stack index used by the matching Restore or EndContainer record */
+	GraphicsState state;
+	GpMatrix base;
+	GpMatrix world;
+	float page_x;
+	float page_y;
+} EmfPlusState;
+
+/*
+ * EMF+ playback state, created when the first EMF+ block is played on a graphics and kept across
+ * the EMR_GDICOMMENT records until gdip_metafile_play_emfplus_cleanup.
+ */
+struct _EmfPlusContext {
+	EmfPlusObjectSlot objects [EMFPLUS_MAX_OBJECTS];
+	EmfPlusState *states;
+	int states_count;
+	int states_capacity;
+	GraphicsState outer;	/* destination state, restored once the metafile is played */
+	GpRegion *clip;		/* destination clip, in device units, that ResetClip goes back to */
+	GpSolidFill *solid;	/* reused for the records carrying an ARGB color instead of a brush */
+	void *scratch;		/* points, rectangles and strings decoded from the current record */
+	int scratch_size;
+	/* device = world * page * base, base maps the metafile onto the destination (and containers) */
+	GpMatrix base;
+	GpMatrix world;
+	float page_x;
+	float page_y;
+	float dpi_x;
+	float dpi_y;
+	BOOL dual;		/* EmfPlusDual, the GDI records duplicate the EMF+ ones... */
+	BOOL get_dc;		/* ...unless a GetDC record hands the drawing over to them */
+	/* object split in several Object records */
+	BYTE *continued;
+	int continued_length;
+	int continued_size;
+};
+
 /*
  * Some interesting links...
  * [EMF+ Metafile Record Format Documentation]	http://www.aces.uiuc.edu/~jhtodd/Metafile/
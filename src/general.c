@@ -30,6 +30,8 @@
 #include "codecs-private.h"
 #include "graphics-private.h"
 #include "font-private.h"
+#include "hatchbrush-private.h"
+#include "lineargradientbrush-private.h"
 #include "stringformat-private.h"
 #include "carbon-private.h"
 #ifdef WIN32
@@ -136,6 +138,8 @@ WINGDIPAPI GdiplusShutdown (ULONG_PTR token)
 	if (gdiplusInitialized) {
 		releaseCodecList ();
 		gdip_font_clear_pattern_cache ();
+		gdip_hatch_clear_tile_cache ();
+		gdip_linear_gradient_clear_ramp_cache ();
 		gdip_delete_system_fonts ();
 		gdip_delete_generic_stringformats ();
 #if HAVE_FCFINI
@@ -38,376 +38,9 @@ GUID gdip_gif_image_format_guid = {0xb96b3cb0U, 0x0728U, 0x11d3U, {0x9d, 0x7b, 0
 #include <stdint.h>
 
 #include "gifcodec.h"
+#include "quantize-private.h"
 
 
-/* START GifQuantizeBuffer copy from giflib
-
-The giflib 5.2.0 release notes mention:
-
-> The undocumented and deprecated GifQuantizeBuffer() entry point
-> has been moved to the util library to reduce libgif size and attack
-> surface. Applications needing this function are couraged to link the
-> util library or make their own copy.
-
-Since the util library doesn't get installed in most distros we can't
-link against it and need to make our own copy called LibgdiplusGifQuantizeBuffer.
-This is taken from giflib 52b62de83d5facbbbde042b85bf3f61182e3bebd.
-
-> The GIFLIB distribution is Copyright (c) 1997  Eric S. Raymond
->
-> Permission is hereby granted, free of charge, to any person obtaining a copy
-> of this software and associated documentation files (the "Software"), to deal
-> in the Software without restriction, including without limitation the rights
-> to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-> copies of the Software, and to permit persons to whom the Software is
-> furnished to do so, subject to the following conditions:
->
-> The above copyright notice and this permission notice shall be included in
-> all copies or substantial portions of the Software.
->
-> THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-> IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-> FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
-> AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-> LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-> OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
-> THE SOFTWARE.
-
-*/
-
-/*****************************************************************************
-
- quantize.c - quantize a high resolution image into lower one
-
- Based on: "Color Image Quantization for frame buffer Display", by
- Paul Heckbert SIGGRAPH 1982 page 297-307.
-
- This doesn't really belong in the core library, was undocumented,
- and was removed in 4.2.  Then it turned out some client apps were
- actually using it, so it was restored in 5.0.
-
-SPDX-License-Identifier: MIT
-
-******************************************************************************/
-
-#include <stdlib.h>
-#include <stdio.h>
-#include "gif_lib.h"
-//#include "gif_lib_private.h"
-
-//#define ABS(x)    ((x) > 0 ? (x) : (-(x)))
-
-#define COLOR_ARRAY_SIZE 32768
-#define BITS_PER_PRIM_COLOR 5
-#define MAX_PRIM_COLOR      0x1f
-
-static int SortRGBAxis;
-
-typedef struct QuantizedColorType {
-    GifByteType RGB[3];
-    GifByteType NewColorIndex;
-    long Count;
-    struct QuantizedColorType *Pnext;
-} QuantizedColorType;
-
-typedef struct NewColorMapType {
-    GifByteType RGBMin[3], RGBWidth[3];
-    unsigned int NumEntries; /* # of QuantizedColorType in linked list below */
-    unsigned long Count; /* Total number of pixels in all the entries */
-    QuantizedColorType *QuantizedColors;
-} NewColorMapType;
-
-static int SubdivColorMap(NewColorMapType * NewColorSubdiv,
-                          unsigned int ColorMapSize,
-                          unsigned int *NewColorMapSize);
-static int SortCmpRtn(const void *Entry1, const void *Entry2);
-
-/******************************************************************************
- Quantize high resolution image into lower one. Input image consists of a
- 2D array for each of the RGB colors with size Width by Height. There is no
- Color map for the input. Output is a quantized image with 2D array of
- indexes into the output color map.
-   Note input image can be 24 bits at the most (8 for red/green/blue) and
- the output has 256 colors at the most (256 entries in the color map.).
- ColorMapSize specifies size of color map up to 256 and will be updated to
- real size before returning.
-   Also non of the parameter are allocated by this routine.
-   This function returns GIF_OK if successful, GIF_ERROR otherwise.
-******************************************************************************/
-int
-LibgdiplusGifQuantizeBuffer(unsigned int Width,
-               unsigned int Height,
-               int *ColorMapSize,
-               GifByteType * RedInput,
-               GifByteType * GreenInput,
-               GifByteType * BlueInput,
-               GifByteType * OutputBuffer,
-               GifColorType * OutputColorMap) {
-
-    unsigned int Index, NumOfEntries;
-    int i, j, MaxRGBError[3];
-    unsigned int NewColorMapSize;
-    long Red, Green, Blue;
-    NewColorMapType NewColorSubdiv[256];
-    QuantizedColorType *ColorArrayEntries, *QuantizedColor;
-
-    ColorArrayEntries = (QuantizedColorType *)malloc(
-                           sizeof(QuantizedColorType) * COLOR_ARRAY_SIZE);
-    if (ColorArrayEntries == NULL) {
-        return GIF_ERROR;
-    }
-
-    for (i = 0; i < COLOR_ARRAY_SIZE; i++) {
-        ColorArrayEntries[i].RGB[0] = i >> (2 * BITS_PER_PRIM_COLOR);
-        ColorArrayEntries[i].RGB[1] = (i >> BITS_PER_PRIM_COLOR) &
-           MAX_PRIM_COLOR;
-        ColorArrayEntries[i].RGB[2] = i & MAX_PRIM_COLOR;
-        ColorArrayEntries[i].Count = 0;
-    }
-
-    /* Sample the colors and their distribution: */
-    for (i = 0; i < (int)(Width * Height); i++) {
-        Index = ((RedInput[i] >> (8 - BITS_PER_PRIM_COLOR)) <<
-                  (2 * BITS_PER_PRIM_COLOR)) +
-                ((GreenInput[i] >> (8 - BITS_PER_PRIM_COLOR)) <<
-                  BITS_PER_PRIM_COLOR) +
-                (BlueInput[i] >> (8 - BITS_PER_PRIM_COLOR));
-        ColorArrayEntries[Index].Count++;
-    }
-
-    /* Put all the colors in the first entry of the color map, and call the
-     * recursive subdivision process.  */
-    for (i = 0; i < 256; i++) {
-        NewColorSubdiv[i].QuantizedColors = NULL;
-        NewColorSubdiv[i].Count = NewColorSubdiv[i].NumEntries = 0;
-        for (j = 0; j < 3; j++) {
-            NewColorSubdiv[i].RGBMin[j] = 0;
-            NewColorSubdiv[i].RGBWidth[j] = 255;
-        }
-    }
-
-    /* Find the non empty entries in the color table and chain them: */
-    for (i = 0; i < COLOR_ARRAY_SIZE; i++)
-        if (ColorArrayEntries[i].Count > 0)
-            break;
-    QuantizedColor = NewColorSubdiv[0].QuantizedColors = &ColorArrayEntries[i];
-    NumOfEntries = 1;
-    while (++i < COLOR_ARRAY_SIZE)
-        if (ColorArrayEntries[i].Count > 0) {
-            QuantizedColor->Pnext = &ColorArrayEntries[i];
-            QuantizedColor = &ColorArrayEntries[i];
-            NumOfEntries++;
-        }
-    QuantizedColor->Pnext = NULL;
-
-    NewColorSubdiv[0].NumEntries = NumOfEntries; /* Different sampled colors */
-    NewColorSubdiv[0].Count = ((long)Width) * Height; /* Pixels */
-    NewColorMapSize = 1;
-    if (SubdivColorMap(NewColorSubdiv, *ColorMapSize, &NewColorMapSize) !=
-       GIF_OK) {
-        free((char *)ColorArrayEntries);
-        return GIF_ERROR;
-    }
-    if (NewColorMapSize < *ColorMapSize) {
-        /* And clear rest of color map: */
-        for (i = NewColorMapSize; i < *ColorMapSize; i++)
-            OutputColorMap[i].Red = OutputColorMap[i].Green =
-                OutputColorMap[i].Blue = 0;
-    }
-
-    /* Average the colors in each entry to be the color to be used in the
-     * output color map, and plug it into the output color map itself. */
-    for (i = 0; i < NewColorMapSize; i++) {
-        if ((j = NewColorSubdiv[i].NumEntries) > 0) {
-            QuantizedColor = NewColorSubdiv[i].QuantizedColors;
-            Red = Green = Blue = 0;
-            while (QuantizedColor) {
-                QuantizedColor->NewColorIndex = i;
-                Red += QuantizedColor->RGB[0];
-                Green += QuantizedColor->RGB[1];
-                Blue += QuantizedColor->RGB[2];
-                QuantizedColor = QuantizedColor->Pnext;
-            }
-            OutputColorMap[i].Red = (Red << (8 - BITS_PER_PRIM_COLOR)) / j;
-            OutputColorMap[i].Green = (Green << (8 - BITS_PER_PRIM_COLOR)) / j;
-            OutputColorMap[i].Blue = (Blue << (8 - BITS_PER_PRIM_COLOR)) / j;
-        }
-    }
-
-    /* Finally scan the input buffer again and put the mapped index in the
-     * output buffer.  */
-    MaxRGBError[0] = MaxRGBError[1] = MaxRGBError[2] = 0;
-    for (i = 0; i < (int)(Width * Height); i++) {
-        Index = ((RedInput[i] >> (8 - BITS_PER_PRIM_COLOR)) <<
-                 (2 * BITS_PER_PRIM_COLOR)) +
-                ((GreenInput[i] >> (8 - BITS_PER_PRIM_COLOR)) <<
-                 BITS_PER_PRIM_COLOR) +
-                (BlueInput[i] >> (8 - BITS_PER_PRIM_COLOR));
-        Index = ColorArrayEntries[Index].NewColorIndex;
-        OutputBuffer[i] = Index;
-        if (MaxRGBError[0] < ABS(OutputColorMap[Index].Red - RedInput[i]))
-            MaxRGBError[0] = ABS(OutputColorMap[Index].Red - RedInput[i]);
-        if (MaxRGBError[1] < ABS(OutputColorMap[Index].Green - GreenInput[i]))
-            MaxRGBError[1] = ABS(OutputColorMap[Index].Green - GreenInput[i]);
-        if (MaxRGBError[2] < ABS(OutputColorMap[Index].Blue - BlueInput[i]))
-            MaxRGBError[2] = ABS(OutputColorMap[Index].Blue - BlueInput[i]);
-    }
-
-#ifdef DEBUG
-    fprintf(stderr,
-            "Quantization L(0) errors: Red = %d, Green = %d, Blue = %d.\n",
-            MaxRGBError[0], MaxRGBError[1], MaxRGBError[2]);
-#endif /* DEBUG */
-
-    free((char *)ColorArrayEntries);
-
-    *ColorMapSize = NewColorMapSize;
-
-    return GIF_OK;
-}
-
-/******************************************************************************
- Routine to subdivide the RGB space recursively using median cut in each
- axes alternatingly until ColorMapSize different cubes exists.
- The biggest cube in one dimension is subdivide unless it has only one entry.
- Returns GIF_ERROR if failed, otherwise GIF_OK.
-*******************************************************************************/
-static int
-SubdivColorMap(NewColorMapType * NewColorSubdiv,
-               unsigned int ColorMapSize,
-               unsigned int *NewColorMapSize) {
-
-    unsigned int i, j, Index = 0;
-    QuantizedColorType *QuantizedColor, **SortArray;
-
-    while (ColorMapSize > *NewColorMapSize) {
-        /* Find candidate for subdivision: */
-	long Sum, Count;
-        int MaxSize = -1;
-	unsigned int NumEntries, MinColor, MaxColor;
-        for (i = 0; i < *NewColorMapSize; i++) {
-            for (j = 0; j < 3; j++) {
-                if ((((int)NewColorSubdiv[i].RGBWidth[j]) > MaxSize) &&
-                      (NewColorSubdiv[i].NumEntries > 1)) {
-                    MaxSize = NewColorSubdiv[i].RGBWidth[j];
-                    Index = i;
-                    SortRGBAxis = j;
-                }
-            }
-        }
-
-        if (MaxSize == -1)
-            return GIF_OK;
-
-        /* Split the entry Index into two along the axis SortRGBAxis: */
-
-        /* Sort all elements in that entry along the given axis and split at
-         * the median.  */
-        SortArray = (QuantizedColorType **)malloc(
-                      sizeof(QuantizedColorType *) * 
-                      NewColorSubdiv[Index].NumEntries);
-        if (SortArray == NULL)
-            return GIF_ERROR;
-        for (j = 0, QuantizedColor = NewColorSubdiv[Index].QuantizedColors;
-             j < NewColorSubdiv[Index].NumEntries && QuantizedColor != NULL;
-             j++, QuantizedColor = QuantizedColor->Pnext)
-            SortArray[j] = QuantizedColor;
-
-	/*
-	 * Because qsort isn't stable, this can produce differing 
-	 * results for the order of tuples depending on platform
-	 * details of how qsort() is implemented.
-	 *
-	 * We mitigate this problem by sorting on all three axes rather
-	 * than only the one specied by SortRGBAxis; that way the instability
-	 * can only become an issue if there are multiple color indices
-	 * referring to identical RGB tuples.  Older versions of this 
-	 * sorted on only the one axis.
-	 */
-        qsort(SortArray, NewColorSubdiv[Index].NumEntries,
-              sizeof(QuantizedColorType *), SortCmpRtn);
-
-        /* Relink the sorted list into one: */
-        for (j = 0; j < NewColorSubdiv[Index].NumEntries - 1; j++)
-            SortArray[j]->Pnext = SortArray[j + 1];
-        SortArray[NewColorSubdiv[Index].NumEntries - 1]->Pnext = NULL;
-        NewColorSubdiv[Index].QuantizedColors = QuantizedColor = SortArray[0];
-        free((char *)SortArray);
-
-        /* Now simply add the Counts until we have half of the Count: */
-        Sum = NewColorSubdiv[Index].Count / 2 - QuantizedColor->Count;
-        NumEntries = 1;
-        Count = QuantizedColor->Count;
-        while (QuantizedColor->Pnext != NULL &&
-	       (Sum -= QuantizedColor->Pnext->Count) >= 0 &&
-               QuantizedColor->Pnext->Pnext != NULL) {
-            QuantizedColor = QuantizedColor->Pnext;
-            NumEntries++;
-            Count += QuantizedColor->Count;
-        }
-        /* Save the values of the last color of the first half, and first
-         * of the second half so we can update the Bounding Boxes later.
-         * Also as the colors are quantized and the BBoxes are full 0..255,
-         * they need to be rescaled.
-         */
-        MaxColor = QuantizedColor->RGB[SortRGBAxis]; /* Max. of first half */
-	/* coverity[var_deref_op] */
-        MinColor = QuantizedColor->Pnext->RGB[SortRGBAxis]; /* of second */
-        MaxColor <<= (8 - BITS_PER_PRIM_COLOR);
-        MinColor <<= (8 - BITS_PER_PRIM_COLOR);
-
-        /* Partition right here: */
-        NewColorSubdiv[*NewColorMapSize].QuantizedColors =
-           QuantizedColor->Pnext;
-        QuantizedColor->Pnext = NULL;
-        NewColorSubdiv[*NewColorMapSize].Count = Count;
-        NewColorSubdiv[Index].Count -= Count;
-        NewColorSubdiv[*NewColorMapSize].NumEntries =
-           NewColorSubdiv[Index].NumEntries - NumEntries;
-        NewColorSubdiv[Index].NumEntries = NumEntries;
-        for (j = 0; j < 3; j++) {
-            NewColorSubdiv[*NewColorMapSize].RGBMin[j] =
-               NewColorSubdiv[Index].RGBMin[j];
-            NewColorSubdiv[*NewColorMapSize].RGBWidth[j] =
-               NewColorSubdiv[Index].RGBWidth[j];
-        }
-        NewColorSubdiv[*NewColorMapSize].RGBWidth[SortRGBAxis] =
-           NewColorSubdiv[*NewColorMapSize].RGBMin[SortRGBAxis] +
-           NewColorSubdiv[*NewColorMapSize].RGBWidth[SortRGBAxis] - MinColor;
-        NewColorSubdiv[*NewColorMapSize].RGBMin[SortRGBAxis] = MinColor;
-
-        NewColorSubdiv[Index].RGBWidth[SortRGBAxis] =
-           MaxColor - NewColorSubdiv[Index].RGBMin[SortRGBAxis];
-
-        (*NewColorMapSize)++;
-    }
-
-    return GIF_OK;
-}
-
-/****************************************************************************
- Routine called by qsort to compare two entries.
-*****************************************************************************/
-
-static int
-SortCmpRtn(const void *Entry1,
-           const void *Entry2) {
-	   QuantizedColorType *entry1 = (*((QuantizedColorType **) Entry1));
-	   QuantizedColorType *entry2 = (*((QuantizedColorType **) Entry2));
-
-	   /* sort on all axes of the color space! */
-	   int hash1 = entry1->RGB[SortRGBAxis] * 256 * 256
-	   			+ entry1->RGB[(SortRGBAxis+1) % 3] * 256
-				+ entry1->RGB[(SortRGBAxis+2) % 3];
-	   int hash2 = entry2->RGB[SortRGBAxis] * 256 * 256
-	   			+ entry2->RGB[(SortRGBAxis+1) % 3] * 256
-				+ entry2->RGB[(SortRGBAxis+2) % 3];
-
-    return hash1 - hash2;
-}
-
-/* END GifQuantizeBuffer copy from giflib */
-
 /* Data structure used for callback */
 typedef struct
 {
@@ -416,6 +49,47 @@ typedef struct
 	
 } gif_callback_data;
 
+/* GIF disposal methods, applied to the frame rectangle before drawing the next frame */
+#define GIF_DISPOSAL_RESTORE_BACKGROUND	2
+#define GIF_DISPOSAL_RESTORE_PREVIOUS	3
+
+/* Frame whose pixels are composed on the canvas when it's selected */
+typedef struct
+{
+	int		offset;		/* of its image descriptor, in the copy of the file */
+	int		disposal;
+	Rect		rect;		/* part of the screen drawn by the frame */
+} gif_frame_data;
+
+/*
+ * The frames are only scanned when loading, their LZW data is decoded later from a copy
+ * of the file kept by the bitmap, see gdip_gif_decode_frame.
+ * A single canvas holds the screen of the selected frame, and is shared by the frames as they are selected.
+ * The canvas keeps palette indexes when all the frames have the same palette. When some frames have palettes
+ * (or transparent indexes) of their own, the frames are composed in ARGB and the selected frame gets the
+ * indexes of its palette nearest to the composed colors, so every frame stays 8bpp indexed.
+ */
+typedef struct
+{
+	void		*stream;	/* FILE or gif_callback_data, while scanning */
+	BOOL		from_file;
+	BYTE		*data;
+	int		size;
+	int		capacity;
+	int		position;	/* read position when decoding a frame */
+	gif_frame_data	*frames;
+	int		count;
+	BYTE		*canvas;
+	int		stride;		/* of the canvas */
+	BYTE		*indexes;	/* pixels of the selected frame, when the canvas is ARGB */
+	int		current;	/* last frame drawn on the canvas, -1 if none */
+	int		view;		/* frame whose scan0 is the canvas (or the indexes), -1 if none */
+	BYTE		*previous;	/* rectangle of the current frame before it was drawn, for its disposal */
+	int		previous_size;
+	BYTE		*line;
+	BOOL		argb;		/* ARGB canvas, the frames' palettes differ */
+} gif_decoder_data;
+
 /* Codecinfo related data*/
 static ImageCodecInfo gif_codec;
 static const WCHAR gif_codecname[] = {'B', 'u', 'i','l', 't', '-','i', 'n', ' ', 'G', 'I', 'F', ' ', 'C', 
@@ -447,27 +121,88 @@ gdip_getcodecinfo_gif ()
 	return &gif_codec;
 }
 
-/* Read callback function for the gif libbrary*/
+/* Read callback function for the gif libbrary, keeping what is read for the frames decoded later */
 static int 
-gdip_gif_fileinputfunc (GifFileType *gif, GifByteType *data, int len) 
+gdip_gif_scaninputfunc (GifFileType *gif, GifByteType *data, int len) 
 {
-	return fread (data, 1, len, (FILE*) gif->UserData);
+	int read = 0;	
+	gif_decoder_data *decoder = (gif_decoder_data*) gif->UserData;
+
+	if (len <= 0)
+		return 0;
+
+	if (len > decoder->capacity - decoder->size) {
+		int capacity = decoder->capacity ? decoder->capacity : 4096;
+		BYTE *data;
+
+		while (len > capacity - decoder->size) {
+			if (capacity > G_MAXINT32 / 2)
+				return 0;
+			capacity *= 2;
+		}
+
+		data = gdip_realloc (decoder->data, capacity);
+		if (!data)
+			return 0;
+
+		decoder->data = data;
+		decoder->capacity = capacity;
+	}
+
+	if (decoder->from_file) {
+		read = fread (decoder->data + decoder->size, 1, len, (FILE*) decoder->stream);
+	} else {
+		gif_callback_data *gcd = (gif_callback_data*) decoder->stream;
+		read = gcd->getBytesFunc (decoder->data + decoder->size, len, 0);
+	}
+
+	if (read <= 0)
+		return read;
+
+	memcpy (data, decoder->data + decoder->size, read);
+	decoder->size += read;
+	return read;
 }
 
+/* Read callback function used to decode a frame from the copy of the file */
 static int 
-gdip_gif_inputfunc (GifFileType *gif, GifByteType *data, int len) 
+gdip_gif_memoryinputfunc (GifFileType *gif, GifByteType *data, int len) 
 {
-	int read = 0;	
-	gif_callback_data *gcd = (gif_callback_data*) gif->UserData;
-	
-	read = gcd->getBytesFunc (data, len, 0);
+	gif_decoder_data *decoder = (gif_decoder_data*) gif->UserData;
+	int read = MIN (len, decoder->size - decoder->position);
+
+	if (read <= 0)
+		return 0;
+
+	memcpy (data, decoder->data + decoder->position, read);
+	decoder->position += read;
 	return read;
 }
 
+static void
+gdip_gif_decoder_dispose (void *data)
+{
+	gif_decoder_data *decoder = (gif_decoder_data*) data;
+
+	if (decoder->data)
+		GdipFree (decoder->data);
+	if (decoder->frames)
+		GdipFree (decoder->frames);
+	if (decoder->canvas)
+		GdipFree (decoder->canvas);
+	if (decoder->indexes)
+		GdipFree (decoder->indexes);
+	if (decoder->previous)
+		GdipFree (decoder->previous);
+	if (decoder->line)
+		GdipFree (decoder->line);
+	GdipFree (decoder);
+}
+
 /*
    This is the DGifSlurp and AddExtensionBlock code courtesy of giflib, 
    It's modified to not dump comments after the image block, since those 
-   are still valid
+   are still valid, and to skip the image data instead of decoding it
 */
 
 static int
@@ -527,14 +262,18 @@ FreeExtensionMono(SavedImage *Image)
 #endif
 
 static int
-DGifSlurpMono(GifFileType * GifFile, SavedImage *TrailingExtensions)
+DGifScanMono(GifFileType * GifFile, SavedImage *TrailingExtensions, gif_decoder_data *decoder)
 {
 	int		ImageSize;
 	int		Function;
+	int		CodeSize;
+	int		Offset;
 	GifRecordType	RecordType;
 	SavedImage	*sp;
 	GifByteType	*ExtData;
+	GifByteType	*CodeBlock;
 	SavedImage	temp_save;
+	gif_frame_data	*frames;
 
 	temp_save.ExtensionBlocks = NULL;
 	temp_save.ExtensionBlockCount = 0;
@@ -553,6 +292,8 @@ DGifSlurpMono(GifFileType * GifFile, SavedImage *TrailingExtensions)
 
 		switch (RecordType) {
 			case IMAGE_DESC_RECORD_TYPE: {
+				/* where the frame is decoded from */
+				Offset = decoder->size;
 				if (DGifGetImageDesc(GifFile) == GIF_ERROR) {
 					goto error;
 				}
@@ -568,31 +309,27 @@ DGifSlurpMono(GifFileType * GifFile, SavedImage *TrailingExtensions)
 					goto error;
 				}
 
-				sp->RasterBits = (BYTE *) GdipAlloc (ImageSize * sizeof(GifPixelType));
-				if (sp->RasterBits == NULL) {
+				frames = gdip_realloc (decoder->frames, sizeof (gif_frame_data) * GifFile->ImageCount);
+				if (frames == NULL) {
 					goto error;
 				}
 
-				if (sp->ImageDesc.Interlace) {
-					int i, j;
-					/* 
-					* The way an interlaced image should be read - 
-					* offsets and jumps...
-					*/
-					int InterlacedOffset[] = { 0, 4, 2, 1 };
-					int InterlacedJumps[] = { 8, 8, 4, 2 };
-					/* Need to perform 4 passes on the image */
-					for (i = 0; i < 4; i++) {
-						for (j = InterlacedOffset[i]; j < sp->ImageDesc.Height; j += InterlacedJumps[i]) {
-							if (DGifGetLine(GifFile, sp->RasterBits + j * sp->ImageDesc.Width, sp->ImageDesc.Width) == GIF_ERROR)
-								goto error;
-						}
-					}
-				}
-				else if (DGifGetLine(GifFile, sp->RasterBits, ImageSize) == GIF_ERROR) {
+				decoder->frames = frames;
+				decoder->count = GifFile->ImageCount;
+				frames [decoder->count - 1].offset = Offset;
+				frames [decoder->count - 1].disposal = 0;
+
+				/* Skip the LZW data, the pixels are decoded when the frame is selected */
+				if (DGifGetCode(GifFile, &CodeSize, &CodeBlock) == GIF_ERROR) {
 					goto error;
 				}
 
+				while (CodeBlock != NULL) {
+					if (DGifGetCodeNext(GifFile, &CodeBlock) == GIF_ERROR) {
+						goto error;
+					}
+				}
+
 				if (temp_save.ExtensionBlocks) {
 					sp->ExtensionBlocks = temp_save.ExtensionBlocks;
 					sp->ExtensionBlockCount = temp_save.ExtensionBlockCount;
@@ -655,13 +392,260 @@ error:
 	return GIF_ERROR;
 }
 
+/* Draw the pixels of a frame, whose properties and palette were set by the scan, over the canvas */
+static GpStatus
+gdip_gif_draw_frame (gif_decoder_data *decoder, ActiveBitmapData *bitmap_data, int index)
+{
+	GpStatus	status;
+	GifFileType	*gif;
+	GifImageDesc	*img_desc;
+	Rect		*rect;
+	BYTE		*writeptr;
+	int		transparent_index;
+	int		bpp = decoder->argb ? 4 : 1;
+	int		width;
+	int		pass;
+	int		row;
+	int		l;
+	/* The way an interlaced image should be read - offsets and jumps... */
+	int		InterlacedOffset[] = { 0, 4, 2, 1 };
+	int		InterlacedJumps[] = { 8, 8, 4, 2 };
+
+	rect = &decoder->frames [index].rect;
+	transparent_index = (bitmap_data->transparent < 0) ? (bitmap_data->transparent + 1) * -1 : -1;
+
+	/* a single backup, as "restore to previous" only applies before the next frame */
+	if (decoder->frames [index].disposal == GIF_DISPOSAL_RESTORE_PREVIOUS) {
+		width = rect->Width * bpp;
+		if (decoder->previous_size < width * rect->Height) {
+			BYTE *previous = gdip_realloc (decoder->previous, width * rect->Height);
+			if (!previous)
+				return OutOfMemory;
+
+			decoder->previous = previous;
+			decoder->previous_size = width * rect->Height;
+		}
+
+		for (row = 0; row < rect->Height; row++)
+			memcpy (decoder->previous + row * width, decoder->canvas + (rect->Y + row) * decoder->stride + rect->X * bpp, width);
+	}
+
+	decoder->position = 0;
+#if GIFLIB_MAJOR >= 5
+	gif = DGifOpen (decoder, &gdip_gif_memoryinputfunc, NULL);
+#else
+	gif = DGifOpen (decoder, &gdip_gif_memoryinputfunc);
+#endif
+	if (gif == NULL)
+		return OutOfMemory;
+
+	status = OutOfMemory;
+	decoder->position = decoder->frames [index].offset;
+	if (DGifGetImageDesc (gif) == GIF_ERROR)
+		goto cleanup;
+
+	/* the same descriptor as the scan, already checked against the screen */
+	img_desc = &gif->Image;
+
+	/* 4 passes on interlaced images, a single one otherwise */
+	for (pass = 0; pass < (img_desc->Interlace ? 4 : 1); pass++) {
+		for (row = img_desc->Interlace ? InterlacedOffset [pass] : 0; row < img_desc->Height; row += img_desc->Interlace ? InterlacedJumps [pass] : 1) {
+			writeptr = decoder->canvas + (img_desc->Top + row) * decoder->stride + img_desc->Left * bpp;
+
+			if ((transparent_index == -1) && !decoder->argb) {
+				if (DGifGetLine (gif, writeptr, img_desc->Width) == GIF_ERROR)
+					goto cleanup;
+				continue;
+			}
+
+			/* the transparent pixels show the canvas */
+			if (DGifGetLine (gif, decoder->line, img_desc->Width) == GIF_ERROR)
+				goto cleanup;
+
+			for (l = 0; l < img_desc->Width; l++) {
+				BYTE pixel = decoder->line [l];
+
+				if (pixel == transparent_index)
+					continue;
+
+				if (!decoder->argb)
+					writeptr [l] = pixel;
+				else if (pixel < bitmap_data->palette->Count)
+					((ARGB *) writeptr) [l] = bitmap_data->palette->Entries [pixel];
+				else
+					((ARGB *) writeptr) [l] = 0xFF000000;
+			}
+		}
+	}
+
+	status = Ok;
+
+cleanup:
+#if (GIFLIB_MAJOR > 5) || ((GIFLIB_MAJOR == 5) && (GIFLIB_MINOR >= 1))
+	DGifCloseFile (gif, NULL);
+#else
+	DGifCloseFile (gif);
+#endif
+	return status;
+}
+
+/*
+ * The background is transparent: the transparent index of the frame that shows the canvas next, or a
+ * transparent color on ARGB canvases. Without a transparent index the first palette entry is used.
+ */
+static BYTE
+gdip_gif_background (gif_decoder_data *decoder, ActiveBitmapData *bitmap_data)
+{
+	if (decoder->argb)
+		return 0;
+	return (bitmap_data->transparent < 0) ? (bitmap_data->transparent + 1) * -1 : 0;
+}
+
+/* Apply the disposal of a frame to its rectangle, before the next frame is drawn */
+static void
+gdip_gif_dispose_frame (gif_decoder_data *decoder, int index, BYTE background)
+{
+	Rect	*rect = &decoder->frames [index].rect;
+	int	bpp = decoder->argb ? 4 : 1;
+	BYTE	*writeptr = decoder->canvas + rect->Y * decoder->stride + rect->X * bpp;
+	int	row;
+
+	switch (decoder->frames [index].disposal) {
+	case GIF_DISPOSAL_RESTORE_BACKGROUND:
+		for (row = 0; row < rect->Height; row++, writeptr += decoder->stride)
+			memset (writeptr, background, rect->Width * bpp);
+		break;
+	case GIF_DISPOSAL_RESTORE_PREVIOUS:
+		for (row = 0; row < rect->Height; row++, writeptr += decoder->stride)
+			memcpy (writeptr, decoder->previous + row * rect->Width * bpp, rect->Width * bpp);
+		break;
+	default:
+		/* 0 (don't care), 1 (do not dispose) and 4, 5, 6, 7 (undocumented) leave the frame */
+		break;
+	}
+}
+
+/* the entry of @palette nearest to @color, transparent colors use the transparent index when there's one */
+static BYTE
+gdip_gif_nearest_index (ColorPalette *palette, ARGB color, int transparent_index)
+{
+	int	best = 0;
+	int	best_distance = INT_MAX;
+	int	i;
+
+	if (((color & 0xFF000000) == 0) && (transparent_index >= 0))
+		return transparent_index;
+
+	for (i = 0; i < palette->Count; i++) {
+		ARGB	entry = palette->Entries [i];
+		int	r, g, b, distance;
+
+		if (i == transparent_index)
+			continue;
+		if (entry == color)
+			return i;
+
+		r = (int) ((entry >> 16) & 0xFF) - (int) ((color >> 16) & 0xFF);
+		g = (int) ((entry >> 8) & 0xFF) - (int) ((color >> 8) & 0xFF);
+		b = (int) (entry & 0xFF) - (int) (color & 0xFF);
+		distance = r * r + g * g + b * b;
+		if (distance < best_distance) {
+			best = i;
+			best_distance = distance;
+		}
+	}
+	return best;
+}
+
+/* Map the ARGB canvas to the indexes of the frame's palette */
+static void
+gdip_gif_index_canvas (gif_decoder_data *decoder, ActiveBitmapData *bitmap_data)
+{
+	int	transparent_index = (bitmap_data->transparent < 0) ? (bitmap_data->transparent + 1) * -1 : -1;
+	ARGB	last = 0;
+	BYTE	index = gdip_gif_nearest_index (bitmap_data->palette, last, transparent_index);
+	int	x, y;
+
+	for (y = 0; y < bitmap_data->height; y++) {
+		ARGB *src = (ARGB *) (decoder->canvas + y * decoder->stride);
+		BYTE *dst = decoder->indexes + y * bitmap_data->stride;
+
+		/* runs of the same color are common, only look the palette up when the color changes */
+		for (x = 0; x < bitmap_data->width; x++) {
+			if (src [x] != last) {
+				last = src [x];
+				index = gdip_gif_nearest_index (bitmap_data->palette, last, transparent_index);
+			}
+			dst [x] = index;
+		}
+	}
+}
+
+/*
+ * Called by gdip_bitmap_setactive for the frames not on the canvas. Selecting the following frames
+ * only draws their rectangles, going back replays the animation from the first frame.
+ */
+static GpStatus
+gdip_gif_decode_frame (GpBitmap *bitmap, int frame, int index)
+{
+	gif_decoder_data *decoder = (gif_decoder_data*) bitmap->decoder;
+	ActiveBitmapData *bitmaps = bitmap->frames [frame].bitmap;
+	GpStatus status = Ok;
+	BYTE *view;
+	int i;
+
+	if (!decoder->canvas) {
+		if (!decoder->line)
+			decoder->line = GdipAlloc (bitmaps [0].width);
+		if (!decoder->line)
+			return OutOfMemory;
+		decoder->stride = decoder->argb ? bitmaps [0].width * 4 : bitmaps [0].stride;
+		decoder->canvas = GdipAlloc ((size_t) decoder->stride * bitmaps [0].height);
+		if (!decoder->canvas)
+			return OutOfMemory;
+		if (decoder->argb) {
+			decoder->indexes = GdipAlloc ((size_t) bitmaps [0].stride * bitmaps [0].height);
+			if (!decoder->indexes)
+				return OutOfMemory;
+		}
+		decoder->current = -1;
+		decoder->view = -1;
+	}
+
+	if (decoder->current >= index)
+		decoder->current = -1;
+	if (decoder->current == -1)
+		memset (decoder->canvas, gdip_gif_background (decoder, &bitmaps [0]), (size_t) decoder->stride * bitmaps [0].height);
+
+	for (i = decoder->current + 1; i <= index; i++) {
+		if (i > 0)
+			gdip_gif_dispose_frame (decoder, i - 1, gdip_gif_background (decoder, &bitmaps [i]));
+
+		status = gdip_gif_draw_frame (decoder, &bitmaps [i], i);
+		if (status != Ok) {
+			decoder->current = -1;
+			return status;
+		}
+		decoder->current = i;
+	}
+
+	/* the canvas moves to the selected frame, unless the previous one got its own pixels (e.g. rotated) */
+	view = decoder->argb ? decoder->indexes : decoder->canvas;
+	if ((decoder->view >= 0) && (bitmaps [decoder->view].scan0 == view))
+		bitmaps [decoder->view].scan0 = NULL;
+
+	if (decoder->argb)
+		gdip_gif_index_canvas (decoder, &bitmaps [index]);
+	bitmaps [index].scan0 = view;
+	decoder->view = index;
+	return Ok;
+}
+
 static GpStatus 
 gdip_load_gif_image (void *stream, GpImage **image, BOOL from_file)
 {
 	GpStatus status;
 	GifFileType	*gif;
-	BYTE		*readptr;
-	BYTE		*writeptr;
 	int		i;
 	int		l;
 	int		num_of_images;
@@ -670,13 +654,14 @@ gdip_load_gif_image (void *stream, GpImage **image, BOOL from_file)
 	FrameData	*frame;
 	GpBitmap	*result;
 	ActiveBitmapData	*bitmap_data;
+	gif_decoder_data	*decoder;
+	gif_frame_data	*frame_data;
 	SavedImage	si;
 	SavedImage	global_extensions;
 	ColorPalette	*global_palette;
 	BOOL		loop_counter;
 	unsigned short	loop_value;
 	int		disposal;
-	int		last_disposal;
 	int 		transparent_index;
 	int		screen_width;
 	int		screen_height;
@@ -684,33 +669,35 @@ gdip_load_gif_image (void *stream, GpImage **image, BOOL from_file)
 
 	status = Ok;
 	disposal = 0;
-	last_disposal = 0;
 	loop_value = 0;
 	global_palette = NULL;
 	result = NULL;
 	loop_counter = FALSE;
+	gif = NULL;
+
+	decoder = GdipAlloc (sizeof (gif_decoder_data));
+	if (decoder == NULL) {
+		status = OutOfMemory;
+		goto error;
+	}
+
+	memset (decoder, 0, sizeof (gif_decoder_data));
+	decoder->stream = stream;
+	decoder->from_file = from_file;
 
-	if (from_file) {
-#if GIFLIB_MAJOR >= 5
-		gif = DGifOpen(stream, &gdip_gif_fileinputfunc, NULL);
-#else
-		gif = DGifOpen(stream, &gdip_gif_fileinputfunc);
-#endif
-	} else {
 #if GIFLIB_MAJOR >= 5
-		gif = DGifOpen (stream, &gdip_gif_inputfunc, NULL);
+	gif = DGifOpen (decoder, &gdip_gif_scaninputfunc, NULL);
 #else
-		gif = DGifOpen (stream, &gdip_gif_inputfunc);
+	gif = DGifOpen (decoder, &gdip_gif_scaninputfunc);
 #endif
-	}
 	
 	if (gif == NULL) {
 		status = OutOfMemory;
 		goto error;
 	}
 
-	/* Read the image */
-	if (DGifSlurpMono (gif, &global_extensions) != GIF_OK) {
+	/* Read the image structure, the frames are decoded when selected */
+	if (DGifScanMono (gif, &global_extensions, decoder) != GIF_OK) {
 		status = OutOfMemory;
 		goto error;
 	}
@@ -774,6 +761,13 @@ gdip_load_gif_image (void *stream, GpImage **image, BOOL from_file)
 	}
 
 	result->type = ImageTypeBitmap;
+	result->decoder = decoder;
+	result->decode_frame = gdip_gif_decode_frame;
+	result->dispose_decoder = gdip_gif_decoder_dispose;
+	frame_data = decoder->frames;
+	decoder->stream = NULL;
+	decoder = NULL;
+
 	frame = gdip_frame_add(result, dimension);
 	if (!frame) {
 		status = OutOfMemory;
@@ -904,7 +898,6 @@ gdip_load_gif_image (void *stream, GpImage **image, BOOL from_file)
 		if (img_desc->ColorMap != NULL) {
 			ColorMapObject	*local_palette_obj;
 
-			/* TODO: what do we do with combined gif + local palettes? */
 			local_palette_obj = img_desc->ColorMap;
 	
 			bitmap_data->palette = GdipAlloc (sizeof(ColorPalette) + sizeof(ARGB) * local_palette_obj->ColorCount);
@@ -963,63 +956,46 @@ gdip_load_gif_image (void *stream, GpImage **image, BOOL from_file)
 			goto error;
 		}
 
-		bitmap_data->scan0 = GdipAlloc (size);
-		if (!bitmap_data->scan0) {
-			status = OutOfMemory;
-			goto error;
-		}
-
-		bitmap_data->reserved = GBD_OWN_SCAN0;
+		/* scan0 is the decoder canvas, see gdip_gif_decode_frame */
+		bitmap_data->reserved = 0;
 		bitmap_data->image_flags = ImageFlagsReadOnly | ImageFlagsHasRealPixelSize | ImageFlagsHasRealDPI | ImageFlagsColorSpaceRGB;
 		if (bitmap_data->transparent < 0)
 			bitmap_data->image_flags |= ImageFlagsHasAlpha;
 
 		bitmap_data->dpi_horz = gdip_get_display_dpi ();
 		bitmap_data->dpi_vert = bitmap_data->dpi_horz;
-	
-		readptr = (BYTE*) si.RasterBits;
-		writeptr = bitmap_data->scan0;
-
-		for (l = 0; l < bitmap_data->height; l++) {
-			if (l >= img_desc->Top && l - img_desc->Top < img_desc->Height) {
-				/* Ignore 'disposal' 0 (don't care) and 4, 5, 6, 7 (undocumented) */
-				if (i == 0 || transparent_index == -1 || (last_disposal != 1 && last_disposal != 3)) {
-					writeptr += img_desc->Left;
-					memcpy (writeptr, readptr, img_desc->Width);
-					writeptr -= img_desc->Left;
-					writeptr += bitmap_data->stride;
-					readptr += img_desc->Width;
-				} else {
-					int ridx, widx;
-					ActiveBitmapData *last_bitmap;
-
-					last_bitmap = &frame->bitmap [i - 1];
-					if (l == img_desc->Top) {
-						/* Copy the previous bitmap as the base for this one */
-						/* TODO: This will be wrong if each image has a different palette */
-						/* There's a comment up there too */
-						memcpy (bitmap_data->scan0, last_bitmap->scan0,
-							size);
-					}
 
-					for (ridx = 0, widx = bitmap_data->left; ridx < img_desc->Width; widx++, ridx++) {
-						BYTE bt = readptr [ridx];
-						if (bt == transparent_index)
-							continue;
-						writeptr [widx] = bt;
-					}
-					readptr += img_desc->Width;
-					writeptr += bitmap_data->stride;
-				}
-			} else {
-				writeptr += bitmap_data->stride;
-			}
-		}
-		last_disposal = disposal;
+		frame_data [i].disposal = disposal;
+		frame_data [i].rect.X = img_desc->Left;
+		frame_data [i].rect.Y = img_desc->Top;
+		frame_data [i].rect.Width = img_desc->Width;
+		frame_data [i].rect.Height = img_desc->Height;
 		disposal = 0;
 	}
 
-	gdip_bitmap_setactive(result, dimension, 0);
+	/* frames with palettes of their own are composed in ARGB, their indexes can't share a canvas */
+	for (i = 1; i < num_of_images; i++) {
+		ColorPalette *first = frame->bitmap [0].palette;
+		ColorPalette *palette = frame->bitmap [i].palette;
+
+		if ((palette->Count != first->Count) || memcmp (palette->Entries, first->Entries, palette->Count * sizeof (ARGB)))
+			break;
+	}
+
+	if (i < num_of_images) {
+		if ((unsigned long long int) screen_width * 4 * screen_height > G_MAXINT32) {
+			status = OutOfMemory;
+			goto error;
+		}
+
+		((gif_decoder_data*) result->decoder)->argb = TRUE;
+	}
+
+	/* decode the first frame, its errors are the loading ones */
+	if (gdip_bitmap_setactive (result, dimension, 0) != Ok) {
+		status = OutOfMemory;
+		goto error;
+	}
 
 	if (global_palette != NULL) {
 		GdipFree(global_palette);
@@ -1043,6 +1019,10 @@ error:
 		gdip_bitmap_dispose (result);
 	}
 
+	if (decoder != NULL) {
+		gdip_gif_decoder_dispose (decoder);
+	}
+
 	if (gif != NULL) {
 		FreeExtensionMono (&global_extensions);
 #if (GIFLIB_MAJOR > 5) || ((GIFLIB_MAJOR == 5) && (GIFLIB_MINOR >= 1))
@@ -1090,15 +1070,10 @@ gdip_save_gif_image (void *stream, GpImage *image, BOOL from_file)
 	GpStatus status;
 	GifFileType	*fp;
 	int		i, x, y;
-	GifByteType	*red;
-	GifByteType	*green;
-	GifByteType	*blue;
-	GifByteType	*red_ptr;
-	GifByteType	*green_ptr;
-	GifByteType	*blue_ptr;
 	GifByteType	*pixbuf;
 	GifByteType	*pixbuf_org;
 	int		cmap_size;
+	ARGB		palette[256];
 	ColorMapObject *cmap = NULL;	
 	int		k;
 	BYTE		*v;
@@ -1131,9 +1106,6 @@ gdip_save_gif_image (void *stream, GpImage *image, BOOL from_file)
 		return FileNotFound;
 	}
 
-	red = NULL;
-	green = NULL;
-	blue = NULL;
 	pixbuf_org = NULL;
 
 	for (frame = 0; frame < image->num_of_frames; frame++) {
@@ -1269,40 +1241,26 @@ gdip_save_gif_image (void *stream, GpImage *image, BOOL from_file)
 #else
 				cmap  = MakeMapObject (cmap_size, 0);
 #endif
-				red = GdipAlloc(pixbuf_size);
-				green = GdipAlloc(pixbuf_size);
-				blue = GdipAlloc(pixbuf_size);
 				pixbuf = GdipAlloc(pixbuf_size);
-				if ((red == NULL) || (green == NULL) || (blue == NULL) || (pixbuf == NULL)) {
+				if ((cmap == NULL) || (pixbuf == NULL)) {
 					status = OutOfMemory;
 					goto error;
 				}
 
 				pixbuf_org = pixbuf;
-				red_ptr = red;
-				green_ptr = green;
-				blue_ptr = blue;
 
-				for (y = 0; y < bitmap_data->height; y++) {
-					v = bitmap_data->scan0 + y * bitmap_data->stride;
-					for (x = 0; x < bitmap_data->width; x++) {
-#ifdef WORDS_BIGENDIAN
-						*red_ptr++ =   v[1];
-						*green_ptr++ = v[2];
-						*blue_ptr++ =  v[3];
-#else
-						*red_ptr++ =   v[2];
-						*green_ptr++ = v[1];
-						*blue_ptr++ =  v[0];
-#endif
-
-						v += 4;
-					}
-				}
-				if (LibgdiplusGifQuantizeBuffer(bitmap_data->width, bitmap_data->height, &cmap_size, red,  green, blue, pixbuf, cmap->Colors) == GIF_ERROR) {
-					status = GenericError;
+				/* no dithering, images made of flat colors keep them exactly */
+				status = gdip_quantize_argb (bitmap_data->scan0, bitmap_data->width, bitmap_data->height, bitmap_data->stride,
+					256, QuantizeDitherNone, palette, &cmap_size, pixbuf, bitmap_data->width);
+				if (status != Ok) {
 					goto error;
 				}
+
+				for (c = 0; c < cmap_size; c++) {
+					cmap->Colors[c].Red = (palette[c] >> 16) & 0xFF;
+					cmap->Colors[c].Green = (palette[c] >> 8) & 0xFF;
+					cmap->Colors[c].Blue = palette[c] & 0xFF;
+				}
 			}
 
 #if GIFLIB_MAJOR >= 5
@@ -1395,23 +1353,10 @@ gdip_save_gif_image (void *stream, GpImage *image, BOOL from_file)
 #else
 			FreeMapObject (cmap);
 #endif
-			if (red != NULL) {
-				GdipFree (red);
-			}
-			if (green != NULL) {
-				GdipFree (green);
-			}
-			if (blue != NULL) {
-				GdipFree (blue);
-			}
-
 			if (pixbuf_org != NULL) {
 				GdipFree (pixbuf_org);
 			}
 
-			red = NULL;
-			green = NULL;
-			blue = NULL;
 			pixbuf_org = NULL;
 		}
 	}
@@ -1433,18 +1378,6 @@ error:
 #endif
 	}
 
-	if (red != NULL) {
-		GdipFree (red);
-	}
-
-	if (green != NULL) {
-		GdipFree (green);
-	}
-
-	if (blue != NULL) {
-		GdipFree (blue);
-	}
-
 	if (pixbuf_org != NULL) {
 		GdipFree (pixbuf_org);
 	}
@@ -412,8 +412,9 @@ cairo_DrawLines (GpGraphics *graphics, GpPen *pen, GDIPCONST GpPointF *points, i
 	ret = stroke_graphics_with_pen (graphics, pen);
 
 	if (count > 1) {
-		gdip_pen_draw_custom_start_cap (graphics, pen, points [0].X, points [0].Y, points [1].X, points [1].Y);
-		gdip_pen_draw_custom_end_cap (graphics, pen, last_x, last_y, prev_x, prev_y);
+		GpPointF last = { last_x, last_y }, previous = { prev_x, prev_y };
+
+		gdip_pen_draw_custom_caps (graphics, pen, points [0], points [1], last, previous);
 	}
 
 	return ret;
@@ -469,43 +470,338 @@ gdip_plot_path (GpGraphics *graphics, GpPath *path, BOOL antialiasing)
 	return Ok;
 }
 
-GpStatus
-cairo_DrawPath (GpGraphics *graphics, GpPen *pen, GpPath *path)
-{
-	GpStatus ret;
+/*
+ * Dashed paths. Instead of letting cairo dash the path on every stroke, the flattened path is
+ * dashed once, the same way (in the stroke coordinates, restarting the pattern on each figure),
+ * and the resulting segments are kept with the path to be stroked directly on later draws.
+ */
+typedef struct {
+	cairo_path_data_t *data;
 	int count;
-	GpPointF *points;
+	int size;
+	BOOL outOfMemory;
+} DashOutput;
 
-	/* We use graphics->copy_of_ctm matrix for path creation. We should have it set already. */
-	GpStatus status = gdip_plot_path (graphics, path, TRUE);
-	if (status != Ok)
-		return status;
+static BOOL
+dash_reserve (DashOutput *out, int count)
+{
+	if (out->count + count > out->size) {
+		int size = MAX (out->size * 2, out->count + count + 64);
+		cairo_path_data_t *data = gdip_realloc (out->data, size * sizeof (cairo_path_data_t));
 
-	ret = stroke_graphics_with_pen (graphics, pen);
+		if (!data) {
+			out->outOfMemory = TRUE;
+			return FALSE;
+		}
+		out->data = data;
+		out->size = size;
+	}
+	return TRUE;
+}
 
-	/* Draw any custom pen end caps */
+static void
+dash_emit (DashOutput *out, cairo_path_data_type_t type, double x, double y)
+{
+	cairo_path_data_t *data;
 
-	status = GdipGetPointCount (path, &count);
+	if (!dash_reserve (out, 2))
+		return;
 
-	/* To know the angle of the end cap, we need the penultimate point.
-	   Unfortunately there's no way of getting it without getting all
-	   the points :-(
-	 */
-	if (status == Ok && count > 1) {
-		points = gdip_calloc (count, sizeof(GpPointF));
-		if (points == NULL) {
-			return OutOfMemory;
+	data = &out->data [out->count];
+	data [0].header.type = type;
+	data [0].header.length = 2;
+	data [1].point.x = x;
+	data [1].point.y = y;
+	out->count += 2;
+}
+
+/* dashes one flattened figure, made of count points (each one a cairo path data point) */
+static void
+dash_figure (DashOutput *out, const cairo_path_data_t **points, int count, BOOL closed, const double *pattern, int patternCount, double offset)
+{
+	/* like cairo an odd pattern is repeated twice, alternating dashes and gaps */
+	int period = (patternCount & 1) ? patternCount * 2 : patternCount;
+	int index = 0, first = -1, firstEnd = -1;
+	double remaining;
+	BOOL on = TRUE;
+	int i;
+
+	while ((offset > 0) && (offset >= pattern [index % patternCount])) {
+		offset -= pattern [index % patternCount];
+		index = (index + 1) % period;
+		on = !on;
+	}
+	remaining = pattern [index % patternCount] - offset;
+
+	if (on) {
+		first = out->count;
+		dash_emit (out, CAIRO_PATH_MOVE_TO, points [0]->point.x, points [0]->point.y);
+	}
+
+	for (i = 1; i <= count; i++) {
+		const cairo_path_data_t *p = points [i - 1];
+		const cairo_path_data_t *q;
+		double dx, dy, length, t = 0;
+
+		if (i == count) {
+			/* the closing segment */
+			if (!closed)
+				break;
+			q = points [0];
+		} else {
+			q = points [i];
+		}
+
+		dx = q->point.x - p->point.x;
+		dy = q->point.y - p->point.y;
+		length = sqrt (dx * dx + dy * dy);
+
+		while (length - t > remaining) {
+			double x, y;
+
+			t += remaining;
+			x = p->point.x + dx * t / length;
+			y = p->point.y + dy * t / length;
+
+			if (on) {
+				dash_emit (out, CAIRO_PATH_LINE_TO, x, y);
+				if ((first >= 0) && (firstEnd < 0))
+					firstEnd = out->count;
+			} else {
+				dash_emit (out, CAIRO_PATH_MOVE_TO, x, y);
+			}
+
+			on = !on;
+			index = (index + 1) % period;
+			remaining = pattern [index % patternCount];
+		}
+
+		remaining -= length - t;
+		if (on)
+			dash_emit (out, CAIRO_PATH_LINE_TO, q->point.x, q->point.y);
+	}
+
+	if (!closed || !on || (first < 0) || out->outOfMemory)
+		return;
+
+	if (firstEnd < 0) {
+		/* a single dash covers the whole figure */
+		if (dash_reserve (out, 1)) {
+			out->data [out->count].header.type = CAIRO_PATH_CLOSE_PATH;
+			out->data [out->count].header.length = 1;
+			out->count++;
+		}
+		return;
+	}
+
+	/* the last dash continues into the first one, so they are joined instead of capped */
+	if (dash_reserve (out, firstEnd - first - 2)) {
+		memcpy (&out->data [out->count], &out->data [first + 2], (firstEnd - first - 2) * sizeof (cairo_path_data_t));
+		out->count += firstEnd - first - 2;
+		memmove (&out->data [first], &out->data [firstEnd], (out->count - firstEnd) * sizeof (cairo_path_data_t));
+		out->count -= firstEnd - first;
+	}
+}
+
+static cairo_path_t *
+dash_path (const cairo_path_t *flat, const double *pattern, int patternCount, double offset)
+{
+	DashOutput out = { NULL, 0, 0, FALSE };
+	const cairo_path_data_t **points;
+	cairo_path_t *result;
+	double total = 0;
+	int i, count = 0;
+
+	for (i = 0; i < patternCount; i++)
+		total += pattern [i];
+	if (patternCount & 1)
+		total *= 2;
+
+	/* every point of a figure is kept to dash it once complete */
+	points = GdipAlloc (MAX (flat->num_data / 2, 1) * sizeof (cairo_path_data_t *));
+	if (!points)
+		return NULL;
+
+	offset = fmod (offset, total);
+	if (offset < 0)
+		offset += total;
+
+	for (i = 0; i < flat->num_data; i += flat->data [i].header.length) {
+		const cairo_path_data_t *data = &flat->data [i];
+
+		switch (data->header.type) {
+		case CAIRO_PATH_MOVE_TO:
+			if (count > 1)
+				dash_figure (&out, points, count, FALSE, pattern, patternCount, offset);
+			points [0] = &data [1];
+			count = 1;
+			break;
+		case CAIRO_PATH_LINE_TO:
+			points [count++] = &data [1];
+			break;
+		case CAIRO_PATH_CLOSE_PATH:
+			if (count > 0)
+				dash_figure (&out, points, count, TRUE, pattern, patternCount, offset);
+			/* cairo follows each close with a move to the figure start */
+			count = 0;
+			break;
+		default:
+			/* there's no curve in a flattened path */
+			break;
+		}
+	}
+	if (count > 1)
+		dash_figure (&out, points, count, FALSE, pattern, patternCount, offset);
+
+	GdipFree (points);
+
+	result = out.outOfMemory ? NULL : GdipAlloc (sizeof (cairo_path_t));
+	if (!result) {
+		GdipFree (out.data);
+		return NULL;
+	}
+
+	result->status = CAIRO_STATUS_SUCCESS;
+	result->data = out.data;
+	result->num_data = out.count;
+	return result;
+}
+
+static BOOL
+path_dashes_match (const PathDashes *dashes, const PathDashes *key)
+{
+	return dashes && (memcmp (&dashes->plot_matrix, &key->plot_matrix, sizeof (cairo_matrix_t)) == 0) &&
+		(memcmp (&dashes->stroke_matrix, &key->stroke_matrix, sizeof (cairo_matrix_t)) == 0) &&
+		(dashes->unit_x == key->unit_x) && (dashes->unit_y == key->unit_y) &&
+		(dashes->aa_x == key->aa_x) && (dashes->aa_y == key->aa_y) &&
+		(dashes->tolerance == key->tolerance) && (dashes->width == key->width) &&
+		(dashes->offset == key->offset) && (dashes->count == key->count) &&
+		(memcmp (dashes->pattern, key->pattern, key->count * sizeof (float)) == 0);
+}
+
+/* returns FALSE if the path must be dashed (and stroked) by cairo */
+static BOOL
+stroke_path_with_cached_dashes (GpGraphics *graphics, GpPen *pen, GpPath *path, GpStatus *status)
+{
+	PathDashes key;
+	double *pattern;
+	double total = 0;
+	int i;
+
+	if ((pen->dash_count <= 0) || (path->count < 2))
+		return FALSE;
+
+	/* this sets the stroke matrix, line width (and dashes) */
+	*status = gdip_pen_setup (graphics, pen);
+	if (*status != Ok)
+		return FALSE;
+
+	gdip_cairo_matrix_copy (&key.plot_matrix, graphics->copy_of_ctm);
+	cairo_get_matrix (graphics->ct, &key.stroke_matrix);
+	key.unit_x = OPTIMIZE_CONVERSION (graphics) ? 1.0 : gdip_unitx_convgr (graphics, 1.0);
+	key.unit_y = OPTIMIZE_CONVERSION (graphics) ? 1.0 : gdip_unity_convgr (graphics, 1.0);
+	key.aa_x = gdip_is_scaled (graphics) ? 0.0 : graphics->aa_offset_x;
+	key.aa_y = gdip_is_scaled (graphics) ? 0.0 : graphics->aa_offset_y;
+	key.tolerance = cairo_get_tolerance (graphics->ct);
+	key.width = cairo_get_line_width (graphics->ct);
+	key.offset = pen->dash_offset;
+	key.count = pen->dash_count;
+	key.pattern = pen->dash_array;
+
+	if (!path_dashes_match (path->dashes, &key)) {
+		cairo_path_t *flat, *segments;
+		PathDashes *dashes;
+
+		pattern = GdipAlloc (pen->dash_count * sizeof (double));
+		if (!pattern)
+			return FALSE;
+		for (i = 0; i < pen->dash_count; i++) {
+			/* same as convert_dash_array */
+			pattern [i] = (double) pen->dash_array [i] * key.width;
+			if (pattern [i] < 0)
+				break;
+			total += pattern [i];
+		}
+
+		/* leave invalid patterns to cairo */
+		if ((i < pen->dash_count) || (total <= 0)) {
+			GdipFree (pattern);
+			return FALSE;
 		}
-		status = GdipGetPathPoints (path, points, count);
 
-		if (status == Ok) {
-			gdip_pen_draw_custom_start_cap (graphics, pen, points [0].X, points [0].Y, points [1].X, points [1].Y);
-			gdip_pen_draw_custom_end_cap (graphics, pen, points [count - 1].X, points [count - 1].Y, points [count - 2].X, points [count - 2].Y);
+		/* plot the path and get it, flattened, in the stroke coordinates */
+		gdip_cairo_set_matrix (graphics, graphics->copy_of_ctm);
+		cairo_new_path (graphics->ct);
+		*status = gdip_plot_path (graphics, path, TRUE);
+		gdip_cairo_set_matrix (graphics, &key.stroke_matrix);
+		if (*status != Ok) {
+			GdipFree (pattern);
+			return FALSE;
+		}
+
+		flat = cairo_copy_path_flat (graphics->ct);
+		cairo_new_path (graphics->ct);
+		segments = (flat->status == CAIRO_STATUS_SUCCESS) ? dash_path (flat, pattern, pen->dash_count, pen->dash_offset) : NULL;
+		cairo_path_destroy (flat);
+		GdipFree (pattern);
+
+		dashes = segments ? GdipAlloc (sizeof (PathDashes)) : NULL;
+		if (dashes) {
+			*dashes = key;
+			dashes->segments = segments;
+			dashes->pattern = GdipAlloc (key.count * sizeof (float));
+		}
+		if (!dashes || !dashes->pattern) {
+			if (dashes) {
+				dashes->pattern = NULL;
+				gdip_path_dashes_free (dashes);
+			} else if (segments) {
+				GdipFree (segments->data);
+				GdipFree (segments);
+			}
+			*status = OutOfMemory;
+			return TRUE;
 		}
+		memcpy (dashes->pattern, key.pattern, key.count * sizeof (float));
 
-		GdipFree (points);
+		gdip_path_dashes_free (path->dashes);
+		path->dashes = dashes;
 	}
 
+	cairo_new_path (graphics->ct);
+	cairo_append_path (graphics->ct, path->dashes->segments);
+	cairo_set_dash (graphics->ct, NULL, 0, 0);
+	cairo_stroke (graphics->ct);
+
+	/* the dashes were removed behind the pen's back */
+	graphics->last_pen = NULL;
+	gdip_cairo_set_matrix (graphics, graphics->copy_of_ctm);
+
+	*status = gdip_get_status (cairo_status (graphics->ct));
+	return TRUE;
+}
+
+GpStatus
+cairo_DrawPath (GpGraphics *graphics, GpPen *pen, GpPath *path)
+{
+	GpStatus ret;
+	int count;
+
+	if (!stroke_path_with_cached_dashes (graphics, pen, path, &ret)) {
+		/* We use graphics->copy_of_ctm matrix for path creation. */
+		gdip_cairo_set_matrix (graphics, graphics->copy_of_ctm);
+		ret = gdip_plot_path (graphics, path, TRUE);
+		if (ret != Ok)
+			return ret;
+
+		ret = stroke_graphics_with_pen (graphics, pen);
+	}
+
+	/* Draw any custom pen end caps, the path points are used directly to know their angles */
+	count = path->count;
+	if (count > 1)
+		gdip_pen_draw_custom_caps (graphics, pen, path->points [0], path->points [1], path->points [count - 1], path->points [count - 2]);
+
 	return ret;
 }
 
@@ -72,6 +72,9 @@ GpStatus metafile_SetSmoothingMode (GpGraphics *graphics, SmoothingMode mode) GD
 GpStatus metafile_SetTextContrast (GpGraphics *graphics, UINT contrast) GDIP_INTERNAL;
 GpStatus metafile_SetTextRenderingHint (GpGraphics *graphics, TextRenderingHint mode) GDIP_INTERNAL;
 
+GpStatus metafile_SaveGraphics (GpGraphics *graphics, GraphicsState state) GDIP_INTERNAL;
+GpStatus metafile_RestoreGraphics (GpGraphics *graphics, GraphicsState state) GDIP_INTERNAL;
+
 GpStatus metafile_ResetClip (GpGraphics *graphics) GDIP_INTERNAL;
 GpStatus metafile_SetClipPath (GpGraphics *graphics, GpPath *path, CombineMode combineMode) GDIP_INTERNAL;
 GpStatus metafile_SetClipRect (GpGraphics *graphics, float x, float y, float width, float height, 
@@ -86,4 +89,6 @@ GpStatus metafile_RotateWorldTransform (GpGraphics *graphics, float angle, GpMat
 GpStatus metafile_ScaleWorldTransform (GpGraphics *graphics, float sx, float sy, GpMatrixOrder order) GDIP_INTERNAL;
 GpStatus metafile_TranslateWorldTransform (GpGraphics *graphics, float dx, float dy, GpMatrixOrder order) GDIP_INTERNAL;
 
+GpStatus gdip_metafile_record_end_of_file (GpMetafile *metafile) GDIP_INTERNAL;
+
 #endif
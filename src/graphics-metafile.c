@@ -21,6 +21,14 @@
  */
 
 #include "graphics-metafile-private.h"
+#include "emfplus.h"
+#include "graphics-path-private.h"
+#include "hatchbrush-private.h"
+#include "lineargradientbrush-private.h"
+#include "pathgradientbrush-private.h"
+#include "pen-private.h"
+#include "region-private.h"
+#include "texturebrush-private.h"
 
 /*
  * NOTE: all parameter's validations are done inside graphics.c
@@ -28,11 +36,6 @@
 
 #define FIT_IN_INT16(x)		(((x) >= G_MININT16) && ((x) <= G_MAXINT16))
 
-#define EMFPLUS_FLAGS_USE_SINGLE	0x0000
-#define EMFPLUS_FLAGS_FILLMODE_WINDING	0x2000
-#define EMFPLUS_FLAGS_USE_INT16		0x4000
-#define EMFPLUS_FLAGS_USE_ARGB		0x8000
-
 ATTRIBUTE_USED static BOOL
 RectFitInInt16 (int x, int y, int width, int height)
 {
@@ -57,14 +60,729 @@ GpRectArrayFitInInt16 (GDIPCONST GpRect *rects, int count)
 	return TRUE;
 }
 
+/*
+ * EMF+ records are appended to the metafile's record buffer while recording and packed into
+ * EMR_GDICOMMENT records by gdip_metafile_stop_recording. A record is opened with
+ * metafile_record_begin, its fields are appended and record_end patches its size. Allocation
+ * failures are remembered and reported once, by record_end.
+ */
+typedef struct {
+	GpMetafile *metafile;
+	int start;
+	BOOL failed;
+} EmfPlusRecord;
+
+static BYTE*
+record_reserve (EmfPlusRecord *record, int size)
+{
+	GpMetafile *metafile = record->metafile;
+	BYTE *records;
+	int capacity;
+
+	if (record->failed)
+		return NULL;
+
+	if (size > G_MAXINT - metafile->records_length) {
+		record->failed = TRUE;
+		return NULL;
+	}
+
+	if (metafile->records_length + size > metafile->records_capacity) {
+		capacity = metafile->records_capacity ? metafile->records_capacity : 4096;
+		while (capacity < metafile->records_length + size && capacity <= G_MAXINT / 2)
+			capacity *= 2;
+		if (capacity < metafile->records_length + size)
+			capacity = metafile->records_length + size;
+
+		records = gdip_realloc (metafile->records, capacity);
+		if (!records) {
+			record->failed = TRUE;
+			return NULL;
+		}
+		metafile->records = records;
+		metafile->records_capacity = capacity;
+	}
+
+	records = metafile->records + metafile->records_length;
+	metafile->records_length += size;
+	return records;
+}
+
+static void
+put_float (BYTE *p, float value)
+{
+	union {
+		float f;
+		DWORD d;
+	} u;
+
+	u.f = value;
+	gdip_metafile_put_dword (p, u.d);
+}
+
+static int
+record_offset (EmfPlusRecord *record)
+{
+	return record->metafile->records_length;
+}
+
+/* overwrite a DWORD already appended to the current record, e.g. the size of nested data */
+static void
+record_patch (EmfPlusRecord *record, int offset, DWORD value)
+{
+	if (!record->failed)
+		gdip_metafile_put_dword (record->metafile->records + offset, value);
+}
+
+static void
+record_dword (EmfPlusRecord *record, DWORD value)
+{
+	BYTE *p = record_reserve (record, sizeof (DWORD));
+	if (p)
+		gdip_metafile_put_dword (p, value);
+}
+
+static void
+record_float (EmfPlusRecord *record, float value)
+{
+	BYTE *p = record_reserve (record, sizeof (float));
+	if (p)
+		put_float (p, value);
+}
+
+static void
+record_floats (EmfPlusRecord *record, GDIPCONST float *values, int count)
+{
+	BYTE *p = record_reserve (record, count * sizeof (float));
+	int i;
+
+	if (!p)
+		return;
+
+	for (i = 0; i < count; i++, p += sizeof (float))
+		put_float (p, values [i]);
+}
+
+static void
+record_colors (EmfPlusRecord *record, GDIPCONST ARGB *colors, int count)
+{
+	BYTE *p = record_reserve (record, count * sizeof (ARGB));
+	int i;
+
+	if (!p)
+		return;
+
+	for (i = 0; i < count; i++, p += sizeof (ARGB))
+		gdip_metafile_put_dword (p, colors [i]);
+}
+
+/* records are DWORD aligned, pad the bytes with zeros */
+static void
+record_bytes (EmfPlusRecord *record, GDIPCONST BYTE *data, int length)
+{
+	int padded = (length + 3) & ~3;
+	BYTE *p = record_reserve (record, padded);
+
+	if (!p)
+		return;
+
+	memcpy (p, data, length);
+	memset (p + length, 0, padded - length);
+}
+
+static void
+record_points (EmfPlusRecord *record, GDIPCONST GpPointF *points, int count)
+{
+	BYTE *p = record_reserve (record, count * sizeof (GpPointF));
+	int i;
+
+	if (!p)
+		return;
+
+	for (i = 0; i < count; i++, p += sizeof (GpPointF)) {
+		put_float (p, points [i].X);
+		put_float (p + sizeof (float), points [i].Y);
+	}
+}
+
+static void
+record_rects (EmfPlusRecord *record, GDIPCONST GpRectF *rects, int count)
+{
+	BYTE *p = record_reserve (record, count * sizeof (GpRectF));
+	int i;
+
+	if (!p)
+		return;
+
+	for (i = 0; i < count; i++, p += sizeof (GpRectF)) {
+		put_float (p, rects [i].X);
+		put_float (p + 4, rects [i].Y);
+		put_float (p + 8, rects [i].Width);
+		put_float (p + 12, rects [i].Height);
+	}
+}
+
+static void
+record_matrix (EmfPlusRecord *record, GDIPCONST GpMatrix *matrix)
+{
+	BYTE *p = record_reserve (record, 6 * sizeof (float));
+
+	if (!p)
+		return;
+
+	put_float (p, matrix->xx);
+	put_float (p + 4, matrix->yx);
+	put_float (p + 8, matrix->xy);
+	put_float (p + 12, matrix->yy);
+	put_float (p + 16, matrix->x0);
+	put_float (p + 20, matrix->y0);
+}
+
+static void
+record_begin (EmfPlusRecord *record, GpMetafile *metafile, WORD type, WORD flags)
+{
+	record->metafile = metafile;
+	record->start = metafile->records_length;
+	record->failed = FALSE;
+
+	record_dword (record, type | (flags << 16));
+	/* size and data size, known once the record ends */
+	record_dword (record, 0);
+	record_dword (record, 0);
+}
+
+static GpStatus
+record_end (EmfPlusRecord *record)
+{
+	GpMetafile *metafile = record->metafile;
+	int size;
+
+	if (record->failed) {
+		/* drop whatever was written of the record */
+		metafile->records_length = record->start;
+		return OutOfMemory;
+	}
+
+	size = metafile->records_length - record->start;
+	gdip_metafile_put_dword (metafile->records + record->start + 4, size);
+	gdip_metafile_put_dword (metafile->records + record->start + 8, size - EMFPLUS_RECORD_HEADER_SIZE);
+	return Ok;
+}
+
+static void
+record_cancel (EmfPlusRecord *record)
+{
+	record->metafile->records_length = record->start;
+}
+
+/* http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/Header.html */
+static GpStatus
+record_header (GpMetafile *metafile)
+{
+	EmfPlusRecord record;
+	DWORD dpi = gdip_get_display_dpi ();
+
+	record_begin (&record, metafile, EmfPlusRecordTypeHeader,
+		(metafile->metafile_header.Type == MetafileTypeEmfPlusDual) ? EMFPLUS_FLAGS_DUAL : 0);
+	record_dword (&record, EMFPLUS_VERSION);
+	record_dword (&record, EMFPLUS_HEADER_VIDEO_DISPLAY);
+	record_dword (&record, dpi);
+	record_dword (&record, dpi);
+	return record_end (&record);
+}
+
+/* every EMF+ stream starts with a header record, emitted in front of the first record */
+static void
+metafile_record_begin (EmfPlusRecord *record, GpGraphics *graphics, WORD type, WORD flags)
+{
+	GpMetafile *metafile = graphics->metafile;
+
+	if (metafile->records_length == 0 && record_header (metafile) != Ok) {
+		record->metafile = metafile;
+		record->start = metafile->records_length;
+		record->failed = TRUE;
+		return;
+	}
+
+	record_begin (record, metafile, type, flags);
+}
+
+/* http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/EndOfFile.html */
+GpStatus
+gdip_metafile_record_end_of_file (GpMetafile *metafile)
+{
+	EmfPlusRecord record;
+	GpStatus status;
+
+	if (metafile->records_length == 0) {
+		status = record_header (metafile);
+		if (status != Ok)
+			return status;
+	}
+
+	record_begin (&record, metafile, EmfPlusRecordTypeEndOfFile, 0);
+	return record_end (&record);
+}
+
+/*
+ * Objects - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/Object.html
+ */
+
+/* EMF+ paths have no fill mode, it's given by the records filling them */
+static void
+record_path_data (EmfPlusRecord *record, GpPath *path)
+{
+	record_dword (record, EMFPLUS_VERSION);
+	record_dword (record, path->count);
+	record_dword (record, 0);
+	record_points (record, path->points, path->count);
+	record_bytes (record, path->types, path->count);
+}
+
+/* bitmaps are stored uncompressed, as 32bpp ARGB, whatever their original format is */
+static GpStatus
+record_image_data (EmfPlusRecord *record, GpImage *image)
+{
+	BitmapData data;
+	GpRect rect;
+	GpStatus status;
+	BYTE *p;
+	int y;
+
+	if (image->type != ImageTypeBitmap || !image->active_bitmap)
+		return NotImplemented;
+
+	rect.X = 0;
+	rect.Y = 0;
+	rect.Width = image->active_bitmap->width;
+	rect.Height = image->active_bitmap->height;
+
+	status = GdipBitmapLockBits ((GpBitmap *) image, &rect, ImageLockModeRead, PixelFormat32bppARGB, &data);
+	if (status != Ok)
+		return status;
+
+	record_dword (record, EMFPLUS_VERSION);
+	record_dword (record, EMFPLUS_IMAGE_BITMAP);
+	record_dword (record, rect.Width);
+	record_dword (record, rect.Height);
+	record_dword (record, rect.Width * 4);
+	record_dword (record, PixelFormat32bppARGB);
+	record_dword (record, EMFPLUS_BITMAP_PIXEL);
+
+	p = record_reserve (record, rect.Width * rect.Height * 4);
+	if (p) {
+		for (y = 0; y < rect.Height; y++) {
+			DWORD *src = (DWORD *) ((BYTE *) data.Scan0 + y * data.Stride);
+			int x;
+
+			for (x = 0; x < rect.Width; x++, p += sizeof (DWORD))
+				gdip_metafile_put_dword (p, src [x]);
+		}
+	}
+
+	return GdipBitmapUnlockBits ((GpBitmap *) image, &data);
+}
+
+static void
+record_blend_data (EmfPlusRecord *record, DWORD flags, InterpolationColors *presetColors, Blend *blend)
+{
+	if (flags & EMFPLUS_BRUSH_DATA_PRESET_COLORS) {
+		record_dword (record, presetColors->count);
+		record_floats (record, presetColors->positions, presetColors->count);
+		record_colors (record, presetColors->colors, presetColors->count);
+	} else if (flags & EMFPLUS_BRUSH_DATA_BLEND_FACTORS_H) {
+		record_dword (record, blend->count);
+		record_floats (record, blend->positions, blend->count);
+		record_floats (record, blend->factors, blend->count);
+	}
+}
+
+static DWORD
+blend_flags (InterpolationColors *presetColors, Blend *blend)
+{
+	if (presetColors && presetColors->count >= 2)
+		return EMFPLUS_BRUSH_DATA_PRESET_COLORS;
+	if (blend && blend->count > 1)
+		return EMFPLUS_BRUSH_DATA_BLEND_FACTORS_H;
+	return 0;
+}
+
+/* http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileObjects/Brush.html */
+static GpStatus
+record_brush_data (EmfPlusRecord *record, GpBrush *brush)
+{
+	DWORD flags;
+
+	record_dword (record, EMFPLUS_VERSION);
+	record_dword (record, brush->vtable->type);
+
+	switch (brush->vtable->type) {
+	case BrushTypeSolidColor:
+		record_dword (record, ((GpSolidFill *) brush)->color);
+		return Ok;
+	case BrushTypeHatchFill: {
+		GpHatch *hatch = (GpHatch *) brush;
+
+		record_dword (record, hatch->hatchStyle);
+		record_dword (record, hatch->foreColor);
+		record_dword (record, hatch->backColor);
+		return Ok;
+	}
+	case BrushTypeLinearGradient: {
+		GpLineGradient *linear = (GpLineGradient *) brush;
+
+		/* the gradient angle is already part of the brush matrix */
+		flags = blend_flags (linear->presetColors, linear->blend);
+		if (!gdip_is_matrix_empty (&linear->matrix))
+			flags |= EMFPLUS_BRUSH_DATA_TRANSFORM;
+		if (linear->gammaCorrection)
+			flags |= EMFPLUS_BRUSH_DATA_GAMMA_CORRECTED;
+
+		record_dword (record, flags);
+		record_dword (record, linear->wrapMode);
+		record_rects (record, &linear->rectangle, 1);
+		record_colors (record, linear->lineColors, 2);
+		/* reserved */
+		record_dword (record, 0);
+		record_dword (record, 0);
+		if (flags & EMFPLUS_BRUSH_DATA_TRANSFORM)
+			record_matrix (record, &linear->matrix);
+		record_blend_data (record, flags, linear->presetColors, linear->blend);
+		return Ok;
+	}
+	case BrushTypePathGradient: {
+		GpPathGradient *pg = (GpPathGradient *) brush;
+		int at;
+
+		if (!pg->boundary)
+			return NotImplemented;
+
+		/* the boundary is always serialized as a path, it covers both points and paths */
+		flags = EMFPLUS_BRUSH_DATA_PATH | blend_flags (pg->presetColors, pg->blend);
+		if (!gdip_is_matrix_empty (&pg->transform))
+			flags |= EMFPLUS_BRUSH_DATA_TRANSFORM;
+		if (pg->focusScales.X != 0 || pg->focusScales.Y != 0)
+			flags |= EMFPLUS_BRUSH_DATA_FOCUS_SCALES;
+		if (pg->useGammaCorrection)
+			flags |= EMFPLUS_BRUSH_DATA_GAMMA_CORRECTED;
+
+		record_dword (record, flags);
+		record_dword (record, pg->wrapMode);
+		record_dword (record, pg->centerColor);
+		record_points (record, &pg->center, 1);
+		record_dword (record, pg->boundaryColorsCount);
+		record_colors (record, pg->boundaryColors, pg->boundaryColorsCount);
+
+		at = record_offset (record);
+		record_dword (record, 0);
+		record_path_data (record, pg->boundary);
+		record_patch (record, at, record_offset (record) - at - sizeof (DWORD));
+
+		if (flags & EMFPLUS_BRUSH_DATA_TRANSFORM)
+			record_matrix (record, &pg->transform);
+		record_blend_data (record, flags, pg->presetColors, pg->blend);
+		if (flags & EMFPLUS_BRUSH_DATA_FOCUS_SCALES) {
+			record_dword (record, 2);
+			record_float (record, pg->focusScales.X);
+			record_float (record, pg->focusScales.Y);
+		}
+		return Ok;
+	}
+	case BrushTypeTextureFill: {
+		GpTexture *texture = (GpTexture *) brush;
+
+		flags = gdip_is_matrix_empty (&texture->matrix) ? 0 : EMFPLUS_BRUSH_DATA_TRANSFORM;
+		record_dword (record, flags);
+		record_dword (record, texture->wrapMode);
+		if (flags & EMFPLUS_BRUSH_DATA_TRANSFORM)
+			record_matrix (record, &texture->matrix);
+		return record_image_data (record, texture->image);
+	}
+	default:
+		return NotImplemented;
+	}
+}
+
+/* http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileObjects/Pen.html */
+static GpStatus
+record_pen_data (EmfPlusRecord *record, GpPen *pen)
+{
+	DWORD flags = 0;
+
+	/* custom line caps are not serialized, their caps are drawn flat on playback */
+	if (!gdip_is_matrix_empty (&pen->matrix))
+		flags |= EMFPLUS_PEN_DATA_TRANSFORM;
+	if (pen->line_cap != LineCapFlat && pen->line_cap != LineCapCustom)
+		flags |= EMFPLUS_PEN_DATA_START_CAP;
+	if (pen->end_cap != LineCapFlat && pen->end_cap != LineCapCustom)
+		flags |= EMFPLUS_PEN_DATA_END_CAP;
+	if (pen->line_join != LineJoinMiter)
+		flags |= EMFPLUS_PEN_DATA_JOIN;
+	if (pen->miter_limit != 10.0f)
+		flags |= EMFPLUS_PEN_DATA_MITER_LIMIT;
+	if (pen->dash_style != DashStyleSolid)
+		flags |= EMFPLUS_PEN_DATA_LINE_STYLE;
+	if (pen->dash_cap != DashCapFlat)
+		flags |= EMFPLUS_PEN_DATA_DASHED_LINE_CAP;
+	if (pen->dash_offset != 0)
+		flags |= EMFPLUS_PEN_DATA_DASHED_LINE_OFFSET;
+	if (pen->dash_style == DashStyleCustom && pen->dash_count > 0)
+		flags |= EMFPLUS_PEN_DATA_DASHED_LINE;
+	if (pen->mode != PenAlignmentCenter)
+		flags |= EMFPLUS_PEN_DATA_NON_CENTER;
+	if (pen->compound_count > 0)
+		flags |= EMFPLUS_PEN_DATA_COMPOUND_LINE;
+
+	record_dword (record, EMFPLUS_VERSION);
+	/* type, always 0 */
+	record_dword (record, 0);
+	record_dword (record, flags);
+	record_dword (record, pen->unit);
+	record_float (record, pen->width);
+
+	if (flags & EMFPLUS_PEN_DATA_TRANSFORM)
+		record_matrix (record, &pen->matrix);
+	if (flags & EMFPLUS_PEN_DATA_START_CAP)
+		record_dword (record, pen->line_cap);
+	if (flags & EMFPLUS_PEN_DATA_END_CAP)
+		record_dword (record, pen->end_cap);
+	if (flags & EMFPLUS_PEN_DATA_JOIN)
+		record_dword (record, pen->line_join);
+	if (flags & EMFPLUS_PEN_DATA_MITER_LIMIT)
+		record_float (record, pen->miter_limit);
+	if (flags & EMFPLUS_PEN_DATA_LINE_STYLE)
+		record_dword (record, pen->dash_style);
+	if (flags & EMFPLUS_PEN_DATA_DASHED_LINE_CAP)
+		record_dword (record, pen->dash_cap);
+	if (flags & EMFPLUS_PEN_DATA_DASHED_LINE_OFFSET)
+		record_float (record, pen->dash_offset);
+	if (flags & EMFPLUS_PEN_DATA_DASHED_LINE) {
+		record_dword (record, pen->dash_count);
+		record_floats (record, pen->dash_array, pen->dash_count);
+	}
+	if (flags & EMFPLUS_PEN_DATA_NON_CENTER)
+		record_dword (record, pen->mode);
+	if (flags & EMFPLUS_PEN_DATA_COMPOUND_LINE) {
+		record_dword (record, pen->compound_count);
+		record_floats (record, pen->compound_array, pen->compound_count);
+	}
+
+	if (pen->brush)
+		return record_brush_data (record, pen->brush);
+
+	record_dword (record, EMFPLUS_VERSION);
+	record_dword (record, BrushTypeSolidColor);
+	record_dword (record, pen->color);
+	return Ok;
+}
+
+static int
+region_tree_node_count (GpPathTree *tree)
+{
+	if (tree->path)
+		return 1;
+	/* replacing only keeps the second operand */
+	if (tree->mode == CombineModeReplace)
+		return region_tree_node_count (tree->branch2);
+	return 1 + region_tree_node_count (tree->branch1) + region_tree_node_count (tree->branch2);
+}
+
+/* the combine modes and the EMF+ region node types share the same values */
+static void
+record_region_tree (EmfPlusRecord *record, GpPathTree *tree)
+{
+	int at;
+
+	if (tree->path) {
+		GpPath *path = tree->path;
+
+		/* region paths are read back with the alternate fill mode, so record what a winding one covers */
+		if (path->fill_mode == FillModeWinding) {
+			if ((GdipClonePath (tree->path, &path) != Ok) ||
+				(GdipWindingModeOutline (path, NULL, PATH_EDGES_FLATNESS) != Ok)) {
+				if (path != tree->path)
+					GdipDeletePath (path);
+				record->failed = TRUE;
+				return;
+			}
+		}
+
+		record_dword (record, RegionDataPath);
+		at = record_offset (record);
+		record_dword (record, 0);
+		record_path_data (record, path);
+		record_patch (record, at, record_offset (record) - at - sizeof (DWORD));
+
+		if (path != tree->path)
+			GdipDeletePath (path);
+	} else if (tree->mode == CombineModeReplace) {
+		record_region_tree (record, tree->branch2);
+	} else {
+		record_dword (record, tree->mode);
+		record_region_tree (record, tree->branch1);
+		record_region_tree (record, tree->branch2);
+	}
+}
+
+/* http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileObjects/Region.html */
+static GpStatus
+record_region_data (EmfPlusRecord *record, GpRegion *region)
+{
+	int i;
+
+	record_dword (record, EMFPLUS_VERSION);
+
+	if (gdip_is_InfiniteRegion (region)) {
+		record_dword (record, 0);
+		record_dword (record, RegionDataInfiniteRect);
+		return Ok;
+	}
+
+	switch (region->type) {
+	case RegionTypeRect:
+		if (region->cnt == 0) {
+			record_dword (record, 0);
+			record_dword (record, RegionDataEmptyRect);
+			break;
+		}
+
+		/* a chain of unions, each holding one rectangle and the rest of the chain */
+		record_dword (record, (region->cnt - 1) * 2);
+		for (i = 0; i < region->cnt; i++) {
+			if (i < region->cnt - 1)
+				record_dword (record, CombineModeUnion);
+			record_dword (record, RegionDataRect);
+			record_rects (record, &region->rects [i], 1);
+		}
+		break;
+	case RegionTypePath:
+		record_dword (record, region_tree_node_count (region->tree) - 1);
+		record_region_tree (record, region->tree);
+		break;
+	default:
+		return NotImplemented;
+	}
+	return Ok;
+}
+
+/* serialize @object into the next object slot, returned in @id, for the next record to use */
+static GpStatus
+metafile_record_object (GpGraphics *graphics, EmfPlusObjectType type, void *object, int *id)
+{
+	GpMetafile *metafile = graphics->metafile;
+	EmfPlusRecord record;
+	GpStatus status;
+
+	*id = metafile->next_object;
+
+	metafile_record_begin (&record, graphics, EmfPlusRecordTypeObject, (type << 8) | *id);
+	switch (type) {
+	case EmfPlusObjectTypeBrush:
+		status = record_brush_data (&record, (GpBrush *) object);
+		break;
+	case EmfPlusObjectTypePen:
+		status = record_pen_data (&record, (GpPen *) object);
+		break;
+	case EmfPlusObjectTypePath:
+		record_path_data (&record, (GpPath *) object);
+		status = Ok;
+		break;
+	case EmfPlusObjectTypeRegion:
+		status = record_region_data (&record, (GpRegion *) object);
+		break;
+	default:
+		status = NotImplemented;
+		break;
+	}
+
+	if (status != Ok) {
+		record_cancel (&record);
+		return status;
+	}
+
+	status = record_end (&record);
+	if (status == Ok)
+		metafile->next_object = (*id + 1) % EMFPLUS_MAX_OBJECTS;
+	return status;
+}
+
+/* solid colors are stored directly in the record, other brushes are serialized as objects */
+static GpStatus
+metafile_record_brush (GpGraphics *graphics, GpBrush *brush, WORD *flags, DWORD *brushId)
+{
+	GpStatus status;
+	int id;
+
+	if (brush->vtable->type == BrushTypeSolidColor) {
+		*flags |= EMFPLUS_FLAGS_USE_ARGB;
+		*brushId = ((GpSolidFill *) brush)->color;
+		return Ok;
+	}
+
+	status = metafile_record_object (graphics, EmfPlusObjectTypeBrush, brush, &id);
+	*brushId = id;
+	return status;
+}
+
+/* start a record which fills with @brush, its first field is the brush */
+static GpStatus
+metafile_fill_record_begin (EmfPlusRecord *record, GpGraphics *graphics, WORD type, WORD flags, GpBrush *brush)
+{
+	DWORD brushId;
+	GpStatus status;
+
+	status = metafile_record_brush (graphics, brush, &flags, &brushId);
+	if (status != Ok)
+		return status;
+
+	metafile_record_begin (record, graphics, type, flags);
+	record_dword (record, brushId);
+	return Ok;
+}
+
+/* start a record which strokes with @pen, referenced in the record flags */
+static GpStatus
+metafile_draw_record_begin (EmfPlusRecord *record, GpGraphics *graphics, WORD type, WORD flags, GpPen *pen)
+{
+	GpStatus status;
+	int id;
+
+	status = metafile_record_object (graphics, EmfPlusObjectTypePen, pen, &id);
+	if (status != Ok)
+		return status;
+
+	metafile_record_begin (record, graphics, type, flags | id);
+	return Ok;
+}
+
+/* start a record with no data except its flags */
+static GpStatus
+metafile_record_flags (GpGraphics *graphics, WORD type, WORD flags)
+{
+	EmfPlusRecord record;
+
+	metafile_record_begin (&record, graphics, type, flags);
+	return record_end (&record);
+}
+
 /* DrawArcs - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/DrawArc.html */
 
 GpStatus
 metafile_DrawArc (GpGraphics *graphics, GpPen *pen, float x, float y, float width, float height, float startAngle, 
 	float sweepAngle)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+	GpRectF rect = { x, y, width, height };
+	GpStatus status;
+
+	status = metafile_draw_record_begin (&record, graphics, EmfPlusRecordTypeDrawArc, 0, pen);
+	if (status != Ok)
+		return status;
+
+	record_float (&record, startAngle);
+	record_float (&record, sweepAngle);
+	record_rects (&record, &rect, 1);
+	return record_end (&record);
 }
 
 /* DrawBeziers - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/DrawBeziers.html */
@@ -72,8 +790,16 @@ metafile_DrawArc (GpGraphics *graphics, GpPen *pen, float x, float y, float widt
 GpStatus 
 metafile_DrawBeziers (GpGraphics *graphics, GpPen *pen, GDIPCONST GpPointF *points, int count)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+	GpStatus status;
+
+	status = metafile_draw_record_begin (&record, graphics, EmfPlusRecordTypeDrawBeziers, 0, pen);
+	if (status != Ok)
+		return status;
+
+	record_dword (&record, count);
+	record_points (&record, points, count);
+	return record_end (&record);
 }
 
 /*
@@ -83,8 +809,17 @@ metafile_DrawBeziers (GpGraphics *graphics, GpPen *pen, GDIPCONST GpPointF *poin
 GpStatus
 metafile_DrawClosedCurve2 (GpGraphics *graphics, GpPen *pen, GDIPCONST GpPointF *points, int count, float tension)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+	GpStatus status;
+
+	status = metafile_draw_record_begin (&record, graphics, EmfPlusRecordTypeDrawClosedCurve, 0, pen);
+	if (status != Ok)
+		return status;
+
+	record_float (&record, tension);
+	record_dword (&record, count);
+	record_points (&record, points, count);
+	return record_end (&record);
 }
 
 /*
@@ -94,8 +829,18 @@ metafile_DrawClosedCurve2 (GpGraphics *graphics, GpPen *pen, GDIPCONST GpPointF
 GpStatus
 metafile_FillClosedCurve2 (GpGraphics *graphics, GpBrush *brush, GDIPCONST GpPointF *points, int count, float tension, GpFillMode fillMode)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+	GpStatus status;
+
+	status = metafile_fill_record_begin (&record, graphics, EmfPlusRecordTypeFillClosedCurve,
+		(fillMode == FillModeWinding) ? EMFPLUS_FLAGS_FILLMODE_WINDING : 0, brush);
+	if (status != Ok)
+		return status;
+
+	record_float (&record, tension);
+	record_dword (&record, count);
+	record_points (&record, points, count);
+	return record_end (&record);
 }
 
 /*
@@ -106,8 +851,19 @@ GpStatus
 metafile_DrawCurve3 (GpGraphics *graphics, GpPen* pen, GDIPCONST GpPointF *points, int count, int offset, int numOfSegments, 
 	float tension)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+	GpStatus status;
+
+	status = metafile_draw_record_begin (&record, graphics, EmfPlusRecordTypeDrawCurve, 0, pen);
+	if (status != Ok)
+		return status;
+
+	record_float (&record, tension);
+	record_dword (&record, offset);
+	record_dword (&record, numOfSegments);
+	record_dword (&record, count);
+	record_points (&record, points, count);
+	return record_end (&record);
 }
 
 /*
@@ -117,8 +873,16 @@ metafile_DrawCurve3 (GpGraphics *graphics, GpPen* pen, GDIPCONST GpPointF *point
 GpStatus 
 metafile_DrawEllipse (GpGraphics *graphics, GpPen *pen, float x, float y, float width, float height)
 {	
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+	GpRectF rect = { x, y, width, height };
+	GpStatus status;
+
+	status = metafile_draw_record_begin (&record, graphics, EmfPlusRecordTypeDrawEllipse, 0, pen);
+	if (status != Ok)
+		return status;
+
+	record_rects (&record, &rect, 1);
+	return record_end (&record);
 }
 
 /*
@@ -128,19 +892,42 @@ metafile_DrawEllipse (GpGraphics *graphics, GpPen *pen, float x, float y, float
 GpStatus
 metafile_FillEllipse (GpGraphics *graphics, GpBrush *brush, float x, float y, float width, float height)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+	GpRectF rect = { x, y, width, height };
+	GpStatus status;
+
+	status = metafile_fill_record_begin (&record, graphics, EmfPlusRecordTypeFillEllipse, 0, brush);
+	if (status != Ok)
+		return status;
+
+	record_rects (&record, &rect, 1);
+	return record_end (&record);
 }
 
 /*
  * DrawLines - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/DrawLines.html
  */
 
+static GpStatus
+metafile_draw_lines (GpGraphics *graphics, GpPen *pen, GDIPCONST GpPointF *points, int count, BOOL closed)
+{
+	EmfPlusRecord record;
+	GpStatus status;
+
+	status = metafile_draw_record_begin (&record, graphics, EmfPlusRecordTypeDrawLines,
+		closed ? EMFPLUS_FLAGS_CLOSED : 0, pen);
+	if (status != Ok)
+		return status;
+
+	record_dword (&record, count);
+	record_points (&record, points, count);
+	return record_end (&record);
+}
+
 GpStatus 
 metafile_DrawLines (GpGraphics *graphics, GpPen *pen, GDIPCONST GpPointF *points, int count)
 {
-	/* TODO */
-	return Ok;
+	return metafile_draw_lines (graphics, pen, points, count, FALSE);
 }
 
 /*
@@ -149,8 +936,21 @@ metafile_DrawLines (GpGraphics *graphics, GpPen *pen, GDIPCONST GpPointF *points
 GpStatus
 metafile_DrawPath (GpGraphics *graphics, GpPen *pen, GpPath *path)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+	GpStatus status;
+	int pathId, penId;
+
+	status = metafile_record_object (graphics, EmfPlusObjectTypePath, path, &pathId);
+	if (status != Ok)
+		return status;
+
+	status = metafile_record_object (graphics, EmfPlusObjectTypePen, pen, &penId);
+	if (status != Ok)
+		return status;
+
+	metafile_record_begin (&record, graphics, EmfPlusRecordTypeDrawPath, pathId);
+	record_dword (&record, penId);
+	return record_end (&record);
 }
 
 /*
@@ -160,8 +960,26 @@ metafile_DrawPath (GpGraphics *graphics, GpPen *pen, GpPath *path)
 GpStatus
 metafile_FillPath (GpGraphics *graphics, GpBrush *brush, GpPath *path)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+	GpStatus status;
+	DWORD brushId;
+	WORD flags = 0;
+	int pathId;
+
+	status = metafile_record_brush (graphics, brush, &flags, &brushId);
+	if (status != Ok)
+		return status;
+
+	status = metafile_record_object (graphics, EmfPlusObjectTypePath, path, &pathId);
+	if (status != Ok)
+		return status;
+
+	if (path->fill_mode == FillModeWinding)
+		flags |= EMFPLUS_FLAGS_FILLMODE_WINDING;
+
+	metafile_record_begin (&record, graphics, EmfPlusRecordTypeFillPath, flags | pathId);
+	record_dword (&record, brushId);
+	return record_end (&record);
 }
 
 /*
@@ -172,8 +990,18 @@ GpStatus
 metafile_DrawPie (GpGraphics *graphics, GpPen *pen, float x, float y, float width, float height, 
 	float startAngle, float sweepAngle)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+	GpRectF rect = { x, y, width, height };
+	GpStatus status;
+
+	status = metafile_draw_record_begin (&record, graphics, EmfPlusRecordTypeDrawPie, 0, pen);
+	if (status != Ok)
+		return status;
+
+	record_float (&record, startAngle);
+	record_float (&record, sweepAngle);
+	record_rects (&record, &rect, 1);
+	return record_end (&record);
 }
 
 /*
@@ -184,8 +1012,18 @@ GpStatus
 metafile_FillPie (GpGraphics *graphics, GpBrush *brush, float x, float y, float width, float height, 
 	float startAngle, float sweepAngle)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+	GpRectF rect = { x, y, width, height };
+	GpStatus status;
+
+	status = metafile_fill_record_begin (&record, graphics, EmfPlusRecordTypeFillPie, 0, brush);
+	if (status != Ok)
+		return status;
+
+	record_float (&record, startAngle);
+	record_float (&record, sweepAngle);
+	record_rects (&record, &rect, 1);
+	return record_end (&record);
 }
 
 /*
@@ -195,8 +1033,7 @@ metafile_FillPie (GpGraphics *graphics, GpBrush *brush, float x, float y, float
 GpStatus
 metafile_DrawPolygon (GpGraphics *graphics, GpPen *pen, GDIPCONST GpPointF *points, int count)
 {
-	/* TODO */
-	return Ok;
+	return metafile_draw_lines (graphics, pen, points, count, TRUE);
 }
 
 /*
@@ -206,8 +1043,32 @@ metafile_DrawPolygon (GpGraphics *graphics, GpPen *pen, GDIPCONST GpPointF *poin
 GpStatus
 metafile_FillPolygon (GpGraphics *graphics, GpBrush *brush, GDIPCONST GpPointF *points, int count, FillMode fillMode)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+	GpStatus status;
+
+	/* the record has no fill mode, winding polygons are filled as paths */
+	if (fillMode == FillModeWinding) {
+		GpPath *path;
+
+		status = GdipCreatePath (FillModeWinding, &path);
+		if (status != Ok)
+			return status;
+
+		status = GdipAddPathPolygon (path, points, count);
+		if (status == Ok)
+			status = metafile_FillPath (graphics, brush, path);
+
+		GdipDeletePath (path);
+		return status;
+	}
+
+	status = metafile_fill_record_begin (&record, graphics, EmfPlusRecordTypeFillPolygon, 0, brush);
+	if (status != Ok)
+		return status;
+
+	record_dword (&record, count);
+	record_points (&record, points, count);
+	return record_end (&record);
 }
 
 /*
@@ -217,8 +1078,16 @@ metafile_FillPolygon (GpGraphics *graphics, GpBrush *brush, GDIPCONST GpPointF *
 GpStatus
 metafile_DrawRectangles (GpGraphics *graphics, GpPen *pen, GDIPCONST GpRectF *rects, int count)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+	GpStatus status;
+
+	status = metafile_draw_record_begin (&record, graphics, EmfPlusRecordTypeDrawRects, 0, pen);
+	if (status != Ok)
+		return status;
+
+	record_dword (&record, count);
+	record_rects (&record, rects, count);
+	return record_end (&record);
 }
 
 /*
@@ -228,15 +1097,24 @@ metafile_DrawRectangles (GpGraphics *graphics, GpPen *pen, GDIPCONST GpRectF *re
 GpStatus
 metafile_FillRectangle (GpGraphics *graphics, GpBrush *brush, float x, float y, float width, float height)
 {
-	/* TODO */
-	return Ok;
+	GpRectF rect = { x, y, width, height };
+
+	return metafile_FillRectangles (graphics, brush, &rect, 1);
 }
 
 GpStatus 
 metafile_FillRectangles (GpGraphics *graphics, GpBrush *brush, GDIPCONST GpRectF *rects, int count)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+	GpStatus status;
+
+	status = metafile_fill_record_begin (&record, graphics, EmfPlusRecordTypeFillRects, 0, brush);
+	if (status != Ok)
+		return status;
+
+	record_dword (&record, count);
+	record_rects (&record, rects, count);
+	return record_end (&record);
 }
 
 /*
@@ -246,8 +1124,23 @@ metafile_FillRectangles (GpGraphics *graphics, GpBrush *brush, GDIPCONST GpRectF
 GpStatus
 metafile_FillRegion (GpGraphics *graphics, GpBrush *brush, GpRegion *region)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+	GpStatus status;
+	DWORD brushId;
+	WORD flags = 0;
+	int regionId;
+
+	status = metafile_record_brush (graphics, brush, &flags, &brushId);
+	if (status != Ok)
+		return status;
+
+	status = metafile_record_object (graphics, EmfPlusObjectTypeRegion, region, &regionId);
+	if (status != Ok)
+		return status;
+
+	metafile_record_begin (&record, graphics, EmfPlusRecordTypeFillRegion, flags | regionId);
+	record_dword (&record, brushId);
+	return record_end (&record);
 }
 
 /*
@@ -257,8 +1150,11 @@ metafile_FillRegion (GpGraphics *graphics, GpBrush *brush, GpRegion *region)
 GpStatus
 metafile_GraphicsClear (GpGraphics *graphics, ARGB color)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+
+	metafile_record_begin (&record, graphics, EmfPlusRecordTypeClear, 0);
+	record_dword (&record, color);
+	return record_end (&record);
 }
 
 /*
@@ -268,8 +1164,7 @@ metafile_GraphicsClear (GpGraphics *graphics, ARGB color)
 GpStatus
 metafile_SetCompositingMode (GpGraphics *graphics, CompositingMode compositingMode)
 {
-	/* TODO */
-	return Ok;
+	return metafile_record_flags (graphics, EmfPlusRecordTypeSetCompositingMode, compositingMode);
 }
 
 /*
@@ -279,8 +1174,7 @@ metafile_SetCompositingMode (GpGraphics *graphics, CompositingMode compositingMo
 GpStatus
 metafile_SetCompositingQuality (GpGraphics *graphics, CompositingQuality compositingQuality)
 {
-	/* TODO */
-	return Ok;
+	return metafile_record_flags (graphics, EmfPlusRecordTypeSetCompositingQuality, compositingQuality);
 }
 
 /*
@@ -290,8 +1184,7 @@ metafile_SetCompositingQuality (GpGraphics *graphics, CompositingQuality composi
 GpStatus
 metafile_SetInterpolationMode (GpGraphics *graphics, InterpolationMode interpolationMode)
 {
-	/* TODO */
-	return Ok;
+	return metafile_record_flags (graphics, EmfPlusRecordTypeSetInterpolationMode, interpolationMode);
 }
 
 /*
@@ -301,8 +1194,7 @@ metafile_SetInterpolationMode (GpGraphics *graphics, InterpolationMode interpola
 GpStatus
 metafile_SetPixelOffsetMode (GpGraphics *graphics, PixelOffsetMode pixelOffsetMode)
 {
-	/* TODO */
-	return Ok;
+	return metafile_record_flags (graphics, EmfPlusRecordTypeSetPixelOffsetMode, pixelOffsetMode);
 }
 
 /*
@@ -312,8 +1204,11 @@ metafile_SetPixelOffsetMode (GpGraphics *graphics, PixelOffsetMode pixelOffsetMo
 GpStatus
 metafile_SetPageTransform (GpGraphics *graphics, GpUnit unit, float scale)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+
+	metafile_record_begin (&record, graphics, EmfPlusRecordTypeSetPageTransform, unit);
+	record_float (&record, scale);
+	return record_end (&record);
 }
 
 /*
@@ -323,8 +1218,12 @@ metafile_SetPageTransform (GpGraphics *graphics, GpUnit unit, float scale)
 GpStatus 
 metafile_SetRenderingOrigin (GpGraphics *graphics, int x, int y)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+
+	metafile_record_begin (&record, graphics, EmfPlusRecordTypeSetRenderingOrigin, 0);
+	record_dword (&record, x);
+	record_dword (&record, y);
+	return record_end (&record);
 }
 
 /*
@@ -334,8 +1233,10 @@ metafile_SetRenderingOrigin (GpGraphics *graphics, int x, int y)
 GpStatus
 metafile_SetSmoothingMode (GpGraphics *graphics, SmoothingMode mode)
 {
-	/* TODO */
-	return Ok;
+	/* bit 0 is set when antialiasing, the mode itself follows */
+	BOOL antialias = (mode == SmoothingModeHighQuality) || (mode >= SmoothingModeAntiAlias);
+
+	return metafile_record_flags (graphics, EmfPlusRecordTypeSetAntiAliasMode, (mode << 1) | antialias);
 }
 
 /*
@@ -345,8 +1246,7 @@ metafile_SetSmoothingMode (GpGraphics *graphics, SmoothingMode mode)
 GpStatus
 metafile_SetTextContrast (GpGraphics *graphics, UINT contrast)
 {
-	/* TODO */
-	return Ok;
+	return metafile_record_flags (graphics, EmfPlusRecordTypeSetTextContrast, contrast & 0x0FFF);
 }
 
 /*
@@ -356,8 +1256,35 @@ metafile_SetTextContrast (GpGraphics *graphics, UINT contrast)
 GpStatus
 metafile_SetTextRenderingHint (GpGraphics *graphics, TextRenderingHint mode)
 {
-	/* TODO */
-	return Ok;
+	return metafile_record_flags (graphics, EmfPlusRecordTypeSetTextRenderingHint, mode);
+}
+
+/*
+ * Save - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/Save.html
+ */
+
+GpStatus
+metafile_SaveGraphics (GpGraphics *graphics, GraphicsState state)
+{
+	EmfPlusRecord record;
+
+	metafile_record_begin (&record, graphics, EmfPlusRecordTypeSave, 0);
+	record_dword (&record, state);
+	return record_end (&record);
+}
+
+/*
+ * Restore - http://www.aces.uiuc.edu/~jhtodd/Metafile/MetafileRecords/Restore.html
+ */
+
+GpStatus
+metafile_RestoreGraphics (GpGraphics *graphics, GraphicsState state)
+{
+	EmfPlusRecord record;
+
+	metafile_record_begin (&record, graphics, EmfPlusRecordTypeRestore, 0);
+	record_dword (&record, state);
+	return record_end (&record);
 }
 
 /*
@@ -367,8 +1294,7 @@ metafile_SetTextRenderingHint (GpGraphics *graphics, TextRenderingHint mode)
 GpStatus
 metafile_ResetClip (GpGraphics *graphics)
 {
-	/* TODO */
-	return Ok;
+	return metafile_record_flags (graphics, EmfPlusRecordTypeResetClip, 0);
 }
 
 /*
@@ -378,8 +1304,14 @@ metafile_ResetClip (GpGraphics *graphics)
 GpStatus
 metafile_SetClipPath (GpGraphics *graphics, GpPath *path, CombineMode combineMode)
 {
-	/* TODO */
-	return Ok;
+	GpStatus status;
+	int pathId;
+
+	status = metafile_record_object (graphics, EmfPlusObjectTypePath, path, &pathId);
+	if (status != Ok)
+		return status;
+
+	return metafile_record_flags (graphics, EmfPlusRecordTypeSetClipPath, (combineMode << 8) | pathId);
 }
 
 /*
@@ -389,8 +1321,12 @@ metafile_SetClipPath (GpGraphics *graphics, GpPath *path, CombineMode combineMod
 GpStatus
 metafile_SetClipRect (GpGraphics *graphics, float x, float y, float width, float height, CombineMode combineMode)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+	GpRectF rect = { x, y, width, height };
+
+	metafile_record_begin (&record, graphics, EmfPlusRecordTypeSetClipRect, combineMode << 8);
+	record_rects (&record, &rect, 1);
+	return record_end (&record);
 }
 
 /*
@@ -400,8 +1336,20 @@ metafile_SetClipRect (GpGraphics *graphics, float x, float y, float width, float
 GpStatus
 metafile_SetClipRegion (GpGraphics *graphics, GpRegion *region, CombineMode combineMode)
 {
-	/* TODO */
-	return Ok;
+	GpStatus status;
+	int regionId;
+
+	/* GdipSetClipRect ends up here, keep simple rectangles as simple records */
+	if (region->type == RegionTypeRect && region->cnt == 1 && !gdip_is_InfiniteRegion (region)) {
+		GpRectF *rect = &region->rects [0];
+		return metafile_SetClipRect (graphics, rect->X, rect->Y, rect->Width, rect->Height, combineMode);
+	}
+
+	status = metafile_record_object (graphics, EmfPlusObjectTypeRegion, region, &regionId);
+	if (status != Ok)
+		return status;
+
+	return metafile_record_flags (graphics, EmfPlusRecordTypeSetClipRegion, (combineMode << 8) | regionId);
 }
 
 /*
@@ -411,8 +1359,12 @@ metafile_SetClipRegion (GpGraphics *graphics, GpRegion *region, CombineMode comb
 GpStatus
 metafile_TranslateClip (GpGraphics *graphics, float dx, float dy)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+
+	metafile_record_begin (&record, graphics, EmfPlusRecordTypeOffsetClip, 0);
+	record_float (&record, dx);
+	record_float (&record, dy);
+	return record_end (&record);
 }
 
 /*
@@ -422,8 +1374,11 @@ metafile_TranslateClip (GpGraphics *graphics, float dx, float dy)
 GpStatus
 metafile_ResetWorldTransform (GpGraphics *graphics)
 {
-	/* TODO */
-	return Ok;
+	/* inside a container the transform is reset to the container's one, which playback can't know */
+	if (!gdip_is_matrix_empty (&graphics->previous_matrix))
+		return metafile_SetWorldTransform (graphics, graphics->copy_of_ctm);
+
+	return metafile_record_flags (graphics, EmfPlusRecordTypeResetWorldTransform, 0);
 }
 
 /*
@@ -433,8 +1388,11 @@ metafile_ResetWorldTransform (GpGraphics *graphics)
 GpStatus
 metafile_SetWorldTransform (GpGraphics *graphics, GpMatrix *matrix)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+
+	metafile_record_begin (&record, graphics, EmfPlusRecordTypeSetWorldTransform, 0);
+	record_matrix (&record, matrix);
+	return record_end (&record);
 }
 
 /*
@@ -444,8 +1402,12 @@ metafile_SetWorldTransform (GpGraphics *graphics, GpMatrix *matrix)
 GpStatus
 metafile_MultiplyWorldTransform (GpGraphics *graphics, GpMatrix *matrix, GpMatrixOrder order)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+
+	metafile_record_begin (&record, graphics, EmfPlusRecordTypeMultiplyWorldTransform,
+		(order == MatrixOrderAppend) ? EMFPLUS_FLAGS_APPEND : 0);
+	record_matrix (&record, matrix);
+	return record_end (&record);
 }
 
 /*
@@ -455,8 +1417,12 @@ metafile_MultiplyWorldTransform (GpGraphics *graphics, GpMatrix *matrix, GpMatri
 GpStatus
 metafile_RotateWorldTransform (GpGraphics *graphics, float angle, GpMatrixOrder order)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+
+	metafile_record_begin (&record, graphics, EmfPlusRecordTypeRotateWorldTransform,
+		(order == MatrixOrderAppend) ? EMFPLUS_FLAGS_APPEND : 0);
+	record_float (&record, angle);
+	return record_end (&record);
 }
 
 /*
@@ -466,8 +1432,13 @@ metafile_RotateWorldTransform (GpGraphics *graphics, float angle, GpMatrixOrder
 GpStatus
 metafile_ScaleWorldTransform (GpGraphics *graphics, float sx, float sy, GpMatrixOrder order)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+
+	metafile_record_begin (&record, graphics, EmfPlusRecordTypeScaleWorldTransform,
+		(order == MatrixOrderAppend) ? EMFPLUS_FLAGS_APPEND : 0);
+	record_float (&record, sx);
+	record_float (&record, sy);
+	return record_end (&record);
 }
 
 /*
@@ -477,6 +1448,11 @@ metafile_ScaleWorldTransform (GpGraphics *graphics, float sx, float sy, GpMatrix
 GpStatus
 metafile_TranslateWorldTransform (GpGraphics *graphics, float dx, float dy, GpMatrixOrder order)
 {
-	/* TODO */
-	return Ok;
+	EmfPlusRecord record;
+
+	metafile_record_begin (&record, graphics, EmfPlusRecordTypeTranslateWorldTransform,
+		(order == MatrixOrderAppend) ? EMFPLUS_FLAGS_APPEND : 0);
+	record_float (&record, dx);
+	record_float (&record, dy);
+	return record_end (&record);
 }
@@ -39,6 +39,36 @@
 #include "graphics-private.h"
 #include "stringformat-private.h"
 
+/* flatness used to build the edges for hit-testing (FlatnessDefault in GDI+) */
+#define PATH_EDGES_FLATNESS	0.25f
+
+typedef struct _PathEdge {
+	float x0, y0, x1, y1;
+	BOOL stroked;		/* FALSE for the implicit closing edge of an open figure */
+	BOOL join;		/* TRUE if the start point joins the previous stroked edge */
+} PathEdge;
+
+/* flattened edges of a path, cached for hit-testing until the path is modified */
+typedef struct _PathEdges {
+	int count;
+	float minX, minY, maxX, maxY;
+	PathEdge *edges;
+} PathEdges;
+
+/* dashed segments of the last dashed stroke, and everything they were built from */
+typedef struct _PathDashes {
+	cairo_matrix_t plot_matrix;	/* graphics matrix used to plot the path */
+	cairo_matrix_t stroke_matrix;	/* pen and graphics matrix used to stroke it */
+	double unit_x, unit_y;		/* page unit conversion */
+	double aa_x, aa_y;		/* antialiasing offset */
+	double tolerance;
+	double width;			/* line width the pattern is relative to */
+	float offset;
+	int count;
+	float *pattern;
+	cairo_path_t *segments;		/* in the stroke (user) coordinates */
+} PathDashes;
+
 typedef struct _Path {
 	FillMode fill_mode;
 	int count;
@@ -46,10 +76,14 @@ typedef struct _Path {
 	BYTE *types;
 	GpPointF *points;
 	BOOL start_new_fig;	/* Flag to keep track if we need to start a new figure */
+	PathEdges *edges;	/* NULL until a hit-test needs them */
+	PathDashes *dashes;	/* NULL until drawn with a dashed pen */
 } Path;
 
 BOOL gdip_path_has_curve (GpPath *path) GDIP_INTERNAL;
 BOOL gdip_path_ensure_size (GpPath *path, int size) GDIP_INTERNAL;
+void gdip_path_invalidate (GpPath *path) GDIP_INTERNAL;
+void gdip_path_dashes_free (PathDashes *dashes) GDIP_INTERNAL;
 BOOL gdip_path_closed (GpPath *path) GDIP_INTERNAL;
 
 #include "graphics-path.h"
@@ -34,12 +34,41 @@
 	#include "text-pango-private.h"
 #endif
 
+/* discard the cached hit-testing edges, must be called before the path geometry changes */
+void
+gdip_path_invalidate (GpPath *path)
+{
+	if (path->edges) {
+		GdipFree (path->edges->edges);
+		GdipFree (path->edges);
+		path->edges = NULL;
+	}
+	gdip_path_dashes_free (path->dashes);
+	path->dashes = NULL;
+}
+
+void
+gdip_path_dashes_free (PathDashes *dashes)
+{
+	if (dashes) {
+		GdipFree (dashes->pattern);
+		if (dashes->segments) {
+			GdipFree (dashes->segments->data);
+			GdipFree (dashes->segments);
+		}
+		GdipFree (dashes);
+	}
+}
+
 BOOL
 gdip_path_ensure_size (GpPath *path, int size)
 {
 	BYTE *new_types;
 	GpPointF *new_points;
 
+	/* every append goes through here */
+	gdip_path_invalidate (path);
+
 	if (path->size < size) {
 		if (size < path->size + 64)
 			size = path->size + 64;
@@ -278,6 +307,8 @@ GdipCreatePath (FillMode fillMode, GpPath **path)
 	result->types = NULL;
 	result->count = 0;
 	result->start_new_fig = TRUE;
+	result->edges = NULL;
+	result->dashes = NULL;
 
 	*path = result;
 	return Ok;
@@ -326,6 +357,8 @@ GdipCreatePath2 (GDIPCONST GpPointF *points, GDIPCONST BYTE *types, INT count, F
 
 	// Match GDI+ behaviour by normalizing the start of the type array.
 	result->types[0] = PathPointTypeStart;
+	result->edges = NULL;
+	result->dashes = NULL;
 
 	*path = result;
 	return Ok;
@@ -400,6 +433,8 @@ GdipClonePath (GpPath *path, GpPath **clonePath)
 	}
 
 	result->start_new_fig = path->start_new_fig;
+	result->edges = NULL;
+	result->dashes = NULL;
 
 	*clonePath = result;
 	return Ok;
@@ -411,6 +446,8 @@ GdipDeletePath (GpPath *path)
 	if (path == NULL)
 		return InvalidParameter;
 
+	gdip_path_invalidate (path);
+
 	if (path->points != NULL)
 		GdipFree (path->points);
 	path->points = NULL;
@@ -429,6 +466,7 @@ GdipResetPath (GpPath *path)
 	if (path == NULL)
 		return InvalidParameter;
 
+	gdip_path_invalidate (path);
 	path->count = 0;
 	path->fill_mode = FillModeAlternate;
 	path->start_new_fig = TRUE;
@@ -545,8 +583,10 @@ GdipClosePathFigure (GpPath *path)
 		return InvalidParameter;
 
 	// Close the last figure.
-	if (path->count > 1)
+	if (path->count > 1) {
+		gdip_path_invalidate (path);
 		path->types[path->count - 1] |= PathPointTypeCloseSubpath;
+	}
 
 	// Start a new figure.
 	path->start_new_fig = TRUE;
@@ -560,6 +600,8 @@ GdipClosePathFigures (GpPath *path)
 		return InvalidParameter;
 
 	if (path->count > 1) {
+		gdip_path_invalidate (path);
+
 		// Close the last figure.
 		path->types[path->count - 1] |= PathPointTypeCloseSubpath;
 
@@ -646,6 +688,8 @@ GdipReversePath (GpPath *path)
 	if (length <= 1)
 		return Ok;
 
+	gdip_path_invalidate (path);
+
 	/* PathTypes reversal */
 
 	/* First adjust the flags for each subpath */
@@ -1606,107 +1650,120 @@ GdipAddPathPolygonI (GpPath *path, const GpPoint *points, int count)
 	return GdipClosePathFigure (path);
 }
 
-/* nr_curve_flatten comes from Sodipodi's libnr (public domain) available from http://www.sodipodi.com/ */
-/* Mono changes: converted to float (from double), added recursion limit, use GArray */
-static BOOL
-nr_curve_flatten (float x0, float y0, float x1, float y1, float x2, float y2, float x3, float y3, float flatness, int level, GpPath *flat_path)
-{
-	float dx1_0, dy1_0, dx2_0, dy2_0, dx3_0, dy3_0, dx2_3, dy2_3, d3_0_2;
-	float s1_q, t1_q, s2_q, t2_q, v2_q;
-	float f2, f2_q;
-	float x00t, y00t, x0tt, y0tt, xttt, yttt, x1tt, y1tt, x11t, y11t;
-
-	dx1_0 = x1 - x0;
-	dy1_0 = y1 - y0;
-	dx2_0 = x2 - x0;
-	dy2_0 = y2 - y0;
-	dx3_0 = x3 - x0;
-	dy3_0 = y3 - y0;
-	dx2_3 = x3 - x2;
-	dy2_3 = y3 - y2;
-	f2 = flatness;
-	d3_0_2 = dx3_0 * dx3_0 + dy3_0 * dy3_0;
-	if (d3_0_2 < f2) {
-		float d1_0_2, d2_0_2;
-		d1_0_2 = dx1_0 * dx1_0 + dy1_0 * dy1_0;
-		d2_0_2 = dx2_0 * dx2_0 + dy2_0 * dy2_0;
-		if ((d1_0_2 < f2) && (d2_0_2 < f2)) {
-			goto nosubdivide;
-		} else {
-			goto subdivide;
+/*
+ * Number of line segments needed to flatten the bezier starting at p [0]. Like the
+ * recursive subdivision used previously, flatness is compared with squared distances.
+ * When the control points project in order on the chord, their distance to it shrinks
+ * with the square of the number of (uniform) segments; otherwise the bound from the
+ * second differences of the control polygon (Wang's formula) is used.
+ * Returns -1 if more than 1 << FLATTEN_RECURSION_LIMIT segments would be required.
+ */
+static int
+gdip_bezier_segments (const GpPointF *p, float flatness)
+{
+	double dx1_0 = p[1].X - p[0].X, dy1_0 = p[1].Y - p[0].Y;
+	double dx2_0 = p[2].X - p[0].X, dy2_0 = p[2].Y - p[0].Y;
+	double dx3_0 = p[3].X - p[0].X, dy3_0 = p[3].Y - p[0].Y;
+	double dx2_3 = p[3].X - p[2].X, dy2_3 = p[3].Y - p[2].Y;
+	double d3_0_2 = dx3_0 * dx3_0 + dy3_0 * dy3_0;
+	double segments;
+
+	if (d3_0_2 >= flatness) {
+		double f2_q = flatness * d3_0_2;
+		double s1_q = dx1_0 * dx3_0 + dy1_0 * dy3_0;
+		double t1_q = dy1_0 * dx3_0 - dx1_0 * dy3_0;
+		double s2_q = dx2_0 * dx3_0 + dy2_0 * dy3_0;
+		double t2_q = dy2_0 * dx3_0 - dx2_0 * dy3_0;
+		double v2_q = dx2_3 * dx3_0 + dy2_3 * dy3_0;
+
+		if (!((s1_q < 0.0) && ((s1_q * s1_q) > f2_q)) && !((v2_q < 0.0) && ((v2_q * v2_q) > f2_q)) && (s1_q < s2_q)) {
+			/* squared distance of the farthest control point to the chord */
+			double d2 = MAX (t1_q * t1_q, t2_q * t2_q) / d3_0_2;
+
+			if (d2 <= flatness)
+				return 1;
+			if (flatness == 0)
+				return -1;
+
+			segments = ceil (pow (d2 / flatness, 0.25));
+			return (segments > (1 << FLATTEN_RECURSION_LIMIT)) ? -1 : (int) segments;
 		}
+	} else if ((dx1_0 * dx1_0 + dy1_0 * dy1_0 < flatness) && (dx2_0 * dx2_0 + dy2_0 * dy2_0 < flatness)) {
+		/* the whole curve is within the tolerance of its start point */
+		return 1;
 	}
-	f2_q = f2 * d3_0_2;
-	s1_q = dx1_0 * dx3_0 + dy1_0 * dy3_0;
-	t1_q = dy1_0 * dx3_0 - dx1_0 * dy3_0;
-	s2_q = dx2_0 * dx3_0 + dy2_0 * dy3_0;
-	t2_q = dy2_0 * dx3_0 - dx2_0 * dy3_0;
-	v2_q = dx2_3 * dx3_0 + dy2_3 * dy3_0;
-	if ((t1_q * t1_q) > f2_q) goto subdivide;
-	if ((t2_q * t2_q) > f2_q) goto subdivide;
-	if ((s1_q < 0.0) && ((s1_q * s1_q) > f2_q)) goto subdivide;
-	if ((v2_q < 0.0) && ((v2_q * v2_q) > f2_q)) goto subdivide;
-	if (s1_q >= s2_q) goto subdivide;
-
- nosubdivide:
-	{
-	append (flat_path, x3, y3, PathPointTypeLine, FALSE);
-	return TRUE;
-	}
- subdivide:
-	/* things gets *VERY* memory intensive without a limit */
-	if (level >= FLATTEN_RECURSION_LIMIT)
-		return FALSE;
 
-	x00t = (x0 + x1) * 0.5;
-	y00t = (y0 + y1) * 0.5;
-	x0tt = (x0 + 2 * x1 + x2) * 0.25;
-	y0tt = (y0 + 2 * y1 + y2) * 0.25;
-	x1tt = (x1 + 2 * x2 + x3) * 0.25;
-	y1tt = (y1 + 2 * y2 + y3) * 0.25;
-	x11t = (x2 + x3) * 0.5;
-	y11t = (y2 + y3) * 0.5;
-	xttt = (x0tt + x1tt) * 0.5;
-	yttt = (y0tt + y1tt) * 0.5;
-
-	if (!nr_curve_flatten (x0, y0, x00t, y00t, x0tt, y0tt, xttt, yttt, flatness, level+1, flat_path)) return FALSE;
-	if (!nr_curve_flatten (xttt, yttt, x1tt, y1tt, x11t, y11t, x3, y3, flatness, level+1, flat_path)) return FALSE;
-	return TRUE;
+	if (flatness == 0)
+		return -1;
+
+	segments = MAX (hypot (p[0].X - 2 * p[1].X + p[2].X, p[0].Y - 2 * p[1].Y + p[2].Y),
+		hypot (p[1].X - 2 * p[2].X + p[3].X, p[1].Y - 2 * p[2].Y + p[3].Y));
+	segments = ceil (sqrt (0.75 * segments / sqrt (flatness)));
+	if (segments > (1 << FLATTEN_RECURSION_LIMIT))
+		return -1;
+
+	return (segments < 1) ? 1 : (int) segments;
 }
 
-static BOOL
-gdip_convert_bezier_to_lines (GpPath *path, int index, float flatness, GpPath *flat_path)
-{
-	GpPointF start, first, second, end;
-	int saved_count;
+/* evaluate the bezier at n uniform steps using forward differences, the end point is exact */
+static void
+gdip_flatten_bezier (const GpPointF *p, int n, GpPointF *points, BYTE *types)
+{
+	double h = 1.0 / n, h2 = h * h, h3 = h2 * h;
+	double ax = -p[0].X + 3 * (p[1].X - p[2].X) + p[3].X, ay = -p[0].Y + 3 * (p[1].Y - p[2].Y) + p[3].Y;
+	double bx = 3 * (p[0].X - 2 * p[1].X + p[2].X), by = 3 * (p[0].Y - 2 * p[1].Y + p[2].Y);
+	double cx = 3 * (p[1].X - p[0].X), cy = 3 * (p[1].Y - p[0].Y);
+	double x = p[0].X, y = p[0].Y;
+	double dx = ax * h3 + bx * h2 + cx * h, dy = ay * h3 + by * h2 + cy * h;
+	double ddx = 6 * ax * h3 + 2 * bx * h2, ddy = 6 * ay * h3 + 2 * by * h2;
+	double dddx = 6 * ax * h3, dddy = 6 * ay * h3;
+	int i;
+
+	for (i = 0; i < n - 1; i++) {
+		x += dx; y += dy;
+		dx += ddx; dy += ddy;
+		ddx += dddx; ddy += dddy;
+		points [i].X = x;
+		points [i].Y = y;
+		types [i] = PathPointTypeLine;
+	}
 
-	if ((index <= 0) || (index + 2 >= path->count))
-		return FALSE; /* bad path data */
+	points [n - 1] = p[3];
+	types [n - 1] = PathPointTypeLine;
+}
 
-	start = path->points[index - 1];
-	first = path->points[index];
-	second = path->points[index + 1];
-	end = path->points[index + 2];
+/* number of points once flattened, or -1 if the path is too complex (or has bad curve data) */
+static int
+gdip_path_flattened_count (GpPath *path, float flatness)
+{
+	int i, count = 0;
 
-	if (!gdip_path_ensure_size (path, path->count + (1 << FLATTEN_RECURSION_LIMIT)))
-		return FALSE;
+	for (i = 0; i < path->count; i++) {
+		/* PathPointTypeBezier3 has the same value as PathPointTypeBezier */
+		if ((path->types [i] & PathPointTypeBezier) == PathPointTypeBezier) {
+			/* beziers have 4 points: the previous one, the current and the next two */
+			int segments = ((i > 0) && (i + 2 < path->count)) ? gdip_bezier_segments (&path->points [i - 1], flatness) : -1;
 
-	saved_count = flat_path->count;
-	if (!nr_curve_flatten (start.X, start.Y, first.X, first.Y, second.X, second.Y, end.X, end.Y, flatness, 0, flat_path)) {
-		/* curved path is too complex (i.e. would result in too many points) to render as a polygon */
-		flat_path->count = saved_count;
-		return FALSE;
+			if (segments < 0)
+				return -1;
+			count += segments;
+			i += 2;
+		} else {
+			count++;
+		}
 	}
 
-	return TRUE;
+	return count;
 }
 
 GpStatus WINGDIPAPI 
 GdipFlattenPath (GpPath *path, GpMatrix *matrix, float flatness)
 {
 	GpStatus status = Ok;
-	GpPath *flat_path;
-	int i;
+	GpPointF *points;
+	BYTE *types;
+	int i, count;
+	BOOL tooComplex;
 
 	if (!path)
 		return InvalidParameter;
@@ -1722,62 +1779,57 @@ GdipFlattenPath (GpPath *path, GpMatrix *matrix, float flatness)
 	if (!gdip_path_has_curve (path))
 		return status;
 
-	status = GdipCreatePath (path->fill_mode, &flat_path);
-	if (status != Ok)
-		return status;
+	flatness = fabs (flatness);
 
-	/* Iterate the current path and replace each bezier with multiple lines */
-	for (i = 0; i < path->count; i++) {
-		GpPointF point = path->points[i];
-		BYTE type = path->types[i];
+	/* first pass: count the output points so they can be allocated at once */
+	count = gdip_path_flattened_count (path, flatness);
 
-		/* PathPointTypeBezier3 has the same value as PathPointTypeBezier */
-		if ((type & PathPointTypeBezier) == PathPointTypeBezier) {
-			if (!gdip_convert_bezier_to_lines (path, i, fabs (flatness), flat_path)) {
-				/* uho, too much recursion - do not pass go, do not collect 200$ */
+	/* curved path is too complex (i.e. would result in too many points) or bad path data:
+	 * mimic MS behaviour - it's not really an empty rectangle as the last point isn't closing */
+	tooComplex = (count < 0);
+	if (tooComplex)
+		count = 4;
 
-				/* free the the partial flat */
-				GdipResetPath (flat_path);
+	points = GdipAlloc (count * sizeof (GpPointF));
+	types = GdipAlloc (count * sizeof (BYTE));
+	if (!points || !types) {
+		GdipFree (points);
+		GdipFree (types);
+		return OutOfMemory;
+	}
 
-				if (!gdip_path_ensure_size (flat_path, flat_path->count + 4)) {
-					GdipDeletePath (flat_path);					
-					return OutOfMemory;
-				}
+	if (tooComplex) {
+		memset (points, 0, count * sizeof (GpPointF));
+		types [0] = PathPointTypeStart;
+		types [1] = types [2] = types [3] = PathPointTypeLine;
+	} else {
+		int n = 0;
 
-				/* mimic MS behaviour when recursion becomes a problem */
-				/* note: it's not really an empty rectangle as the last point isn't closing */
+		/* second pass: replace each bezier with multiple lines */
+		for (i = 0; i < path->count; i++) {
+			if ((path->types [i] & PathPointTypeBezier) == PathPointTypeBezier) {
+				int segments = gdip_bezier_segments (&path->points [i - 1], flatness);
 
-				append (flat_path, 0, 0, PathPointTypeStart, FALSE);
-				append (flat_path, 0, 0, PathPointTypeLine, FALSE);
-				append (flat_path, 0, 0, PathPointTypeLine, FALSE);
-				append (flat_path, 0, 0, PathPointTypeLine, FALSE);
-				break;
-			}
-			/* beziers have 4 points: the previous one, the current and the next two */
-			i += 2;
-		} else {
-			if (!gdip_path_ensure_size (flat_path, flat_path->count + 1)) {
-				GdipDeletePath (flat_path);					
-				return OutOfMemory;
+				gdip_flatten_bezier (&path->points [i - 1], segments, &points [n], &types [n]);
+				n += segments;
+				i += 2;
+			} else {
+				/* no change required, just copy the point */
+				points [n] = path->points [i];
+				types [n] = path->types [i];
+				n++;
 			}
-
-			/* no change required, just copy the point */
-			append_point(flat_path, point, type, FALSE);
 		}
 	}
 
-	/* free original path points and types */
-	if (path->points != NULL)
-		GdipFree (path->points);
-	if (path->types != NULL)
-		GdipFree (path->types);	
-
-	/* transfer new path informations */
-	path->points = flat_path->points;
-	path->types = flat_path->types;
-	path->count = flat_path->count;
-	path->size = flat_path->size;
-	GdipFree (flat_path);
+	/* replace the original path points and types */
+	gdip_path_invalidate (path);
+	GdipFree (path->points);
+	GdipFree (path->types);
+	path->points = points;
+	path->types = types;
+	path->count = count;
+	path->size = count;
 
 	/* note: no error code is given for excessive recursion */
 	return Ok;
@@ -1799,305 +1851,1803 @@ gdip_prepare_path (GpPath *path, GpMatrix *matrix, float flatness)
 	return Ok;
 }
 
-/* MonoTODO - doesn't seems to be exposed in System.Drawing.dll */
-GpStatus WINGDIPAPI 
-GdipWindingModeOutline (GpPath *path, GpMatrix *matrix, float flatness)
-{
-	GpStatus status;
+/*
+ * GdipWindingModeOutline support. The flattened figures are split into edges, which are
+ * then split again where they intersect (found with a sweep over the edges sorted on X).
+ * Only the pieces separating the inside (non-zero winding) from the outside are kept
+ * (a second sweep, over the edges sorted on Y, classifies both sides of every piece),
+ * oriented the same way as the source figures, and chained back into closed figures.
+ */
+typedef struct {
+	double x0, y0, x1, y1;
+} OutlineEdge;
+
+typedef struct {
+	int edge;
+	double t;
+	double x, y;
+} OutlineSplit;
+
+typedef struct {
+	double ax, ay, bx, by;
+	BOOL used;
+} OutlineSegment;
+
+typedef struct {
+	OutlineEdge *edges;
+	int edgeCount;
+	OutlineSplit *splits;
+	int splitCount;
+	int splitSize;
+} OutlineBuilder;
 
-	if (!path)
-		return InvalidParameter;
+static BOOL
+outline_add_split (OutlineBuilder *ob, int edge, double t, double x, double y)
+{
+	if (ob->splitCount == ob->splitSize) {
+		int size = ob->splitSize ? ob->splitSize * 2 : 64;
+		OutlineSplit *splits = gdip_realloc (ob->splits, size * sizeof (OutlineSplit));
 
-	/* quick out */
-	if (path->count == 0)
-		return Ok;
+		if (!splits)
+			return FALSE;
+		ob->splits = splits;
+		ob->splitSize = size;
+	}
 
-	status = gdip_prepare_path (path, matrix, flatness);
-	if (status != Ok)
-		return status;
+	ob->splits [ob->splitCount].edge = edge;
+	ob->splits [ob->splitCount].t = t;
+	ob->splits [ob->splitCount].x = x;
+	ob->splits [ob->splitCount].y = y;
+	ob->splitCount++;
+	return TRUE;
+}
 
-	/* TODO */
+/* parameter of (x, y) along the edge, assuming the point is on the edge */
+static double
+outline_edge_param (const OutlineEdge *e, double x, double y)
+{
+	double dx = e->x1 - e->x0;
+	double dy = e->y1 - e->y0;
 
-	return NotImplemented;
+	return ((x - e->x0) * dx + (y - e->y0) * dy) / (dx * dx + dy * dy);
 }
 
-/* MonoTODO */
-GpStatus WINGDIPAPI 
-GdipWidenPath (GpPath *nativePath, GpPen *pen, GpMatrix *matrix, float flatness)
+#define OUTLINE_EPSILON	1e-9
+
+/* split the edge at (x, y), which must be on it, unless it's one of its end points */
+static BOOL
+outline_split_at (OutlineBuilder *ob, int edge, double x, double y)
 {
-	static int called = 0;
-	GpStatus status;
+	const OutlineEdge *e = &ob->edges [edge];
+	double t;
 
-	if (!nativePath || !pen)
-		return InvalidParameter;
+	if (((x == e->x0) && (y == e->y0)) || ((x == e->x1) && (y == e->y1)))
+		return TRUE;
 
-	/* (0) is deal within System.Drawing */
-	/* (1) for compatibility with MS GDI+ (reported as FDBK49685) */
-	if (nativePath->count <= 1)
-		return OutOfMemory;
+	t = outline_edge_param (e, x, y);
+	if ((t <= 0) || (t >= 1))
+		return TRUE;
 
-	status = gdip_prepare_path (nativePath, matrix, flatness);
-	if (status != Ok)
-		return status;
+	return outline_add_split (ob, edge, t, x, y);
+}
 
-	/* TODO inner path (same number of points as the prepared path) */
+static BOOL
+outline_intersect (OutlineBuilder *ob, int i, int j)
+{
+	const OutlineEdge *p = &ob->edges [i];
+	const OutlineEdge *q = &ob->edges [j];
+	double rx = p->x1 - p->x0, ry = p->y1 - p->y0;
+	double sx = q->x1 - q->x0, sy = q->y1 - q->y0;
+	double qpx = q->x0 - p->x0, qpy = q->y0 - p->y0;
+	double denom = rx * sy - ry * sx;
+	double scale = (fabs (rx) + fabs (ry)) * (fabs (sx) + fabs (sy));
+	double t, u, x, y;
+
+	if (fabs (denom) <= OUTLINE_EPSILON * scale) {
+		/* parallel, only collinear edges can overlap: split each one at the other's ends */
+		if (fabs (qpx * ry - qpy * rx) > OUTLINE_EPSILON * scale)
+			return TRUE;
+
+		t = outline_edge_param (p, q->x0, q->y0);
+		if ((t > 0) && (t < 1) && !outline_split_at (ob, i, q->x0, q->y0))
+			return FALSE;
+		t = outline_edge_param (p, q->x1, q->y1);
+		if ((t > 0) && (t < 1) && !outline_split_at (ob, i, q->x1, q->y1))
+			return FALSE;
+		u = outline_edge_param (q, p->x0, p->y0);
+		if ((u > 0) && (u < 1) && !outline_split_at (ob, j, p->x0, p->y0))
+			return FALSE;
+		u = outline_edge_param (q, p->x1, p->y1);
+		if ((u > 0) && (u < 1) && !outline_split_at (ob, j, p->x1, p->y1))
+			return FALSE;
+		return TRUE;
+	}
 
-	/* TODO outer path (twice the number of points as the prepared path) */
+	t = (qpx * sy - qpy * sx) / denom;
+	u = (qpx * ry - qpy * rx) / denom;
+	if ((t < -OUTLINE_EPSILON) || (t > 1 + OUTLINE_EPSILON) || (u < -OUTLINE_EPSILON) || (u > 1 + OUTLINE_EPSILON))
+		return TRUE;
 
-	if (!called) {
-		g_warning ("NOT IMPLEMENTED: GdipWidenPath");
-		called = 1;
+	/* reuse the exact end point coordinates so that the pieces can be chained later */
+	if (t <= OUTLINE_EPSILON) {
+		x = p->x0; y = p->y0;
+	} else if (t >= 1 - OUTLINE_EPSILON) {
+		x = p->x1; y = p->y1;
+	} else if (u <= OUTLINE_EPSILON) {
+		x = q->x0; y = q->y0;
+	} else if (u >= 1 - OUTLINE_EPSILON) {
+		x = q->x1; y = q->y1;
+	} else {
+		x = p->x0 + t * rx;
+		y = p->y0 + t * ry;
 	}
-	return Ok;
+
+	return outline_split_at (ob, i, x, y) && outline_split_at (ob, j, x, y);
 }
 
-/* MonoTODO */
-GpStatus WINGDIPAPI 
-GdipWarpPath (GpPath *path, GpMatrix *matrix, const GpPointF *points, int count, 
-		float srcx, float srcy, float srcwidth, float srcheight,
-		WarpMode warpMode, float flatness)
-{
-	static int called = 0;
-	GpStatus status;
+/* an edge with the coordinate it is sorted on, qsort has no user data to look it up */
+typedef struct {
+	double key;
+	int edge;
+} OutlineOrder;
 
-	if (!path || !points || (count < 1))
-		return InvalidParameter;
+static int
+outline_compare_order (const void *a, const void *b)
+{
+	const OutlineOrder *oa = (const OutlineOrder *) a;
+	const OutlineOrder *ob = (const OutlineOrder *) b;
 
-	/* quick out */
-	if (path->count == 0)
-		return Ok;
+	return (oa->key < ob->key) ? -1 : (oa->key > ob->key) ? 1 : 0;
+}
 
-	/* an invalid warp mode resets the current path */
-	/* a path with a single point will reset it too */
-	if (((warpMode != WarpModePerspective) && (warpMode != WarpModeBilinear)) || (path->count == 1))
-		return GdipResetPath (path);
+static int
+outline_compare_splits (const void *a, const void *b)
+{
+	const OutlineSplit *sa = (const OutlineSplit *) a;
+	const OutlineSplit *sb = (const OutlineSplit *) b;
 
-	status = gdip_prepare_path (path, matrix, flatness);
-	if (status != Ok)
-		return status;
+	if (sa->edge != sb->edge)
+		return sa->edge - sb->edge;
+	return (sa->t < sb->t) ? -1 : (sa->t > sb->t) ? 1 : 0;
+}
 
-	/* TODO */
+static int
+outline_compare_segment_start (const void *a, const void *b)
+{
+	const OutlineSegment *sa = (const OutlineSegment *) a;
+	const OutlineSegment *sb = (const OutlineSegment *) b;
 
-	if (!called) {
-		g_warning ("NOT IMPLEMENTED: GdipWarpPath");
-		called = 1;
-	}
-	return Ok;
+	if (sa->ax != sb->ax)
+		return (sa->ax < sb->ax) ? -1 : 1;
+	if (sa->ay != sb->ay)
+		return (sa->ay < sb->ay) ? -1 : 1;
+	if (sa->bx != sb->bx)
+		return (sa->bx < sb->bx) ? -1 : 1;
+	if (sa->by != sb->by)
+		return (sa->by < sb->by) ? -1 : 1;
+	return 0;
 }
 
-GpStatus WINGDIPAPI 
-GdipTransformPath (GpPath* path, GpMatrix *matrix)
+/* sweep from left to right, only testing the edges whose X ranges overlap */
+static BOOL
+outline_find_intersections (OutlineBuilder *ob)
 {
-	if (!path)
-		return InvalidParameter;
+	OutlineOrder *order;
+	int *active;
+	int i, k, activeCount = 0;
 
-	if (path->count == 0)
-		return Ok; /* GdipTransformMatrixPoints would fail */
+	order = GdipAlloc (ob->edgeCount * sizeof (OutlineOrder));
+	active = GdipAlloc (ob->edgeCount * sizeof (int));
+	if (!order || !active) {
+		GdipFree (order);
+		GdipFree (active);
+		return FALSE;
+	}
 
-	/* avoid allocation/free/calculation for null/identity matrix */
-	if (gdip_is_matrix_empty (matrix))
-		return Ok;
+	for (i = 0; i < ob->edgeCount; i++) {
+		order [i].key = MIN (ob->edges [i].x0, ob->edges [i].x1);
+		order [i].edge = i;
+	}
+	qsort (order, ob->edgeCount, sizeof (OutlineOrder), outline_compare_order);
+
+	for (i = 0; i < ob->edgeCount; i++) {
+		const OutlineEdge *e = &ob->edges [order [i].edge];
+		double minX = MIN (e->x0, e->x1);
+		double minY = MIN (e->y0, e->y1);
+		double maxY = MAX (e->y0, e->y1);
+		int kept = 0;
+
+		for (k = 0; k < activeCount; k++) {
+			const OutlineEdge *a = &ob->edges [active [k]];
+
+			/* the active edge ends before this one starts, and so before all the next ones */
+			if (MAX (a->x0, a->x1) < minX)
+				continue;
+			active [kept++] = active [k];
+
+			if ((MAX (a->y0, a->y1) < minY) || (MIN (a->y0, a->y1) > maxY))
+				continue;
+			if (!outline_intersect (ob, active [k], order [i].edge)) {
+				GdipFree (order);
+				GdipFree (active);
+				return FALSE;
+			}
+		}
 
-	return GdipTransformMatrixPoints (matrix, path->points, path->count);
+		activeCount = kept;
+		active [activeCount++] = order [i].edge;
+	}
+
+	GdipFree (order);
+	GdipFree (active);
+	return TRUE;
 }
 
-GpStatus WINGDIPAPI 
-GdipGetPathWorldBounds (GpPath *path, GpRectF *bounds, const GpMatrix *matrix, const GpPen *pen)
+/* a point beside a piece, its winding number tells whether that side is inside */
+typedef struct {
+	double x, y;
+	int index;
+} OutlineProbe;
+
+static int
+outline_compare_probe_y (const void *a, const void *b)
 {
-	GpStatus status;
-	GpPath *workpath;
-	GpPointF points;
+	const OutlineProbe *pa = (const OutlineProbe *) a;
+	const OutlineProbe *pb = (const OutlineProbe *) b;
 
-	if (!path || !bounds)
-		return InvalidParameter;
+	return (pa->y < pb->y) ? -1 : (pa->y > pb->y) ? 1 : 0;
+}
 
-	// Paths with zero or one points are empty.
-	if (path->count <= 1) {
-		bounds->X = 0.0f;
-		bounds->Y = 0.0f;
-		bounds->Width = 0.0f;
-		bounds->Height = 0.0f;
-		return Ok;
+/*
+ * Winding numbers of all the probes in one sweep from top to bottom. Only the edges
+ * whose Y range contains the probe's are kept active and tested against it.
+ */
+static BOOL
+outline_probe_windings (const OutlineBuilder *ob, OutlineProbe *probes, int count, int *windings)
+{
+	OutlineOrder *order;
+	int *active;
+	int i, k, next = 0, activeCount = 0;
+
+	order = GdipAlloc (ob->edgeCount * sizeof (OutlineOrder));
+	active = GdipAlloc (ob->edgeCount * sizeof (int));
+	if (!order || !active) {
+		GdipFree (order);
+		GdipFree (active);
+		return FALSE;
 	}
 
-	status = GdipClonePath (path, &workpath);
-	if (status != Ok)
-		return status;
+	for (i = 0; i < ob->edgeCount; i++) {
+		order [i].key = MIN (ob->edges [i].y0, ob->edges [i].y1);
+		order [i].edge = i;
+	}
+	qsort (order, ob->edgeCount, sizeof (OutlineOrder), outline_compare_order);
+	qsort (probes, count, sizeof (OutlineProbe), outline_compare_probe_y);
 
-	/* We don't need a very precise flat value to get the bounds (GDI+ isn't, big time) -
-	 * however flattening helps by removing curves, making the rest of the algorithm a 
-	 * lot simpler.
-	 */
+	for (i = 0; i < count; i++) {
+		double x = probes [i].x, y = probes [i].y;
+		int kept = 0, winding = 0;
 
-	/* note: only the matrix is applied if no curves are present in the path */
-	status = GdipFlattenPath (workpath, (GpMatrix*)matrix, 25.0f);
-	if (status != Ok) {
-		GdipDeletePath (workpath);
-		return status;
-	}
+		while ((next < ob->edgeCount) && (order [next].key <= y))
+			active [activeCount++] = order [next++].edge;
 
-	points = workpath->points[0];
-	bounds->X = points.X;		/* keep minimum X here */
-	bounds->Y = points.Y;		/* keep minimum Y here */
-	if (workpath->count == 1) {
-		/* special case #2 - Only one element */
-		bounds->Width = 0.0f;
-		bounds->Height = 0.0f;
-		GdipDeletePath (workpath);
-		return Ok;
-	}
+		for (k = 0; k < activeCount; k++) {
+			const OutlineEdge *e = &ob->edges [active [k]];
 
-	bounds->Width = points.X;	/* keep maximum X here */
-	bounds->Height = points.Y;	/* keep maximum Y here */
+			/* the edge ends above this probe, and so above all the next ones */
+			if (MAX (e->y0, e->y1) < y)
+				continue;
+			active [kept++] = active [k];
 
-	for (int i = 1; i < workpath->count; i++) {
-		points = workpath->points[i];
-		if (points.X < bounds->X)
-			bounds->X = points.X;
-		if (points.Y < bounds->Y)
-			bounds->Y = points.Y;
-		if (points.X > bounds->Width)
-			bounds->Width = points.X;
-		if (points.Y > bounds->Height)
-			bounds->Height = points.Y;
-	}
+			if ((e->y0 <= y) != (e->y1 <= y)) {
+				double ix = e->x0 + (y - e->y0) * (e->x1 - e->x0) / (e->y1 - e->y0);
 
-	/* convert maximum values (width/height) as length */
-	bounds->Width -= bounds->X;
-	bounds->Height -= bounds->Y;
+				if (ix > x)
+					winding += (e->y1 > e->y0) ? 1 : -1;
+			}
+		}
 
-	if (pen) {
-		/* in calculation the pen's width is at least 1.0 */
-		float width = (pen->width < 1.0f) ? 1.0f : pen->width;
-		float halfw = (width / 2);
-		
-		bounds->X -= halfw;
-		bounds->Y -= halfw;
-		bounds->Width += width;
-		bounds->Height += width;
+		activeCount = kept;
+		windings [probes [i].index] = winding;
 	}
 
-	GdipDeletePath (workpath);
-	return Ok;
+	GdipFree (order);
+	GdipFree (active);
+	return TRUE;
 }
 
-GpStatus WINGDIPAPI 
-GdipGetPathWorldBoundsI (GpPath *path, GpRect *bounds, const GpMatrix *matrix, const GpPen *pen)
+/*
+ * Keep the pieces between an inside (non-zero winding) and an outside area, oriented with
+ * the inside on their left (or on their right when insideLeft is FALSE). The count pieces
+ * are compacted in place.
+ */
+static BOOL
+outline_keep_boundaries (const OutlineBuilder *ob, OutlineSegment *segments, int *count, double offset, BOOL insideLeft)
 {
-	GpRectF rect;
-	GpStatus status;
+	OutlineProbe *probes;
+	int *windings;
+	int i, kept = 0;
 
-	if (!path || !bounds)
-		return InvalidParameter;
+	if (*count == 0)
+		return TRUE;
 
-	status = GdipGetPathWorldBounds (path, &rect, matrix, pen);
-	if (status != Ok)
-		return status;	
+	probes = GdipAlloc (*count * 2 * sizeof (OutlineProbe));
+	windings = GdipAlloc (*count * 2 * sizeof (int));
+	if (!probes || !windings) {
+		GdipFree (probes);
+		GdipFree (windings);
+		return FALSE;
+	}
 
-	bounds->X = (int) rect.X;
-	bounds->Y = (int) rect.Y;
-	bounds->Width = (int) rect.Width;
-	bounds->Height = (int) rect.Height;
-	return Ok;
+	/* one probe on each side of the middle of every piece */
+	for (i = 0; i < *count; i++) {
+		const OutlineSegment *s = &segments [i];
+		double dx = s->bx - s->ax, dy = s->by - s->ay;
+		double length = sqrt (dx * dx + dy * dy);
+		double mx = (s->ax + s->bx) / 2, my = (s->ay + s->by) / 2;
+		double nx = -dy / length * offset, ny = dx / length * offset;
+
+		probes [i * 2].x = mx + nx;
+		probes [i * 2].y = my + ny;
+		probes [i * 2].index = i * 2;
+		probes [i * 2 + 1].x = mx - nx;
+		probes [i * 2 + 1].y = my - ny;
+		probes [i * 2 + 1].index = i * 2 + 1;
+	}
+
+	if (!outline_probe_windings (ob, probes, *count * 2, windings)) {
+		GdipFree (probes);
+		GdipFree (windings);
+		return FALSE;
+	}
+
+	for (i = 0; i < *count; i++) {
+		OutlineSegment s = segments [i];
+		BOOL left = windings [i * 2] != 0;
+		BOOL right = windings [i * 2 + 1] != 0;
+
+		if (left == right)
+			continue;
+
+		if (left == insideLeft) {
+			segments [kept] = s;
+		} else {
+			segments [kept].ax = s.bx; segments [kept].ay = s.by;
+			segments [kept].bx = s.ax; segments [kept].by = s.ay;
+		}
+		segments [kept++].used = FALSE;
+	}
+	*count = kept;
+
+	GdipFree (probes);
+	GdipFree (windings);
+	return TRUE;
 }
 
-GpStatus WINGDIPAPI 
-GdipIsVisiblePathPoint (GpPath *path, float x, float y, GpGraphics *graphics, BOOL *result)
+/* find the unused piece, starting at (x, y), that turns the most to the left of (dx, dy) */
+static OutlineSegment *
+outline_next_segment (OutlineSegment *sorted, int count, double x, double y, double dx, double dy)
 {
-	GpStatus status = Ok;
-	cairo_surface_t* s = NULL;
-	GpGraphics *g;
-	GpUnit page_unit = UnitPixel;
+	OutlineSegment *best = NULL;
+	double bestAngle = -PI * 2;
+	int low = 0, high = count;
 
-	if (!path || !result)
-		return InvalidParameter;
+	while (low < high) {
+		int mid = (low + high) / 2;
 
-	if (graphics) {
-		g = graphics;
-		cairo_save (g->ct);
-		page_unit = g->page_unit;
-	} else {
-		/* create a temporary context */
-		s = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 1, 1);
-		g = gdip_graphics_new (s);
-	}
-
-	cairo_new_path (g->ct);
-	/* unit tests shows that PageUnit isn't consireded (well x, y are probably considered to be the same unit format ) */
-	g->page_unit = UnitPixel;
-	status = gdip_plot_path (g, path, FALSE);
-	if (status == Ok) {
-		cairo_set_fill_rule (g->ct, gdip_convert_fill_mode (path->fill_mode));
-		cairo_set_antialias (g->ct, CAIRO_ANTIALIAS_NONE);
-		*result = cairo_in_fill (g->ct, x + 1.0 /* CAIRO_AA_OFFSET_X */, y + CAIRO_AA_OFFSET_Y);
-	} else {
-		*result = FALSE;
+		if ((sorted [mid].ax < x) || ((sorted [mid].ax == x) && (sorted [mid].ay < y)))
+			low = mid + 1;
+		else
+			high = mid;
 	}
 
-	if (graphics) {
-		/* restore GpGraphics to original state */
-		cairo_restore (graphics->ct);
-		g->page_unit = page_unit;
-	} else {
-		/* delete temporary context */
-		cairo_surface_destroy (s);
-		GdipDeleteGraphics (g);
+	for (; (low < count) && (sorted [low].ax == x) && (sorted [low].ay == y); low++) {
+		double ox = sorted [low].bx - x, oy = sorted [low].by - y;
+		double angle;
+
+		if (sorted [low].used)
+			continue;
+
+		angle = atan2 (dx * oy - dy * ox, dx * ox + dy * oy);
+		if (angle > bestAngle) {
+			bestAngle = angle;
+			best = &sorted [low];
+		}
 	}
 
-	return status;
+	return best;
 }
 
-GpStatus WINGDIPAPI 
-GdipIsVisiblePathPointI (GpPath *path, int x, int y, GpGraphics *graphics, BOOL *result)
+static BOOL
+outline_collinear (const GpPointF *a, const GpPointF *b, const GpPointF *c)
 {
-	return GdipIsVisiblePathPoint (path, x, y, graphics, result);
+	double abx = b->X - a->X, aby = b->Y - a->Y;
+	double bcx = c->X - b->X, bcy = c->Y - b->Y;
+
+	return (fabs (abx * bcy - aby * bcx) <= OUTLINE_EPSILON * (fabs (abx) + fabs (aby)) * (fabs (bcx) + fabs (bcy))) &&
+		(abx * bcx + aby * bcy > 0);
+}
+
+/* chain the pieces into closed figures, dropping the points in the middle of straight lines */
+static BOOL
+outline_emit_figures (OutlineSegment *sorted, int count, GpPath *out, GpPointF *loop)
+{
+	int i, j, n;
+
+	for (i = 0; i < count; i++) {
+		OutlineSegment *s = &sorted [i];
+
+		if (s->used)
+			continue;
+
+		n = 0;
+		while (s && !s->used) {
+			s->used = TRUE;
+			loop [n].X = s->ax;
+			loop [n].Y = s->ay;
+			n++;
+			s = outline_next_segment (sorted, count, s->bx, s->by, s->bx - s->ax, s->by - s->ay);
+		}
+
+		/* remove the collinear points, including around the start of the loop */
+		for (j = 0; j < n; ) {
+			if ((n > 2) && outline_collinear (&loop [(j + n - 1) % n], &loop [j], &loop [(j + 1) % n])) {
+				memmove (&loop [j], &loop [j + 1], (n - j - 1) * sizeof (GpPointF));
+				n--;
+				if (j > 0)
+					j--;
+			} else {
+				j++;
+			}
+		}
+
+		if (n < 3)
+			continue;
+
+		if (!gdip_path_ensure_size (out, out->count + n))
+			return FALSE;
+
+		for (j = 0; j < n; j++) {
+			out->points [out->count] = loop [j];
+			out->types [out->count] = (j == 0) ? PathPointTypeStart : PathPointTypeLine;
+			out->count++;
+		}
+		out->types [out->count - 1] |= PathPointTypeCloseSubpath;
+	}
+
+	return TRUE;
+}
+
+static GpStatus
+gdip_winding_outline (GpPath *path)
+{
+	OutlineBuilder ob;
+	OutlineSegment *segments = NULL, *sorted = NULL;
+	GpPointF *loop = NULL;
+	GpPath *out = NULL;
+	GpStatus status = OutOfMemory;
+	double minX, minY, maxX, maxY, offset, area = 0;
+	int i, start, count = 0;
+
+	memset (&ob, 0, sizeof (OutlineBuilder));
+
+	/* one edge per point, every figure being implicitly closed */
+	ob.edges = GdipAlloc (path->count * sizeof (OutlineEdge));
+	if (!ob.edges)
+		return OutOfMemory;
+
+	minX = maxX = path->points [0].X;
+	minY = maxY = path->points [0].Y;
+	for (start = 0; start < path->count; start = i) {
+		for (i = start + 1; (i < path->count) && ((path->types [i] & PathPointTypePathTypeMask) != PathPointTypeStart); i++)
+			;
+
+		for (int k = start; k < i; k++) {
+			GpPointF a = path->points [k];
+			GpPointF b = path->points [(k + 1 < i) ? k + 1 : start];
+
+			minX = MIN (minX, a.X); maxX = MAX (maxX, a.X);
+			minY = MIN (minY, a.Y); maxY = MAX (maxY, a.Y);
+			if ((a.X == b.X) && (a.Y == b.Y))
+				continue;
+
+			area += (double) a.X * b.Y - (double) b.X * a.Y;
+
+			ob.edges [ob.edgeCount].x0 = a.X;
+			ob.edges [ob.edgeCount].y0 = a.Y;
+			ob.edges [ob.edgeCount].x1 = b.X;
+			ob.edges [ob.edgeCount].y1 = b.Y;
+			ob.edgeCount++;
+		}
+	}
+
+	/* nothing to fill (e.g. a single point) gives an empty path */
+	if (ob.edgeCount == 0) {
+		GdipFree (ob.edges);
+		return GdipResetPath (path);
+	}
+
+	if (!outline_find_intersections (&ob))
+		goto cleanup;
+
+	/* add the end points of every edge and sort the splits along each edge */
+	for (i = 0; i < ob.edgeCount; i++) {
+		if (!outline_add_split (&ob, i, 0, ob.edges [i].x0, ob.edges [i].y0) ||
+		    !outline_add_split (&ob, i, 1, ob.edges [i].x1, ob.edges [i].y1))
+			goto cleanup;
+	}
+	qsort (ob.splits, ob.splitCount, sizeof (OutlineSplit), outline_compare_splits);
+
+	segments = GdipAlloc (MAX (ob.splitCount, 1) * sizeof (OutlineSegment));
+	loop = GdipAlloc (MAX (ob.splitCount, 1) * sizeof (GpPointF));
+	if (!segments || !loop)
+		goto cleanup;
+
+	/* small enough not to cross another edge, large enough for the precision of doubles */
+	offset = MAX (MAX (maxX - minX, maxY - minY), 1.0) * 1e-7;
+	for (i = 1; i < ob.splitCount; i++) {
+		const OutlineSplit *a = &ob.splits [i - 1];
+		const OutlineSplit *b = &ob.splits [i];
+
+		if ((a->edge != b->edge) || ((a->x == b->x) && (a->y == b->y)))
+			continue;
+		segments [count].ax = a->x;
+		segments [count].ay = a->y;
+		segments [count].bx = b->x;
+		segments [count].by = b->y;
+		count++;
+	}
+	/* like GDI+, keep the orientation of the source figures (e.g. once mirrored by the matrix) */
+	if (!outline_keep_boundaries (&ob, segments, &count, offset, area >= 0))
+		goto cleanup;
+
+	/* overlapping edges give duplicated pieces */
+	sorted = segments;
+	qsort (sorted, count, sizeof (OutlineSegment), outline_compare_segment_start);
+	for (i = 1, start = (count > 0) ? 1 : 0; i < count; i++) {
+		if (outline_compare_segment_start (&sorted [i], &sorted [start - 1]) != 0)
+			sorted [start++] = sorted [i];
+	}
+	count = start;
+
+	if (GdipCreatePath (FillModeAlternate, &out) != Ok)
+		goto cleanup;
+	if (!outline_emit_figures (sorted, count, out, loop))
+		goto cleanup;
+
+	/* replace the original path with its outline */
+	gdip_path_invalidate (path);
+	GdipFree (path->points);
+	GdipFree (path->types);
+	path->points = out->points;
+	path->types = out->types;
+	path->count = out->count;
+	path->size = out->size;
+	path->fill_mode = FillModeAlternate;
+	path->start_new_fig = TRUE;
+	GdipFree (out);
+	out = NULL;
+	status = Ok;
+
+cleanup:
+	if (out)
+		GdipDeletePath (out);
+	GdipFree (ob.edges);
+	GdipFree (ob.splits);
+	GdipFree (segments);
+	GdipFree (loop);
+	return status;
+}
+
+/* note: doesn't seems to be exposed in System.Drawing.dll */
+GpStatus WINGDIPAPI 
+GdipWindingModeOutline (GpPath *path, GpMatrix *matrix, float flatness)
+{
+	GpStatus status;
+
+	if (!path)
+		return InvalidParameter;
+
+	/* quick out */
+	if (path->count == 0)
+		return Ok;
+
+	/* unlike GdipFlattenPath, GDI+ fails on curves that can't be flattened */
+	if (gdip_path_has_curve (path)) {
+		if (!gdip_is_matrix_empty (matrix)) {
+			status = GdipTransformPath (path, matrix);
+			if (status != Ok)
+				return status;
+		}
+		if (gdip_path_flattened_count (path, fabs (flatness)) < 0)
+			return GenericError;
+		matrix = NULL;
+	}
+
+	status = gdip_prepare_path (path, matrix, flatness);
+	if (status != Ok)
+		return status;
+
+	return gdip_winding_outline (path);
+}
+
+/*
+ * Stroker used by GdipWidenPath. Each (flattened) figure is turned into closed outline
+ * figures: open figures become a single outline (left side, end cap, right side, start
+ * cap) while closed figures become an outer and an inner loop running in opposite
+ * directions. The inner side of a join goes through the join point itself so that the
+ * outline keeps covering the corner; the result is meant to be filled with FillModeWinding.
+ */
+typedef struct {
+	GpPath *out;
+	float halfWidth;
+	float flatness;		/* maximum error allowed when approximating arcs */
+	GpLineJoin join;
+	float miterLimit;
+	BOOL newFigure;
+	BOOL outOfMemory;
+} PathStroker;
+
+static void
+stroker_emit (PathStroker *s, float x, float y)
+{
+	/* the output was sized beforehand, this only grows it if the estimate was too low */
+	if (!gdip_path_ensure_size (s->out, s->out->count + 1)) {
+		s->outOfMemory = TRUE;
+		return;
+	}
+
+	s->out->points [s->out->count].X = x;
+	s->out->points [s->out->count].Y = y;
+	s->out->types [s->out->count] = s->newFigure ? PathPointTypeStart : PathPointTypeLine;
+	s->out->count++;
+	s->newFigure = FALSE;
+}
+
+static void
+stroker_close (PathStroker *s)
+{
+	if (!s->newFigure && (s->out->count > 0))
+		s->out->types [s->out->count - 1] |= PathPointTypeCloseSubpath;
+	s->newFigure = TRUE;
+}
+
+/* number of segments needed to approximate an arc of the specified sweep */
+static int
+stroker_arc_segments (PathStroker *s, float sweep)
+{
+	float step;
+	int segments;
+
+	if (s->flatness < s->halfWidth)
+		step = 2 * acos (1 - s->flatness / s->halfWidth);
+	else
+		step = PI / 2;
+
+	segments = (int) ceil (fabs (sweep) / step);
+	return CLAMP (segments, 1, 64);
+}
+
+/* emits the arc points after the start angle, up to and including the end angle */
+static void
+stroker_arc (PathStroker *s, GpPointF center, float radius, float startAngle, float sweep)
+{
+	int i, segments = stroker_arc_segments (s, sweep);
+
+	for (i = 1; i <= segments; i++) {
+		float angle = startAngle + sweep * i / segments;
+
+		stroker_emit (s, center.X + radius * cos (angle), center.Y + radius * sin (angle));
+	}
+}
+
+/* offset of p, by the half width, on the left side of the (unit) direction d */
+static GpPointF
+stroker_offset (PathStroker *s, GpPointF p, GpPointF d)
+{
+	GpPointF result;
+
+	result.X = p.X - d.Y * s->halfWidth;
+	result.Y = p.Y + d.X * s->halfWidth;
+	return result;
+}
+
+/* emits the left side of the join at p between the incoming (d0) and outgoing (d1) directions */
+static void
+stroker_join (PathStroker *s, GpPointF p, GpPointF d0, GpPointF d1)
+{
+	GpPointF a = stroker_offset (s, p, d0);
+	GpPointF b = stroker_offset (s, p, d1);
+	float cross = d0.X * d1.Y - d0.Y * d1.X;
+	float dot = d0.X * d1.X + d0.Y * d1.Y;
+
+	/* (almost) straight line */
+	if ((fabs (cross) < 0.0001f) && (dot > 0)) {
+		stroker_emit (s, b.X, b.Y);
+		return;
+	}
+
+	stroker_emit (s, a.X, a.Y);
+
+	/* inner side of the join */
+	if (cross > 0) {
+		stroker_emit (s, p.X, p.Y);
+		stroker_emit (s, b.X, b.Y);
+		return;
+	}
+
+	switch (s->join) {
+	case LineJoinRound: {
+		float startAngle = atan2 (a.Y - p.Y, a.X - p.X);
+		float sweep = atan2 (cross, dot);
+
+		stroker_arc (s, p, s->halfWidth, startAngle, sweep);
+		return;
+	}
+	case LineJoinMiter:
+	case LineJoinMiterClipped: {
+		/* the miter length, relative to the half width, is 1 / cos (theta / 2) */
+		float ratio = (dot > -1) ? sqrt (2 / (1 + dot)) : FLT_MAX;
+
+		/* like cairo we fall back to a bevel beyond the miter limit */
+		if (ratio <= s->miterLimit) {
+			GpPointF m;
+
+			m.X = p.X - (d0.Y + d1.Y) * s->halfWidth / (1 + dot);
+			m.Y = p.Y + (d0.X + d1.X) * s->halfWidth / (1 + dot);
+			stroker_emit (s, m.X, m.Y);
+		}
+		break;
+	}
+	case LineJoinBevel:
+	default:
+		break;
+	}
+
+	stroker_emit (s, b.X, b.Y);
+}
+
+/* emits the cap at the end point p of direction d, from the left offset to the right offset */
+static void
+stroker_cap (PathStroker *s, GpPointF p, GpPointF d, GpLineCap cap, BOOL emitLast)
+{
+	GpPointF right;
+	float hw = s->halfWidth;
+
+	right.X = p.X + d.Y * hw;
+	right.Y = p.Y - d.X * hw;
+
+	switch (cap) {
+	case LineCapSquare:
+		stroker_emit (s, p.X - d.Y * hw + d.X * hw, p.Y + d.X * hw + d.Y * hw);
+		stroker_emit (s, right.X + d.X * hw, right.Y + d.Y * hw);
+		break;
+	case LineCapRound:
+		stroker_arc (s, p, hw, atan2 (d.X, -d.Y), -PI);
+		/* the arc already ended on the right offset */
+		return;
+	case LineCapTriangle:
+		stroker_emit (s, p.X + d.X * hw, p.Y + d.Y * hw);
+		break;
+	default:
+		/* flat, anchors (added as separate figures) and custom caps (drawn by the pen) */
+		break;
+	}
+
+	if (emitLast)
+		stroker_emit (s, right.X, right.Y);
+}
+
+/*
+ * anchor caps are centered on the end point and larger than the line, they turn the same way as the
+ * outlines so that the winding fill adds them up where they overlap
+ */
+static void
+stroker_anchor (PathStroker *s, GpPointF p, GpPointF d, GpLineCap cap)
+{
+	float size = s->halfWidth * 2;
+	GpPointF n, center;
+
+	n.X = -d.Y;
+	n.Y = d.X;
+
+	switch (cap) {
+	case LineCapSquareAnchor:
+		stroker_emit (s, p.X + (d.X + n.X) * size, p.Y + (d.Y + n.Y) * size);
+		stroker_emit (s, p.X + (d.X - n.X) * size, p.Y + (d.Y - n.Y) * size);
+		stroker_emit (s, p.X - (d.X + n.X) * size, p.Y - (d.Y + n.Y) * size);
+		stroker_emit (s, p.X + (-d.X + n.X) * size, p.Y + (-d.Y + n.Y) * size);
+		break;
+	case LineCapRoundAnchor:
+		stroker_emit (s, p.X + size, p.Y);
+		center = p;
+		stroker_arc (s, center, size, 0, -2 * PI);
+		break;
+	case LineCapDiamondAnchor:
+		stroker_emit (s, p.X + d.X * size, p.Y + d.Y * size);
+		stroker_emit (s, p.X - n.X * size, p.Y - n.Y * size);
+		stroker_emit (s, p.X - d.X * size, p.Y - d.Y * size);
+		stroker_emit (s, p.X + n.X * size, p.Y + n.Y * size);
+		break;
+	case LineCapArrowAnchor:
+		stroker_emit (s, p.X + d.X * size, p.Y + d.Y * size);
+		stroker_emit (s, p.X - d.X * size - n.X * size, p.Y - d.Y * size - n.Y * size);
+		stroker_emit (s, p.X - d.X * size + n.X * size, p.Y - d.Y * size + n.Y * size);
+		break;
+	default:
+		return;
+	}
+
+	stroker_close (s);
+}
+
+static GpPointF
+stroker_direction (GpPointF from, GpPointF to)
+{
+	GpPointF d;
+	float length = sqrt ((to.X - from.X) * (to.X - from.X) + (to.Y - from.Y) * (to.Y - from.Y));
+
+	d.X = (to.X - from.X) / length;
+	d.Y = (to.Y - from.Y) / length;
+	return d;
+}
+
+static GpPointF
+stroker_reverse (GpPointF d)
+{
+	d.X = -d.X;
+	d.Y = -d.Y;
+	return d;
+}
+
+/* strokes a polyline without consecutive duplicate points (nor a duplicated closing point) */
+static void
+stroker_polyline (PathStroker *s, const GpPointF *pts, int n, BOOL closed, GpLineCap startCap, GpLineCap endCap)
+{
+	GpPointF start, end;
+	int i;
+
+	if (n < 2)
+		return;
+
+	if (closed && (n > 2)) {
+		/* outer loop, then the inner loop in the opposite direction */
+		for (i = 0; i < n; i++)
+			stroker_join (s, pts [i], stroker_direction (pts [(i + n - 1) % n], pts [i]), stroker_direction (pts [i], pts [(i + 1) % n]));
+		stroker_close (s);
+
+		for (i = n - 1; i >= 0; i--)
+			stroker_join (s, pts [i], stroker_direction (pts [(i + 1) % n], pts [i]), stroker_direction (pts [i], pts [(i + n - 1) % n]));
+		stroker_close (s);
+		return;
+	}
+
+	start = stroker_direction (pts [0], pts [1]);
+	end = stroker_direction (pts [n - 2], pts [n - 1]);
+
+	/* left side */
+	start = stroker_offset (s, pts [0], start);
+	stroker_emit (s, start.X, start.Y);
+	for (i = 1; i < n - 1; i++)
+		stroker_join (s, pts [i], stroker_direction (pts [i - 1], pts [i]), stroker_direction (pts [i], pts [i + 1]));
+	start = stroker_offset (s, pts [n - 1], end);
+	stroker_emit (s, start.X, start.Y);
+	stroker_cap (s, pts [n - 1], end, endCap, TRUE);
+
+	/* right side */
+	for (i = n - 2; i > 0; i--)
+		stroker_join (s, pts [i], stroker_direction (pts [i + 1], pts [i]), stroker_direction (pts [i], pts [i - 1]));
+	start = stroker_reverse (stroker_direction (pts [0], pts [1]));
+	end = stroker_offset (s, pts [0], start);
+	stroker_emit (s, end.X, end.Y);
+	stroker_cap (s, pts [0], start, startCap, FALSE);
+	stroker_close (s);
+
+	stroker_anchor (s, pts [0], start, startCap);
+	stroker_anchor (s, pts [n - 1], stroker_direction (pts [n - 2], pts [n - 1]), endCap);
+}
+
+static void
+stroker_dash_append (GpPointF *dash, int *count, GpPointF pt)
+{
+	if ((*count == 0) || (dash [*count - 1].X != pt.X) || (dash [*count - 1].Y != pt.Y))
+		dash [(*count)++] = pt;
+}
+
+/* splits a figure into dashes, each one stroked as its own polyline */
+static void
+stroker_dashes (PathStroker *s, GpPen *pen, const GpPointF *pts, int n, BOOL closed, GpPointF *dash)
+{
+	float width = s->halfWidth * 2;
+	int segments = closed ? n : n - 1;
+	int index = 0, count = 0, i;
+	float remaining, offset;
+	BOOL on = TRUE, atStart = TRUE;
+	float total = 0;
+
+	for (i = 0; i < pen->dash_count; i++)
+		total += pen->dash_array [i] * width;
+	if (total <= 0) {
+		stroker_polyline (s, pts, n, closed, pen->line_cap, pen->end_cap);
+		return;
+	}
+
+	/* skip the dash offset (in units of the pen width, like GDI+) */
+	offset = fmod (pen->dash_offset * width, total);
+	if (offset < 0)
+		offset += total;
+	remaining = pen->dash_array [0] * width;
+	while (offset >= remaining) {
+		offset -= remaining;
+		index = (index + 1) % pen->dash_count;
+		remaining = pen->dash_array [index] * width;
+		on = !on;
+	}
+	remaining -= offset;
+
+	if (on)
+		stroker_dash_append (dash, &count, pts [0]);
+
+	for (i = 0; i < segments; i++) {
+		GpPointF p0 = pts [i];
+		GpPointF p1 = pts [(i + 1) % n];
+		float length = sqrt ((p1.X - p0.X) * (p1.X - p0.X) + (p1.Y - p0.Y) * (p1.Y - p0.Y));
+		float position = 0;
+
+		while (length - position > remaining) {
+			GpPointF split;
+
+			position += remaining;
+			split.X = p0.X + (p1.X - p0.X) * position / length;
+			split.Y = p0.Y + (p1.Y - p0.Y) * position / length;
+
+			stroker_dash_append (dash, &count, split);
+			if (on) {
+				stroker_polyline (s, dash, count, FALSE, (atStart && !closed) ? pen->line_cap : (GpLineCap) pen->dash_cap, (GpLineCap) pen->dash_cap);
+				count = 0;
+				atStart = FALSE;
+			}
+
+			on = !on;
+			index = (index + 1) % pen->dash_count;
+			remaining = pen->dash_array [index] * width;
+		}
+
+		remaining -= length - position;
+		if (on)
+			stroker_dash_append (dash, &count, p1);
+	}
+
+	if (on && (count > 1))
+		stroker_polyline (s, dash, count, FALSE, (atStart && !closed) ? pen->line_cap : (GpLineCap) pen->dash_cap, closed ? (GpLineCap) pen->dash_cap : pen->end_cap);
+}
+
+/* MonoTODO - the pen's transform, alignment and compound array are ignored */
+GpStatus WINGDIPAPI 
+GdipWidenPath (GpPath *nativePath, GpPen *pen, GpMatrix *matrix, float flatness)
+{
+	GpStatus status;
+	GpPath *widened;
+	GpPointF *figure, *dash;
+	PathStroker s;
+	int i, start, estimate;
+
+	if (!nativePath || !pen)
+		return InvalidParameter;
+
+	/* (0) is deal within System.Drawing */
+	/* (1) for compatibility with MS GDI+ (reported as FDBK49685) */
+	if (nativePath->count <= 1)
+		return OutOfMemory;
+
+	status = gdip_prepare_path (nativePath, matrix, flatness);
+	if (status != Ok)
+		return status;
+
+	/* the sides of consecutive segments overlap on the inner side of the joins, as the caps of close dashes do */
+	status = GdipCreatePath (FillModeWinding, &widened);
+	if (status != Ok)
+		return status;
+
+	/* we draw a pixel wide line if the width is < 1.0 */
+	s.out = widened;
+	s.halfWidth = ((pen->width < 1.0f) ? 1.0f : pen->width) / 2;
+	s.flatness = (flatness > 0) ? flatness : 0.25f;
+	s.join = pen->line_join;
+	s.miterLimit = pen->miter_limit;
+	s.newFigure = TRUE;
+	s.outOfMemory = FALSE;
+
+	/* both sides of each point, with room for round joins, plus the caps */
+	estimate = stroker_arc_segments (&s, PI) + 2;
+	estimate = 2 * (nativePath->count + 2) * ((s.join == LineJoinRound) ? estimate : 3) + 2 * estimate + 8;
+	figure = GdipAlloc (sizeof (GpPointF) * (nativePath->count + 1));
+	dash = GdipAlloc (sizeof (GpPointF) * (nativePath->count + 3));
+	if (!figure || !dash || !gdip_path_ensure_size (widened, estimate)) {
+		GdipFree (figure);
+		GdipFree (dash);
+		GdipDeletePath (widened);
+		return OutOfMemory;
+	}
+
+	/* single pass over the flattened figures */
+	for (start = 0; start < nativePath->count; start = i) {
+		BOOL closed;
+		int n = 0;
+
+		for (i = start; i < nativePath->count; i++) {
+			GpPointF pt = nativePath->points [i];
+
+			if ((i > start) && ((nativePath->types [i] & PathPointTypePathTypeMask) == PathPointTypeStart))
+				break;
+
+			/* drop duplicated points, they have no direction */
+			if ((n == 0) || (figure [n - 1].X != pt.X) || (figure [n - 1].Y != pt.Y))
+				figure [n++] = pt;
+		}
+
+		closed = (nativePath->types [i - 1] & PathPointTypeCloseSubpath) != 0;
+		if (closed && (n > 1) && (figure [0].X == figure [n - 1].X) && (figure [0].Y == figure [n - 1].Y))
+			n--;
+
+		if (pen->dash_count > 0)
+			stroker_dashes (&s, pen, figure, n, closed, dash);
+		else
+			stroker_polyline (&s, figure, n, closed, pen->line_cap, pen->end_cap);
+	}
+
+	GdipFree (figure);
+	GdipFree (dash);
+
+	if (s.outOfMemory) {
+		GdipDeletePath (widened);
+		return OutOfMemory;
+	}
+
+	/* replace the original path with its outline */
+	gdip_path_invalidate (nativePath);
+	GdipFree (nativePath->points);
+	GdipFree (nativePath->types);
+	nativePath->points = widened->points;
+	nativePath->types = widened->types;
+	nativePath->count = widened->count;
+	nativePath->size = widened->size;
+	nativePath->fill_mode = widened->fill_mode;
+	nativePath->start_new_fig = TRUE;
+	GdipFree (widened);
+
+	return Ok;
+}
+
+/*
+ * Maps the unit square onto the quadrilateral q (upper-left, upper-right, lower-left, lower-right)
+ * with the homography m, where X = (m0 u + m1 v + m2) / (m6 u + m7 v + 1) and
+ * Y = (m3 u + m4 v + m5) / (m6 u + m7 v + 1) - see Heckbert's "Fundamentals of Texture Mapping"
+ */
+static void
+gdip_warp_square_to_quad (const GpPointF *q, double *m)
+{
+	double sx = q[0].X - q[1].X + q[3].X - q[2].X;
+	double sy = q[0].Y - q[1].Y + q[3].Y - q[2].Y;
+	double dx1 = q[1].X - q[3].X, dx2 = q[2].X - q[3].X;
+	double dy1 = q[1].Y - q[3].Y, dy2 = q[2].Y - q[3].Y;
+	double den = dx1 * dy2 - dx2 * dy1;
+
+	/* a parallelogram (or a degenerated quadrilateral) only needs an affine transform */
+	if (((sx == 0) && (sy == 0)) || (den == 0)) {
+		m[6] = m[7] = 0;
+	} else {
+		m[6] = (sx * dy2 - sy * dx2) / den;
+		m[7] = (dx1 * sy - dy1 * sx) / den;
+	}
+
+	m[0] = q[1].X - q[0].X + m[6] * q[1].X;
+	m[1] = q[2].X - q[0].X + m[7] * q[2].X;
+	m[2] = q[0].X;
+	m[3] = q[1].Y - q[0].Y + m[6] * q[1].Y;
+	m[4] = q[2].Y - q[0].Y + m[7] * q[2].Y;
+	m[5] = q[0].Y;
+}
+
+/* u = (x - srcx) / srcwidth and v = (y - srcy) / srcheight are folded into the coefficients */
+static void
+gdip_warp_perspective (GpPointF *points, int count, const double *m)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		double u = points [i].X, v = points [i].Y;
+		double w = 1.0 / (m[6] * u + m[7] * v + m[8]);
+
+		points [i].X = (m[0] * u + m[1] * v + m[2]) * w;
+		points [i].Y = (m[3] * u + m[4] * v + m[5]) * w;
+	}
+}
+
+/* P (u, v) = P0 + u (P1 - P0) + v (P2 - P0) + u v (P0 - P1 - P2 + P3) */
+static void
+gdip_warp_bilinear (GpPointF *points, int count, const GpPointF *q, float srcx, float srcy, float srcwidth, float srcheight)
+{
+	double ax = q[0].X, bx = q[1].X - q[0].X, cx = q[2].X - q[0].X, dx = q[0].X - q[1].X - q[2].X + q[3].X;
+	double ay = q[0].Y, by = q[1].Y - q[0].Y, cy = q[2].Y - q[0].Y, dy = q[0].Y - q[1].Y - q[2].Y + q[3].Y;
+	double su = 1.0 / srcwidth, sv = 1.0 / srcheight;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		double u = (points [i].X - srcx) * su;
+		double v = (points [i].Y - srcy) * sv;
+
+		points [i].X = ax + bx * u + cx * v + dx * u * v;
+		points [i].Y = ay + by * u + cy * v + dy * u * v;
+	}
+}
+
+GpStatus WINGDIPAPI 
+GdipWarpPath (GpPath *path, GpMatrix *matrix, const GpPointF *points, int count, 
+		float srcx, float srcy, float srcwidth, float srcheight,
+		WarpMode warpMode, float flatness)
+{
+	GpStatus status;
+	GpPointF quad [4];
+
+	if (!path || !points || (count < 1))
+		return InvalidParameter;
+
+	/* quick out */
+	if (path->count == 0)
+		return Ok;
+
+	/* an invalid warp mode resets the current path */
+	/* a path with a single point will reset it too */
+	if (((warpMode != WarpModePerspective) && (warpMode != WarpModeBilinear)) || (path->count == 1))
+		return GdipResetPath (path);
+
+	status = gdip_prepare_path (path, matrix, flatness);
+	if (status != Ok)
+		return status;
+
+	/* an empty source rectangle is replaced by the path bounds */
+	if ((srcwidth == 0) || (srcheight == 0)) {
+		GpRectF bounds;
+
+		GdipGetPathWorldBounds (path, &bounds, NULL, NULL);
+		srcx = bounds.X;
+		srcy = bounds.Y;
+		srcwidth = (bounds.Width == 0) ? 1.0f : bounds.Width;
+		srcheight = (bounds.Height == 0) ? 1.0f : bounds.Height;
+	}
+
+	/* missing destination points complete a parallelogram, the source rectangle being moved */
+	quad [0] = points [0];
+	if (count > 1) {
+		quad [1] = points [1];
+	} else {
+		quad [1].X = quad [0].X + srcwidth;
+		quad [1].Y = quad [0].Y;
+	}
+	if (count > 2) {
+		quad [2] = points [2];
+	} else {
+		quad [2].X = quad [0].X;
+		quad [2].Y = quad [0].Y + srcheight;
+	}
+	if (count > 3) {
+		quad [3] = points [3];
+	} else {
+		quad [3].X = quad [1].X + quad [2].X - quad [0].X;
+		quad [3].Y = quad [1].Y + quad [2].Y - quad [0].Y;
+	}
+
+	gdip_path_invalidate (path);
+
+	if (warpMode == WarpModePerspective) {
+		double square [8], m [9];
+		double su = 1.0 / srcwidth, sv = 1.0 / srcheight;
+		int i;
+
+		gdip_warp_square_to_quad (quad, square);
+
+		/* fold the normalization of the source rectangle into the homography */
+		for (i = 0; i < 3; i++) {
+			double a = (i < 2) ? square [i * 3] : square [6];
+			double b = (i < 2) ? square [i * 3 + 1] : square [7];
+			double c = (i < 2) ? square [i * 3 + 2] : 1.0;
+
+			m [i * 3] = a * su;
+			m [i * 3 + 1] = b * sv;
+			m [i * 3 + 2] = c - a * srcx * su - b * srcy * sv;
+		}
+
+		gdip_warp_perspective (path->points, path->count, m);
+	} else {
+		gdip_warp_bilinear (path->points, path->count, quad, srcx, srcy, srcwidth, srcheight);
+	}
+
+	return Ok;
+}
+
+GpStatus WINGDIPAPI 
+GdipTransformPath (GpPath* path, GpMatrix *matrix)
+{
+	if (!path)
+		return InvalidParameter;
+
+	if (path->count == 0)
+		return Ok; /* GdipTransformMatrixPoints would fail */
+
+	/* avoid allocation/free/calculation for null/identity matrix */
+	if (gdip_is_matrix_empty (matrix))
+		return Ok;
+
+	gdip_path_invalidate (path);
+	return GdipTransformMatrixPoints (matrix, path->points, path->count);
+}
+
+typedef struct {
+	float minX, minY, maxX, maxY;
+} PathBounds;
+
+static void
+bounds_extend (PathBounds *b, float x, float y)
+{
+	if (x < b->minX)
+		b->minX = x;
+	if (x > b->maxX)
+		b->maxX = x;
+	if (y < b->minY)
+		b->minY = y;
+	if (y > b->maxY)
+		b->maxY = y;
+}
+
+static GpPointF
+bounds_point (GpPath *path, int i, const GpMatrix *matrix)
+{
+	GpPointF pt = path->points [i];
+
+	if (matrix) {
+		double x = pt.X, y = pt.Y;
+
+		cairo_matrix_transform_point (matrix, &x, &y);
+		pt.X = x;
+		pt.Y = y;
+	}
+	return pt;
+}
+
+static void
+bounds_bezier_at (PathBounds *b, const GpPointF *p, double t)
+{
+	double mt = 1 - t;
+	double c0 = mt * mt * mt, c1 = 3 * mt * mt * t, c2 = 3 * mt * t * t, c3 = t * t * t;
+
+	bounds_extend (b, c0 * p[0].X + c1 * p[1].X + c2 * p[2].X + c3 * p[3].X,
+		c0 * p[0].Y + c1 * p[1].Y + c2 * p[2].Y + c3 * p[3].Y);
+}
+
+/* a bezier axis can only extend past its end points where its derivative is zero */
+static void
+bounds_bezier_axis (PathBounds *b, const GpPointF *p, double p0, double p1, double p2, double p3)
+{
+	double a = p3 - 3 * p2 + 3 * p1 - p0;
+	double c = p1 - p0;
+	double bb = 2 * (p2 - 2 * p1 + p0);
+	double low = MIN (p0, p3), high = MAX (p0, p3);
+
+	/* control points within the end points range: the curve is too */
+	if ((p1 >= low) && (p1 <= high) && (p2 >= low) && (p2 <= high))
+		return;
+
+	if (fabs (a) < 1e-12) {
+		if (fabs (bb) > 1e-12) {
+			double t = -c / bb;
+			if ((t > 0) && (t < 1))
+				bounds_bezier_at (b, p, t);
+		}
+	} else {
+		double discriminant = bb * bb - 4 * a * c;
+
+		if (discriminant >= 0) {
+			double root = sqrt (discriminant);
+			double t1 = (-bb + root) / (2 * a);
+			double t2 = (-bb - root) / (2 * a);
+
+			if ((t1 > 0) && (t1 < 1))
+				bounds_bezier_at (b, p, t1);
+			if ((t2 > 0) && (t2 < 1))
+				bounds_bezier_at (b, p, t2);
+		}
+	}
+}
+
+/* true if a unit direction from -> to exists (i.e. the points are distinct) */
+static BOOL
+bounds_direction (GpPointF from, GpPointF to, GpPointF *d)
+{
+	float dx = to.X - from.X, dy = to.Y - from.Y;
+	float length = sqrt (dx * dx + dy * dy);
+
+	if (length < 0.0001f)
+		return FALSE;
+
+	d->X = dx / length;
+	d->Y = dy / length;
+	return TRUE;
+}
+
+/* extent of the cap (d points away from the line) past the half width box of its end point */
+static void
+bounds_cap (PathBounds *b, GpPointF p, GpPointF d, GpLineCap cap, float hw)
+{
+	/* anchors are sized like in GdipWidenPath */
+	float size = hw * 2;
+	GpPointF n;
+
+	n.X = -d.Y;
+	n.Y = d.X;
+
+	switch (cap) {
+	case LineCapSquare:
+		bounds_extend (b, p.X + (d.X + n.X) * hw, p.Y + (d.Y + n.Y) * hw);
+		bounds_extend (b, p.X + (d.X - n.X) * hw, p.Y + (d.Y - n.Y) * hw);
+		break;
+	case LineCapSquareAnchor:
+		bounds_extend (b, p.X + (d.X + n.X) * size, p.Y + (d.Y + n.Y) * size);
+		bounds_extend (b, p.X + (d.X - n.X) * size, p.Y + (d.Y - n.Y) * size);
+		bounds_extend (b, p.X - (d.X + n.X) * size, p.Y - (d.Y + n.Y) * size);
+		bounds_extend (b, p.X - (d.X - n.X) * size, p.Y - (d.Y - n.Y) * size);
+		break;
+	case LineCapRoundAnchor:
+		bounds_extend (b, p.X - size, p.Y - size);
+		bounds_extend (b, p.X + size, p.Y + size);
+		break;
+	case LineCapDiamondAnchor:
+		bounds_extend (b, p.X + d.X * size, p.Y + d.Y * size);
+		bounds_extend (b, p.X - d.X * size, p.Y - d.Y * size);
+		bounds_extend (b, p.X + n.X * size, p.Y + n.Y * size);
+		bounds_extend (b, p.X - n.X * size, p.Y - n.Y * size);
+		break;
+	case LineCapArrowAnchor:
+		bounds_extend (b, p.X + d.X * size, p.Y + d.Y * size);
+		bounds_extend (b, p.X + (n.X - d.X) * size, p.Y + (n.Y - d.Y) * size);
+		bounds_extend (b, p.X - (n.X + d.X) * size, p.Y - (n.Y + d.Y) * size);
+		break;
+	default:
+		/* flat, round and triangle caps stay within the half width, custom caps are ignored */
+		break;
+	}
+}
+
+/* miter joins are the only ones that can extend past the half width */
+static void
+bounds_join (PathBounds *b, GpPointF p, GpPointF d0, GpPointF d1, float hw, float miterLimit)
+{
+	float cross = d0.X * d1.Y - d0.Y * d1.X;
+	float dot = d0.X * d1.X + d0.Y * d1.Y;
+	float ratio, side;
+
+	if ((fabs (cross) < 0.0001f) && (dot > 0))
+		return;
+
+	/* GdipWidenPath falls back to a bevel beyond the miter limit */
+	ratio = (dot > -1) ? sqrt (2 / (1 + dot)) : FLT_MAX;
+	if (ratio > miterLimit)
+		return;
+
+	/* the miter is on the outer side of the turn */
+	side = (cross > 0) ? -hw : hw;
+	bounds_extend (b, p.X - (d0.Y + d1.Y) * side / (1 + dot), p.Y + (d0.X + d1.X) * side / (1 + dot));
+}
+
+/* index of the closest point, in the figure [start, end], distinct from the vertex v in direction step */
+static int
+bounds_neighbour (GpPath *path, const GpMatrix *matrix, int v, GpPointF pv, int start, int end, BOOL closed, int step, GpPointF *d)
+{
+	int i = v;
+
+	while (TRUE) {
+		i += step;
+		if ((i < start) || (i > end)) {
+			if (!closed)
+				return -1;
+			i = (i < start) ? end : start;
+		}
+		if (i == v)
+			return -1;
+		if (step > 0) {
+			if (bounds_direction (pv, bounds_point (path, i, matrix), d))
+				return i;
+		} else {
+			if (bounds_direction (bounds_point (path, i, matrix), pv, d))
+				return i;
+		}
+	}
+}
+
+static void
+bounds_stroke_figure (GpPath *path, const GpMatrix *matrix, const GpPen *pen, float hw, int start, int end, PathBounds *b)
+{
+	BOOL closed = (path->types [end] & PathPointTypeCloseSubpath) == PathPointTypeCloseSubpath;
+	int i;
+
+	for (i = start; i <= end; i++) {
+		GpPointF p, d0, d1;
+		BOOL hasPrevious, hasNext;
+
+		/* only the end points of the beziers are vertices */
+		if ((path->types [i] & PathPointTypePathTypeMask) == PathPointTypeBezier) {
+			i += 2;
+			if (i > end)
+				break;
+		}
+
+		p = bounds_point (path, i, matrix);
+		hasPrevious = bounds_neighbour (path, matrix, i, p, start, end, closed, -1, &d0) >= 0;
+		hasNext = bounds_neighbour (path, matrix, i, p, start, end, closed, 1, &d1) >= 0;
+
+		if (hasPrevious && hasNext) {
+			if ((pen->line_join == LineJoinMiter) || (pen->line_join == LineJoinMiterClipped))
+				bounds_join (b, p, d0, d1, hw, pen->miter_limit);
+		} else if (hasNext) {
+			d1.X = -d1.X;
+			d1.Y = -d1.Y;
+			bounds_cap (b, p, d1, pen->line_cap, hw);
+		} else if (hasPrevious) {
+			bounds_cap (b, p, d0, pen->end_cap, hw);
+		}
+	}
+}
+
+/* bounds are computed without flattening: beziers are bounded by the roots of their derivative */
+GpStatus WINGDIPAPI
+GdipGetPathWorldBounds (GpPath *path, GpRectF *bounds, const GpMatrix *matrix, const GpPen *pen)
+{
+	PathBounds b;
+	GpPointF p [4];
+	int i;
+
+	if (!path || !bounds)
+		return InvalidParameter;
+
+	// Paths with zero or one points are empty.
+	if (path->count <= 1) {
+		bounds->X = 0.0f;
+		bounds->Y = 0.0f;
+		bounds->Width = 0.0f;
+		bounds->Height = 0.0f;
+		return Ok;
+	}
+
+	p [3] = bounds_point (path, 0, matrix);
+	b.minX = b.maxX = p [3].X;
+	b.minY = b.maxY = p [3].Y;
+
+	for (i = 1; i < path->count; i++) {
+		/* PathPointTypeBezier3 has the same value as PathPointTypeBezier */
+		if (((path->types [i] & PathPointTypePathTypeMask) == PathPointTypeBezier) && (i + 2 < path->count)) {
+			p [0] = p [3];
+			p [1] = bounds_point (path, i, matrix);
+			p [2] = bounds_point (path, i + 1, matrix);
+			p [3] = bounds_point (path, i + 2, matrix);
+			bounds_extend (&b, p [3].X, p [3].Y);
+			bounds_bezier_axis (&b, p, p [0].X, p [1].X, p [2].X, p [3].X);
+			bounds_bezier_axis (&b, p, p [0].Y, p [1].Y, p [2].Y, p [3].Y);
+			i += 2;
+		} else {
+			p [3] = bounds_point (path, i, matrix);
+			bounds_extend (&b, p [3].X, p [3].Y);
+		}
+	}
+
+	if (pen) {
+		/* in calculation the pen's width is at least 1.0 */
+		float halfw = ((pen->width < 1.0f) ? 1.0f : pen->width) / 2;
+		int start = 0;
+
+		b.minX -= halfw;
+		b.minY -= halfw;
+		b.maxX += halfw;
+		b.maxY += halfw;
+
+		/* miters and caps can extend further */
+		for (i = 1; i <= path->count; i++) {
+			if ((i == path->count) || ((path->types [i] & PathPointTypePathTypeMask) == PathPointTypeStart)) {
+				bounds_stroke_figure (path, matrix, pen, halfw, start, i - 1, &b);
+				start = i;
+			}
+		}
+	}
+
+	bounds->X = b.minX;
+	bounds->Y = b.minY;
+	bounds->Width = b.maxX - b.minX;
+	bounds->Height = b.maxY - b.minY;
+	return Ok;
 }
 
 GpStatus WINGDIPAPI 
-GdipIsOutlineVisiblePathPoint (GpPath *path, float x, float y, GpPen *pen, GpGraphics *graphics, BOOL *result)
+GdipGetPathWorldBoundsI (GpPath *path, GpRect *bounds, const GpMatrix *matrix, const GpPen *pen)
 {
-	GpStatus status = Ok;
-	cairo_surface_t* s = NULL;
-	GpGraphics *g;
-	GpUnit page_unit = UnitPixel;
+	GpRectF rect;
+	GpStatus status;
 
-	if (!path || !pen || !result)
+	if (!path || !bounds)
 		return InvalidParameter;
 
-	if (graphics) {
-		g = graphics;
-		cairo_save (graphics->ct);
-		page_unit = g->page_unit;
-	} else {
-		/* create a temporary context */
-		s = cairo_image_surface_create (CAIRO_FORMAT_A1, 1, 1);
-		g = gdip_graphics_new (s);
-	}
-
-	cairo_new_path (g->ct);
-	/* unit tests shows that PageUnit isn't consireded (well x, y are probably considered to be the same unit format ) */
-	g->page_unit = UnitPixel;
-	status = gdip_plot_path (g, path, FALSE);
-	if (status == Ok) {
-		/* we must fight around cairo AA */
-		cairo_set_antialias (g->ct, CAIRO_ANTIALIAS_NONE);
-		cairo_set_line_width (g->ct, pen->width - CAIRO_AA_OFFSET_Y);
-		*result = cairo_in_stroke (g->ct, x, y);
+	status = GdipGetPathWorldBounds (path, &rect, matrix, pen);
+	if (status != Ok)
+		return status;	
+
+	bounds->X = (int) rect.X;
+	bounds->Y = (int) rect.Y;
+	bounds->Width = (int) rect.Width;
+	bounds->Height = (int) rect.Height;
+	return Ok;
+}
+
+static void
+append_edge (PathEdges *edges, GpPointF start, GpPointF end, BOOL stroked, BOOL join)
+{
+	PathEdge *edge = &edges->edges [edges->count++];
+
+	edge->x0 = start.X;
+	edge->y0 = start.Y;
+	edge->x1 = end.X;
+	edge->y1 = end.Y;
+	edge->stroked = stroked;
+	edge->join = join;
+}
+
+/* flatten the path once and keep its edges (and bounds) until the path is modified */
+static GpStatus
+gdip_path_get_edges (GpPath *path, PathEdges **result)
+{
+	GpStatus status;
+	GpPath *flat;
+	PathEdges *edges;
+	int i, start;
+
+	if (path->edges) {
+		*result = path->edges;
+		return Ok;
+	}
+
+	status = GdipClonePath (path, &flat);
+	if (status != Ok)
+		return status;
+
+	status = GdipFlattenPath (flat, NULL, PATH_EDGES_FLATNESS);
+	if (status != Ok) {
+		GdipDeletePath (flat);
+		return status;
+	}
+
+	edges = (PathEdges *) GdipAlloc (sizeof (PathEdges));
+	if (!edges) {
+		GdipDeletePath (flat);
+		return OutOfMemory;
+	}
+
+	/* each point starts at most one edge, plus the closing edge of each figure */
+	edges->count = 0;
+	edges->edges = (PathEdge *) GdipAlloc (sizeof (PathEdge) * (flat->count + 1));
+	if (!edges->edges) {
+		GdipFree (edges);
+		GdipDeletePath (flat);
+		return OutOfMemory;
+	}
+
+	if (flat->count > 0) {
+		edges->minX = edges->maxX = flat->points [0].X;
+		edges->minY = edges->maxY = flat->points [0].Y;
 	} else {
+		edges->minX = edges->maxX = edges->minY = edges->maxY = 0;
+	}
+
+	for (start = 0; start < flat->count; start = i) {
+		BOOL closed;
+		int first = edges->count;
+
+		for (i = start + 1; (i < flat->count) && ((flat->types [i] & PathPointTypePathTypeMask) != PathPointTypeStart); i++)
+			append_edge (edges, flat->points [i - 1], flat->points [i], TRUE, i > start + 1);
+
+		/* filling always closes the figure, stroking only if it was closed */
+		closed = (flat->types [i - 1] & PathPointTypeCloseSubpath) != 0;
+		if (i - 1 > start) {
+			append_edge (edges, flat->points [i - 1], flat->points [start], closed, closed);
+			if (closed)
+				edges->edges [first].join = TRUE;
+		}
+	}
+
+	for (i = 1; i < flat->count; i++) {
+		GpPointF pt = flat->points [i];
+
+		if (pt.X < edges->minX)
+			edges->minX = pt.X;
+		else if (pt.X > edges->maxX)
+			edges->maxX = pt.X;
+		if (pt.Y < edges->minY)
+			edges->minY = pt.Y;
+		else if (pt.Y > edges->maxY)
+			edges->maxY = pt.Y;
+	}
+
+	GdipDeletePath (flat);
+	path->edges = edges;
+	*result = edges;
+	return Ok;
+}
+
+static BOOL
+point_on_edge (const PathEdge *edge, float x, float y)
+{
+	float dx = edge->x1 - edge->x0;
+	float dy = edge->y1 - edge->y0;
+
+	if ((x < MIN (edge->x0, edge->x1)) || (x > MAX (edge->x0, edge->x1)) ||
+	    (y < MIN (edge->y0, edge->y1)) || (y > MAX (edge->y0, edge->y1)))
+		return FALSE;
+
+	return fabs (dx * (y - edge->y0) - dy * (x - edge->x0)) <= 0.0001f * (fabs (dx) + fabs (dy));
+}
+
+/* winding number (or crossing parity) test, points on an edge are inside (like cairo_in_fill) */
+static BOOL
+gdip_path_edges_contain (const PathEdges *edges, FillMode fillMode, float x, float y)
+{
+	int i, winding = 0;
+
+	if ((x < edges->minX) || (x > edges->maxX) || (y < edges->minY) || (y > edges->maxY))
+		return FALSE;
+
+	for (i = 0; i < edges->count; i++) {
+		const PathEdge *edge = &edges->edges [i];
+
+		if (point_on_edge (edge, x, y))
+			return TRUE;
+
+		/* half-open on y so that a vertex is only counted once */
+		if ((edge->y0 <= y) != (edge->y1 <= y)) {
+			float ix = edge->x0 + (y - edge->y0) * (edge->x1 - edge->x0) / (edge->y1 - edge->y0);
+
+			if (ix > x)
+				winding += (edge->y1 > edge->y0) ? 1 : -1;
+		}
+	}
+
+	return (fillMode == FillModeAlternate) ? (winding & 1) : (winding != 0);
+}
+
+/* butt caps and round joins, which is close enough for hit-testing */
+static BOOL
+gdip_path_edges_stroke_contain (const PathEdges *edges, float halfWidth, float x, float y)
+{
+	float hw2 = halfWidth * halfWidth;
+	int i;
+
+	if ((x < edges->minX - halfWidth) || (x > edges->maxX + halfWidth) ||
+	    (y < edges->minY - halfWidth) || (y > edges->maxY + halfWidth))
+		return FALSE;
+
+	for (i = 0; i < edges->count; i++) {
+		const PathEdge *edge = &edges->edges [i];
+		float dx, dy, px, py, length2, t;
+
+		if (!edge->stroked)
+			continue;
+
+		px = x - edge->x0;
+		py = y - edge->y0;
+		if (edge->join && (px * px + py * py <= hw2))
+			return TRUE;
+
+		dx = edge->x1 - edge->x0;
+		dy = edge->y1 - edge->y0;
+		length2 = dx * dx + dy * dy;
+		if (length2 == 0)
+			continue;
+
+		t = (px * dx + py * dy) / length2;
+		if ((t >= 0) && (t <= 1)) {
+			float cross = px * dy - py * dx;
+
+			if (cross * cross <= hw2 * length2)
+				return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/*
+ * Hit-testing doesn't depend on the graphics (x, y are in the same unit as the path, the
+ * page unit isn't considered) so we don't need to go through cairo at all.
+ */
+GpStatus WINGDIPAPI 
+GdipIsVisiblePathPoint (GpPath *path, float x, float y, GpGraphics *graphics, BOOL *result)
+{
+	GpStatus status;
+	PathEdges *edges;
+
+	if (!path || !result)
+		return InvalidParameter;
+
+	status = gdip_path_get_edges (path, &edges);
+	if (status != Ok) {
 		*result = FALSE;
+		return status;
 	}
 
-	if (graphics) {
-		/* restore GpGraphics to original state */
-		cairo_restore (graphics->ct);
-		g->page_unit = page_unit;
-	} else {
-		/* delete temporary context */
-		cairo_surface_destroy (s);
-		GdipDeleteGraphics (g);
+	/* keep the sampling position previously used with cairo_in_fill */
+	*result = gdip_path_edges_contain (edges, path->fill_mode, x + 1.0 /* CAIRO_AA_OFFSET_X */, y + CAIRO_AA_OFFSET_Y);
+	return Ok;
+}
+
+GpStatus WINGDIPAPI 
+GdipIsVisiblePathPointI (GpPath *path, int x, int y, GpGraphics *graphics, BOOL *result)
+{
+	return GdipIsVisiblePathPoint (path, x, y, graphics, result);
+}
+
+GpStatus WINGDIPAPI
+GdipIsVisiblePathPoints_linux (GpPath *path, GDIPCONST GpPointF *points, INT count, BOOL *results)
+{
+	GpStatus status;
+	PathEdges *edges;
+	int i;
+
+	if (!path || !points || !results || (count < 0))
+		return InvalidParameter;
+
+	status = gdip_path_get_edges (path, &edges);
+	if (status != Ok)
+		return status;
+
+	for (i = 0; i < count; i++)
+		results [i] = gdip_path_edges_contain (edges, path->fill_mode, points [i].X + 1.0, points [i].Y + CAIRO_AA_OFFSET_Y);
+
+	return Ok;
+}
+
+GpStatus WINGDIPAPI
+GdipIsVisiblePathsPoint_linux (GpPath **paths, INT count, REAL x, REAL y, BOOL *results)
+{
+	GpStatus status;
+	int i;
+
+	if (!paths || !results || (count < 0))
+		return InvalidParameter;
+
+	for (i = 0; i < count; i++) {
+		status = GdipIsVisiblePathPoint (paths [i], x, y, NULL, &results [i]);
+		if (status != Ok)
+			return status;
 	}
 
-	return status;
+	return Ok;
+}
+
+GpStatus WINGDIPAPI 
+GdipIsOutlineVisiblePathPoint (GpPath *path, float x, float y, GpPen *pen, GpGraphics *graphics, BOOL *result)
+{
+	GpStatus status;
+	PathEdges *edges;
+	float halfWidth;
+
+	if (!path || !pen || !result)
+		return InvalidParameter;
+
+	status = gdip_path_get_edges (path, &edges);
+	if (status != Ok) {
+		*result = FALSE;
+		return status;
+	}
+
+	/* the same (AA compensated) width that was previously given to cairo_in_stroke */
+	halfWidth = (pen->width - CAIRO_AA_OFFSET_Y) / 2;
+	*result = (halfWidth > 0) && gdip_path_edges_stroke_contain (edges, halfWidth, x, y);
+	return Ok;
 }
 
 GpStatus WINGDIPAPI 
@@ -103,4 +103,8 @@ GpStatus WINGDIPAPI GdipIsVisiblePathPointI (GpPath *path, INT x, INT y, GpGraph
 GpStatus WINGDIPAPI GdipIsOutlineVisiblePathPoint (GpPath *path, REAL x, REAL y, GpPen *pen, GpGraphics *graphics, BOOL *result);
 GpStatus WINGDIPAPI GdipIsOutlineVisiblePathPointI (GpPath *path, INT x, INT y, GpPen *pen, GpGraphics *graphics, BOOL *result);
 
+/* libgdiplus-specific API, batched hit-testing */
+GpStatus WINGDIPAPI GdipIsVisiblePathPoints_linux (GpPath *path, GDIPCONST GpPointF *points, INT count, BOOL *results);
+GpStatus WINGDIPAPI GdipIsVisiblePathsPoint_linux (GpPath **paths, INT count, REAL x, REAL y, BOOL *results);
+
 #endif
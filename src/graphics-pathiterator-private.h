@@ -37,8 +37,19 @@
 
 #include "gdiplus-private.h"
 
+/* one record per figure of the iterated path, built once when the iterator is created */
+typedef struct {
+	int start;		/* index of the figure's start point */
+	int end;		/* index of the figure's last point */
+	BOOL closed;
+	BOOL has_curve;
+} PathSubpath;
+
 struct _PathIterator {
 	GpPath *path;
+	PathSubpath *subpaths;
+	int subpathCount;
+	int subpathIndex;	/* The index of the next subpath record */
 	int markerPosition;	/* The start position of next marker, index of (marker type) + 1  */
 	int subpathPosition;	/* The start position of next subpath, index of (start type) */
 	int pathTypePosition;	/* The position to get the next path type inside a subpath */
@@ -46,4 +57,7 @@ struct _PathIterator {
 
 #include "graphics-pathiterator.h"
 
+BOOL gdip_path_iter_get_subpath (GpPathIterator *iterator, int index, const GpPointF **points, const BYTE **types, int *count, BOOL *isClosed) GDIP_INTERNAL;
+BOOL gdip_path_iter_next_subpath_view (GpPathIterator *iterator, const GpPointF **points, const BYTE **types, int *count, BOOL *isClosed) GDIP_INTERNAL;
+
 #endif
@@ -28,6 +28,110 @@
 #include "graphics-path-private.h"
 #include "font.h"
 
+/* split the path into figures once, so iterating them never has to rescan the types */
+static BOOL
+gdip_path_iter_build_index (GpPathIterator *iterator)
+{
+	GpPath *path = iterator->path;
+	PathSubpath *subpath;
+	int i, count;
+
+	iterator->subpaths = NULL;
+	iterator->subpathCount = 0;
+	if (!path || path->count == 0)
+		return TRUE;
+
+	/* the first point always starts a figure, even if it isn't flagged as one */
+	count = 1;
+	for (i = 1; i < path->count; i++) {
+		if (path->types [i] == PathPointTypeStart)
+			count++;
+	}
+
+	iterator->subpaths = (PathSubpath *) GdipAlloc (count * sizeof (PathSubpath));
+	if (!iterator->subpaths)
+		return FALSE;
+
+	subpath = iterator->subpaths;
+	subpath->start = 0;
+	subpath->has_curve = FALSE;
+	for (i = 1; i <= path->count; i++) {
+		if (i == path->count || path->types [i] == PathPointTypeStart) {
+			subpath->end = i - 1;
+			subpath->closed = (path->types [i - 1] & PathPointTypeCloseSubpath) != 0;
+			if (i == path->count)
+				break;
+			subpath++;
+			subpath->start = i;
+			subpath->has_curve = FALSE;
+		} else if ((path->types [i] & PathPointTypePathTypeMask) == PathPointTypeBezier) {
+			subpath->has_curve = TRUE;
+		}
+	}
+
+	iterator->subpathCount = count;
+	return TRUE;
+}
+
+/* copy a view of the iterated path into @path, reusing the storage @path already owns */
+static GpStatus
+gdip_path_iter_copy_view (GpPath *path, const GpPointF *points, const BYTE *types, int count)
+{
+	if (!path)
+		return InvalidParameter;
+
+	path->count = 0;
+	path->fill_mode = FillModeAlternate;
+	path->start_new_fig = TRUE;
+	if (!gdip_path_ensure_size (path, count))
+		return OutOfMemory;
+
+	memcpy (path->types, types, sizeof (BYTE) * count);
+	memcpy (path->points, points, sizeof (GpPointF) * count);
+	path->count = count;
+
+	return Ok;
+}
+
+/*
+ * Returns the points and types of the figure at @index without copying them. The pointers
+ * reference the iterator's own copy of the path and stay valid until the iterator is deleted.
+ */
+BOOL
+gdip_path_iter_get_subpath (GpPathIterator *iterator, int index, const GpPointF **points, const BYTE **types, int *count, BOOL *isClosed)
+{
+	PathSubpath *subpath;
+
+	if (!iterator || index < 0 || index >= iterator->subpathCount)
+		return FALSE;
+
+	subpath = &iterator->subpaths [index];
+	*points = iterator->path->points + subpath->start;
+	*types = iterator->path->types + subpath->start;
+	*count = subpath->end - subpath->start + 1;
+	*isClosed = subpath->closed;
+
+	return TRUE;
+}
+
+/* returns a view of the next figure and moves past it, FALSE once all the figures were returned */
+BOOL
+gdip_path_iter_next_subpath_view (GpPathIterator *iterator, const GpPointF **points, const BYTE **types, int *count, BOOL *isClosed)
+{
+	PathSubpath *subpath;
+
+	if (!gdip_path_iter_get_subpath (iterator, iterator->subpathIndex, points, types, count, isClosed))
+		return FALSE;
+
+	subpath = &iterator->subpaths [iterator->subpathIndex++];
+
+	/* set positions for next iteration */
+	iterator->pathTypePosition = subpath->start;
+	iterator->subpathPosition = subpath->end + 1;
+
+	return TRUE;
+}
+
 // coverity[+alloc : arg-*0]
 GpStatus
 GdipCreatePathIter (GpPathIterator **iterator, GpPath *path)
@@ -61,6 +165,14 @@ GdipCreatePathIter (GpPathIterator **iterator, GpPath *path)
 	iter->markerPosition = 0;
 	iter->subpathPosition = 0;
 	iter->pathTypePosition = 0;
+	iter->subpathIndex = 0;
+
+	if (!gdip_path_iter_build_index (iter)) {
+		if (clone)
+			GdipDeletePath (clone);
+		GdipFree (iter);
+		return OutOfMemory;
+	}
 
 	*iterator = iter;
 
@@ -84,23 +196,10 @@ GdipPathIterGetCount (GpPathIterator *iterator, int *count)
 GpStatus
 GdipPathIterGetSubpathCount (GpPathIterator *iterator, int *count)
 {
-	int numSubpaths = 0;
-
 	if (!iterator || !count)
 		return InvalidParameter;
 
-	if (iterator->path) {
-		int i;
-		BYTE type;
-		/* Number of subpaths = Number of starting points */
-		for (i = 0; i < iterator->path->count; i++) {
-			type = iterator->path->types[i];
-			if (type == PathPointTypeStart)
-				numSubpaths++;
-		}
-	}
-
-	*count = numSubpaths;
+	*count = iterator->subpathCount;
 
 	return Ok;
 }
@@ -115,6 +214,10 @@ GdipDeletePathIter (GpPathIterator *iterator)
 		GdipDeletePath (iterator->path);
 		iterator->path = NULL;
 	}
+	if (iterator->subpaths) {
+		GdipFree (iterator->subpaths);
+		iterator->subpaths = NULL;
+	}
 
 	GdipFree (iterator);
 
@@ -148,11 +251,10 @@ GdipPathIterEnumerate (GpPathIterator *iterator, int *resultCount, GpPointF *poi
 	if (!iterator || !resultCount || !points || !types)
 		return InvalidParameter;
 
-	if (iterator->path) {
-		for (; i < count && i < iterator->path->count; i++) {
-			points [i] = iterator->path->points[i];
-			types [i] = iterator->path->types[i];
-		}
+	if (iterator->path && count > 0) {
+		i = MIN (count, iterator->path->count);
+		memcpy (points, iterator->path->points, i * sizeof (GpPointF));
+		memcpy (types, iterator->path->types, i * sizeof (BYTE));
 	}
 
 	*resultCount = i;
@@ -163,10 +265,18 @@ GdipPathIterEnumerate (GpPathIterator *iterator, int *resultCount, GpPointF *poi
 GpStatus
 GdipPathIterHasCurve (GpPathIterator *iterator, BOOL *curve)
 {
+	int i;
+
 	if (!iterator || !curve)
 		return InvalidParameter;
 
-	*curve = gdip_path_has_curve (iterator->path);
+	*curve = FALSE;
+	for (i = 0; i < iterator->subpathCount; i++) {
+		if (iterator->subpaths [i].has_curve) {
+			*curve = TRUE;
+			break;
+		}
+	}
 
 	return Ok;
 }
@@ -178,13 +288,8 @@ GdipPathIterNextMarkerPath (GpPathIterator *iterator, int *resultCount, GpPath *
 	GpStatus status;
 
 	status = GdipPathIterNextMarker (iterator, resultCount, &start, &end);
-	if (status == Ok && *resultCount > 0) {
-		GdipResetPath (path);
-		gdip_path_ensure_size (path, *resultCount);
-		memcpy (path->types, iterator->path->types + start, sizeof (BYTE) * *resultCount);
-		memcpy (path->points, iterator->path->points + start, sizeof (GpPointF) * *resultCount);
-		path->count = *resultCount;
-	}
+	if (status == Ok && *resultCount > 0)
+		status = gdip_path_iter_copy_view (path, iterator->path->points + start, iterator->path->types + start, *resultCount);
 
 	return status;
 }
@@ -282,59 +387,41 @@ GdipPathIterNextPathType (GpPathIterator *iterator, int *resultCount, BYTE *path
 GpStatus
 GdipPathIterNextSubpathPath (GpPathIterator *iterator, int *resultCount, GpPath *path, BOOL *isClosed)
 {
-	int start, end;
-	GpStatus status;
+	const GpPointF *points;
+	const BYTE *types;
 
-	status = GdipPathIterNextSubpath (iterator, resultCount, &start, &end, isClosed);
-	if (status == Ok && *resultCount > 0) {
-		GdipResetPath (path);
-		gdip_path_ensure_size (path, *resultCount);
-		memcpy (path->types, iterator->path->types + start, sizeof (BYTE) * *resultCount);
-		memcpy (path->points, iterator->path->points + start, sizeof (GpPointF) * *resultCount);
-		path->count = *resultCount;
+	if (!iterator || !resultCount || !isClosed)
+		return InvalidParameter;
+
+	/* There are no subpaths or we are done with all the subpaths */
+	if (!gdip_path_iter_next_subpath_view (iterator, &points, &types, resultCount, isClosed)) {
+		*resultCount = 0;
+		*isClosed = TRUE;
+		return Ok;
 	}
 
-	return status;
+	return gdip_path_iter_copy_view (path, points, types, *resultCount);
 }
 
 GpStatus
 GdipPathIterNextSubpath (GpPathIterator *iterator, int *resultCount, int *startIndex, int *endIndex, BOOL *isClosed)
 {
-	int index = 0;
-	BYTE currentType;
+	const GpPointF *points;
+	const BYTE *types;
 
 	if (!iterator || !resultCount || !startIndex || !endIndex || !isClosed)
 		return InvalidParameter;
 
 	/* There are no subpaths or we are done with all the subpaths */
-	if (!iterator->path || (iterator->path->count == 0) || 
-	    (iterator->subpathPosition == iterator->path->count)) {
+	if (!gdip_path_iter_next_subpath_view (iterator, &points, &types, resultCount, isClosed)) {
 		/* we don't touch startIndex and endIndex in this case */
 		*resultCount = 0;
 		*isClosed = TRUE;
 		return Ok;
 	}
 
-	/* Check for next start point */
-	for (index = iterator->subpathPosition + 1; index < iterator->path->count; index++) {
-		currentType = iterator->path->types[index];
-		if (currentType == PathPointTypeStart)
-			break;
-	}
-
-	*startIndex = iterator->subpathPosition;
-	*endIndex = index - 1;
-	*resultCount = (*endIndex) - (*startIndex) + 1;
-	/* set positions for next iteration */
-	iterator->pathTypePosition = iterator->subpathPosition;
-	iterator->subpathPosition = index;
-
-	/* check if last subpath was closed */
-	currentType = iterator->path->types[index - 1];
-	if (currentType & PathPointTypeCloseSubpath)
-		*isClosed = TRUE;
-	else
-		*isClosed = FALSE;
+	*startIndex = points - iterator->path->points;
+	*endIndex = *startIndex + *resultCount - 1;
 
 	return Ok;
 }
@@ -349,6 +436,7 @@ GdipPathIterRewind (GpPathIterator *iterator)
 	iterator->markerPosition = 0;
 	iterator->subpathPosition = 0;
 	iterator->pathTypePosition = 0;
+	iterator->subpathIndex = 0;
 
 	return Ok;
 }
@@ -56,7 +56,7 @@
 
 #define DEFAULT_TEXT_CONTRAST		4
 
-/* Recursion depth of the flattening algorithm */
+/* Flattening gives up on curves needing more than (1 << FLATTEN_RECURSION_LIMIT) segments */
 #define FLATTEN_RECURSION_LIMIT		10
 
 /* not 100% identical to MS GDI+ which varies a little from int and float, but still around 0x40000000 */
@@ -569,6 +569,12 @@ GdipRestoreGraphics (GpGraphics *graphics, GraphicsState state)
 
 	graphics->saved_status_pos = state - 1;
 
+	if (graphics->backend == GraphicsBackEndMetafile) {
+		status = metafile_RestoreGraphics (graphics, state);
+		if (status != Ok)
+			return status;
+	}
+
 	/* re-adjust clipping (region and matrix) */
 	gdip_cairo_set_matrix (graphics, graphics->copy_of_ctm);
 
@@ -636,6 +642,9 @@ GdipSaveGraphics (GpGraphics *graphics, GraphicsState *state)
 	
 	*state = graphics->saved_status_pos + 1; // make sure GraphicsState is non-zero for compat with GDI+
 	graphics->saved_status_pos++;
+
+	if (graphics->backend == GraphicsBackEndMetafile)
+		return metafile_SaveGraphics (graphics, *state);
 	return Ok;
 }
 
@@ -37,14 +37,10 @@
 
 #include "brush-private.h"
 
-#define HATCH_SIZE 7
-#define LINE_WIDTH 1
+#define HATCH_SIZE 8
 
-#define gdip_hatch_get_width(hbr)	(hatches_const[hbr->hatchStyle][0])
-#define gdip_hatch_get_height(hbr)	(hatches_const[hbr->hatchStyle][1])
-#define gdip_hatch_get_line_width(hbr)	(hatches_const[hbr->hatchStyle][2])
-
-#define gdip_cairo_pixel(ct,x,y)	cairo_rectangle (ct, x, y, 1, 1)
+/* maximum number of (style, colors, alpha) tiles kept in the process-wide cache */
+#define HATCH_TILE_CACHE_SIZE 256
 
 typedef struct _Hatch {
 	GpBrush		base;
@@ -55,6 +51,8 @@ typedef struct _Hatch {
 	BOOL		alpha;
 } Hatch;
 
+void gdip_hatch_clear_tile_cache (void) GDIP_INTERNAL;
+
 #include "hatchbrush.h"
 
 #endif
@@ -22,6 +22,7 @@
 
 #include "gdiplus-private.h"
 #include "icocodec.h"
+#include "pngcodec.h"
 
 GUID gdip_ico_image_format_guid = {0xb96b3cb5U, 0x0728U, 0x11d3U, {0x9d, 0x7b, 0x00, 0x00, 0xf8, 0x1e, 0xf3, 0x2e}};
 
@@ -78,110 +79,135 @@ get_ico_data (BYTE *data, int x, int y, int bpp, int line_length)
 	return result;
 }
 
+/* The whole file is kept, every entry of the directory is a frame decoded when selected */
+typedef struct {
+	BYTE		*data;
+	int		size;
+	int		count;
+	ICONDIRENTRY	*entries;
+} ico_decoder_data;
+
+#define ICO_READ_BLOCK_SIZE	65536
+
+static const BYTE ico_png_signature[] = { 0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A };
+
+static void
+read_ICONDIRENTRY (const BYTE *data, ICONDIRENTRY *entry)
+{
+	/* entry->bWidth, bHeight, bColorCount, bReserved are all BYTE, the rest is little endian */
+	entry->bWidth = data[0];
+	entry->bHeight = data[1];
+	entry->bColorCount = data[2];
+	entry->bReserved = data[3];
+	entry->wPlanes = data[4] | (data[5] << 8);
+	entry->wBitCount = data[6] | (data[7] << 8);
+	entry->dwBytesInRes = data[8] | (data[9] << 8) | (data[10] << 16) | ((guint32)data[11] << 24);
+	entry->dwImageOffset = data[12] | (data[13] << 8) | (data[14] << 16) | ((guint32)data[15] << 24);
+}
+
+static void
+gdip_ico_decoder_dispose (void *data)
+{
+	ico_decoder_data *decoder = (ico_decoder_data *) data;
+
+	if (decoder->data)
+		GdipFree (decoder->data);
+	if (decoder->entries)
+		GdipFree (decoder->entries);
+	GdipFree (decoder);
+}
+
+/* Images start after the directory, even if the entry says otherwise */
+static int
+gdip_ico_image_offset (ico_decoder_data *decoder, const ICONDIRENTRY *entry)
+{
+	int directory_end = 6 + decoder->count * 16;
+
+	if (entry->dwImageOffset < directory_end)
+		return directory_end;
+	if (entry->dwImageOffset > decoder->size)
+		return decoder->size;
+	return entry->dwImageOffset;
+}
+
 static BOOL
-read_ICONDIRENTRY (void *pointer, ICONDIRENTRY *entry, ImageSource source, BOOL decode)
+gdip_ico_is_png (ico_decoder_data *decoder, const ICONDIRENTRY *entry)
+{
+	int offset = gdip_ico_image_offset (decoder, entry);
+
+	return (decoder->size - offset >= 24) && (memcmp (decoder->data + offset, ico_png_signature, sizeof (ico_png_signature)) == 0);
+}
+
+static GpStatus
+gdip_ico_decode_png (ico_decoder_data *decoder, const ICONDIRENTRY *entry, ActiveBitmapData *data)
 {
-	if (gdip_read_ico_data (pointer, (void*)entry, sizeof (ICONDIRENTRY), source) != sizeof (ICONDIRENTRY))
-		return FALSE;
-#if WORDS_BIGENDIAN
-	if (decode) {
-		BYTE *b;
-		/* entry->bWidth, bHeight, bColorCount, bReserved are all BYTE, no change required */
-		b = (BYTE*)&entry->wPlanes;
-		entry->wPlanes = (b[1] << 8) | b[0]; 
-		b = (BYTE*)&entry->wBitCount;
-		entry->wBitCount = (b[1] << 8) | b[0];
-		b = (BYTE*)&entry->dwBytesInRes;
-		entry->dwBytesInRes = ((guint32)b[3] << 24) | (b[2] << 16) | (b[1] << 8) | b[0];
-		b = (BYTE*)&entry->dwImageOffset;
-		entry->dwImageOffset = ((guint32)b[3] << 24) | (b[2] << 16) | (b[1] << 8) | b[0];
+	int offset = gdip_ico_image_offset (decoder, entry);
+	GpBitmap *png;
+	ActiveBitmapData *png_data;
+	GpStatus status;
+	BYTE *pixels;
+	int x, y;
+
+	status = gdip_load_png_image_from_memory (decoder->data + offset, decoder->size - offset, &png);
+	if (status != Ok)
+		return status;
+
+	png_data = png->active_bitmap;
+	if ((png_data->width != data->width) || (png_data->height != data->height)) {
+		gdip_bitmap_dispose (png);
+		return OutOfMemory;
 	}
-#endif
-	return TRUE;
+
+	if ((png_data->pixel_format == PixelFormat32bppARGB) && (png_data->reserved & GBD_OWN_SCAN0)) {
+		/* take the pixels over */
+		pixels = png_data->scan0;
+		png_data->scan0 = NULL;
+		png_data->reserved &= ~GBD_OWN_SCAN0;
+	} else {
+		pixels = GdipAlloc ((size_t) data->stride * data->height);
+		if (!pixels) {
+			gdip_bitmap_dispose (png);
+			return OutOfMemory;
+		}
+
+		for (y = 0; y < data->height; y++) {
+			ARGB *line = (ARGB *) (pixels + y * data->stride);
+			for (x = 0; x < data->width; x++)
+				GdipBitmapGetPixel (png, x, y, &line[x]);
+		}
+	}
+
+	gdip_bitmap_dispose (png);
+	data->scan0 = pixels;
+	data->reserved |= GBD_OWN_SCAN0;
+	return Ok;
 }
 
 static GpStatus
-gdip_read_ico_image_from_file_stream (void *pointer, GpImage **image, ImageSource source)
+gdip_ico_decode_bitmap (ico_decoder_data *decoder, const ICONDIRENTRY *entry, ActiveBitmapData *data)
 {
-	GpStatus status = OutOfMemory;
-	GpBitmap *result = NULL;
+	GpStatus status;
+	MemorySource ms;
 	BYTE *pixels = NULL;
-	WORD w, count;
-	void *p = &w;
-	BYTE *b = (BYTE*)&w;
-	ICONDIRENTRY entry;
-	int i, pos;
+	int i;
 	BOOL upsidedown = TRUE;
 	BITMAPV5HEADER bih;
 	int palette_entries = -1;
-	ARGB *colors = NULL;
+	ColorPalette *palette = NULL;
+	ARGB *colors;
 	int x, y;
 	int line_xor_length, xor_size;
 	int line_and_length, and_size;
-	BYTE *xor_data = NULL, *and_data = NULL;
+	BYTE *xor_data, *and_data;
 
-	/* WORD ICONDIR.idReserved / reversed, MUST be 0 */
-	if (gdip_read_ico_data (pointer, p, sizeof (WORD), source) != sizeof (WORD))
-		goto error;
-	if (w != 0)
-		goto error;
-
-	/* WORD ICONDIR.idType / resource type, MUST be 1 for icons */
-	if (gdip_read_ico_data (pointer, p, sizeof (WORD), source) != sizeof (WORD))
-		goto error;
-	i = (b[1] << 8 | b[0]);
-	if (i != 1)
-		goto error;
-
-	/* WORD ICONDIR.idCount / number of icons, must be greater than 0 */
-	if (gdip_read_ico_data (pointer, p, sizeof (WORD), source) != sizeof (WORD))
-		goto error;
-	count = (b[1] << 8 | b[0]); 
-	if (count < 1)
-		goto error;
-
-	pos = 6;
-	/*
-	 * NOTE: it looks like (from unit tests) that we get the last icon 
-	 * (e.g. it can return the 16 pixel version, instead of the 32 or 48 pixels available in the same file)
-	 */ 
-	for (i = 0; i < count - 1; i++) {
-		if (!read_ICONDIRENTRY (pointer, &entry, source, FALSE))
-			goto error;
-		pos += sizeof (ICONDIRENTRY);
-	}
-	/* last one is important, so we must decode (endianess) it's values */
-	if (!read_ICONDIRENTRY (pointer, &entry, source, TRUE))
-		goto error;
-	pos += sizeof (ICONDIRENTRY);
-
-	while (pos < entry.dwImageOffset) {
-		if (gdip_read_ico_data (pointer, p, sizeof (WORD), source) != sizeof (WORD))
-			goto error;
-		pos += sizeof (WORD);
-	}
+	ms.ptr = decoder->data;
+	ms.size = decoder->size;
+	ms.pos = gdip_ico_image_offset (decoder, entry);
 
 	/* BITMAPINFOHEADER */
-	status = gdip_read_BITMAPINFOHEADER (pointer, source, &bih, &upsidedown);
+	status = gdip_read_BITMAPINFOHEADER (&ms, Memory, &bih, &upsidedown);
 	if (status != Ok)
-		goto error;
-	
-	result = gdip_bitmap_new_with_frame (NULL, TRUE);
-	if (!result) {
-		status = OutOfMemory;
-		goto error;
-	}
-
-	result->type = ImageTypeBitmap;
-	result->image_format = ICON;
-	result->active_bitmap->pixel_format = PixelFormat32bppARGB; /* icons are always promoted to 32 bbp */
-	result->active_bitmap->width = entry.bWidth;
-	result->active_bitmap->height = entry.bHeight;
-	result->active_bitmap->stride = result->active_bitmap->width * 4;
-	/* Ensure 32bits alignment */
-	gdip_align_stride (result->active_bitmap->stride);
-	result->active_bitmap->dpi_horz = 96.0f;
-	result->active_bitmap->dpi_vert = 96.0f;
+		return status;
 
 	switch (bih.bV5BitCount) {
 	case 1:
@@ -200,34 +226,27 @@ gdip_read_ico_image_from_file_stream (void *pointer, GpImage **image, ImageSourc
 		break;
 	}
 
-	if (palette_entries < 0) {
-		status = OutOfMemory;
-		goto error;
-	}
+	if (palette_entries < 0)
+		return OutOfMemory;
 
 	/*
 	 * Strangely, even if we're supplying a 32bits ARGB image, 
 	 * the icon's palette is also supplied with the image.
 	 */
-	result->active_bitmap->palette = GdipAlloc (sizeof(ColorPalette) + sizeof(ARGB) * palette_entries);
-	if (result->active_bitmap->palette == NULL) {
-		status = OutOfMemory;
-		goto error;
-	}
-	result->active_bitmap->palette->Flags = 0;
-	result->active_bitmap->palette->Count = palette_entries;
+	palette = GdipAlloc (sizeof(ColorPalette) + sizeof(ARGB) * palette_entries);
+	if (palette == NULL)
+		return OutOfMemory;
+	palette->Flags = 0;
+	palette->Count = palette_entries;
 
 	for (i = 0; i < palette_entries; i++) {
 		/* colors are stored as R, G, B and reserved (always 0) */
 		BYTE color[4]; 
-		void *p = &color;
 
-		if (gdip_read_ico_data (pointer, p, 4, source) < 4) {
-			status = OutOfMemory;
+		if (gdip_read_ico_data (&ms, color, 4, Memory) < 4)
 			goto error;
-		}
 
-		set_pixel_bgra (result->active_bitmap->palette->Entries, i * 4,
+		set_pixel_bgra (palette->Entries, i * 4,
 			(color[0] & 0xFF),		/* B */
 			(color[1] & 0xFF),		/* G */
 			(color[2] & 0xFF),		/* R */
@@ -240,49 +259,31 @@ gdip_read_ico_image_from_file_stream (void *pointer, GpImage **image, ImageSourc
 	 * - XORBitmap can be a 1, 4 or 8 bpp bitmap
 	 * - ANDBitmap is *always* a monochrome (1bpp) bitmap
 	 * - in every case each line is padded to 32 bits boundary
+	 * both are used in place, from the copy of the file
 	 */
-	unsigned long long int size = (unsigned long long int)result->active_bitmap->stride * result->active_bitmap->height;
-	if (size > G_MAXINT32) {
-		status = OutOfMemory;
+	line_xor_length = (((bih.bV5BitCount * data->width + 31) & ~31) >> 3);
+	xor_size = line_xor_length * data->height;
+	if (xor_size > ms.size - ms.pos)
 		goto error;
-	}
-	pixels = GdipAlloc (size);
-	if (pixels == NULL) {
-		status = OutOfMemory;
-		goto error;
-	}
-
-	result->active_bitmap->scan0 = pixels;
-	result->active_bitmap->reserved = GBD_OWN_SCAN0;
-	result->active_bitmap->image_flags = ImageFlagsReadOnly | ImageFlagsHasRealPixelSize | ImageFlagsColorSpaceRGB | ImageFlagsHasAlpha;
+	xor_data = ms.ptr + ms.pos;
+	ms.pos += xor_size;
 
-	line_xor_length = (((bih.bV5BitCount * entry.bWidth + 31) & ~31) >> 3);
-	xor_size = line_xor_length * entry.bHeight;
-	xor_data = (BYTE*) GdipAlloc (xor_size);
-	if (!xor_data) {
-		status = OutOfMemory;
-		goto error;
-	}
-	if (gdip_read_ico_data (pointer, xor_data, xor_size, source) < xor_size) {
-		status = OutOfMemory;
+	line_and_length = (((data->width + 31) & ~31) >> 3);
+	and_size = line_and_length * data->height;
+	if (and_size > ms.size - ms.pos)
 		goto error;
-	}
+	and_data = ms.ptr + ms.pos;
 
-	line_and_length = (((entry.bWidth + 31) & ~31) >> 3);
-	and_size = line_and_length * entry.bHeight;
-	and_data = (BYTE*) GdipAlloc (and_size);
-	if (!and_data) {
-		status = OutOfMemory;
-		goto error;
-	}
-	if (gdip_read_ico_data (pointer, and_data, and_size, source) < and_size) {
-		status = OutOfMemory;
+	pixels = GdipAlloc ((size_t) data->stride * data->height);
+	if (pixels == NULL)
 		goto error;
-	}
 
-	colors = result->active_bitmap->palette->Entries;
-	for (y = 0; y < entry.bHeight; y++) {
-		for (x = 0; x < entry.bWidth; x++) {
+	colors = palette->Entries;
+	for (y = 0; y < data->height; y++) {
+		/* image is reversed (y) */
+		ARGB *line = (ARGB *) (pixels + (data->height - y - 1) * data->stride);
+
+		for (x = 0; x < data->width; x++) {
 			ARGB color;
 			if (palette_entries > 0) {
 				color = colors [get_ico_data (xor_data, x, y, bih.bV5BitCount, line_xor_length)];
@@ -301,24 +302,148 @@ gdip_read_ico_image_from_file_stream (void *pointer, GpImage **image, ImageSourc
 				/* ARGB to BRGA */
 				color = (line_data [0] | line_data [1] << 8 | line_data [2] << 16 | (guint32)line_data [3] << 24);
 			}
-			/* image is reversed (y) */
-			GdipBitmapSetPixel (result, x, entry.bHeight - y - 1, color);
+			line[x] = color;
+		}
+	}
+
+	data->scan0 = pixels;
+	data->reserved |= GBD_OWN_SCAN0;
+	data->palette = palette;
+	return Ok;
+
+error:
+	GdipFree (palette);
+	return OutOfMemory;
+}
+
+static GpStatus
+gdip_ico_decode_frame (GpBitmap *bitmap, int frame, int index)
+{
+	ico_decoder_data *decoder = (ico_decoder_data *) bitmap->decoder;
+	const ICONDIRENTRY *entry = &decoder->entries[index];
+	ActiveBitmapData *data = &bitmap->frames[frame].bitmap[index];
+
+	if (gdip_ico_is_png (decoder, entry))
+		return gdip_ico_decode_png (decoder, entry, data);
+
+	return gdip_ico_decode_bitmap (decoder, entry, data);
+}
+
+static GpStatus
+gdip_read_ico_image_from_file_stream (void *pointer, GpImage **image, ImageSource source)
+{
+	GpStatus status = OutOfMemory;
+	ico_decoder_data *decoder;
+	GpBitmap *result = NULL;
+	FrameData *frame;
+	int size_read;
+	int i;
+
+	decoder = GdipAlloc (sizeof (ico_decoder_data));
+	if (!decoder)
+		return OutOfMemory;
+	memset (decoder, 0, sizeof (ico_decoder_data));
+
+	/* icons are small, keep the whole file so that only the selected entry gets decoded */
+	do {
+		BYTE *data;
+
+		if (decoder->size > G_MAXINT32 - ICO_READ_BLOCK_SIZE)
+			goto error;
+
+		data = gdip_realloc (decoder->data, decoder->size + ICO_READ_BLOCK_SIZE);
+		if (!data)
+			goto error;
+		decoder->data = data;
+
+		size_read = gdip_read_ico_data (pointer, decoder->data + decoder->size, ICO_READ_BLOCK_SIZE, source);
+		if (size_read > 0)
+			decoder->size += size_read;
+	} while (size_read == ICO_READ_BLOCK_SIZE);
+
+	/* WORD ICONDIR.idReserved / reversed, MUST be 0 */
+	/* WORD ICONDIR.idType / resource type, MUST be 1 for icons */
+	/* WORD ICONDIR.idCount / number of icons, must be greater than 0 */
+	if (decoder->size < 6)
+		goto error;
+	if ((decoder->data[0] | (decoder->data[1] << 8)) != 0)
+		goto error;
+	if ((decoder->data[2] | (decoder->data[3] << 8)) != 1)
+		goto error;
+	decoder->count = decoder->data[4] | (decoder->data[5] << 8);
+	if (decoder->count < 1)
+		goto error;
+
+	if (decoder->size < 6 + decoder->count * 16)
+		goto error;
+
+	decoder->entries = GdipAlloc (sizeof (ICONDIRENTRY) * decoder->count);
+	if (!decoder->entries)
+		goto error;
+
+	for (i = 0; i < decoder->count; i++)
+		read_ICONDIRENTRY (decoder->data + 6 + i * 16, &decoder->entries[i]);
+
+	result = gdip_bitmap_new ();
+	if (!result)
+		goto error;
+
+	result->type = ImageTypeBitmap;
+	result->image_format = ICON;
+	result->decoder = decoder;
+	result->decode_frame = gdip_ico_decode_frame;
+	result->dispose_decoder = gdip_ico_decoder_dispose;
+
+	frame = gdip_frame_add (result, &gdip_image_frameDimension_resolution_guid);
+	if (!frame)
+		goto error;
+
+	/* every entry is a frame of the resolution dimension, described without being decoded */
+	for (i = 0; i < decoder->count; i++) {
+		ICONDIRENTRY *entry = &decoder->entries[i];
+		ActiveBitmapData *bitmap_data = gdip_frame_add_bitmapdata (frame);
+
+		if (!bitmap_data)
+			goto error;
+
+		bitmap_data->pixel_format = PixelFormat32bppARGB; /* icons are always promoted to 32 bbp */
+		if (gdip_ico_is_png (decoder, entry)) {
+			/* the size is in the IHDR chunk, big endian */
+			BYTE *ihdr = decoder->data + gdip_ico_image_offset (decoder, entry) + 16;
+			bitmap_data->width = ((guint32) ihdr[0] << 24) | (ihdr[1] << 16) | (ihdr[2] << 8) | ihdr[3];
+			bitmap_data->height = ((guint32) ihdr[4] << 24) | (ihdr[5] << 16) | (ihdr[6] << 8) | ihdr[7];
+			if ((bitmap_data->width <= 0) || (bitmap_data->height <= 0) || (bitmap_data->width > 0x7FFF) || (bitmap_data->height > 0x7FFF))
+				goto error;
+		} else {
+			/* a size of 0 stands for 256 pixels */
+			bitmap_data->width = entry->bWidth ? entry->bWidth : 256;
+			bitmap_data->height = entry->bHeight ? entry->bHeight : 256;
 		}
+		bitmap_data->stride = bitmap_data->width * 4;
+		/* Ensure 32bits alignment */
+		gdip_align_stride (bitmap_data->stride);
+		bitmap_data->dpi_horz = 96.0f;
+		bitmap_data->dpi_vert = 96.0f;
+		bitmap_data->image_flags = ImageFlagsReadOnly | ImageFlagsHasRealPixelSize | ImageFlagsColorSpaceRGB | ImageFlagsHasAlpha;
 	}
 
-	GdipFree (xor_data);
-	GdipFree (and_data);
+	/*
+	 * NOTE: it looks like (from unit tests) that we get the last icon 
+	 * (e.g. it can return the 16 pixel version, instead of the 32 or 48 pixels available in the same file)
+	 */ 
+	status = gdip_bitmap_setactive (result, &gdip_image_frameDimension_resolution_guid, frame->count - 1);
+	if (status != Ok)
+		goto error;
 
 	*image = result;
 	return Ok;
 
 error:
+	/* the bitmap owns the decoder once created */
 	if (result)
-		GdipDisposeImage (result);
-	if (xor_data)
-		GdipFree (xor_data);
-	if (and_data)
-		GdipFree (and_data);
+		gdip_bitmap_dispose (result);
+	else
+		gdip_ico_decoder_dispose (decoder);
 
 	return status;
 }
@@ -426,13 +426,30 @@ GdipDrawImageRect (GpGraphics *graphics, GpImage *image, REAL x, REAL y, REAL wi
 	/* metafile */
 	if (image->type == ImageTypeMetafile) {
 		GpStatus status;
+		GpImage *raster = NULL;
+		cairo_matrix_t device;
+
+		/* a cached raster can replace the records when it maps 1:1 to device pixels */
+		cairo_get_matrix (graphics->ct, &device);
+		if ((graphics->backend == GraphicsBackEndCairo) && (graphics->composite_mode != CompositingModeSourceCopy) &&
+			(device.xy == 0) && (device.yx == 0)) {
+			status = gdip_metafile_get_raster ((GpMetafile*)image, iround (fabs (width * device.xx)),
+				iround (fabs (height * device.yy)), graphics, &raster);
+			if (status != Ok)
+				return status;
+		}
 
-		metacontext = gdip_metafile_play_setup ((GpMetafile*)image, graphics, x, y, width, height);
+		if (!raster) {
+			metacontext = gdip_metafile_play_setup ((GpMetafile*)image, graphics, x, y, width, height);
 
-		status = gdip_metafile_play (metacontext);
+			status = gdip_metafile_play (metacontext);
 
-		gdip_metafile_play_cleanup (metacontext);
-		return status;
+			gdip_metafile_play_cleanup (metacontext);
+			return status;
+		}
+
+		/* paint the raster like any other bitmap */
+		image = raster;
 	}
 
 	/* Create a surface for this bitmap if one doesn't exist */
@@ -1125,12 +1142,17 @@ GdipSaveImageToFile (GpImage *image, GDIPCONST WCHAR *file, GDIPCONST CLSID *enc
 	if (format == INVALID)
 		return UnknownImageFormat;
 	
+	gdip_bitmap_flush_surface (image);
+
+	/* the encoders walk every frame, including the ones not decoded yet */
+	status = gdip_bitmap_decode_frames (image);
+	if (status != Ok)
+		return status;
+
 	file_name = (char *) utf16_to_utf8 ((const gunichar2 *)file, -1);
 	if (file_name == NULL)
 		return InvalidParameter;
 	
-	gdip_bitmap_flush_surface (image);
-	
 	if (format == GIF) { /* gif library has to open the file itself*/
 		status = gdip_save_gif_image_to_file ((BYTE*)file_name, image);
 		GdipFree (file_name);
@@ -2318,11 +2340,18 @@ GdipSaveImageToDelegate_linux (GpImage *image, GetBytesDelegate getBytesFunc, Pu
 	SeekDelegate seekFunc, CloseDelegate closeFunc, SizeDelegate sizeFunc, GDIPCONST CLSID *encoderCLSID,
 	GDIPCONST EncoderParameters *params)
 {
+	GpStatus status;
+
 	if (!image || !encoderCLSID || (image->type != ImageTypeBitmap))
 		return InvalidParameter;
 
 	gdip_bitmap_flush_surface (image);
 
+	/* the encoders walk every frame, including the ones not decoded yet */
+	status = gdip_bitmap_decode_frames (image);
+	if (status != Ok)
+		return status;
+
 	switch (gdip_get_imageformat_from_codec_clsid ((CLSID *)encoderCLSID)) {
 	case ICON:
 	case BMP:
@@ -2607,6 +2636,41 @@ GdipGetEncoderParameterList (GpImage *image, GDIPCONST CLSID *clsidEncoder, UINT
 	return FileNotFound;
 }
 
+/* The resolution frame closest to a thumbnail size: the smallest one covering it, else the largest one */
+static int
+gdip_get_thumbnail_resolution (GpBitmap *bitmap, UINT width, UINT height, int *frame)
+{
+	int best = -1;
+	int i, j;
+
+	for (i = 0; i < bitmap->num_of_frames; i++) {
+		FrameData *data = &bitmap->frames[i];
+
+		if (memcmp (&data->frame_dimension, &gdip_image_frameDimension_resolution_guid, sizeof (GUID)) != 0)
+			continue;
+
+		for (j = 0; j < data->count; j++) {
+			ActiveBitmapData *candidate = &data->bitmap[j];
+			ActiveBitmapData *current = (best >= 0) ? &data->bitmap[best] : NULL;
+			BOOL covers = (candidate->width >= width) && (candidate->height >= height);
+
+			if (!current) {
+				best = j;
+			} else if ((current->width >= width) && (current->height >= height)) {
+				if (covers && ((gint64) candidate->width * candidate->height < (gint64) current->width * current->height))
+					best = j;
+			} else if (covers || ((gint64) candidate->width * candidate->height > (gint64) current->width * current->height)) {
+				best = j;
+			}
+		}
+
+		*frame = i;
+		return best;
+	}
+
+	return -1;
+}
+
 GpStatus WINGDIPAPI
 GdipGetImageThumbnail (GpImage *image, UINT thumbWidth, UINT thumbHeight, GpImage **thumbImage, GetThumbnailImageAbort callback, VOID *callbackData)
 {
@@ -2614,6 +2678,9 @@ GdipGetImageThumbnail (GpImage *image, UINT thumbWidth, UINT thumbHeight, GpImag
 	PixelFormat format;
 	GpImage *result;
 	GpGraphics *graphics;
+	int previous_frame = 0;
+	int previous_index = 0;
+	BOOL restore = FALSE;
 
 	if (!image || !thumbImage)
 		return InvalidParameter;
@@ -2638,20 +2705,37 @@ GdipGetImageThumbnail (GpImage *image, UINT thumbWidth, UINT thumbHeight, GpImag
 	if (status != Ok)
 		return status;
 
+	/* multi-resolution images (e.g. icons) draw their best fit, only that one gets decoded */
+	if (image->type == ImageTypeBitmap) {
+		int frame;
+		int best = gdip_get_thumbnail_resolution (image, thumbWidth, thumbHeight, &frame);
+
+		if ((best >= 0) && ((frame != image->active_frame) || (best != image->active_bitmap_no))) {
+			previous_frame = image->active_frame;
+			previous_index = image->active_bitmap_no;
+			status = gdip_bitmap_setactive (image, &image->frames[frame].frame_dimension, best);
+			if (status != Ok) {
+				GdipDisposeImage (result);
+				return status;
+			}
+			restore = TRUE;
+		}
+	}
+
 	status = GdipGetImageGraphicsContext (result, &graphics);
-	if (status != Ok) {
-		GdipDisposeImage (result);
-		return status;
+	if (status == Ok) {
+		status = GdipDrawImageRectI (graphics, image, 0, 0, thumbWidth, thumbHeight);
+		GdipDeleteGraphics (graphics);
 	}
 
-	status = GdipDrawImageRectI (graphics, image, 0, 0, thumbWidth, thumbHeight);
+	if (restore)
+		gdip_bitmap_setactive (image, &image->frames[previous_frame].frame_dimension, previous_index);
+
 	if (status != Ok) {
 		GdipDisposeImage (result);
-		GdipDeleteGraphics (graphics);
 		return status;
 	}
 
-	GdipDeleteGraphics (graphics);
 	*thumbImage = result;
 	return Ok;
 }
@@ -41,6 +41,10 @@
 
 #define DEFAULT_GRADIENT_ANGLE	45.0f
 
+#define LINEAR_RAMP_SIZE	256
+#define LINEAR_RAMP_CACHE_SIZE	64
+#define LINEAR_RAMP_GAMMA	2.2
+
 typedef struct _LineGradient {
 	GpBrush			base;
 	ARGB			lineColors [2];
@@ -53,9 +57,11 @@ typedef struct _LineGradient {
 	InterpolationColors	*presetColors;
 	cairo_pattern_t		*pattern;
 	BOOL			isAngleScalable;
-	BOOL			gammaCorrection; /* FIXME: Not used */
+	BOOL			gammaCorrection;
 } LineGradient;
 
+void gdip_linear_gradient_clear_ramp_cache (void) GDIP_INTERNAL;
+
 #include "lineargradientbrush.h"
 
 #endif
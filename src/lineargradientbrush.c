@@ -222,88 +222,283 @@ gdip_linear_gradient_destroy (GpBrush *brush)
 	return Ok;
 }
 
-static void
-add_color_stops_from_blend (cairo_pattern_t *pattern, Blend *blend, ARGB *colors)
+/*
+ * Color ramps are compiled into a LINEAR_RAMP_SIZE x 1 premultiplied ARGB32 lookup
+ * surface which is then sampled along the gradient axis by a repeating (or reflecting)
+ * surface pattern. Brushes using identical stops share the same surface through a
+ * process-wide cache, so only the first brush pays for computing the ramp.
+ */
+typedef enum {
+	LinearRampTwoColors,
+	LinearRampBlend,
+	LinearRampPreset
+} LinearRampKind;
+
+typedef struct {
+	LinearRampKind	kind;
+	BOOL		gammaCorrection;
+	ARGB		lineColors [2];
+	int		count;
+	float		*positions;
+	guint32		*values;	/* blend factors (as bits) or preset colors */
+} LinearRampKey;
+
+#if GLIB_CHECK_VERSION(2,32,0)
+static GMutex ramps_mutex;
+#else
+static GStaticMutex ramps_mutex = G_STATIC_MUTEX_INIT;
+#endif
+static GHashTable *ramps_hashtable = NULL;
+
+static guint
+linear_ramp_key_hash (gconstpointer key)
 {
-	int index;
-	double sr, sg, sb, sa;
-	double er, eg, eb, ea;
-	double offset, factor;
-
-	sa = (colors[0] >> 24) & 0xFF;
-	sr = (colors[0] >> 16) & 0xFF;
-	sg = (colors[0] >> 8) & 0xFF;
-	sb = colors[0] & 0xFF;
-
-	ea = (colors[1] >> 24) & 0xFF;
-	er = (colors[1] >> 16) & 0xFF;
-	eg = (colors[1] >> 8) & 0xFF;
-	eb = colors[1] & 0xFF;
-
-	for (index = 0; index < blend->count; index++) {
-		factor = blend->factors [index];
-		offset = blend->positions [index];
-
-		cairo_pattern_add_color_stop_rgba (pattern, offset, 
-					      ((sr * (1 - factor)) + (er * factor)) / 255,
-					      ((sg * (1 - factor)) + (eg * factor)) / 255,
-					      ((sb * (1 - factor)) + (eb * factor)) / 255,
-					      ((sa * (1 - factor)) + (ea * factor)) / 255);
+	const LinearRampKey *k = (const LinearRampKey *) key;
+	guint hash = (k->lineColors [0] * 31 + k->lineColors [1]) * 67 + (k->kind << 1) + (k->gammaCorrection ? 1 : 0);
+	int i;
+
+	for (i = 0; i < k->count; i++) {
+		guint32 position;
+
+		memcpy (&position, &k->positions [i], sizeof (guint32));
+		hash = (hash * 31 + position) * 31 + k->values [i];
 	}
+
+	return hash;
+}
+
+static gboolean
+linear_ramp_key_equal (gconstpointer a, gconstpointer b)
+{
+	const LinearRampKey *ka = (const LinearRampKey *) a;
+	const LinearRampKey *kb = (const LinearRampKey *) b;
+
+	return (ka->kind == kb->kind) && (ka->gammaCorrection == kb->gammaCorrection) &&
+		(ka->lineColors [0] == kb->lineColors [0]) && (ka->lineColors [1] == kb->lineColors [1]) &&
+		(ka->count == kb->count) &&
+		(memcmp (ka->positions, kb->positions, ka->count * sizeof (float)) == 0) &&
+		(memcmp (ka->values, kb->values, ka->count * sizeof (guint32)) == 0);
+}
+
+/* the copy is a single block, so that the hash table can release it with g_free */
+static LinearRampKey *
+linear_ramp_key_copy (const LinearRampKey *key)
+{
+	LinearRampKey *copy = (LinearRampKey *) g_malloc (sizeof (LinearRampKey) + key->count * (sizeof (float) + sizeof (guint32)));
+
+	*copy = *key;
+	copy->positions = (float *) (copy + 1);
+	copy->values = (guint32 *) (copy->positions + key->count);
+	memcpy (copy->positions, key->positions, key->count * sizeof (float));
+	memcpy (copy->values, key->values, key->count * sizeof (guint32));
+	return copy;
 }
 
 static void
-add_color_stops_from_interpolation_colors (cairo_pattern_t *pattern, InterpolationColors *presetColors)
+linear_ramp_surface_destroy (gpointer surface)
 {
-	int index;
-	double r, g, b, a;
-	double offset;
-	ARGB color;
+	cairo_surface_destroy ((cairo_surface_t *) surface);
+}
 
-	/* MS accecpts positions above 1.0 also. Cairo assumes the values above 1.0 as 1.0
-	 * and values below 0 are assumed as 0. So we get different results if any of the
-	 * offset values is out of [0.0, 1.0].
-	 */
-	for (index = 0; index < presetColors->count; index++) {
-		color = presetColors->colors [index];
-		a = (color >> 24) & 0xFF;
-		r = (color >> 16) & 0xFF;
-		g = (color >> 8) & 0xFF;
-		b = color & 0xFF;
-		offset = presetColors->positions [index];
-
-		cairo_pattern_add_color_stop_rgba (pattern, offset, r / 255, g / 255, b / 255, a / 255);
+/*
+ * With gamma correction the color channels are interpolated in linear light (gamma 2.2)
+ * instead of directly between the sRGB values. Alpha is always interpolated linearly.
+ */
+static void
+linear_ramp_unpack (ARGB color, BOOL gammaCorrection, double *channels)
+{
+	int i;
+
+	channels [0] = ((color >> 24) & 0xFF) / 255.0;
+	channels [1] = ((color >> 16) & 0xFF) / 255.0;
+	channels [2] = ((color >> 8) & 0xFF) / 255.0;
+	channels [3] = (color & 0xFF) / 255.0;
+
+	if (gammaCorrection) {
+		for (i = 1; i < 4; i++)
+			channels [i] = pow (channels [i], LINEAR_RAMP_GAMMA);
+	}
+}
+
+static guint32
+linear_ramp_pack (const double *channels, BOOL gammaCorrection)
+{
+	BYTE argb [4];
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		double value = channels [i];
+
+		if (gammaCorrection && i > 0)
+			value = pow (value, 1.0 / LINEAR_RAMP_GAMMA);
+
+		argb [i] = (BYTE) (CLAMP (value, 0.0, 1.0) * 255.0 + 0.5);
 	}
+
+	/* cairo wants native endian, premultiplied pixels */
+	return ((guint32) argb [0] << 24) |
+		((guint32) pre_multiplied_table [argb [1]][argb [0]] << 16) |
+		((guint32) pre_multiplied_table [argb [2]][argb [0]] << 8) |
+		pre_multiplied_table [argb [3]][argb [0]];
 }
 
 static void
-add_color_stops (cairo_pattern_t *pattern, ARGB *colors)
+linear_ramp_lerp (const double *start, const double *end, double factor, double *result)
+{
+	int i;
+
+	for (i = 0; i < 4; i++)
+		result [i] = start [i] + (end [i] - start [i]) * factor;
+}
+
+/* find the stop segment containing t and the relative position of t inside it */
+static int
+linear_ramp_find_segment (const float *positions, int count, double t, double *factor)
+{
+	int i;
+
+	if (t <= positions [0]) {
+		*factor = 0;
+		return 0;
+	}
+
+	for (i = 1; i < count; i++) {
+		if (t <= positions [i]) {
+			double width = positions [i] - positions [i - 1];
+
+			*factor = (width > 0) ? (t - positions [i - 1]) / width : 1.0;
+			return i - 1;
+		}
+	}
+
+	/* beyond the last stop the last value is used */
+	*factor = 1.0;
+	return count - 2;
+}
+
+static cairo_surface_t *
+create_linear_ramp (const LinearRampKey *key)
 {
-	double r, g, b, a;
+	cairo_surface_t *ramp;
+	guint32 *scan;
+	double start [4], end [4], color [4];
+	int i;
+
+	ramp = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, LINEAR_RAMP_SIZE, 1);
+	if (cairo_surface_status (ramp) != CAIRO_STATUS_SUCCESS)
+		return ramp;
+
+	cairo_surface_flush (ramp);
+	scan = (guint32 *) cairo_image_surface_get_data (ramp);
+
+	linear_ramp_unpack (key->lineColors [0], key->gammaCorrection, start);
+	linear_ramp_unpack (key->lineColors [1], key->gammaCorrection, end);
+
+	for (i = 0; i < LINEAR_RAMP_SIZE; i++) {
+		/* each entry holds the color at the center of its span */
+		double t = (i + 0.5) / LINEAR_RAMP_SIZE;
+		double factor;
+		int segment;
+
+		switch (key->kind) {
+		case LinearRampBlend: {
+			float blendFactors [2];
+
+			segment = linear_ramp_find_segment (key->positions, key->count, t, &factor);
+			memcpy (blendFactors, &key->values [segment], sizeof (blendFactors));
+			linear_ramp_lerp (start, end, blendFactors [0] + (blendFactors [1] - blendFactors [0]) * factor, color);
+			break;
+		}
+		case LinearRampPreset: {
+			double stop0 [4], stop1 [4];
+
+			segment = linear_ramp_find_segment (key->positions, key->count, t, &factor);
+			linear_ramp_unpack (key->values [segment], key->gammaCorrection, stop0);
+			linear_ramp_unpack (key->values [segment + 1], key->gammaCorrection, stop1);
+			linear_ramp_lerp (stop0, stop1, factor, color);
+			break;
+		}
+		default:
+			linear_ramp_lerp (start, end, t, color);
+			break;
+		}
 
-	a = (colors[0] >> 24) & 0xFF;
-	r = (colors[0] >> 16) & 0xFF;
-	g = (colors[0] >> 8) & 0xFF;
-	b = colors[0] & 0xFF;
+		scan [i] = linear_ramp_pack (color, key->gammaCorrection);
+	}
 
-	/* set start color */
-	cairo_pattern_add_color_stop_rgba (pattern, 0.0, r / 255, g / 255, b / 255, a / 255);
+	cairo_surface_mark_dirty (ramp);
+	return ramp;
+}
+
+/* returns a new reference to the (possibly cached) ramp for the specified key */
+static cairo_surface_t *
+gdip_linear_gradient_get_ramp (const LinearRampKey *key)
+{
+	cairo_surface_t *ramp;
+
+#if GLIB_CHECK_VERSION(2,32,0)
+	g_mutex_lock (&ramps_mutex);
+#else
+	g_static_mutex_lock (&ramps_mutex);
+#endif
+
+	if (ramps_hashtable) {
+		ramp = (cairo_surface_t *) g_hash_table_lookup (ramps_hashtable, key);
+	} else {
+		ramps_hashtable = g_hash_table_new_full (linear_ramp_key_hash, linear_ramp_key_equal, g_free, linear_ramp_surface_destroy);
+		ramp = NULL;
+	}
 
-	a = (colors[1] >> 24) & 0xFF;
-	r = (colors[1] >> 16) & 0xFF;
-	g = (colors[1] >> 8) & 0xFF;
-	b = colors[1] & 0xFF;
+	if (!ramp) {
+		ramp = create_linear_ramp (key);
+		if (cairo_surface_status (ramp) == CAIRO_STATUS_SUCCESS) {
+			/* don't let applications using many gradients grow the cache without limit */
+			if (g_hash_table_size (ramps_hashtable) >= LINEAR_RAMP_CACHE_SIZE)
+				g_hash_table_remove_all (ramps_hashtable);
 
-	/* set end color */
-	cairo_pattern_add_color_stop_rgba (pattern, 1.0, r / 255, g / 255, b / 255, a / 255);
+			g_hash_table_insert (ramps_hashtable, linear_ramp_key_copy (key), ramp);
+			cairo_surface_reference (ramp);
+		}
+	} else {
+		cairo_surface_reference (ramp);
+	}
+
+#if GLIB_CHECK_VERSION(2,32,0)
+	g_mutex_unlock (&ramps_mutex);
+#else
+	g_static_mutex_unlock (&ramps_mutex);
+#endif
+	return ramp;
+}
+
+void
+gdip_linear_gradient_clear_ramp_cache (void)
+{
+#if GLIB_CHECK_VERSION(2,32,0)
+	g_mutex_lock (&ramps_mutex);
+#else
+	g_static_mutex_lock (&ramps_mutex);
+#endif
+	if (ramps_hashtable) {
+		g_hash_table_destroy (ramps_hashtable);
+		ramps_hashtable = NULL;
+	}
+#if GLIB_CHECK_VERSION(2,32,0)
+	g_mutex_unlock (&ramps_mutex);
+#else
+	g_static_mutex_unlock (&ramps_mutex);
+#endif
 }
 
 static GpStatus
 create_tile_linear (GpGraphics *graphics, cairo_t *ct, GpLineGradient *linear)
 {
 	GpStatus status;
+	LinearRampKey key;
+	cairo_surface_t *ramp;
 	cairo_pattern_t *pat;
-	cairo_matrix_t matrix;
+	cairo_matrix_t matrix, axis;
+	double dx, dy, length2;
 
 	if (!graphics || !ct || !linear)
 		return InvalidParameter;
@@ -313,20 +508,57 @@ create_tile_linear (GpGraphics *graphics, cairo_t *ct, GpLineGradient *linear)
 	if (status != Ok)
 		return status;
 
-	pat = cairo_pattern_create_linear (linear->points [0].X, linear->points [0].Y, linear->points [1].X, linear->points [1].Y);
+	/* map the gradient axis onto [0, LINEAR_RAMP_SIZE] horizontally; the ramp is a single
+	 * row so the vertical (perpendicular) component only needs to keep the matrix invertible */
+	dx = linear->points [1].X - linear->points [0].X;
+	dy = linear->points [1].Y - linear->points [0].Y;
+	length2 = dx * dx + dy * dy;
+	if (length2 == 0)
+		return InvalidParameter;
+
+	cairo_matrix_init (&axis, dx * LINEAR_RAMP_SIZE / length2, -dy / length2, dy * LINEAR_RAMP_SIZE / length2, dx / length2, 0, 0);
+	cairo_matrix_translate (&axis, -linear->points [0].X, -linear->points [0].Y);
+	cairo_matrix_multiply (&matrix, &matrix, &axis);
+
+	key.gammaCorrection = linear->gammaCorrection;
+	if (linear->blend->count > 1) {
+		key.kind = LinearRampBlend;
+		key.lineColors [0] = linear->lineColors [0];
+		key.lineColors [1] = linear->lineColors [1];
+		key.count = linear->blend->count;
+		key.positions = linear->blend->positions;
+		key.values = (guint32 *) linear->blend->factors;
+	} else if (linear->presetColors->count > 1) {
+		/* the line colors are ignored, don't let them prevent sharing the ramp */
+		key.kind = LinearRampPreset;
+		key.lineColors [0] = key.lineColors [1] = 0;
+		key.count = linear->presetColors->count;
+		key.positions = linear->presetColors->positions;
+		key.values = linear->presetColors->colors;
+	} else {
+		key.kind = LinearRampTwoColors;
+		key.lineColors [0] = linear->lineColors [0];
+		key.lineColors [1] = linear->lineColors [1];
+		key.count = 0;
+		key.positions = NULL;
+		key.values = NULL;
+	}
+
+	ramp = gdip_linear_gradient_get_ramp (&key);
+	status = gdip_get_status (cairo_surface_status (ramp));
+	if (status != Ok) {
+		cairo_surface_destroy (ramp);
+		return status;
+	}
+
+	pat = cairo_pattern_create_for_surface (ramp);
+	cairo_surface_destroy (ramp);
 	status = gdip_get_pattern_status (pat);
 	if (status != Ok)
 		return status;
 
 	cairo_pattern_set_matrix (pat, &matrix);
 
-	if (linear->blend->count > 1)
-		add_color_stops_from_blend (pat, linear->blend, linear->lineColors);
-	else if (linear->presetColors->count > 1)
-		add_color_stops_from_interpolation_colors (pat, linear->presetColors);
-	else
-		add_color_stops (pat, linear->lineColors);
-
 	linear->pattern = pat;
 
 	return Ok;
@@ -370,12 +602,15 @@ gdip_linear_gradient_setup (GpGraphics *graphics, GpBrush *brush)
 
 			case WrapModeTile:
 			case WrapModeTileFlipY:
+				/* a bilinear filter would blend the last ramp entry into the first one at each seam */
 				cairo_pattern_set_extend (linear->pattern, CAIRO_EXTEND_REPEAT);
+				cairo_pattern_set_filter (linear->pattern, CAIRO_FILTER_NEAREST);
 				break;
 
 			case WrapModeTileFlipX:
 			case WrapModeTileFlipXY:
 				cairo_pattern_set_extend (linear->pattern, CAIRO_EXTEND_REFLECT);
+				cairo_pattern_set_filter (linear->pattern, CAIRO_FILTER_BILINEAR);
 				break;
 			default :
 				return InvalidParameter; // we will never get here but I hate warnings!
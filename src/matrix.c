@@ -130,6 +130,76 @@ gdip_matrix_init_from_rect_3points (GpMatrix *matrix, const GpRectF *rect, const
 	return Ok;
 }
 
+/*
+ * Batch point transformations. The matrix is inspected once, then the points are
+ * transformed by a loop without calls, which the compiler can vectorize, instead of
+ * calling cairo_matrix_transform_point/distance for each of them.
+ */
+static BOOL
+gdip_matrix_is_scale (const GpMatrix *matrix)
+{
+	return (matrix->yx == 0) && (matrix->xy == 0);
+}
+
+static void
+gdip_matrix_transform_points (const GpMatrix *matrix, GpPointF *pts, int count, BOOL translate)
+{
+	double xx = matrix->xx, yx = matrix->yx, xy = matrix->xy, yy = matrix->yy;
+	double x0 = translate ? matrix->x0 : 0, y0 = translate ? matrix->y0 : 0;
+	int i;
+
+	if (gdip_matrix_is_scale (matrix)) {
+		if ((xx == 1) && (yy == 1)) {
+			/* identity or translation only */
+			if ((x0 == 0) && (y0 == 0))
+				return;
+
+			for (i = 0; i < count; i++) {
+				pts [i].X = (REAL) (pts [i].X + x0);
+				pts [i].Y = (REAL) (pts [i].Y + y0);
+			}
+		} else {
+			for (i = 0; i < count; i++) {
+				pts [i].X = (REAL) (xx * pts [i].X + x0);
+				pts [i].Y = (REAL) (yy * pts [i].Y + y0);
+			}
+		}
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		double x = pts [i].X;
+		double y = pts [i].Y;
+
+		pts [i].X = (REAL) (xx * x + xy * y + x0);
+		pts [i].Y = (REAL) (yx * x + yy * y + y0);
+	}
+}
+
+static void
+gdip_matrix_transform_points_int (const GpMatrix *matrix, GpPoint *pts, int count, BOOL translate)
+{
+	double xx = matrix->xx, yx = matrix->yx, xy = matrix->xy, yy = matrix->yy;
+	double x0 = translate ? matrix->x0 : 0, y0 = translate ? matrix->y0 : 0;
+	int i;
+
+	if (gdip_matrix_is_scale (matrix)) {
+		for (i = 0; i < count; i++) {
+			pts [i].X = iround (xx * pts [i].X + x0);
+			pts [i].Y = iround (yy * pts [i].Y + y0);
+		}
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		double x = pts [i].X;
+		double y = pts [i].Y;
+
+		pts [i].X = iround (xx * x + xy * y + x0);
+		pts [i].Y = iround (yx * x + yy * y + y0);
+	}
+}
+
 /* public (exported) functions */
 
 // coverity[+alloc : arg-*0]
@@ -354,14 +424,7 @@ GdipTransformMatrixPoints (GpMatrix *matrix, GpPointF *pts, INT count)
 	if (!matrix || !pts || count <= 0)
 		return InvalidParameter;
 
-	for (int i = 0; i < count; i++, pts++) {
-		double x = pts->X;
-		double y = pts->Y;
-		cairo_matrix_transform_point (matrix, &x, &y);
-
-		pts->X = (REAL) x;
-		pts->Y = (REAL) y;
-	}
+	gdip_matrix_transform_points (matrix, pts, count, TRUE);
 
 	return Ok;
 }
@@ -374,14 +437,7 @@ GdipTransformMatrixPointsI (GpMatrix *matrix, GpPoint *pts, INT count)
 	if (!matrix || !pts || count == 0)
 		return InvalidParameter;
 
-	for (int i = 0; i < count; i++, pts++) {
-		double x = pts->X;
-		double y = pts->Y;
-		cairo_matrix_transform_point (matrix, &x, &y);
-
-		pts->X = iround (x);
-		pts->Y = iround (y);
-	}
+	gdip_matrix_transform_points_int (matrix, pts, count, TRUE);
 
 	return Ok;
 }
@@ -392,14 +448,7 @@ GdipVectorTransformMatrixPoints (GpMatrix *matrix, GpPointF *pts, INT count)
 	if (!matrix || !pts || count <= 0)
 		return InvalidParameter;
 
-	for (int i = 0; i < count; i++, pts++) {
-		double x = pts->X;
-		double y = pts->Y;
-		cairo_matrix_transform_distance (matrix, &x, &y);
-
-		pts->X = (REAL) x;
-		pts->Y = (REAL) y;
-	}
+	gdip_matrix_transform_points (matrix, pts, count, FALSE);
 
 	return Ok;
 }
@@ -410,14 +459,7 @@ GdipVectorTransformMatrixPointsI (GpMatrix *matrix, GpPoint *pts, INT count)
 	if (!matrix || !pts || count <= 0)
 		return InvalidParameter;
 
-	for (int i = 0; i < count; i++, pts++) {
-		double x = pts->X;
-		double y = pts->Y;
-		cairo_matrix_transform_distance (matrix, &x, &y);
-
-		pts->X = iround (x);
-		pts->Y = iround (y);
-	}
+	gdip_matrix_transform_points_int (matrix, pts, count, FALSE);
 
 	return Ok;
 }
@@ -45,6 +45,7 @@
 #define METAOBJECT_TYPE_EMPTY	0
 #define METAOBJECT_TYPE_PEN	1
 #define METAOBJECT_TYPE_BRUSH	2
+#define METAOBJECT_TYPE_IMAGE	3
 
 #define gdip_get_metaheader(image)	(&((GpMetafile*)image)->metafile_header)
 
@@ -57,8 +58,86 @@
 typedef struct {
 	void *ptr;
 	int type;
+	BOOL shared;	/* owned by the metafile's compiled program, not by the playback */
 } MetaObject;
 
+/* operations of a compiled metafile program, each one maps to a gdip_metafile_* player function */
+typedef enum {
+	MetafileOpSaveDC,
+	MetafileOpRestoreDC,
+	MetafileOpSetBkMode,
+	MetafileOpSetBkColor,
+	MetafileOpSetMapMode,
+	MetafileOpSetWindowOrg,
+	MetafileOpSetWindowScale,
+	MetafileOpSetROP2,
+	MetafileOpSetRelabs,
+	MetafileOpSetPolyFillMode,
+	MetafileOpSetStretchBltMode,
+	MetafileOpSetTextAlign,
+	MetafileOpSetMiterLimit,
+	MetafileOpModifyWorldTransform,
+	MetafileOpCreateObject,
+	MetafileOpSelectObject,
+	MetafileOpDeleteObject,
+	/* drawing operations, from MoveTo to StrokeAndFillPath */
+	MetafileOpMoveTo,
+	MetafileOpLineTo,
+	MetafileOpPolyline,
+	MetafileOpPolygon,
+	MetafileOpPolyBezier,
+	MetafileOpArc,
+	MetafileOpRectangle,
+	MetafileOpSetPixel,
+	MetafileOpStretchDIBits,
+	MetafileOpBeginPath,
+	MetafileOpEndPath,
+	MetafileOpCloseFigure,
+	MetafileOpFillPath,
+	MetafileOpStrokePath,
+	MetafileOpStrokeAndFillPath,
+	MetafileOpEmfPlus
+} MetafileOpCode;
+
+typedef struct {
+	MetafileOpCode code;
+	int first;		/* first point in the program's points, or the program's object for CreateObject and StretchDIBits */
+	int count;		/* number of points, or bytes of data */
+	union {
+		int i [10];
+		float f [10];
+	} args;
+	const BYTE *data;	/* referenced in place from the metafile data (EMF+ blocks, DIBs) */
+	const BYTE *bits;
+} MetafileOp;
+
+/* the metafile drawn once at some device size, see GdipSetMetafileRasterCacheSize_linux */
+typedef struct {
+	GpImage *raster;	/* 32bppPARGB bitmap, painted directly by cairo */
+	int width;
+	int height;
+	/* the graphics settings the records were played with */
+	SmoothingMode antialias;
+	InterpolationMode interpolation;
+	TextRenderingHint text_hint;
+	UINT bytes;
+	UINT stamp;		/* last use, the least recently used rasters are evicted first */
+} MetafileRaster;
+
+/* the EMF or WMF records of a metafile, decoded once and replayed on every draw */
+typedef struct {
+	MetafileOp *ops;
+	int count;
+	int capacity;
+	GpPointF *points;
+	int points_count;
+	int points_capacity;
+	MetaObject *objects;	/* pens, brushes and decoded DIBs, created once and shared by every playback */
+	int objects_count;
+	int objects_capacity;
+	GpStatus status;	/* returned after playback when the records couldn't all be compiled */
+} MetafileProgram;
+
 struct _Metafile {
 	GpImage base;
 	MetafileHeader metafile_header;
@@ -67,9 +146,24 @@ struct _Metafile {
 	int length;
 	BOOL recording;		/* recording into memory (data), file (fp) or user stream (stream) */
 	FILE *fp;
-	void *stream;
+	PutBytesDelegate stream;
+	/* EMF+ records accumulated while recording, packed into data when recording stops */
+	BYTE *records;
+	int records_length;
+	int records_capacity;
+	int next_object;	/* EMF+ object slot for the next serialized object */
+	MetafileFrameUnit frame_unit;
+	MetafileProgram *program;	/* compiled on first playback */
+	/* rasters cache, disabled while raster_budget is 0 */
+	MetafileRaster *rasters;
+	int rasters_count;
+	UINT raster_budget;
+	UINT raster_bytes;
+	UINT raster_clock;
 };
 
+typedef struct _EmfPlusContext EmfPlusContext;
+
 typedef struct {
 	GpMetafile *metafile;
 	int x, y, width, height;
@@ -105,6 +199,8 @@ typedef struct {
 	GpSolidFill *stock_brush_null;
 	/* bitmap representation */
 	BYTE *scan0;
+	/* EMF+ records, see emfplus.c */
+	EmfPlusContext *emfplus;
 } MetafilePlayContext;
 
 typedef struct {
@@ -125,11 +221,26 @@ GpStatus gdip_metafile_dispose (GpMetafile *metafile) GDIP_INTERNAL;
 GpStatus gdip_get_bitmap_from_metafile (GpMetafile *metafile, INT width, INT height, GpImage **thumbnail) GDIP_INTERNAL;
 
 GpStatus gdip_metafile_stop_recording (GpMetafile *metafile) GDIP_INTERNAL;
+void gdip_metafile_put_dword (BYTE *p, DWORD value) GDIP_INTERNAL;
 
-GpStatus gdip_metafile_play_emf (MetafilePlayContext *context) GDIP_INTERNAL;
-GpStatus gdip_metafile_play_wmf (MetafilePlayContext *context) GDIP_INTERNAL;
+GpStatus gdip_metafile_compile_emf (GpMetafile *metafile, MetafileProgram *program) GDIP_INTERNAL;
+GpStatus gdip_metafile_compile_wmf (GpMetafile *metafile, MetafileProgram *program) GDIP_INTERNAL;
 GpStatus gdip_metafile_play_emfplus_block (MetafilePlayContext *context, BYTE* data, int length) GDIP_INTERNAL;
+void gdip_metafile_play_emfplus_cleanup (MetafilePlayContext *context) GDIP_INTERNAL;
+
+MetafileOp* gdip_metafile_program_add (MetafileProgram *program, MetafileOpCode code) GDIP_INTERNAL;
+GpStatus gdip_metafile_program_add_simple (MetafileProgram *program, MetafileOpCode code, int arg0, int arg1) GDIP_INTERNAL;
+GpPointF* gdip_metafile_program_add_points (MetafileProgram *program, MetafileOp *op, int count) GDIP_INTERNAL;
+GpStatus gdip_metafile_program_add_created (MetafileProgram *program, MetafilePlayContext *compiler) GDIP_INTERNAL;
+GpStatus gdip_metafile_program_add_dib (MetafileProgram *program, MetafileOp *op, const BYTE *bmi, int bmi_size,
+	const BYTE *bits, int bits_size) GDIP_INTERNAL;
+GpStatus gdip_metafile_program_map_mode (MetafileProgram *program, MetafilePlayContext *compiler, DWORD mode) GDIP_INTERNAL;
+GpStatus gdip_metafile_program_window_ext (MetafileProgram *program, MetafilePlayContext *compiler, int height, 
+	int width) GDIP_INTERNAL;
+void gdip_metafile_program_free (MetafileProgram *program) GDIP_INTERNAL;
 
+GpStatus gdip_metafile_get_raster (GpMetafile *metafile, int width, int height, GpGraphics *graphics, 
+	GpImage **raster) GDIP_INTERNAL;
 MetafilePlayContext* gdip_metafile_play_setup (GpMetafile *metafile, GpGraphics *graphics, int x, int y, int width, 
 	int height) GDIP_INTERNAL;
 GpStatus gdip_metafile_play (MetafilePlayContext *context) GDIP_INTERNAL;
@@ -167,7 +278,7 @@ GpStatus gdip_metafile_Rectangle (MetafilePlayContext *context, int bottomRect,
 GpStatus gdip_metafile_SetPixel (MetafilePlayContext *context, DWORD color, int x, int y) GDIP_INTERNAL;
 GpStatus gdip_metafile_StretchDIBits (MetafilePlayContext *context, int XDest, int YDest, int nDestWidth, int nDestHeight, 
 	int XSrc, int YSrc, int nSrcWidth, int nSrcHeight, CONST void *lpBits, CONST BITMAPINFO *lpBitsInfo, 
-	UINT iUsage, DWORD dwRop) GDIP_INTERNAL;
+	UINT iUsage, DWORD dwRop, GpImage *decoded) GDIP_INTERNAL;
 GpStatus gdip_metafile_PolyBezier (MetafilePlayContext *context, GpPointF *points, int count) GDIP_INTERNAL;
 GpStatus gdip_metafile_Polygon (MetafilePlayContext *context, GpPointF *points, int count) GDIP_INTERNAL;
 GpStatus gdip_metafile_BeginPath (MetafilePlayContext *context) GDIP_INTERNAL;
@@ -24,6 +24,8 @@
 #include "solidbrush-private.h"
 #include "general-private.h"
 #include "graphics.h"
+#include "graphics-metafile-private.h"
+#include "emfplus.h"
 #include "graphics-path-private.h"
 #include "hatchbrush-private.h"
 #include "pen.h"
@@ -53,57 +55,75 @@ gdip_metafile_SetBkMode (MetafilePlayContext *context, DWORD bkMode)
 	return Ok;
 }
 
-/* http://wvware.sourceforge.net/caolan/SetMapMode.html */
-GpStatus
-gdip_metafile_SetMapMode (MetafilePlayContext *context, DWORD mode)
+/* this isn't cumulative (and we get a lot of "junk" calls) */
+static GpStatus
+gdip_metafile_set_scale (MetafilePlayContext *context, float sx, float sy)
 {
 	GpStatus status;
-	float scale;
-#ifdef DEBUG_METAFILE
-	printf ("SetMapMode %d", mode);
+
+	GdipSetWorldTransform (context->graphics, &context->matrix);
+	status = GdipScaleWorldTransform (context->graphics, sx, sy, MatrixOrderPrepend);
+#ifdef DEBUG_METAFILE_2
+	printf ("\n\tGdipScaleWorldTransform sx %g, sy %g (status %d)", sx, sy, status);
 #endif
-	context->map_mode = mode;
+	return status;
+}
 
+/*
+ * Return the map mode that @mode really selects and, in @scale, the size of its logical units in pixels.
+ * The scale is 0 for MM_ISOTROPIC and MM_ANISOTROPIC, whose ratio is only known from SetWindowExt.
+ */
+static DWORD
+gdip_metafile_map_mode_scale (DWORD mode, float *scale)
+{
 	switch (mode) {
 	case MM_HIENGLISH:
 		/* 1 logical unit == 0.001 inch */
-		scale = gdip_get_display_dpi () * 0.001;
+		*scale = gdip_get_display_dpi () * 0.001;
 		break;
 	case MM_LOENGLISH:
 		/* 1 logical unit == 0.01 inch */
-		scale = gdip_get_display_dpi () * 0.01;
+		*scale = gdip_get_display_dpi () * 0.01;
 		break;
 	case MM_HIMETRIC:
 		/* 1 logical unit == 0.01 mm */
-		scale = gdip_get_display_dpi () / (MM_PER_INCH * 100);
+		*scale = gdip_get_display_dpi () / (MM_PER_INCH * 100);
 		break;
 	case MM_LOMETRIC:
 		/* 1 logical unit == 0.1 mm */
-		scale = gdip_get_display_dpi () / (MM_PER_INCH * 10);
+		*scale = gdip_get_display_dpi () / (MM_PER_INCH * 10);
 		break;
 	case MM_TWIPS:
 		/* 1 logical point == 1/1440 inch (1/20 of a "old" printer point ;-) */
-		scale = gdip_get_display_dpi () / 1440;
+		*scale = gdip_get_display_dpi () / 1440;
 		break;
 	case MM_TEXT:
 	default:
 		/* 1 logical unit == 1 pixel */
-		scale = 1.0f;
-		context->map_mode = MM_TEXT;
-		break;
+		*scale = 1.0f;
+		return MM_TEXT;
 	case MM_ISOTROPIC:
 	case MM_ANISOTROPIC:
 		/* SetWindowExt will calculate the correct ratio */
-		return Ok;
+		*scale = 0;
+		break;
 	}
+	return mode;
+}
 
-	/* this isn't cumulative (and we get a lot of "junk" calls) */
-	GdipSetWorldTransform (context->graphics, &context->matrix);
-	status = GdipScaleWorldTransform (context->graphics, scale, scale, MatrixOrderPrepend);
-#ifdef DEBUG_METAFILE_2
-	printf ("\n\tGdipScaleWorldTransform sx %g, sy %g (status %d)", scale, scale, status);
+/* http://wvware.sourceforge.net/caolan/SetMapMode.html */
+GpStatus
+gdip_metafile_SetMapMode (MetafilePlayContext *context, DWORD mode)
+{
+	float scale;
+#ifdef DEBUG_METAFILE
+	printf ("SetMapMode %d", mode);
 #endif
-	return status;
+	context->map_mode = gdip_metafile_map_mode_scale (mode, &scale);
+	if (scale == 0)
+		return Ok;
+
+	return gdip_metafile_set_scale (context, scale, scale);
 }
 
 /* http://wvware.sourceforge.net/caolan/SetROP2.html */
@@ -243,11 +263,11 @@ gdip_metafile_SelectObject (MetafilePlayContext *context, DWORD slot)
 		break;
 	}
 
-	context->objects [slot].type = context->created.type;
-	context->objects [slot].ptr = context->created.ptr;
+	context->objects [slot] = context->created;
 
 	context->created.type = METAOBJECT_TYPE_EMPTY;
 	context->created.ptr = NULL;
+	context->created.shared = FALSE;
 	return Ok;
 }
 
@@ -308,7 +328,8 @@ gdip_metafile_DeleteObject (MetafilePlayContext *context, DWORD slot)
 	}
 
 	obj = &context->objects [slot];
-	switch (obj->type) {
+	/* objects of a compiled program are kept for the next playback */
+	switch (obj->shared ? METAOBJECT_TYPE_EMPTY : obj->type) {
 	case METAOBJECT_TYPE_PEN:
 		status = GdipDeletePen ((GpPen*)obj->ptr);
 		break;
@@ -324,6 +345,7 @@ gdip_metafile_DeleteObject (MetafilePlayContext *context, DWORD slot)
 #endif
 	obj->type = METAOBJECT_TYPE_EMPTY;
 	obj->ptr = NULL;
+	obj->shared = FALSE;
 	return status;
 }
 
@@ -350,40 +372,41 @@ gdip_metafile_SetWindowOrg (MetafilePlayContext *context, int x, int y)
 	return Ok;
 }
 
+/* return FALSE if the window extent doesn't change the scale of the current @map_mode */
+static BOOL
+gdip_metafile_window_ext_scale (GpMetafile *metafile, int map_mode, int height, int width, float *sx, float *sy)
+{
+	switch (map_mode) {
+	case MM_ISOTROPIC:
+		*sx = (float)metafile->metafile_header.Width / width;
+		*sy = (float)metafile->metafile_header.Height / height;
+		/* keeps ratio to 1:1 */
+		if (*sx < *sy)
+			*sy = *sx;
+		return TRUE;
+	case MM_ANISOTROPIC:
+		*sx = (float)metafile->metafile_header.Width / width;
+		*sy = (float)metafile->metafile_header.Height / height;
+		return TRUE;
+	default:
+		/* most cases are handled by SetMapMode */
+		return FALSE;
+	}
+}
+
 /* http://wvware.sourceforge.net/caolan/SetWindowExt.html */
 GpStatus
 gdip_metafile_SetWindowExt (MetafilePlayContext *context, int height, int width)
 {
-	GpStatus status;
 	float sx, sy;
 
 #ifdef DEBUG_METAFILE
 	printf ("SetWindowExt height %d, width %d", height, width);
 #endif
-	switch (context->map_mode) {
-	case MM_ISOTROPIC:
-		sx = (float)context->metafile->metafile_header.Width / width;
-		sy = (float)context->metafile->metafile_header.Height / height;
-		/* keeps ratio to 1:1 */
-		if (sx < sy)
-			sy = sx;
-		break;
-	case MM_ANISOTROPIC:
-		sx = (float)context->metafile->metafile_header.Width / width;
-		sy = (float)context->metafile->metafile_header.Height / height;
-		break;
-	default:
-		/* most cases are handled by SetMapMode */
+	if (!gdip_metafile_window_ext_scale (context->metafile, context->map_mode, height, width, &sx, &sy))
 		return Ok;
-	}
 
-	/* this isn't cumulative (and we get a lot of "junk" calls) */
-	GdipSetWorldTransform (context->graphics, &context->matrix);
-	status = GdipScaleWorldTransform (context->graphics, sx, sy, MatrixOrderPrepend);
-#ifdef DEBUG_METAFILE_2
-	printf ("\n\tGdipScaleWorldTransform sx %g, sy %g (status %d)", sx, sy, status);
-#endif
-	return status;
+	return gdip_metafile_set_scale (context, sx, sy);
 }
 
 /* http://wvware.sourceforge.net/caolan/LineTo.html */
@@ -527,6 +550,7 @@ gdip_metafile_ExtCreatePen (MetafilePlayContext *context, DWORD dwPenStyle, DWOR
 
 	context->created.type = METAOBJECT_TYPE_PEN;
 	context->created.ptr = pen;
+	context->created.shared = FALSE;
 	return Ok;
 }
 
@@ -561,6 +585,7 @@ gdip_metafile_CreateBrushIndirect (MetafilePlayContext *context, DWORD style, DW
 #endif
 	context->created.type = METAOBJECT_TYPE_BRUSH;
 	context->created.ptr = brush;
+	context->created.shared = FALSE;
 	return status;
 }
 
@@ -620,19 +645,44 @@ gdip_metafile_SetPixel (MetafilePlayContext *context, DWORD color, int x, int y)
 }
 
 
-/* http://wvware.sourceforge.net/caolan/ora-wmf.html */
+/* the common raster operations, as the cairo blend modes that give the same result on black and white pixels */
+static cairo_operator_t
+gdip_metafile_rop_operator (DWORD dwRop, cairo_operator_t current)
+{
+	switch (dwRop) {
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE(1, 10, 0)
+	case SRCAND:
+		return CAIRO_OPERATOR_MULTIPLY;
+	case SRCPAINT:
+		return CAIRO_OPERATOR_SCREEN;
+	case SRCINVERT:
+		return CAIRO_OPERATOR_DIFFERENCE;
+#endif
+	case SRCCOPY:
+	default:
+		/* the DIBs are opaque so the current operator copies them */
+		return current;
+	}
+}
+
+/*
+ * http://wvware.sourceforge.net/caolan/ora-wmf.html
+ * @decoded is the bitmap gdip_metafile_program_add_dib kept for the record, otherwise @lpBits are uncompressed
+ * 32bpp pixels painted in place.
+ */
 GpStatus
 gdip_metafile_StretchDIBits (MetafilePlayContext *context, int XDest, int YDest, int nDestWidth, int nDestHeight, 
 	int XSrc, int YSrc, int nSrcWidth, int nSrcHeight, CONST void *lpBits, CONST BITMAPINFO *lpBitsInfo, 
-	UINT iUsage, DWORD dwRop)
+	UINT iUsage, DWORD dwRop, GpImage *decoded)
 {
-	GpStatus status = OutOfMemory;
-	GpImage *image = NULL;
-	MemorySource ms;
+	GpStatus status;
+	GpImage *image = decoded;
+	GpGraphics *graphics = context->graphics;
+	cairo_operator_t op = CAIRO_OPERATOR_OVER;
 #ifdef DEBUG_METAFILE
 	printf ("StretchDIBits\n\t[XDest %d, YDest %d, nDestWidth %d, nDestHeight %d]", XDest, YDest, nDestWidth, nDestHeight);
 	printf ("\n\t[XSrc %d, YSrc %d, nSrcWidth %d, nSrcHeight %d]", XSrc, YSrc, nSrcWidth, nSrcHeight);
-	printf ("\n\tlpBits %p, lpBitsInfo %p, iUsage %d, dwRop %d", lpBits, lpBitsInfo, iUsage, dwRop);
+	printf ("\n\tlpBits %p, lpBitsInfo %p, iUsage %d, dwRop %d, decoded %p", lpBits, lpBitsInfo, iUsage, dwRop, decoded);
 	printf ("\n\tBITMAPINFO\n\t\tSize: %d", lpBitsInfo->bmiHeader.biSize);
 	printf ("\n\t\tWidth: %d", lpBitsInfo->bmiHeader.biWidth);
 	printf ("\n\t\tHeight: %d", lpBitsInfo->bmiHeader.biHeight);
@@ -645,22 +695,43 @@ gdip_metafile_StretchDIBits (MetafilePlayContext *context, int XDest, int YDest,
 	printf ("\n\t\tClrUsed: %d", lpBitsInfo->bmiHeader.biClrUsed);
 	printf ("\n\t\tClrImportant: %d", lpBitsInfo->bmiHeader.biClrImportant);
 #endif
-	ms.ptr = (BYTE*)lpBitsInfo;
-	if (lpBitsInfo->bmiHeader.biCompression == BI_RGB) {
-		// Per the spec, if compression is RGB ImageSize must be ignored (and it should be zero anyway)
-		// and calculated according to the following formula.
-		ms.size = (floor ((lpBitsInfo->bmiHeader.biWidth * lpBitsInfo->bmiHeader.biPlanes * 
-			lpBitsInfo->bmiHeader.biBitCount + 31) / 32) * 4) * abs (lpBitsInfo->bmiHeader.biHeight);
-	} else {
-		ms.size = lpBitsInfo->bmiHeader.biSizeImage;
+	if (!image) {
+		int width, height, stride;
+		BYTE *scan0;
+
+		/* the DIB couldn't be decoded when the metafile was compiled, GDI draws nothing either */
+		if (!lpBits)
+			return Ok;
+
+		/* bottom-up DIBs start at their last row, cairo walks them with a negative stride */
+		width = lpBitsInfo->bmiHeader.biWidth;
+		height = lpBitsInfo->bmiHeader.biHeight;
+		stride = width * 4;
+		scan0 = (BYTE*) lpBits;
+		if (height > 0) {
+			scan0 += (gsize) stride * (height - 1);
+			stride = -stride;
+		} else {
+			height = -height;
+		}
+
+		/* the X byte of the pixels is ignored by the RGB24 surface */
+		status = GdipCreateBitmapFromScan0 (width, height, stride, PixelFormat24bppRGB, scan0, (GpBitmap**) &image);
+		if (status != Ok)
+			return status;
 	}
-	ms.pos = 0;
-	status = gdip_read_bmp_image (&ms, &image, Memory);
-	if (status == Ok) {
-		status = GdipDrawImageRectRect (context->graphics, image, XDest, YDest,
-			nDestWidth, nDestHeight, XSrc, YSrc, nSrcWidth, nSrcHeight, UnitPixel, NULL, NULL, NULL);
+
+	if (graphics->backend == GraphicsBackEndCairo) {
+		op = cairo_get_operator (graphics->ct);
+		cairo_set_operator (graphics->ct, gdip_metafile_rop_operator (dwRop, op));
 	}
-	if (image)
+
+	status = GdipDrawImageRectRect (graphics, image, XDest, YDest, nDestWidth, nDestHeight,
+		XSrc, YSrc, nSrcWidth, nSrcHeight, UnitPixel, NULL, NULL, NULL);
+
+	if (graphics->backend == GraphicsBackEndCairo)
+		cairo_set_operator (graphics->ct, op);
+	if (image != decoded)
 		GdipDisposeImage (image);
 	return status;
 }
@@ -904,6 +975,147 @@ gdip_metafile_StrokeAndFillPath (MetafilePlayContext *context)
 }
 
 
+static void
+gdip_metafile_remove_raster (GpMetafile *metafile, int index)
+{
+	MetafileRaster *raster = &metafile->rasters [index];
+
+	GdipDisposeImage (raster->raster);
+	metafile->raster_bytes -= raster->bytes;
+	metafile->rasters_count--;
+	memmove (raster, raster + 1, (metafile->rasters_count - index) * sizeof (MetafileRaster));
+}
+
+/* evict the least recently used rasters until @needed more bytes fit in the budget */
+static void
+gdip_metafile_evict_rasters (GpMetafile *metafile, UINT needed)
+{
+	while (metafile->rasters_count > 0 && metafile->raster_bytes + needed > metafile->raster_budget) {
+		int i, oldest = 0;
+
+		for (i = 1; i < metafile->rasters_count; i++) {
+			if (metafile->rasters [i].stamp < metafile->rasters [oldest].stamp)
+				oldest = i;
+		}
+		gdip_metafile_remove_raster (metafile, oldest);
+	}
+}
+
+static void
+gdip_metafile_clear_rasters (GpMetafile *metafile)
+{
+	while (metafile->rasters_count > 0)
+		gdip_metafile_remove_raster (metafile, metafile->rasters_count - 1);
+
+	if (metafile->rasters) {
+		GdipFree (metafile->rasters);
+		metafile->rasters = NULL;
+	}
+}
+
+static GpStatus
+gdip_metafile_rasterize (GpMetafile *metafile, int width, int height, MetafileRaster *key, GpImage **raster)
+{
+	MetafilePlayContext *context;
+	GpGraphics *graphics;
+	GpBitmap *bitmap;
+	GpStatus status;
+
+	status = GdipCreateBitmapFromScan0 (width, height, 0, PixelFormat32bppPARGB, NULL, &bitmap);
+	if (status != Ok)
+		return status;
+
+	status = GdipGetImageGraphicsContext ((GpImage *) bitmap, &graphics);
+	if (status != Ok) {
+		GdipDisposeImage ((GpImage *) bitmap);
+		return status;
+	}
+
+	GdipGraphicsClear (graphics, 0);
+	GdipSetSmoothingMode (graphics, key->antialias);
+	GdipSetInterpolationMode (graphics, key->interpolation);
+	GdipSetTextRenderingHint (graphics, key->text_hint);
+
+	context = gdip_metafile_play_setup (metafile, graphics, 0, 0, width, height);
+	if (context) {
+		status = gdip_metafile_play (context);
+		gdip_metafile_play_cleanup (context);
+	} else {
+		status = OutOfMemory;
+	}
+
+	GdipDeleteGraphics (graphics);
+	if (status != Ok) {
+		GdipDisposeImage ((GpImage *) bitmap);
+		return status;
+	}
+
+	*raster = (GpImage *) bitmap;
+	return Ok;
+}
+
+/*
+ * Return, in @raster, the metafile drawn at @width x @height device pixels with the smoothing, interpolation and
+ * text rendering settings of @graphics. The world transform scale is part of the device size, callers only use
+ * rasters when it has no rotation or shear.
+ * @raster is NULL, and the caller must play the metafile itself, when the cache is disabled or too small.
+ */
+GpStatus
+gdip_metafile_get_raster (GpMetafile *metafile, int width, int height, GpGraphics *graphics, GpImage **raster)
+{
+	MetafileRaster key, *entry;
+	GpStatus status;
+	UINT bytes;
+	int i;
+
+	*raster = NULL;
+
+	if (!metafile->raster_budget || metafile->recording || width <= 0 || height <= 0)
+		return Ok;
+	if (width > metafile->raster_budget / 4 / height)
+		return Ok;
+
+	key.antialias = graphics->draw_mode;
+	key.interpolation = graphics->interpolation;
+	key.text_hint = graphics->text_mode;
+
+	for (i = 0; i < metafile->rasters_count; i++) {
+		entry = &metafile->rasters [i];
+		if (entry->width == width && entry->height == height && entry->antialias == key.antialias &&
+			entry->interpolation == key.interpolation && entry->text_hint == key.text_hint) {
+			entry->stamp = ++metafile->raster_clock;
+			*raster = entry->raster;
+			return Ok;
+		}
+	}
+
+	bytes = width * height * 4;
+	gdip_metafile_evict_rasters (metafile, bytes);
+
+	entry = gdip_realloc (metafile->rasters, (metafile->rasters_count + 1) * sizeof (MetafileRaster));
+	if (!entry)
+		return OutOfMemory;
+	metafile->rasters = entry;
+
+	entry = &metafile->rasters [metafile->rasters_count];
+	status = gdip_metafile_rasterize (metafile, width, height, &key, &entry->raster);
+	if (status != Ok)
+		return status;
+
+	entry->width = width;
+	entry->height = height;
+	entry->antialias = key.antialias;
+	entry->interpolation = key.interpolation;
+	entry->text_hint = key.text_hint;
+	entry->bytes = bytes;
+	entry->stamp = ++metafile->raster_clock;
+	metafile->rasters_count++;
+	metafile->raster_bytes += bytes;
+
+	*raster = entry->raster;
+	return Ok;
+}
+
 static GpMetafile*
 gdip_metafile_create ()
 {
@@ -918,6 +1130,16 @@ gdip_metafile_create ()
 		mf->recording = FALSE;
 		mf->fp = NULL;
 		mf->stream = NULL;
+		mf->records = NULL;
+		mf->records_length = 0;
+		mf->records_capacity = 0;
+		mf->next_object = 0;
+		mf->program = NULL;
+		mf->rasters = NULL;
+		mf->rasters_count = 0;
+		mf->raster_budget = 0;
+		mf->raster_bytes = 0;
+		mf->raster_clock = 0;
 	}
 	return mf;
 }
@@ -949,6 +1171,7 @@ gdip_metafile_clone (GpMetafile *metafile, GpMetafile **clonedmetafile)
 	base = NULL;
 
 	memcpy (&mf->metafile_header, &metafile->metafile_header, sizeof (MetafileHeader));
+	mf->raster_budget = metafile->raster_budget;
 	if (metafile->length > 0) {
 		mf->data = GdipAlloc (metafile->length);
 		if (!mf->data) {
@@ -970,6 +1193,15 @@ gdip_metafile_dispose (GpMetafile *metafile)
 	if (!metafile)
 		return InvalidParameter;
 
+	if (metafile->recording)
+		gdip_metafile_stop_recording (metafile);
+
+	if (metafile->program) {
+		gdip_metafile_program_free (metafile->program);
+		metafile->program = NULL;
+	}
+	gdip_metafile_clear_rasters (metafile);
+
 	/* TODO deal with "delete" flag */
 	metafile->length = 0;
 	if (metafile->data) {
@@ -977,9 +1209,6 @@ gdip_metafile_dispose (GpMetafile *metafile)
 		metafile->data = NULL;
 	}
 
-	if (metafile->recording)
-		gdip_metafile_stop_recording (metafile);
-
 	GdipFree (metafile);
 	return Ok;
 }
@@ -1010,10 +1239,263 @@ gdip_get_bitmap_from_metafile (GpMetafile *metafile, INT width, INT height, GpIm
 	return GdipGetImageThumbnail ((GpImage *) metafile, width, height, thumbnail, NULL, NULL);
 }
 
+/*
+ * EMR_GDICOMMENT records are kept under 64KB, each one holding whole EMF+ records. Object records that don't fit
+ * are split into continued records, the other ones get a comment of their own.
+ */
+#define EMFPLUS_COMMENT_MAX_DATA	(65536 - 16)
+/* the object data of a continued record, after its header and the total object size */
+#define EMFPLUS_CONTINUED_MAX_DATA	(EMFPLUS_COMMENT_MAX_DATA - EMFPLUS_RECORD_HEADER_SIZE - 4)
+
+/* EMF and EMF+ are little endian, whatever the host is */
+void
+gdip_metafile_put_dword (BYTE *p, DWORD value)
+{
+	p [0] = value & 0xFF;
+	p [1] = (value >> 8) & 0xFF;
+	p [2] = (value >> 16) & 0xFF;
+	p [3] = (value >> 24) & 0xFF;
+}
+
+static DWORD
+emf_get_dword (const BYTE *p)
+{
+	return p [0] | (p [1] << 8) | (p [2] << 16) | ((DWORD) p [3] << 24);
+}
+
+/* convert a recording frame coordinate into the 0.01mm units of an EMF frame */
+static LONG
+emf_frame_units (float value, MetafileFrameUnit unit, float dpi)
+{
+	switch (unit) {
+	case MetafileFrameUnitPoint:
+		return iround (value * 2540.0f / 72.0f);
+	case MetafileFrameUnitInch:
+		return iround (value * 2540.0f);
+	case MetafileFrameUnitDocument:
+		return iround (value * 2540.0f / 300.0f);
+	case MetafileFrameUnitMillimeter:
+		return iround (value * 100.0f);
+	case MetafileFrameUnitGdi:
+		return iround (value);
+	case MetafileFrameUnitPixel:
+	default:
+		return iround (value * 2540.0f / dpi);
+	}
+}
+
+/* write an EMR_GDICOMMENT header for @size bytes of EMF+ records, nothing is written while sizing (@p is NULL) */
+static BYTE*
+emf_put_comment (BYTE *p, int size)
+{
+	if (p) {
+		gdip_metafile_put_dword (p, EMR_GDICOMMENT);
+		gdip_metafile_put_dword (p + 4, 16 + size);
+		gdip_metafile_put_dword (p + 8, 4 + size);
+		gdip_metafile_put_dword (p + 12, EMFPLUS_COMMENT_SIGNATURE);
+	}
+	return p ? p + 16 : NULL;
+}
+
+/* lay out the EMR_GDICOMMENT records into @data, or only size them when @data is NULL */
+static int
+gdip_metafile_pack_comments (GpMetafile *metafile, BYTE *data, int *records)
+{
+	BYTE *p = data;
+	int length = 0;
+	int offset = 0;
+
+	*records = 0;
+	while (offset < metafile->records_length) {
+		BYTE *record = metafile->records + offset;
+		int size = emf_get_dword (record + 4);
+		int chunk = 0;
+
+		if ((size > EMFPLUS_COMMENT_MAX_DATA) && ((record [0] | (record [1] << 8)) == EmfPlusRecordTypeObject)) {
+			/* every part but the last is flagged as continued and starts with the total object size */
+			DWORD flags = record [2] | (record [3] << 8);
+			int total = size - EMFPLUS_RECORD_HEADER_SIZE;
+			int done = 0;
+
+			while (done < total) {
+				int part = MIN (total - done, EMFPLUS_CONTINUED_MAX_DATA);
+				BOOL continued = (done + part < total);
+				int header = EMFPLUS_RECORD_HEADER_SIZE + (continued ? 4 : 0);
+
+				p = emf_put_comment (p, header + part);
+				if (p) {
+					gdip_metafile_put_dword (p, EmfPlusRecordTypeObject |
+						((continued ? (flags | EMFPLUS_OBJECT_CONTINUED) : flags) << 16));
+					gdip_metafile_put_dword (p + 4, header + part);
+					gdip_metafile_put_dword (p + 8, header + part - EMFPLUS_RECORD_HEADER_SIZE);
+					if (continued)
+						gdip_metafile_put_dword (p + 12, total);
+					memcpy (p + header, record + EMFPLUS_RECORD_HEADER_SIZE + done, part);
+					p += header + part;
+				}
+
+				length += 16 + header + part;
+				done += part;
+				(*records)++;
+			}
+
+			offset += size;
+			continue;
+		}
+
+		while (offset + chunk < metafile->records_length) {
+			size = emf_get_dword (metafile->records + offset + chunk + 4);
+			if (chunk > 0 && chunk + size > EMFPLUS_COMMENT_MAX_DATA)
+				break;
+			chunk += size;
+		}
+
+		p = emf_put_comment (p, chunk);
+		if (p) {
+			memcpy (p, metafile->records + offset, chunk);
+			p += chunk;
+		}
+
+		length += 16 + chunk;
+		offset += chunk;
+		(*records)++;
+	}
+
+	return length;
+}
+
+/* pack the recorded EMF+ records into EMR_GDICOMMENT records, followed by EMR_EOF */
+static GpStatus
+gdip_metafile_pack_records (GpMetafile *metafile)
+{
+	BYTE *data, *p;
+	int records;
+	int length;
+
+	/* size everything first */
+	length = gdip_metafile_pack_comments (metafile, NULL, &records) + 20;
+
+	data = GdipAlloc (length);
+	if (!data)
+		return OutOfMemory;
+
+	p = data + gdip_metafile_pack_comments (metafile, data, &records);
+
+	/* EMR_EOF without palette entries */
+	gdip_metafile_put_dword (p, EMR_EOF);
+	gdip_metafile_put_dword (p + 4, 20);
+	gdip_metafile_put_dword (p + 8, 0);
+	gdip_metafile_put_dword (p + 12, 16);
+	gdip_metafile_put_dword (p + 16, 20);
+
+	if (metafile->data)
+		GdipFree (metafile->data);
+	metafile->data = data;
+	metafile->length = length;
+	/* the EMF header and the records */
+	metafile->metafile_header.Header.Emf.nRecords = records + 2;
+	return Ok;
+}
+
+static void
+gdip_metafile_fill_recorded_header (GpMetafile *metafile)
+{
+	MetafileHeader *header = &metafile->metafile_header;
+	ENHMETAHEADER3 *emf = &header->Header.Emf;
+	float dpi = gdip_get_display_dpi ();
+
+	emf->iType = 1;
+	emf->nSize = sizeof (ENHMETAHEADER3);
+	emf->rclBounds.left = header->X;
+	emf->rclBounds.top = header->Y;
+	emf->rclBounds.right = header->X + header->Width;
+	emf->rclBounds.bottom = header->Y + header->Height;
+	emf->rclFrame.left = emf_frame_units (header->X, metafile->frame_unit, dpi);
+	emf->rclFrame.top = emf_frame_units (header->Y, metafile->frame_unit, dpi);
+	emf->rclFrame.right = emf_frame_units (header->X + header->Width, metafile->frame_unit, dpi);
+	emf->rclFrame.bottom = emf_frame_units (header->Y + header->Height, metafile->frame_unit, dpi);
+	emf->dSignature = 0x464D4520;
+	emf->nVersion = 0x10000;
+	emf->nBytes = emf->nSize + metafile->length;
+	emf->nHandles = 1;
+	emf->sReserved = 0;
+	emf->nDescription = 0;
+	emf->offDescription = 0;
+	emf->nPalEntries = 0;
+	/* a 25.4cm device, whose size in pixels gives back the display resolution */
+	emf->szlDevice.cx = iround (dpi * 10);
+	emf->szlDevice.cy = iround (dpi * 10);
+	emf->szlMillimeters.cx = 254;
+	emf->szlMillimeters.cy = 254;
+
+	header->Size = emf->nBytes;
+	header->Version = EMFPLUS_VERSION;
+	header->EmfPlusFlags = EMFPLUS_HEADER_VIDEO_DISPLAY;
+	header->DpiX = dpi;
+	header->DpiY = dpi;
+	header->EmfPlusHeaderSize = EMFPLUS_HEADER_SIZE;
+	header->LogicalDpiX = dpi;
+	header->LogicalDpiY = dpi;
+}
+
+static GpStatus
+gdip_metafile_write_recorded (GpMetafile *metafile)
+{
+	ENHMETAHEADER3 *emf = &metafile->metafile_header.Header.Emf;
+	BYTE header [sizeof (ENHMETAHEADER3)];
+	DWORD fields [] = {
+		emf->iType, emf->nSize,
+		emf->rclBounds.left, emf->rclBounds.top, emf->rclBounds.right, emf->rclBounds.bottom,
+		emf->rclFrame.left, emf->rclFrame.top, emf->rclFrame.right, emf->rclFrame.bottom,
+		emf->dSignature, emf->nVersion, emf->nBytes, emf->nRecords,
+		emf->nHandles | (emf->sReserved << 16),
+		emf->nDescription, emf->offDescription, emf->nPalEntries,
+		emf->szlDevice.cx, emf->szlDevice.cy, emf->szlMillimeters.cx, emf->szlMillimeters.cy
+	};
+	int i;
+
+	for (i = 0; i < sizeof (fields) / sizeof (DWORD); i++)
+		gdip_metafile_put_dword (header + i * sizeof (DWORD), fields [i]);
+
+	if (metafile->fp) {
+		if ((fwrite (header, sizeof (header), 1, metafile->fp) != 1) ||
+			(fwrite (metafile->data, metafile->length, 1, metafile->fp) != 1))
+			return Win32Error;
+	} else {
+		if ((metafile->stream (header, sizeof (header)) != sizeof (header)) ||
+			(metafile->stream (metafile->data, metafile->length) != metafile->length))
+			return Win32Error;
+	}
+	return Ok;
+}
+
 GpStatus
 gdip_metafile_stop_recording (GpMetafile *metafile)
 {
-	/* TODO save current stuff */
+	GpStatus status;
+
+	/* whatever was compiled or rasterized doesn't match the new records */
+	if (metafile->program) {
+		gdip_metafile_program_free (metafile->program);
+		metafile->program = NULL;
+	}
+	gdip_metafile_clear_rasters (metafile);
+
+	status = gdip_metafile_record_end_of_file (metafile);
+	if (status == Ok)
+		status = gdip_metafile_pack_records (metafile);
+	if (status == Ok) {
+		gdip_metafile_fill_recorded_header (metafile);
+		if (metafile->fp || metafile->stream)
+			status = gdip_metafile_write_recorded (metafile);
+	}
+
+	if (metafile->records) {
+		GdipFree (metafile->records);
+		metafile->records = NULL;
+		metafile->records_length = 0;
+		metafile->records_capacity = 0;
+	}
 
 	if (metafile->fp) {
 		fclose (metafile->fp);
@@ -1025,7 +1507,7 @@ gdip_metafile_stop_recording (GpMetafile *metafile)
 	}
 	/* we cannot open a new graphics instance on this metafile - recording is over */
 	metafile->recording = FALSE;
-	return Ok;
+	return status;
 }
 
 MetafilePlayContext*
@@ -1052,6 +1534,7 @@ gdip_metafile_play_setup (GpMetafile *metafile, GpGraphics *graphics, int x, int
 	context->graphics = graphics;
 	context->use_path = FALSE;
 	context->path = NULL;
+	context->emfplus = NULL;
 
 	/* keep a copy for clean up */
 	GdipGetWorldTransform (graphics, &context->initial);
@@ -1100,6 +1583,7 @@ gdip_metafile_play_setup (GpMetafile *metafile, GpGraphics *graphics, int x, int
 	/* Create* functions store the object here */
 	context->created.type = METAOBJECT_TYPE_EMPTY;
 	context->created.ptr = NULL;
+	context->created.shared = FALSE;
 
 	/* stock objects */
 	context->stock_pen_white = NULL;
@@ -1136,32 +1620,463 @@ gdip_metafile_play_setup (GpMetafile *metafile, GpGraphics *graphics, int x, int
 	for (i = 0; i < context->objects_count; i++) {
 		obj->type = METAOBJECT_TYPE_EMPTY;
 		obj->ptr = NULL;
+		obj->shared = FALSE;
 		obj++;
 	}
 
 	return context;
 }
 
+/*
+ * Compiled programs - the records of EMF and WMF metafiles are decoded once, into operations whose points are
+ * already converted, whose pens and brushes are already created and whose map mode scales are already known.
+ * Every playback of the metafile then only runs the operations.
+ */
+
+MetafileOp*
+gdip_metafile_program_add (MetafileProgram *program, MetafileOpCode code)
+{
+	MetafileOp *op;
+
+	if (program->count == program->capacity) {
+		int capacity = program->capacity ? program->capacity * 2 : 64;
+		MetafileOp *ops = gdip_realloc (program->ops, capacity * sizeof (MetafileOp));
+		if (!ops)
+			return NULL;
+
+		program->ops = ops;
+		program->capacity = capacity;
+	}
+
+	op = &program->ops [program->count++];
+	memset (op, 0, sizeof (MetafileOp));
+	op->code = code;
+	return op;
+}
+
+/* add an operation taking, at most, two integer arguments */
 GpStatus
-gdip_metafile_play (MetafilePlayContext *context)
+gdip_metafile_program_add_simple (MetafileProgram *program, MetafileOpCode code, int arg0, int arg1)
 {
-	if (!context || !context->metafile)
-		return InvalidParameter;
+	MetafileOp *op = gdip_metafile_program_add (program, code);
+	if (!op)
+		return OutOfMemory;
 
-	switch (context->metafile->metafile_header.Type) {
+	op->args.i [0] = arg0;
+	op->args.i [1] = arg1;
+	return Ok;
+}
+
+/* reserve @count points for @op, the returned points are valid until more points are added */
+GpPointF*
+gdip_metafile_program_add_points (MetafileProgram *program, MetafileOp *op, int count)
+{
+	GpPointF *points;
+
+	if (count < 0 || count > G_MAXINT / sizeof (GpPointF) - program->points_count)
+		return NULL;
+
+	if (program->points_count + count > program->points_capacity) {
+		int capacity = program->points_capacity ? program->points_capacity : 256;
+		while (capacity < program->points_count + count && capacity <= G_MAXINT / (2 * sizeof (GpPointF)))
+			capacity *= 2;
+		if (capacity < program->points_count + count)
+			capacity = program->points_count + count;
+
+		points = gdip_realloc (program->points, capacity * sizeof (GpPointF));
+		if (!points)
+			return NULL;
+
+		program->points = points;
+		program->points_capacity = capacity;
+	}
+
+	op->first = program->points_count;
+	op->count = count;
+	program->points_count += count;
+	return program->points + op->first;
+}
+
+static BOOL
+gdip_metafile_program_reserve_object (MetafileProgram *program)
+{
+	if (program->objects_count == program->objects_capacity) {
+		int capacity = program->objects_capacity ? program->objects_capacity * 2 : 16;
+		MetaObject *objects = gdip_realloc (program->objects, capacity * sizeof (MetaObject));
+		if (!objects)
+			return FALSE;
+
+		program->objects = objects;
+		program->objects_capacity = capacity;
+	}
+	return TRUE;
+}
+
+/* move the object the compiler just created into the program, playback will reuse it */
+GpStatus
+gdip_metafile_program_add_created (MetafileProgram *program, MetafilePlayContext *compiler)
+{
+	MetafileOp *op;
+
+	if (compiler->created.type == METAOBJECT_TYPE_EMPTY)
+		return Ok;
+
+	if (!gdip_metafile_program_reserve_object (program))
+		return OutOfMemory;
+
+	program->objects [program->objects_count] = compiler->created;
+	program->objects [program->objects_count].shared = TRUE;
+	compiler->created.type = METAOBJECT_TYPE_EMPTY;
+	compiler->created.ptr = NULL;
+
+	op = gdip_metafile_program_add (program, MetafileOpCreateObject);
+	if (!op)
+		return OutOfMemory;
+
+	op->first = program->objects_count++;
+	return Ok;
+}
+
+/* returns the pixels of an uncompressed 32bpp DIB that cairo can paint in place, or NULL */
+static const BYTE*
+gdip_metafile_dib_pixels (const BYTE *bmi, int bmi_size, const BYTE *bits, int bits_size)
+{
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+	const BITMAPINFOHEADER *header = (const BITMAPINFOHEADER*) bmi;
+	guint64 required;
+
+	if (bmi_size < (int) sizeof (BITMAPINFOHEADER) || header->biSize < sizeof (BITMAPINFOHEADER))
+		return NULL;
+	if (header->biBitCount != 32 || header->biCompression != BI_RGB || header->biWidth <= 0 || header->biHeight == 0)
+		return NULL;
+
+	/* packed DIB, an optional color table sits between the header and the pixels */
+	if (!bits) {
+		guint64 offset = (guint64) header->biSize + (guint64) header->biClrUsed * sizeof (RGBQUAD);
+		if (offset > (guint64) bmi_size)
+			return NULL;
+
+		bits = bmi + offset;
+		bits_size = bmi_size - offset;
+	}
+
+	required = (guint64) header->biWidth * 4 * ABS ((gint64) header->biHeight);
+	if (required > (guint64) bits_size || ((gsize) bits & 3))
+		return NULL;
+
+	return bits;
+#else
+	return NULL;
+#endif
+}
+
+/*
+ * Uncompressed 32bpp DIBs are painted straight from the metafile data on every playback. Other DIBs (paletted, RLE,
+ * 16 and 24bpp) are decoded once, into a RGB bitmap kept with the program. @bits is NULL for packed DIBs, where the
+ * pixels follow the color table within the @bmi_size bytes.
+ */
+GpStatus
+gdip_metafile_program_add_dib (MetafileProgram *program, MetafileOp *op, const BYTE *bmi, int bmi_size,
+	const BYTE *bits, int bits_size)
+{
+	BYTE *packed = NULL;
+	GpImage *image = NULL;
+	MemorySource ms;
+
+	op->data = bmi;
+	op->bits = gdip_metafile_dib_pixels (bmi, bmi_size, bits, bits_size);
+	op->first = -1;
+	if (op->bits)
+		return Ok;
+
+	/* the bitmap reader expects the pixels right after the color table */
+	if (bits && (bits != bmi + bmi_size)) {
+		packed = GdipAlloc (bmi_size + bits_size);
+		if (!packed)
+			return OutOfMemory;
+
+		memcpy (packed, bmi, bmi_size);
+		memcpy (packed + bmi_size, bits, bits_size);
+		ms.ptr = packed;
+	} else {
+		ms.ptr = (BYTE*) bmi;
+	}
+	ms.size = bits ? bmi_size + bits_size : bmi_size;
+	ms.pos = 0;
+
+	/* like GDI an invalid DIB draws nothing, but the rest of the metafile is still played */
+	if (gdip_read_bmp_image (&ms, &image, Memory) != Ok)
+		image = NULL;
+	if (packed)
+		GdipFree (packed);
+	if (!image)
+		return Ok;
+
+	/* otherwise every playback would convert the pixels again */
+	if (gdip_is_an_indexed_pixelformat (image->active_bitmap->pixel_format)) {
+		GpBitmap *rgb_bitmap = gdip_convert_indexed_to_rgb (image);
+		GdipDisposeImage (image);
+		if (!rgb_bitmap)
+			return OutOfMemory;
+
+		image = rgb_bitmap;
+	}
+
+	if (!gdip_metafile_program_reserve_object (program)) {
+		GdipDisposeImage (image);
+		return OutOfMemory;
+	}
+
+	program->objects [program->objects_count].ptr = image;
+	program->objects [program->objects_count].type = METAOBJECT_TYPE_IMAGE;
+	program->objects [program->objects_count].shared = TRUE;
+	op->first = program->objects_count++;
+	return Ok;
+}
+
+GpStatus
+gdip_metafile_program_map_mode (MetafileProgram *program, MetafilePlayContext *compiler, DWORD mode)
+{
+	MetafileOp *op = gdip_metafile_program_add (program, MetafileOpSetMapMode);
+	if (!op)
+		return OutOfMemory;
+
+	compiler->map_mode = gdip_metafile_map_mode_scale (mode, &op->args.f [1]);
+	op->args.i [0] = compiler->map_mode;
+	return Ok;
+}
+
+GpStatus
+gdip_metafile_program_window_ext (MetafileProgram *program, MetafilePlayContext *compiler, int height, int width)
+{
+	MetafileOp *op;
+	float sx, sy;
+
+	/* nothing to do unless the map mode scales with the window */
+	if (!gdip_metafile_window_ext_scale (compiler->metafile, compiler->map_mode, height, width, &sx, &sy))
+		return Ok;
+
+	op = gdip_metafile_program_add (program, MetafileOpSetWindowScale);
+	if (!op)
+		return OutOfMemory;
+
+	op->args.f [0] = sx;
+	op->args.f [1] = sy;
+	return Ok;
+}
+
+void
+gdip_metafile_program_free (MetafileProgram *program)
+{
+	int i;
+
+	for (i = 0; i < program->objects_count; i++) {
+		MetaObject *obj = &program->objects [i];
+		switch (obj->type) {
+		case METAOBJECT_TYPE_PEN:
+			GdipDeletePen ((GpPen*)obj->ptr);
+			break;
+		case METAOBJECT_TYPE_BRUSH:
+			GdipDeleteBrush ((GpBrush*)obj->ptr);
+			break;
+		case METAOBJECT_TYPE_IMAGE:
+			GdipDisposeImage ((GpImage*)obj->ptr);
+			break;
+		}
+	}
+
+	if (program->objects)
+		GdipFree (program->objects);
+	if (program->points)
+		GdipFree (program->points);
+	if (program->ops)
+		GdipFree (program->ops);
+	GdipFree (program);
+}
+
+static GpStatus
+gdip_metafile_compile (GpMetafile *metafile, MetafileProgram **result)
+{
+	MetafileProgram *program;
+	GpStatus status;
+
+	program = GdipAlloc (sizeof (MetafileProgram));
+	if (!program)
+		return OutOfMemory;
+
+	memset (program, 0, sizeof (MetafileProgram));
+
+	switch (metafile->metafile_header.Type) {
 	case MetafileTypeWmfPlaceable:
 	case MetafileTypeWmf:
-		return gdip_metafile_play_wmf (context);
+		status = gdip_metafile_compile_wmf (metafile, program);
+		break;
 	case MetafileTypeEmf:
-		return gdip_metafile_play_emf (context);
 	case MetafileTypeEmfPlusOnly:
 	case MetafileTypeEmfPlusDual:
-		return gdip_metafile_play_emf (context);
+		status = gdip_metafile_compile_emf (metafile, program);
+		break;
 	default:
-		g_warning ("Invalid metafile format %d", context->metafile->metafile_header.Type);
+		g_warning ("Invalid metafile format %d", metafile->metafile_header.Type);
+		status = NotImplemented;
 		break;
 	}
-	return NotImplemented;
+
+	/* invalid records end the program but what comes before them is still played, like GDI+ does */
+	if (status == OutOfMemory || status == NotImplemented) {
+		gdip_metafile_program_free (program);
+		return status;
+	}
+
+	program->status = status;
+	*result = program;
+	return Ok;
+}
+
+static GpStatus
+gdip_metafile_play_op (MetafilePlayContext *context, MetafileProgram *program, MetafileOp *op)
+{
+	GpPointF *points = program->points + op->first;
+
+	switch (op->code) {
+	case MetafileOpSaveDC:
+		return gdip_metafile_SaveDC (context);
+	case MetafileOpRestoreDC:
+		return gdip_metafile_RestoreDC (context);
+	case MetafileOpSetBkMode:
+		return gdip_metafile_SetBkMode (context, op->args.i [0]);
+	case MetafileOpSetBkColor:
+		return gdip_metafile_SetBkColor (context, op->args.i [0]);
+	case MetafileOpSetMapMode:
+		context->map_mode = op->args.i [0];
+		if (op->args.f [1] == 0)
+			return Ok;
+		return gdip_metafile_set_scale (context, op->args.f [1], op->args.f [1]);
+	case MetafileOpSetWindowOrg:
+		return gdip_metafile_SetWindowOrg (context, op->args.i [0], op->args.i [1]);
+	case MetafileOpSetWindowScale:
+		return gdip_metafile_set_scale (context, op->args.f [0], op->args.f [1]);
+	case MetafileOpSetROP2:
+		return gdip_metafile_SetROP2 (context, op->args.i [0]);
+	case MetafileOpSetRelabs:
+		return gdip_metafile_SetRelabs (context, op->args.i [0]);
+	case MetafileOpSetPolyFillMode:
+		return gdip_metafile_SetPolyFillMode (context, op->args.i [0]);
+	case MetafileOpSetStretchBltMode:
+		return gdip_metafile_SetStretchBltMode (context, op->args.i [0]);
+	case MetafileOpSetTextAlign:
+		return gdip_metafile_SetTextAlign (context, op->args.i [0]);
+	case MetafileOpSetMiterLimit:
+		return gdip_metafile_SetMiterLimit (context, op->args.f [0], NULL);
+	case MetafileOpModifyWorldTransform: {
+		XFORM xf;
+		xf.eM11 = op->args.f [0];
+		xf.eM12 = op->args.f [1];
+		xf.eM21 = op->args.f [2];
+		xf.eM22 = op->args.f [3];
+		xf.eDx = op->args.f [4];
+		xf.eDy = op->args.f [5];
+		return gdip_metafile_ModifyWorldTransform (context, &xf, op->args.i [6]);
+	}
+	case MetafileOpCreateObject:
+		context->created = program->objects [op->first];
+		return Ok;
+	case MetafileOpSelectObject:
+		return gdip_metafile_SelectObject (context, op->args.i [0]);
+	case MetafileOpDeleteObject:
+		return gdip_metafile_DeleteObject (context, op->args.i [0]);
+	case MetafileOpMoveTo:
+		return gdip_metafile_MoveTo (context, op->args.i [0], op->args.i [1]);
+	case MetafileOpLineTo:
+		return gdip_metafile_LineTo (context, op->args.i [0], op->args.i [1]);
+	case MetafileOpPolyline: {
+		int p;
+		for (p = 1; p < op->count; p++) {
+			GpStatus status = GdipDrawLine (context->graphics, gdip_metafile_GetSelectedPen (context),
+				points [p - 1].X, points [p - 1].Y, points [p].X, points [p].Y);
+			if (status != Ok)
+				return status;
+		}
+		return Ok;
+	}
+	case MetafileOpPolygon:
+		return gdip_metafile_Polygon (context, points, op->count);
+	case MetafileOpPolyBezier:
+		/* the first point is reserved for the current position, and the last one becomes it */
+		points [0].X = context->current_x;
+		points [0].Y = context->current_y;
+		context->path_x = context->current_x;
+		context->path_y = context->current_y;
+		context->current_x = points [op->count - 1].X;
+		context->current_y = points [op->count - 1].Y;
+		return gdip_metafile_PolyBezier (context, points, op->count);
+	case MetafileOpArc:
+		return gdip_metafile_Arc (context, op->args.i [0], op->args.i [1], op->args.i [2], op->args.i [3],
+			op->args.i [4], op->args.i [5], op->args.i [6], op->args.i [7]);
+	case MetafileOpRectangle:
+		return gdip_metafile_Rectangle (context, op->args.i [0], op->args.i [1], op->args.i [2], op->args.i [3]);
+	case MetafileOpSetPixel:
+		return gdip_metafile_SetPixel (context, op->args.i [0], op->args.i [1], op->args.i [2]);
+	case MetafileOpStretchDIBits:
+		return gdip_metafile_StretchDIBits (context, op->args.i [0], op->args.i [1], op->args.i [2], op->args.i [3],
+			op->args.i [4], op->args.i [5], op->args.i [6], op->args.i [7], op->bits, (CONST BITMAPINFO*) op->data,
+			op->args.i [8], op->args.i [9], (op->first < 0) ? NULL : (GpImage*) program->objects [op->first].ptr);
+	case MetafileOpBeginPath:
+		return gdip_metafile_BeginPath (context);
+	case MetafileOpEndPath:
+		return gdip_metafile_EndPath (context);
+	case MetafileOpCloseFigure:
+		return gdip_metafile_CloseFigure (context);
+	case MetafileOpFillPath:
+		return gdip_metafile_FillPath (context);
+	case MetafileOpStrokePath:
+		return gdip_metafile_StrokePath (context);
+	case MetafileOpStrokeAndFillPath:
+		return gdip_metafile_StrokeAndFillPath (context);
+	case MetafileOpEmfPlus:
+		return gdip_metafile_play_emfplus_block (context, (BYTE*) op->data, op->count);
+	default:
+		return Ok;
+	}
+}
+
+GpStatus
+gdip_metafile_play (MetafilePlayContext *context)
+{
+	GpMetafile *metafile;
+	GpStatus status;
+	int i;
+
+	if (!context || !context->metafile)
+		return InvalidParameter;
+
+	metafile = context->metafile;
+	/* check for empty or recording metafile */
+	if (!metafile->data || metafile->recording)
+		return Ok;
+
+	if (!metafile->program) {
+		status = gdip_metafile_compile (metafile, &metafile->program);
+		if (status != Ok)
+			return status;
+	}
+
+	for (i = 0; i < metafile->program->count; i++) {
+		MetafileOp *op = &metafile->program->ops [i];
+
+		/* the GDI drawing of EMF+ dual metafiles duplicates the EMF+ one, unless a GetDC record asks for it */
+		if (context->emfplus && context->emfplus->dual && !context->emfplus->get_dc &&
+			(op->code >= MetafileOpMoveTo) && (op->code <= MetafileOpStrokeAndFillPath))
+			continue;
+
+		status = gdip_metafile_play_op (context, metafile->program, op);
+		if (status != Ok) {
+			g_warning ("Playback interupted, status %d returned from operation %d.", status, op->code);
+			return status;
+		}
+	}
+
+	return metafile->program->status;
 }
 
 GpStatus
@@ -1170,6 +2085,7 @@ gdip_metafile_play_cleanup (MetafilePlayContext *context)
 	if (!context)
 		return InvalidParameter;
 
+	gdip_metafile_play_emfplus_cleanup (context);
 	GdipSetWorldTransform (context->graphics, &context->initial);
 	context->graphics = NULL;
 	if (context->path) {
@@ -1945,6 +2861,7 @@ GdipRecordMetafile (HDC referenceHdc, EmfType type, GDIPCONST GpRectF *frameRect
 	mf->metafile_header.Height = frameRect->Height;
 	mf->metafile_header.Size = 0;
 	mf->metafile_header.Type = (MetafileType)type;
+	mf->frame_unit = frameUnit;
 	mf->recording = TRUE;
 
 	/* TODO - more stuff here! */
@@ -2019,6 +2936,25 @@ GdipRecordMetafileFileNameI (GDIPCONST WCHAR *fileName, HDC referenceHdc, EmfTyp
 	return GdipRecordMetafileFileName (fileName, referenceHdc, type, (GDIPCONST GpRectF*) &rect, frameUnit, description, metafile);
 }
 
+/*
+ * GdipSetMetafileRasterCacheSize_linux - keep up to @size bytes of rasters of the metafile, one for each device
+ * size (and smoothing, interpolation and text rendering settings) it's drawn at, so drawing it again the same way
+ * paints the raster instead of playing the records. A @size of 0, the default, disables and empties the cache.
+ */
+GpStatus WINGDIPAPI
+GdipSetMetafileRasterCacheSize_linux (GpMetafile *metafile, UINT size)
+{
+	if (!metafile || metafile->base.type != ImageTypeMetafile)
+		return InvalidParameter;
+
+	metafile->raster_budget = size;
+	if (size)
+		gdip_metafile_evict_rasters (metafile, 0);
+	else
+		gdip_metafile_clear_rasters (metafile);
+	return Ok;
+}
+
 /*
  * GdipRecordMetafileStream and GdipRecordMetafileStreamI will never be implemented, as 'stream' is a COM IStream ...
  */
@@ -2056,8 +2992,8 @@ GdipRecordMetafileFromDelegate_linux (GetHeaderDelegate getHeaderFunc, GetBytesD
 	if (status != Ok)
 		return status;
 
-	/* TODO - keep delegates around to write stuff */
-
+	/* the records are written when recording stops */
+	(*metafile)->stream = putBytesFunc;
 	return Ok;
 }
 
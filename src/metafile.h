@@ -83,4 +83,8 @@ GpStatus WINGDIPAPI GdipRecordMetafileFromDelegateI_linux (GetHeaderDelegate get
 	EmfType type, GDIPCONST GpRect *frameRect, MetafileFrameUnit frameUnit, GDIPCONST WCHAR *description,
 	GpMetafile **metafile);
 
+/* extra public (exported) function in libgdiplus, caches the metafile rasterized at the sizes it is drawn to */
+
+GpStatus WINGDIPAPI GdipSetMetafileRasterCacheSize_linux (GpMetafile *metafile, UINT size);
+
 #endif
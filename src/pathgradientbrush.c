@@ -30,6 +30,7 @@
 #include "graphics-private.h"
 #include "graphics-path-private.h"
 #include "matrix-private.h"
+#include "texturebrush-private.h"
 
 static GpStatus gdip_pgrad_setup (GpGraphics *graphics, GpBrush *brush);
 static GpStatus gdip_pgrad_clone_brush (GpBrush *brush, GpBrush **clonedBrush);
@@ -273,6 +274,8 @@ gdip_pgrad_destroy (GpBrush *brush)
 	return Ok;
 }
 
+#if CAIRO_VERSION < CAIRO_VERSION_ENCODE(1, 12, 0)
+
 static void
 add_color_stops_from_blend (cairo_pattern_t *pattern, Blend *blend, ARGB color1, ARGB color2)
 {
@@ -327,6 +330,367 @@ add_color_stops_from_interpolation_colors (cairo_pattern_t *pattern, Interpolati
 	}
 }
 
+static cairo_pattern_t *
+gdip_pgrad_create_radial_pattern (GpPathGradient *pgbrush)
+{
+	cairo_pattern_t *pat;
+	float r = MIN (pgbrush->rectangle.Width / 2, pgbrush->rectangle.Height / 2);
+
+	/* Set the start radius as r and the end radius as 0 so that the center is the end "circle".
+	 * That way interpolation and blend positions go the right direction (edge to center).*/
+	pat = cairo_pattern_create_radial (pgbrush->center.X, pgbrush->center.Y, r,
+		pgbrush->center.X, pgbrush->center.Y, 0.0f);
+	/* the caller checks (and releases) a pattern in error */
+	if (cairo_pattern_status (pat) != CAIRO_STATUS_SUCCESS)
+		return pat;
+
+	if ((pgbrush->blend->count > 1) && (pgbrush->boundaryColorsCount > 0)) {
+		/* FIXME: blending done using the a radial shape (not the path shape) */
+		add_color_stops_from_blend (pat, pgbrush->blend, pgbrush->boundaryColors[0], pgbrush->centerColor);
+	} else if (pgbrush->presetColors->count > 1) {
+		/* FIXME: copied from lineargradiantbrush, most probably not right */
+		add_color_stops_from_interpolation_colors (pat, pgbrush->presetColors);
+	} else {
+		cairo_pattern_add_color_stop_rgba (pat, 1.0f,
+			ARGB_RED_N (pgbrush->centerColor),
+			ARGB_GREEN_N (pgbrush->centerColor),
+			ARGB_BLUE_N (pgbrush->centerColor),
+			ARGB_ALPHA_N (pgbrush->centerColor));
+
+		/* if a single other boundary color is present, then we can do the a real radial */
+		if (pgbrush->boundaryColorsCount == 1) {
+			ARGB c = pgbrush->boundaryColors[0];
+			cairo_pattern_add_color_stop_rgba (pat, 0.0f,
+				ARGB_RED_N (c), ARGB_GREEN_N (c), ARGB_BLUE_N (c), ARGB_ALPHA_N (c));
+		} else {
+			/* FIXME: otherwise we (solid-)fill with the centerColor */
+		}
+	}
+
+	return pat;
+}
+
+#else
+
+/* maximum number of lines used to approximate a single bezier of the boundary */
+#define PGRAD_MAX_BEZIER_SEGMENTS	64
+
+static float pgrad_default_positions[2] = { 0.0f, 1.0f };
+
+static ARGB
+gdip_argb_lerp (ARGB from, ARGB to, double factor)
+{
+	int shift;
+	ARGB result = 0;
+
+	for (shift = 0; shift < 32; shift += 8) {
+		double a = (from >> shift) & 0xFF;
+		double b = (to >> shift) & 0xFF;
+		int c = (int) (a + (b - a) * factor + 0.5);
+
+		result |= ((ARGB) CLAMP (c, 0, 255)) << shift;
+	}
+
+	return result;
+}
+
+static ARGB
+gdip_pgrad_get_surround_color (GpPathGradient *pgbrush, int index)
+{
+	/* the last surround color is used for all remaining boundary points */
+	if (index >= pgbrush->boundaryColorsCount)
+		index = pgbrush->boundaryColorsCount - 1;
+
+	return pgbrush->boundaryColors[index];
+}
+
+/* The color ramp goes from the boundary (position 0.0) to the center (position 1.0) and is
+ * defined either by the preset colors, the blend factors or, by default, by a straight
+ * interpolation between the surround and the center colors.
+ */
+static int
+gdip_pgrad_get_ramp_positions (GpPathGradient *pgbrush, const float **positions)
+{
+	if (pgbrush->presetColors->count > 1) {
+		*positions = pgbrush->presetColors->positions;
+		return pgbrush->presetColors->count;
+	}
+	if (pgbrush->blend->count > 1) {
+		*positions = pgbrush->blend->positions;
+		return pgbrush->blend->count;
+	}
+
+	*positions = pgrad_default_positions;
+	return 2;
+}
+
+static ARGB
+gdip_pgrad_get_ramp_color (GpPathGradient *pgbrush, int stop, ARGB surround)
+{
+	if (pgbrush->presetColors->count > 1)
+		return pgbrush->presetColors->colors[stop];
+	if (pgbrush->blend->count > 1)
+		return gdip_argb_lerp (surround, pgbrush->centerColor, pgbrush->blend->factors[stop]);
+
+	return (stop == 0) ? surround : pgbrush->centerColor;
+}
+
+/* Position of a boundary point once moved by <t> toward the focus (0.0 is the boundary
+ * itself, 1.0 is on the focus outline, i.e. the boundary scaled by the focus scales) */
+static GpPointF
+gdip_pgrad_get_ring_point (GpPathGradient *pgbrush, GpPointF boundary, float t)
+{
+	GpPointF focus, pt;
+
+	focus.X = pgbrush->center.X + (boundary.X - pgbrush->center.X) * pgbrush->focusScales.X;
+	focus.Y = pgbrush->center.Y + (boundary.Y - pgbrush->center.Y) * pgbrush->focusScales.Y;
+
+	pt.X = boundary.X + (focus.X - boundary.X) * t;
+	pt.Y = boundary.Y + (focus.Y - boundary.Y) * t;
+	return pt;
+}
+
+static int
+gdip_pgrad_count_bezier_segments (const GpPointF *p)
+{
+	/* the control polygon length is an upper bound of the curve length */
+	double length = 0;
+	int i, segments;
+
+	for (i = 0; i < 3; i++)
+		length += sqrt ((p[i + 1].X - p[i].X) * (p[i + 1].X - p[i].X) + (p[i + 1].Y - p[i].Y) * (p[i + 1].Y - p[i].Y));
+
+	segments = (int) ceil (length / 4.0);
+	return CLAMP (segments, 1, PGRAD_MAX_BEZIER_SEGMENTS);
+}
+
+/* Flatten the figure [start, end] of the boundary into <points>, keeping track of the
+ * surround color of every point. Points generated inside a bezier get a color interpolated
+ * between the surround colors of its end points. Returns the number of points; a NULL
+ * <points> only counts them.
+ */
+static int
+gdip_pgrad_flatten_figure (GpPathGradient *pgbrush, int start, int end, GpPointF *points, ARGB *colors)
+{
+	GpPath *boundary = pgbrush->boundary;
+	int i, n = 0;
+
+	for (i = start; i <= end; i++) {
+		BYTE type = boundary->types[i] & PathPointTypePathTypeMask;
+
+		if ((type == PathPointTypeBezier) && (i > start) && (i + 2 <= end)) {
+			const GpPointF *p = &boundary->points[i - 1];
+			ARGB c0 = gdip_pgrad_get_surround_color (pgbrush, i - 1);
+			ARGB c3 = gdip_pgrad_get_surround_color (pgbrush, i + 2);
+			int s, segments = gdip_pgrad_count_bezier_segments (p);
+
+			if (points) {
+				for (s = 1; s <= segments; s++) {
+					double t = (double) s / segments;
+					double mt = 1.0 - t;
+					double b0 = mt * mt * mt;
+					double b1 = 3 * mt * mt * t;
+					double b2 = 3 * mt * t * t;
+					double b3 = t * t * t;
+
+					points[n].X = b0 * p[0].X + b1 * p[1].X + b2 * p[2].X + b3 * p[3].X;
+					points[n].Y = b0 * p[0].Y + b1 * p[1].Y + b2 * p[2].Y + b3 * p[3].Y;
+					colors[n] = gdip_argb_lerp (c0, c3, t);
+					n++;
+				}
+			} else {
+				n += segments;
+			}
+			i += 2;
+		} else {
+			if (points) {
+				points[n] = boundary->points[i];
+				colors[n] = gdip_pgrad_get_surround_color (pgbrush, i);
+			}
+			n++;
+		}
+	}
+
+	return n;
+}
+
+static void
+gdip_pgrad_set_corner_color (cairo_pattern_t *pat, unsigned int corner, ARGB color)
+{
+	cairo_mesh_pattern_set_corner_color_rgba (pat, corner,
+		ARGB_RED_N (color), ARGB_GREEN_N (color), ARGB_BLUE_N (color), ARGB_ALPHA_N (color));
+}
+
+static void
+gdip_pgrad_add_patch (cairo_pattern_t *pat, GpPointF p0, GpPointF p1, GpPointF p2, GpPointF p3,
+	ARGB c0, ARGB c1, ARGB c2, ARGB c3)
+{
+	cairo_mesh_pattern_begin_patch (pat);
+	cairo_mesh_pattern_move_to (pat, p0.X, p0.Y);
+	cairo_mesh_pattern_line_to (pat, p1.X, p1.Y);
+	cairo_mesh_pattern_line_to (pat, p2.X, p2.Y);
+	cairo_mesh_pattern_line_to (pat, p3.X, p3.Y);
+	gdip_pgrad_set_corner_color (pat, 0, c0);
+	gdip_pgrad_set_corner_color (pat, 1, c1);
+	gdip_pgrad_set_corner_color (pat, 2, c2);
+	gdip_pgrad_set_corner_color (pat, 3, c3);
+	cairo_mesh_pattern_end_patch (pat);
+}
+
+/* Triangulate every figure of the boundary around the center point. Each boundary edge is
+ * swept toward the focus outline as one band of patches per color ramp interval; the area
+ * inside the focus outline (if any) is closed with a last patch ending on the center.
+ */
+static GpStatus
+gdip_pgrad_add_figure_patches (GpPathGradient *pgbrush, cairo_pattern_t *pat, int start, int end)
+{
+	GpPointF *points;
+	ARGB *colors;
+	const float *positions;
+	int count, stops, i, k;
+	BOOL has_focus = (pgbrush->focusScales.X != 0.0f) || (pgbrush->focusScales.Y != 0.0f);
+
+	count = gdip_pgrad_flatten_figure (pgbrush, start, end, NULL, NULL);
+	if (count < 2)
+		return Ok;
+
+	points = (GpPointF *) GdipAlloc (count * sizeof (GpPointF));
+	if (!points)
+		return OutOfMemory;
+	colors = (ARGB *) GdipAlloc (count * sizeof (ARGB));
+	if (!colors) {
+		GdipFree (points);
+		return OutOfMemory;
+	}
+
+	gdip_pgrad_flatten_figure (pgbrush, start, end, points, colors);
+	stops = gdip_pgrad_get_ramp_positions (pgbrush, &positions);
+
+	for (i = 0; i < count; i++) {
+		int j = (i + 1) % count;
+
+		for (k = 0; k + 1 < stops; k++) {
+			float t0 = positions[k];
+			float t1 = positions[k + 1];
+
+			if (t1 <= t0)
+				continue;
+
+			gdip_pgrad_add_patch (pat,
+				gdip_pgrad_get_ring_point (pgbrush, points[i], t0),
+				gdip_pgrad_get_ring_point (pgbrush, points[j], t0),
+				gdip_pgrad_get_ring_point (pgbrush, points[j], t1),
+				gdip_pgrad_get_ring_point (pgbrush, points[i], t1),
+				gdip_pgrad_get_ramp_color (pgbrush, k, colors[i]),
+				gdip_pgrad_get_ramp_color (pgbrush, k, colors[j]),
+				gdip_pgrad_get_ramp_color (pgbrush, k + 1, colors[j]),
+				gdip_pgrad_get_ramp_color (pgbrush, k + 1, colors[i]));
+		}
+
+		if (has_focus) {
+			ARGB ci = gdip_pgrad_get_ramp_color (pgbrush, stops - 1, colors[i]);
+			ARGB cj = gdip_pgrad_get_ramp_color (pgbrush, stops - 1, colors[j]);
+
+			gdip_pgrad_add_patch (pat,
+				gdip_pgrad_get_ring_point (pgbrush, points[i], 1.0f),
+				gdip_pgrad_get_ring_point (pgbrush, points[j], 1.0f),
+				pgbrush->center, pgbrush->center,
+				ci, cj, cj, ci);
+		}
+	}
+
+	GdipFree (points);
+	GdipFree (colors);
+	return Ok;
+}
+
+static cairo_pattern_t *
+gdip_pgrad_create_mesh_pattern (GpPathGradient *pgbrush)
+{
+	GpPath *boundary = pgbrush->boundary;
+	cairo_pattern_t *pat;
+	int start, end;
+
+	pat = cairo_pattern_create_mesh ();
+	/* the caller checks (and releases) a pattern in error */
+	if (cairo_pattern_status (pat) != CAIRO_STATUS_SUCCESS)
+		return pat;
+
+	for (start = 0; start < boundary->count; start = end + 1) {
+		/* a figure ends before the next start point */
+		for (end = start; end + 1 < boundary->count; end++) {
+			if ((boundary->types[end + 1] & PathPointTypePathTypeMask) == PathPointTypeStart)
+				break;
+		}
+
+		if (gdip_pgrad_add_figure_patches (pgbrush, pat, start, end) != Ok) {
+			cairo_pattern_destroy (pat);
+			return NULL;
+		}
+	}
+
+	return pat;
+}
+
+#endif
+
+/*
+ * The gradient itself only covers the boundary (like WrapModeClamp). The other wrap modes
+ * repeat the bounding rectangle of the boundary, so the gradient is painted once into an
+ * image (one pixel per brush unit) and that image is repeated, mirrored for TileFlip*.
+ * The pattern matrix maps the brush space onto the image.
+ */
+static cairo_pattern_t *
+gdip_pgrad_create_tile_pattern (GpPathGradient *pgbrush, cairo_pattern_t *gradient)
+{
+	cairo_surface_t *surface;
+	cairo_pattern_t *pat;
+	cairo_matrix_t offset;
+	cairo_extend_t extend = CAIRO_EXTEND_REPEAT;
+	BOOL flipX = FALSE, flipY = FALSE;
+	int width = (int) ceil (pgbrush->rectangle.Width);
+	int height = (int) ceil (pgbrush->rectangle.Height);
+	cairo_t *ct;
+
+	switch (pgbrush->wrapMode) {
+	case WrapModeTileFlipX:
+		flipX = TRUE;
+		break;
+	case WrapModeTileFlipY:
+		flipY = TRUE;
+		break;
+	case WrapModeTileFlipXY:
+		extend = CAIRO_EXTEND_REFLECT;
+		break;
+	default:
+		break;
+	}
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, MAX (width, 1), MAX (height, 1));
+	ct = cairo_create (surface);
+	cairo_translate (ct, -pgbrush->rectangle.X, -pgbrush->rectangle.Y);
+	cairo_set_source (ct, gradient);
+	cairo_paint (ct);
+	cairo_destroy (ct);
+	cairo_pattern_destroy (gradient);
+
+	if ((flipX || flipY) && (cairo_surface_status (surface) == CAIRO_STATUS_SUCCESS)) {
+		cairo_surface_t *atlas = gdip_create_mirrored_atlas (surface, flipX, flipY);
+
+		cairo_surface_destroy (surface);
+		surface = atlas;
+	}
+
+	/* a surface in error gives a pattern in error */
+	pat = cairo_pattern_create_for_surface (surface);
+	cairo_surface_destroy (surface);
+
+	cairo_pattern_set_extend (pat, extend);
+	cairo_matrix_init_translate (&offset, -pgbrush->rectangle.X, -pgbrush->rectangle.Y);
+	cairo_pattern_set_matrix (pat, &offset);
+	return pat;
+}
+
 GpStatus
 gdip_pgrad_setup (GpGraphics *graphics, GpBrush *brush)
 {
@@ -346,7 +710,7 @@ gdip_pgrad_setup (GpGraphics *graphics, GpBrush *brush)
 	 */
 	if (pgbrush->base.changed || !pgbrush->pattern) {
 		cairo_pattern_t *pat;
-		float r = MIN (pgbrush->rectangle.Width / 2, pgbrush->rectangle.Height / 2);
+		GpMatrix matrix, offset;
 
 		/* destroy the existing pattern */
 		if (pgbrush->pattern) {
@@ -354,47 +718,39 @@ gdip_pgrad_setup (GpGraphics *graphics, GpBrush *brush)
 			pgbrush->pattern = NULL;
 		}
 
-		/* FIXME: To fully implement this function we need cairo to support path gradients.
-		 * Right now we have radial gradient which can be used, in some cases, to get the right effect.
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE(1, 12, 0)
+		/* the boundary is triangulated into a mesh, which honors the path shape,
+		 * the surround colors, the focus scales and the blend/preset colors */
+		pat = gdip_pgrad_create_mesh_pattern (pgbrush);
+		if (!pat)
+			return OutOfMemory;
+#else
+		/* FIXME: older cairo have no mesh patterns. We use a radial gradient which can be used,
+		 * in some cases, to get the right effect.
 		 */
-
-		/* Set the start radius as r and the end radius as 0 so that the center is the end "circle".
-		 * That way interpolation and blend positions go the right direction (edge to center).*/
-		pat = cairo_pattern_create_radial (pgbrush->center.X, pgbrush->center.Y, r,
-			pgbrush->center.X, pgbrush->center.Y, 0.0f);
+		pat = gdip_pgrad_create_radial_pattern (pgbrush);
+#endif
 		status = gdip_get_pattern_status (pat);
 		if (status != Ok)
 			return status;
 
-		GpMatrix matrix;
+		if (pgbrush->wrapMode != WrapModeClamp) {
+			pat = gdip_pgrad_create_tile_pattern (pgbrush, pat);
+			status = gdip_get_pattern_status (pat);
+			if (status != Ok)
+				return status;
+		}
+
 		gdip_cairo_matrix_copy (&matrix, &pgbrush->transform);
 		status = GdipInvertMatrix (&matrix);
-		if (status != Ok)
+		if (status != Ok) {
+			cairo_pattern_destroy (pat);
 			return status;
-		cairo_pattern_set_matrix (pat, &matrix);
-
-		if ((pgbrush->blend->count > 1) && (pgbrush->boundaryColorsCount > 0)) {
-			/* FIXME: blending done using the a radial shape (not the path shape) */
-			add_color_stops_from_blend (pat, pgbrush->blend, pgbrush->boundaryColors[0], pgbrush->centerColor);
-		} else if (pgbrush->presetColors->count > 1) {
-			/* FIXME: copied from lineargradiantbrush, most probably not right */
-			add_color_stops_from_interpolation_colors (pat, pgbrush->presetColors);
-		} else {
-			cairo_pattern_add_color_stop_rgba (pat, 1.0f,
-				ARGB_RED_N (pgbrush->centerColor),
-				ARGB_GREEN_N (pgbrush->centerColor),
-				ARGB_BLUE_N (pgbrush->centerColor),
-				ARGB_ALPHA_N (pgbrush->centerColor));
-
-			/* if a single other boundary color is present, then we can do the a real radial */
-			if (pgbrush->boundaryColorsCount == 1) {
-				ARGB c = pgbrush->boundaryColors[0];
-				cairo_pattern_add_color_stop_rgba (pat, 0.0f,
-					ARGB_RED_N (c), ARGB_GREEN_N (c), ARGB_BLUE_N (c), ARGB_ALPHA_N (c));
-			} else {
-				/* FIXME: otherwise we (solid-)fill with the centerColor */
-			}
 		}
+		/* the brush transform applies before the pattern's own offset (if any) */
+		cairo_pattern_get_matrix (pat, &offset);
+		cairo_matrix_multiply (&matrix, &matrix, &offset);
+		cairo_pattern_set_matrix (pat, &matrix);
 
 		pgbrush->pattern = pat;
 	}
@@ -656,6 +1012,7 @@ GdipSetPathGradientSurroundColorsWithCount (GpPathGradient *brush, GDIPCONST ARG
 
 	memcpy (brush->boundaryColors, colors, sizeof (ARGB) * boundaryColorsCount);
 	brush->boundaryColorsCount = boundaryColorsCount;
+	brush->base.changed = TRUE;
 	return Ok;
 }
 
@@ -64,8 +64,7 @@ struct _Pen {
 };
 
 GpStatus gdip_pen_setup (GpGraphics *graphics, GpPen *pen) GDIP_INTERNAL;
-GpStatus gdip_pen_draw_custom_start_cap (GpGraphics *graphics, GpPen *pen, float x1, float y1, float x2, float y2);
-GpStatus gdip_pen_draw_custom_end_cap (GpGraphics *graphics, GpPen *pen, float x1, float y1, float x2, float y2);
+GpStatus gdip_pen_draw_custom_caps (GpGraphics *graphics, GpPen *pen, GpPointF start, GpPointF afterStart, GpPointF end, GpPointF beforeEnd) GDIP_INTERNAL;
 
 #include "pen.h"
 
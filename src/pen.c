@@ -214,31 +214,54 @@ gdip_pen_setup (GpGraphics *graphics, GpPen *pen)
 	return gdip_get_status (cairo_status (graphics->ct));
 }
 
-GpStatus
-gdip_pen_draw_custom_start_cap (GpGraphics *graphics, GpPen *pen, float x1, float y1, float x2, float y2)
+/*
+ * Appends the geometry of both custom caps to a single path, so they are drawn with one
+ * fill (for the caps that have one) and one stroke, using a single pen setup for each.
+ */
+static BOOL
+gdip_pen_append_custom_caps (GpGraphics *graphics, GpPen *pen, BOOL fill, GpPointF start, GpPointF afterStart, GpPointF end, GpPointF beforeEnd)
 {
-	if (!graphics || !pen)
-		return InvalidParameter;
+	BOOL appended = FALSE;
 
-	if (pen->custom_start_cap) {
-		/* Draw the end cap */
-		gdip_linecap_draw (graphics, pen, pen->custom_start_cap, x1, y1, x2, y2);
-	}
+	/* the caps are appended using the graphics matrix, like the line itself */
+	gdip_cairo_set_matrix (graphics, graphics->copy_of_ctm);
+	cairo_new_path (graphics->ct);
 
-	return gdip_get_status (cairo_status (graphics->ct));
+	if (pen->custom_start_cap)
+		appended |= gdip_linecap_append (graphics, pen, pen->custom_start_cap, fill, start.X, start.Y, afterStart.X, afterStart.Y);
+	if (pen->custom_end_cap)
+		appended |= gdip_linecap_append (graphics, pen, pen->custom_end_cap, fill, end.X, end.Y, beforeEnd.X, beforeEnd.Y);
+
+	return appended;
 }
 
 GpStatus
-gdip_pen_draw_custom_end_cap (GpGraphics *graphics, GpPen *pen, float x1, float y1, float x2, float y2)
+gdip_pen_draw_custom_caps (GpGraphics *graphics, GpPen *pen, GpPointF start, GpPointF afterStart, GpPointF end, GpPointF beforeEnd)
 {
+	GpStatus status;
+
 	if (!graphics || !pen)
 		return InvalidParameter;
 
-	if (pen->custom_end_cap) {
-		/* Draw the end cap */
-		gdip_linecap_draw (graphics, pen, pen->custom_end_cap, x1, y1, x2, y2);
+	if (!pen->custom_start_cap && !pen->custom_end_cap)
+		return Ok;
+
+	if (gdip_pen_append_custom_caps (graphics, pen, TRUE, start, afterStart, end, beforeEnd)) {
+		status = gdip_pen_setup (graphics, pen);
+		if (status != Ok)
+			return status;
+		cairo_fill (graphics->ct);
+	}
+
+	if (gdip_pen_append_custom_caps (graphics, pen, FALSE, start, afterStart, end, beforeEnd)) {
+		status = gdip_pen_setup (graphics, pen);
+		if (status != Ok)
+			return status;
+		cairo_stroke (graphics->ct);
 	}
 
+	cairo_new_path (graphics->ct);
+	gdip_cairo_set_matrix (graphics, graphics->copy_of_ctm);
 	return gdip_get_status (cairo_status (graphics->ct));
 }
 
@@ -93,6 +93,19 @@ _gdip_png_stream_read_data (png_structp png_ptr, png_bytep data, png_size_t leng
 	}
 }
 
+static void
+_gdip_png_memory_read_data (png_structp png_ptr, png_bytep data, png_size_t length)
+{
+	MemorySource *ms = (MemorySource *) png_get_io_ptr (png_ptr);
+
+	if (length > ms->size - ms->pos) {
+		png_error(png_ptr, "Read failed");
+	}
+
+	memcpy (data, ms->ptr + ms->pos, length);
+	ms->pos += length;
+}
+
 static void
 _gdip_png_stream_write_data (png_structp png_ptr, png_bytep data, png_size_t length)
 {
@@ -242,7 +255,7 @@ gdip_load_png_properties (png_structp png_ptr, png_infop info_ptr, png_infop end
 }
 
 static GpStatus 
-gdip_load_png_image_from_file_or_stream (FILE *fp, GetBytesDelegate getBytesFunc, GpImage **image)
+gdip_load_png_image_from_file_or_stream (FILE *fp, GetBytesDelegate getBytesFunc, MemorySource *memory, GpImage **image)
 {
 	png_structp	png_ptr = NULL;
 	png_infop	info_ptr = NULL;
@@ -280,6 +293,8 @@ gdip_load_png_image_from_file_or_stream (FILE *fp, GetBytesDelegate getBytesFunc
 
 	if (fp != NULL) {
 		png_init_io (png_ptr, fp);
+	} else if (memory != NULL) {
+		png_set_read_fn (png_ptr, (void *) memory, _gdip_png_memory_read_data);
 	} else {
 		png_set_read_fn (png_ptr, (void *) getBytesFunc, _gdip_png_stream_read_data);
 	}
@@ -628,13 +643,25 @@ error:
 GpStatus 
 gdip_load_png_image_from_file (FILE *fp, GpImage **image)
 {
-	return gdip_load_png_image_from_file_or_stream (fp, NULL, image);
+	return gdip_load_png_image_from_file_or_stream (fp, NULL, NULL, image);
 }
 
 GpStatus
 gdip_load_png_image_from_stream_delegate (GetBytesDelegate getBytesFunc, SeekDelegate seeknFunc, GpImage **image)
 {
-	return gdip_load_png_image_from_file_or_stream (NULL, getBytesFunc, image);
+	return gdip_load_png_image_from_file_or_stream (NULL, getBytesFunc, NULL, image);
+}
+
+/* For PNG images embedded in other formats, e.g. icons */
+GpStatus
+gdip_load_png_image_from_memory (BYTE *data, int size, GpImage **image)
+{
+	MemorySource ms;
+
+	ms.ptr = data;
+	ms.size = size;
+	ms.pos = 0;
+	return gdip_load_png_image_from_file_or_stream (NULL, NULL, &ms, image);
 }
 
 static GpStatus 
@@ -844,6 +871,13 @@ gdip_load_png_image_from_stream_delegate (GetBytesDelegate getBytesFunc, SeekDel
 	return UnknownImageFormat;
 }
 
+GpStatus
+gdip_load_png_image_from_memory (BYTE *data, int size, GpImage **image)
+{
+	*image = NULL;
+	return UnknownImageFormat;
+}
+
 
 GpStatus 
 gdip_save_png_image_to_file (FILE *fp, GpImage *image, GDIPCONST EncoderParameters *params)
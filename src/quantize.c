@@ -0,0 +1,404 @@
+/*
+ * quantize.c : color quantization of 32bpp pixels into indexed ones
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+ * NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The colors are first counted in a 5-5-5 histogram, so the cost of building the palette
+ * does not depend on the image size. The populated part of the histogram is then cut in
+ * boxes (median cut along the longest side of the box holding the most pixels) until
+ * there are as many boxes as palette entries, each entry being the mean of its box.
+ * Pixels are mapped back through an inverse table indexed by histogram bin.
+ */
+
+#include "quantize-private.h"
+
+#define QUANTIZE_BITS		5
+#define QUANTIZE_SIDE		(1 << QUANTIZE_BITS)
+#define QUANTIZE_BINS		(QUANTIZE_SIDE * QUANTIZE_SIDE * QUANTIZE_SIDE)
+#define QUANTIZE_UNMAPPED	0xFFFF
+
+#define QUANTIZE_BIN(r,g,b)	((((r) >> 3) << (2 * QUANTIZE_BITS)) | (((g) >> 3) << QUANTIZE_BITS) | ((b) >> 3))
+
+typedef struct {
+	guint64		count;
+	guint64		red;
+	guint64		green;
+	guint64		blue;
+} QuantizeBin;
+
+typedef struct {
+	int		min[3];		/* inclusive bin coordinates, red, green and blue */
+	int		max[3];
+	guint64		count;
+} QuantizeBox;
+
+typedef struct {
+	QuantizeBin	*histogram;
+	guint16		*inverse;
+	ARGB		*palette;
+	int		colors;
+} QuantizeContext;
+
+static int
+quantize_clamp (int value)
+{
+	if (value < 0)
+		return 0;
+	if (value > 255)
+		return 255;
+	return value;
+}
+
+static QuantizeBin *
+quantize_bin_at (QuantizeContext *ctx, int r, int g, int b)
+{
+	return &ctx->histogram[(r << (2 * QUANTIZE_BITS)) | (g << QUANTIZE_BITS) | b];
+}
+
+/* shrinks the box to its populated bins and counts its pixels, returns FALSE if it is empty */
+static BOOL
+quantize_shrink_box (QuantizeContext *ctx, QuantizeBox *box)
+{
+	int min[3] = { QUANTIZE_SIDE, QUANTIZE_SIDE, QUANTIZE_SIDE };
+	int max[3] = { -1, -1, -1 };
+	guint64 count = 0;
+	int r, g, b;
+
+	for (r = box->min[0]; r <= box->max[0]; r++) {
+		for (g = box->min[1]; g <= box->max[1]; g++) {
+			for (b = box->min[2]; b <= box->max[2]; b++) {
+				QuantizeBin *bin = quantize_bin_at (ctx, r, g, b);
+				if (bin->count == 0)
+					continue;
+
+				count += bin->count;
+				min[0] = MIN (min[0], r);
+				max[0] = MAX (max[0], r);
+				min[1] = MIN (min[1], g);
+				max[1] = MAX (max[1], g);
+				min[2] = MIN (min[2], b);
+				max[2] = MAX (max[2], b);
+			}
+		}
+	}
+
+	if (count == 0)
+		return FALSE;
+
+	memcpy (box->min, min, sizeof (min));
+	memcpy (box->max, max, sizeof (max));
+	box->count = count;
+	return TRUE;
+}
+
+/* splits the box at the pixel median of its longest side, the box keeps the lower half */
+static void
+quantize_split_box (QuantizeContext *ctx, QuantizeBox *box, QuantizeBox *upper)
+{
+	guint64 totals[QUANTIZE_SIDE];
+	guint64 sum;
+	int axis = 0;
+	int cut;
+	int c, r, g, b;
+
+	for (c = 1; c < 3; c++) {
+		if (box->max[c] - box->min[c] > box->max[axis] - box->min[axis])
+			axis = c;
+	}
+
+	memset (totals, 0, sizeof (totals));
+	for (r = box->min[0]; r <= box->max[0]; r++) {
+		for (g = box->min[1]; g <= box->max[1]; g++) {
+			for (b = box->min[2]; b <= box->max[2]; b++) {
+				int position = (axis == 0) ? r : (axis == 1) ? g : b;
+				totals[position] += quantize_bin_at (ctx, r, g, b)->count;
+			}
+		}
+	}
+
+	/* both halves keep at least one populated plane, as the box was shrunk */
+	sum = 0;
+	for (cut = box->min[axis]; cut < box->max[axis] - 1; cut++) {
+		sum += totals[cut];
+		if (sum * 2 >= box->count)
+			break;
+	}
+
+	*upper = *box;
+	box->max[axis] = cut;
+	upper->min[axis] = cut + 1;
+	quantize_shrink_box (ctx, box);
+	quantize_shrink_box (ctx, upper);
+}
+
+static ARGB
+quantize_box_color (QuantizeContext *ctx, QuantizeBox *box)
+{
+	guint64 red = 0, green = 0, blue = 0;
+	int r, g, b;
+
+	for (r = box->min[0]; r <= box->max[0]; r++) {
+		for (g = box->min[1]; g <= box->max[1]; g++) {
+			for (b = box->min[2]; b <= box->max[2]; b++) {
+				QuantizeBin *bin = quantize_bin_at (ctx, r, g, b);
+				red += bin->red;
+				green += bin->green;
+				blue += bin->blue;
+			}
+		}
+	}
+
+	return 0xFF000000 |
+		((ARGB) ((red + box->count / 2) / box->count) << 16) |
+		((ARGB) ((green + box->count / 2) / box->count) << 8) |
+		(ARGB) ((blue + box->count / 2) / box->count);
+}
+
+static void
+quantize_build_palette (QuantizeContext *ctx, int max_colors)
+{
+	QuantizeBox boxes[256];
+	int count = 1;
+	int i, r, g, b;
+
+	boxes[0].min[0] = boxes[0].min[1] = boxes[0].min[2] = 0;
+	boxes[0].max[0] = boxes[0].max[1] = boxes[0].max[2] = QUANTIZE_SIDE - 1;
+	if (!quantize_shrink_box (ctx, &boxes[0])) {
+		/* empty image */
+		ctx->palette[0] = 0xFF000000;
+		ctx->colors = 1;
+		return;
+	}
+
+	while (count < max_colors) {
+		int best = -1;
+
+		for (i = 0; i < count; i++) {
+			BOOL splittable = (boxes[i].min[0] != boxes[i].max[0]) || (boxes[i].min[1] != boxes[i].max[1]) ||
+				(boxes[i].min[2] != boxes[i].max[2]);
+			if (splittable && ((best < 0) || (boxes[i].count > boxes[best].count)))
+				best = i;
+		}
+		/* every box is a single bin, there are no more colors to separate */
+		if (best < 0)
+			break;
+
+		quantize_split_box (ctx, &boxes[best], &boxes[count]);
+		count++;
+	}
+
+	for (i = 0; i < count; i++) {
+		ctx->palette[i] = quantize_box_color (ctx, &boxes[i]);
+		for (r = boxes[i].min[0]; r <= boxes[i].max[0]; r++) {
+			for (g = boxes[i].min[1]; g <= boxes[i].max[1]; g++) {
+				for (b = boxes[i].min[2]; b <= boxes[i].max[2]; b++) {
+					int index = (r << (2 * QUANTIZE_BITS)) | (g << QUANTIZE_BITS) | b;
+					if (ctx->histogram[index].count)
+						ctx->inverse[index] = i;
+				}
+			}
+		}
+	}
+	ctx->colors = count;
+}
+
+/* palette index for any color, bins holding no source pixel are resolved on first use */
+static int
+quantize_lookup (QuantizeContext *ctx, int r, int g, int b)
+{
+	int index = QUANTIZE_BIN (r, g, b);
+	int best, i;
+	int best_distance;
+
+	if (ctx->inverse[index] != QUANTIZE_UNMAPPED)
+		return ctx->inverse[index];
+
+	/* compare against the center of the bin */
+	r = (r & 0xF8) | 4;
+	g = (g & 0xF8) | 4;
+	b = (b & 0xF8) | 4;
+	best = 0;
+	best_distance = G_MAXINT;
+	for (i = 0; i < ctx->colors; i++) {
+		int dr = r - (int) ((ctx->palette[i] >> 16) & 0xFF);
+		int dg = g - (int) ((ctx->palette[i] >> 8) & 0xFF);
+		int db = b - (int) (ctx->palette[i] & 0xFF);
+		int distance = dr * dr + dg * dg + db * db;
+		if (distance < best_distance) {
+			best_distance = distance;
+			best = i;
+		}
+	}
+
+	ctx->inverse[index] = best;
+	return best;
+}
+
+static void
+quantize_map_ordered (QuantizeContext *ctx, const BYTE *scan0, int width, int height, int stride,
+	BYTE *indexes, int indexes_stride)
+{
+	static const int bayer[4][4] = {
+		{  0,  8,  2, 10 },
+		{ 12,  4, 14,  6 },
+		{  3, 11,  1,  9 },
+		{ 15,  7, 13,  5 }
+	};
+	int levels = 1;
+	int amplitude;
+	int x, y;
+
+	/* spacing of a uniform palette of the same size */
+	while ((levels + 1) * (levels + 1) * (levels + 1) <= ctx->colors)
+		levels++;
+	amplitude = 255 / levels;
+
+	for (y = 0; y < height; y++) {
+		const ARGB *src = (const ARGB *) (scan0 + y * stride);
+		BYTE *dst = indexes + y * indexes_stride;
+
+		for (x = 0; x < width; x++) {
+			int offset = ((2 * bayer[y & 3][x & 3] + 1 - 16) * amplitude) / 32;
+			ARGB color = src[x];
+
+			dst[x] = quantize_lookup (ctx,
+				quantize_clamp ((int) ((color >> 16) & 0xFF) + offset),
+				quantize_clamp ((int) ((color >> 8) & 0xFF) + offset),
+				quantize_clamp ((int) (color & 0xFF) + offset));
+		}
+	}
+}
+
+static GpStatus
+quantize_map_error_diffusion (QuantizeContext *ctx, const BYTE *scan0, int width, int height, int stride,
+	BYTE *indexes, int indexes_stride)
+{
+	/* errors of the current and next lines, with a guard pixel on each side */
+	int *errors = GdipAlloc (sizeof (int) * 3 * (width + 2) * 2);
+	int *current, *next, *swap;
+	int x, y, c;
+
+	if (!errors)
+		return OutOfMemory;
+
+	memset (errors, 0, sizeof (int) * 3 * (width + 2) * 2);
+	current = errors;
+	next = errors + 3 * (width + 2);
+
+	for (y = 0; y < height; y++) {
+		const ARGB *src = (const ARGB *) (scan0 + y * stride);
+		BYTE *dst = indexes + y * indexes_stride;
+
+		memset (next, 0, sizeof (int) * 3 * (width + 2));
+		for (x = 0; x < width; x++) {
+			int *error = current + 3 * (x + 1);
+			int *below = next + 3 * (x + 1);
+			int wanted[3];
+			int index;
+			ARGB color;
+
+			wanted[0] = quantize_clamp ((int) ((src[x] >> 16) & 0xFF) + error[0] / 16);
+			wanted[1] = quantize_clamp ((int) ((src[x] >> 8) & 0xFF) + error[1] / 16);
+			wanted[2] = quantize_clamp ((int) (src[x] & 0xFF) + error[2] / 16);
+
+			index = quantize_lookup (ctx, wanted[0], wanted[1], wanted[2]);
+			dst[x] = index;
+			color = ctx->palette[index];
+
+			for (c = 0; c < 3; c++) {
+				int diff = wanted[c] - (int) ((color >> (16 - 8 * c)) & 0xFF);
+				error[3 + c] += diff * 7;
+				below[-3 + c] += diff * 3;
+				below[c] += diff * 5;
+				below[3 + c] += diff;
+			}
+		}
+
+		swap = current;
+		current = next;
+		next = swap;
+	}
+
+	GdipFree (errors);
+	return Ok;
+}
+
+GpStatus
+gdip_quantize_argb (const BYTE *scan0, int width, int height, int stride, int max_colors,
+	QuantizeDither dither, ARGB *palette, int *colors, BYTE *indexes, int indexes_stride)
+{
+	QuantizeContext ctx;
+	GpStatus status = Ok;
+	int x, y;
+
+	if (!scan0 || !palette || !colors || !indexes || width < 0 || height < 0 || max_colors < 1 || max_colors > 256)
+		return InvalidParameter;
+
+	ctx.histogram = GdipAlloc (sizeof (QuantizeBin) * QUANTIZE_BINS);
+	ctx.inverse = GdipAlloc (sizeof (guint16) * QUANTIZE_BINS);
+	if (!ctx.histogram || !ctx.inverse) {
+		GdipFree (ctx.histogram);
+		GdipFree (ctx.inverse);
+		return OutOfMemory;
+	}
+	memset (ctx.histogram, 0, sizeof (QuantizeBin) * QUANTIZE_BINS);
+	memset (ctx.inverse, 0xFF, sizeof (guint16) * QUANTIZE_BINS);
+	ctx.palette = palette;
+
+	for (y = 0; y < height; y++) {
+		const ARGB *src = (const ARGB *) (scan0 + y * stride);
+
+		for (x = 0; x < width; x++) {
+			int r = (src[x] >> 16) & 0xFF;
+			int g = (src[x] >> 8) & 0xFF;
+			int b = src[x] & 0xFF;
+			QuantizeBin *bin = &ctx.histogram[QUANTIZE_BIN (r, g, b)];
+
+			bin->count++;
+			bin->red += r;
+			bin->green += g;
+			bin->blue += b;
+		}
+	}
+
+	quantize_build_palette (&ctx, max_colors);
+
+	switch (dither) {
+	case QuantizeDitherOrdered:
+		quantize_map_ordered (&ctx, scan0, width, height, stride, indexes, indexes_stride);
+		break;
+	case QuantizeDitherErrorDiffusion:
+		status = quantize_map_error_diffusion (&ctx, scan0, width, height, stride, indexes, indexes_stride);
+		break;
+	default:
+		/* every source bin is populated, so the inverse table answers directly */
+		for (y = 0; y < height; y++) {
+			const ARGB *src = (const ARGB *) (scan0 + y * stride);
+			BYTE *dst = indexes + y * indexes_stride;
+
+			for (x = 0; x < width; x++)
+				dst[x] = ctx.inverse[QUANTIZE_BIN ((src[x] >> 16) & 0xFF, (src[x] >> 8) & 0xFF, src[x] & 0xFF)];
+		}
+		break;
+	}
+
+	*colors = ctx.colors;
+	GdipFree (ctx.histogram);
+	GdipFree (ctx.inverse);
+	return status;
+}
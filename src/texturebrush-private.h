@@ -46,8 +46,11 @@ typedef struct _Texture {
 	GpRect		rectangle;
 	GpWrapMode	wrapMode;
 	cairo_pattern_t	*pattern;
+	GpWrapMode	patternWrapMode;	/* wrap mode the pattern was created for */
 } Texture;
 
+cairo_surface_t *gdip_create_mirrored_atlas (cairo_surface_t *original, BOOL flipX, BOOL flipY) GDIP_INTERNAL;
+
 #include "texturebrush.h"
 
 #endif
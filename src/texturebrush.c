@@ -21,9 +21,6 @@
  * Authors:
  *   Ravindra (rkumar@novell.com)
  *   Sebastien Pouliot  <sebastien@ximian.com>
- *
- * TODO
- * 	reduce duplication between draw_tile*_texture functions
  */
 
 #include "texturebrush-private.h"
@@ -47,20 +44,6 @@ static BrushClass vtable = { BrushTypeTextureFill,
 			     gdip_texture_clone,
 			     gdip_texture_destroy };
 
-static cairo_content_t
-from_cairoformat_to_content (cairo_format_t format)
-{
-	switch (format) {
-	case CAIRO_FORMAT_RGB24:
-		return CAIRO_CONTENT_COLOR;
-	case CAIRO_FORMAT_A8:
-		return CAIRO_CONTENT_ALPHA;
-	case CAIRO_FORMAT_ARGB32:
-	default:
-		return CAIRO_CONTENT_COLOR_ALPHA;
-    }
-}
-
 static void 
 gdip_texture_init (GpTexture *texture)
 {
@@ -71,6 +54,7 @@ gdip_texture_init (GpTexture *texture)
 	texture->rectangle.Width = 0;
 	texture->rectangle.Height = 0;
 	texture->pattern = NULL;
+	texture->patternWrapMode = WrapModeTile;
 	cairo_matrix_init_identity (&texture->matrix);
 }
 
@@ -84,353 +68,140 @@ gdip_texture_new (void)
 	return result;
 }
 
-/* 
- * functions to create different wrapmodes.
+/*
+ * Copy <original> into a new image surface, mirroring it along X and/or Y. The result holds
+ * the original followed by its mirror image, so repeating it gives the TileFlip* wrap modes.
  */
-static GpStatus
-draw_tile_texture (cairo_t *ct, GpBitmap *bitmap, GpTexture *brush)
+cairo_surface_t *
+gdip_create_mirrored_atlas (cairo_surface_t *original, BOOL flipX, BOOL flipY)
 {
-	cairo_surface_t *texture;
-	cairo_pattern_t *pat;
-	GpStatus	status;
-	GpRect		*rect = &brush->rectangle;
-	cairo_t		*ct2;
-
-	if (!rect)
-		return InvalidParameter;
-	if (gdip_bitmap_ensure_surface (bitmap) == NULL)
-		return OutOfMemory;
-
-	/* Use the bitmap->surface as a pattern */
-	pat = cairo_pattern_create_for_surface (bitmap->surface);
-	status = gdip_get_pattern_status (pat);
-	if (status != Ok) {
-		return status;
-	}
-
-	cairo_pattern_set_extend (pat, CAIRO_EXTEND_REPEAT);
-
-	/* texture surface to be created */
-	texture = cairo_surface_create_similar (
-		bitmap->surface, from_cairoformat_to_content (bitmap->cairo_format),
-		rect->Width, rect->Height);
-	status = gdip_get_status (cairo_surface_status (texture));
-	if (status != Ok) {
-		cairo_pattern_destroy (pat);
-		return status;
-	}
-
-	/* Draw the texture */
-	ct2 = cairo_create (texture);
-	cairo_set_source (ct2, pat);
-	cairo_rectangle (ct2, 0, 0, rect->Width, rect->Height);
-	cairo_fill (ct2);
-	cairo_destroy (ct2);
-
-	brush->pattern = cairo_pattern_create_for_surface (texture);
-	status = gdip_get_pattern_status (brush->pattern);
-	if (status == Ok)
-		cairo_pattern_set_extend (brush->pattern, CAIRO_EXTEND_REPEAT);
-
-	cairo_pattern_destroy (pat);
-	cairo_surface_destroy (texture);
-
-	return gdip_get_status (cairo_status (ct));
-}
-
-static GpStatus
-draw_tile_flipX_texture (cairo_t *ct, GpBitmap *bitmap, GpTexture *brush)
-{
-	cairo_surface_t *texture;
-	cairo_pattern_t *pat;
-	GpRect		*rect = &brush->rectangle;
-	GpStatus	status;
-	cairo_t		*ct2;
-	cairo_matrix_t	tempMatrix;
-
-	if (!rect)
-		return InvalidParameter;
-	if (gdip_bitmap_ensure_surface (bitmap) == NULL)
-		return OutOfMemory;
-
-	/* Use the bitmap->surface as a pattern */
-	pat = cairo_pattern_create_for_surface (bitmap->surface);
-	status = gdip_get_pattern_status (pat);
-	if (status != Ok)
-		return status;
-
-	cairo_pattern_set_extend (pat, CAIRO_EXTEND_REPEAT);
-
-	/* texture surface to be created */
-	texture = cairo_surface_create_similar (
-		bitmap->surface, from_cairoformat_to_content (bitmap->cairo_format),
-		2 * rect->Width, rect->Height);
-	status = gdip_get_status (cairo_surface_status (texture));
-	if (status != Ok) {
-		cairo_pattern_destroy (pat);
-		return status;
+	cairo_surface_t *atlas;
+	int width = cairo_image_surface_get_width (original);
+	int height = cairo_image_surface_get_height (original);
+	int atlas_width = flipX ? width * 2 : width;
+	int atlas_height = flipY ? height * 2 : height;
+	int src_stride, dst_stride, x, y;
+	BYTE *src, *dst;
+
+	atlas = cairo_image_surface_create (cairo_image_surface_get_format (original), atlas_width, atlas_height);
+	if (cairo_surface_status (atlas) != CAIRO_STATUS_SUCCESS)
+		return atlas;
+
+	cairo_surface_flush (original);
+	cairo_surface_flush (atlas);
+	src = cairo_image_surface_get_data (original);
+	src_stride = cairo_image_surface_get_stride (original);
+	dst = cairo_image_surface_get_data (atlas);
+	dst_stride = cairo_image_surface_get_stride (atlas);
+
+	/* both ARGB32 and RGB24 surfaces use 32 bits per pixel */
+	for (y = 0; y < height; y++) {
+		const guint32 *s = (const guint32 *) (src + y * src_stride);
+		guint32 *d = (guint32 *) (dst + y * dst_stride);
+
+		memcpy (d, s, width * sizeof (guint32));
+		if (flipX) {
+			for (x = 0; x < width; x++)
+				d [atlas_width - 1 - x] = s [x];
+		}
+		if (flipY)
+			memcpy (dst + (atlas_height - 1 - y) * dst_stride, d, atlas_width * sizeof (guint32));
 	}
 
-	/* Draw left part of the texture */
-	ct2 = cairo_create (texture);
-	cairo_set_source (ct2, pat);
-	cairo_rectangle (ct2, 0, 0, rect->Width, rect->Height);
-	cairo_fill (ct2);
-
-	/* Not sure if this is a bug, but using rect->Width - 1 avoids the seam. */
-	cairo_matrix_init_identity (&tempMatrix);
-	cairo_matrix_translate (&tempMatrix, rect->Width - 1, 0);
-
-	/* scale in -X direction to flip along X */
-	cairo_matrix_scale (&tempMatrix, -1.0, 1.0);
-	cairo_pattern_set_matrix (pat, &tempMatrix);
-
-	/* Draw right part of the texture */
-	cairo_set_source (ct2, pat);
-	cairo_rectangle (ct2, rect->Width, 0, rect->Width, rect->Height);
-
-	cairo_fill (ct2);
-	cairo_destroy (ct2);
-
-	brush->pattern = cairo_pattern_create_for_surface (texture);
-	status = gdip_get_pattern_status (brush->pattern);
-	if (status == Ok)
-		cairo_pattern_set_extend (brush->pattern, CAIRO_EXTEND_REPEAT);
-
-	cairo_pattern_destroy (pat);
-	cairo_surface_destroy (texture);
-
-	return gdip_get_status (cairo_status (ct));
+	cairo_surface_mark_dirty (atlas);
+	return atlas;
 }
 
+/*
+ * The pattern only depends on the texture image and its wrap mode. Whenever possible it
+ * wraps the bitmap surface directly and lets cairo repeat (Tile), reflect (TileFlipXY) or
+ * clip (Clamp) it. A mirrored atlas is only needed for TileFlipX and TileFlipY, which
+ * cairo can't express with a single extend mode.
+ */
 static GpStatus
-draw_tile_flipY_texture (cairo_t *ct, GpBitmap *bitmap, GpTexture *brush)
+gdip_texture_create_pattern (GpTexture *texture)
 {
-	cairo_surface_t *texture;
-	cairo_pattern_t *pat;
-	GpMatrix	tempMatrix;
-	GpRect		*rect = &brush->rectangle;
+	GpBitmap	*bitmap = texture->image;
+	cairo_surface_t	*surface;
+	cairo_pattern_t	*pattern;
+	cairo_extend_t	extend;
+	BOOL		flipX = FALSE;
+	BOOL		flipY = FALSE;
 	GpStatus	status;
-	cairo_t		*ct2;
 
-	if (!rect)
+	switch (texture->wrapMode) {
+	case WrapModeTile:
+		extend = CAIRO_EXTEND_REPEAT;
+		break;
+	case WrapModeTileFlipX:
+		extend = CAIRO_EXTEND_REPEAT;
+		flipX = TRUE;
+		break;
+	case WrapModeTileFlipY:
+		extend = CAIRO_EXTEND_REPEAT;
+		flipY = TRUE;
+		break;
+	case WrapModeTileFlipXY:
+		extend = CAIRO_EXTEND_REFLECT;
+		break;
+	case WrapModeClamp:
+		extend = CAIRO_EXTEND_NONE;
+		break;
+	default:
 		return InvalidParameter;
-	if (gdip_bitmap_ensure_surface (bitmap) == NULL)
-		return OutOfMemory;
-
-	/* Use the bitmap->surface as a pattern */
-	pat = cairo_pattern_create_for_surface (bitmap->surface);
-	status = gdip_get_pattern_status (pat);
-	if (status != Ok)
-		return status;
-
-	cairo_pattern_set_extend (pat, CAIRO_EXTEND_REPEAT);
-
-	/* texture surface to be created */
-	texture = cairo_surface_create_similar (
-		bitmap->surface, from_cairoformat_to_content (bitmap->cairo_format),
-		rect->Width, 2 * rect->Height);
-	status = gdip_get_status (cairo_surface_status (texture));
-	if (status != Ok) {
-		cairo_pattern_destroy (pat);
-		return status;
-	}
-
-	/* Draw upper part of the texture */
-	ct2 = cairo_create (texture);
-	cairo_set_source (ct2, pat);
-	cairo_rectangle (ct2, 0, 0, rect->Width, rect->Height);
-	cairo_fill (ct2);
-	
-	/* Not sure if this is a bug, but using rect->Height - 1 avoids the seam. */
-	cairo_matrix_init_identity (&tempMatrix);
-	cairo_matrix_translate (&tempMatrix, 0, rect->Height - 1);
-
-	/* scale in -Y direction to flip along Y */
-	cairo_matrix_scale (&tempMatrix, 1.0, -1.0);
-	cairo_pattern_set_matrix (pat, &tempMatrix);
-
-	/* Draw lower part of the texture */
-	cairo_translate (ct2, 0, rect->Height);
-	cairo_set_source (ct2, pat);
-	cairo_rectangle (ct2, 0, 0, rect->Width, rect->Height);
-	cairo_fill (ct2);
-	cairo_destroy(ct2);
-
-	brush->pattern = cairo_pattern_create_for_surface (texture);
-	status = gdip_get_pattern_status (brush->pattern);
-	if (status != Ok) {
-		cairo_pattern_destroy (pat);
-		cairo_surface_destroy (texture);
-		return status;
 	}
-	cairo_pattern_set_extend (brush->pattern, CAIRO_EXTEND_REPEAT);	
-
-	cairo_pattern_destroy (pat);
-	cairo_surface_destroy (texture);
 
-	return gdip_get_status (cairo_status (ct));
-}
-
-static GpStatus
-draw_tile_flipXY_texture (cairo_t *ct, GpBitmap *bitmap, GpTexture *brush)
-{
-	cairo_surface_t *texture;
-	cairo_pattern_t *pat;
-	GpMatrix	tempMatrix;
-	GpRect		*rect = &brush->rectangle;
-	GpStatus	status;
-	cairo_t		*ct2;
-
-	if (!rect)
-		return InvalidParameter;
-	if (gdip_bitmap_ensure_surface (bitmap) == NULL)
-		return OutOfMemory;
-
-	/* Use the original as a pattern */
-	pat = cairo_pattern_create_for_surface (bitmap->surface);
-	status = gdip_get_pattern_status (pat);
-	if (status != Ok)
-		return status;
+	if (gdip_is_an_indexed_pixelformat (bitmap->active_bitmap->pixel_format)) {
+		/* Unable to create a surface for the bitmap; it is an indexed image.
+		 * Instead, it will first be converted to 32-bit RGB and copied, as the
+		 * converted bitmap doesn't outlive this call. */
+		GpBitmap *converted = gdip_convert_indexed_to_rgb (bitmap);
+		if (!converted)
+			return OutOfMemory;
+		if (gdip_bitmap_ensure_surface (converted) == NULL) {
+			GdipDisposeImage ((GpImage *) converted);
+			return OutOfMemory;
+		}
 
-	cairo_pattern_set_extend (pat, CAIRO_EXTEND_REPEAT);
+		surface = gdip_create_mirrored_atlas (converted->surface, flipX, flipY);
+		GdipDisposeImage ((GpImage *) converted);
+	} else {
+		if (gdip_bitmap_ensure_surface (bitmap) == NULL)
+			return OutOfMemory;
 
-	/* texture surface to be created */
-	texture = cairo_surface_create_similar (
-		bitmap->surface, from_cairoformat_to_content (bitmap->cairo_format),
-		2 * rect->Width, 2 * rect->Height);
-	status = gdip_get_status (cairo_surface_status (texture));
-	if (status != Ok) {
-		cairo_pattern_destroy (pat);
-		return status;
+		if (flipX || flipY)
+			surface = gdip_create_mirrored_atlas (bitmap->surface, flipX, flipY);
+		else
+			surface = cairo_surface_reference (bitmap->surface);
 	}
 
-	/* Draw upper left part of the texture */
-	ct2 = cairo_create (texture);
-	cairo_set_source (ct2, pat);
-	cairo_rectangle (ct2, 0, 0, rect->Width, rect->Height);
-	cairo_fill (ct2);
-
-	/* Not sure if this is a bug, but using rect->Height - 1 avoids the seam. */
-	cairo_matrix_init_identity (&tempMatrix);
-	cairo_matrix_translate (&tempMatrix, 0, rect->Height - 1);
-	/* scale in -Y direction to flip along Y */
-	cairo_matrix_scale (&tempMatrix, 1.0, -1.0);
-	cairo_pattern_set_matrix (pat, &tempMatrix);
-
-	/* Draw lower left part of the texture */
-	cairo_translate (ct2, 0, rect->Height);
-	cairo_set_source (ct2, pat);
-	cairo_rectangle (ct2, 0, 0, rect->Width, rect->Height);
-	cairo_fill (ct2);
-
-	/* Reset the pattern matrix and do fresh transformation */
-	cairo_matrix_init_identity (&tempMatrix);
-
-	/* Not sure if this is a bug, but using rect->Width - 1 avoids the seam. */
-	cairo_matrix_translate (&tempMatrix, rect->Width - 1, 0);
-
-	/* scale in -X direction to flip along X */
-	cairo_matrix_scale (&tempMatrix, -1.0, 1.0);
-	cairo_pattern_set_matrix (pat, &tempMatrix);
-
-	/* Draw upper right part of the texture */
-	cairo_translate (ct2, rect->Width, -rect->Height);
-	cairo_set_source (ct2, pat);
-	cairo_rectangle (ct2, 0, 0, rect->Width, rect->Height);
-	cairo_fill (ct2);
-
-	/* Not sure if this is a bug, but using rect->Height - 1 avoids the seam. */
-	cairo_matrix_translate (&tempMatrix, 0, rect->Height - 1);
-
-	/* scale in -Y direction to flip along Y */
-	cairo_matrix_scale (&tempMatrix, 1.0, -1.0);
-	cairo_pattern_set_matrix (pat, &tempMatrix);
-
-	/* Draw lower right part of the texture */
-	cairo_translate (ct2, 0, rect->Height);
-	cairo_set_source (ct2, pat);
-	cairo_rectangle (ct2, 0, 0, rect->Width, rect->Height);
-	cairo_fill (ct2);
-	cairo_destroy(ct2);
-
-	brush->pattern = cairo_pattern_create_for_surface (texture);
-	status = gdip_get_pattern_status(brush->pattern);
+	status = gdip_get_status (cairo_surface_status (surface));
 	if (status != Ok) {
-		cairo_pattern_destroy (pat);
-		cairo_surface_destroy (texture);
+		cairo_surface_destroy (surface);
 		return status;
 	}
-	cairo_pattern_set_extend (brush->pattern, CAIRO_EXTEND_REPEAT);
-
-	cairo_pattern_destroy (pat);
-	cairo_surface_destroy (texture);
-
-	return gdip_get_status (cairo_status (ct));
-}
-
-static GpStatus
-draw_clamp_texture (cairo_t *ct, GpBitmap *bitmap, GpTexture *brush)
-{
-	cairo_surface_t *texture;
-	cairo_pattern_t *pat;
-	GpRect		*rect = &brush->rectangle;
-	GpStatus	status;
-	cairo_t		*ct2;
-
-	/* Original image surface */
-	if (gdip_bitmap_ensure_surface (bitmap) == NULL)
-		return OutOfMemory;
 
-	/* Use the original as a pattern */
-	pat = cairo_pattern_create_for_surface (bitmap->surface);
-	status = gdip_get_pattern_status (pat);
+	/* the pattern keeps its own reference on the surface */
+	pattern = cairo_pattern_create_for_surface (surface);
+	cairo_surface_destroy (surface);
+	status = gdip_get_pattern_status (pattern);
 	if (status != Ok) {
+		cairo_pattern_destroy (pattern);
 		return status;
 	}
 
-	cairo_pattern_set_extend (pat, CAIRO_EXTEND_REPEAT);
-
-	/* texture surface to be created */
-	texture = cairo_surface_create_similar (
-		bitmap->surface, from_cairoformat_to_content (bitmap->cairo_format),
-		rect->Width, rect->Height);
-	if (!texture) {
-		cairo_pattern_destroy (pat);
-		return OutOfMemory;
-	}
-
-	/* Draw the texture */
-	ct2 = cairo_create (texture);
-	cairo_identity_matrix (ct2);
-	cairo_set_source (ct2, pat);
-	cairo_rectangle (ct2, 0, 0, rect->Width, rect->Height);
-	cairo_fill (ct2);
-	cairo_destroy(ct2);
-
-	brush->pattern = cairo_pattern_create_for_surface (texture);
-	status = gdip_get_pattern_status (brush->pattern);
-	if (status != Ok) {
-		cairo_pattern_destroy (pat);
-		cairo_surface_destroy (texture);
-		return status;
-	}
-
-	cairo_pattern_destroy (pat);
-	cairo_surface_destroy (texture);
-
-	return gdip_get_status (cairo_status (ct));
+	cairo_pattern_set_extend (pattern, extend);
+	texture->pattern = pattern;
+	texture->patternWrapMode = texture->wrapMode;
+	return Ok;
 }
 
 GpStatus
 gdip_texture_setup (GpGraphics *graphics, GpBrush *brush)
 {
-	cairo_t		*ct;
-	cairo_pattern_t	*pattern;
 	GpTexture	*texture;
 	GpImage		*img;
-	GpStatus	status = Ok;
-	BOOL		dispose_bitmap;
+	cairo_matrix_t	product;
 
 	if (!graphics || !brush || !graphics->ct)
 		return InvalidParameter;
@@ -443,75 +214,25 @@ gdip_texture_setup (GpGraphics *graphics, GpBrush *brush)
 	if (img->type != ImageTypeBitmap)
 		return NotImplemented;
 
-	if (gdip_is_an_indexed_pixelformat (img->active_bitmap->pixel_format)) {
-		/* Unable to create a surface for the bitmap; it is an indexed image.
-		 * Instead, it will first be converted to 32-bit RGB. */
-		img = gdip_convert_indexed_to_rgb (img);
-		if (!img)
-			return OutOfMemory;
-		if (gdip_bitmap_ensure_surface (img) == NULL)
-			return OutOfMemory;
-		dispose_bitmap = TRUE;
-	} else {
-		dispose_bitmap = FALSE;
-	}
-
-	ct = graphics->ct;
-
-	/* We create the new pattern for brush, if the brush is changed
-	 * or if pattern has not been created yet. */
-	if (texture->base.changed || !texture->pattern) {
-		if (texture->pattern)
+	/* We create the new pattern for brush, if the wrap mode is changed
+	 * or if pattern has not been created yet. A changed transform only
+	 * requires a new pattern matrix. */
+	if (!texture->pattern || (texture->patternWrapMode != texture->wrapMode)) {
+		if (texture->pattern) {
 			cairo_pattern_destroy (texture->pattern);
-
-		switch (texture->wrapMode) {
-			case WrapModeTile:
-				status = draw_tile_texture (ct, img, texture);
-				break;
-
-			case WrapModeTileFlipX:
-				status = draw_tile_flipX_texture (ct, img, texture);
-				break;
-
-			case WrapModeTileFlipY:
-				status = draw_tile_flipY_texture (ct, img, texture);
-				break;
-
-			case WrapModeTileFlipXY:
-				status = draw_tile_flipXY_texture (ct, img, texture);
-				break;
-
-			case WrapModeClamp:
-				status = draw_clamp_texture (ct, img, texture);
-				break;
-
-			default:
-				status = InvalidParameter;
+			texture->pattern = NULL;
 		}
-	}
-
-	if (dispose_bitmap) {
-		GdipDisposeImage((GpImage *)img);
-	}
 
-	if ((status != Ok) || (gdip_get_pattern_status(texture->pattern) != Ok)) {
-		return GenericError;
+		if (gdip_texture_create_pattern (texture) != Ok)
+			return GenericError;
 	}
 
-	pattern = texture->pattern;
-	if (pattern != NULL) {
-		/* got something to apply ? */
-		if (!gdip_is_matrix_empty (&texture->matrix)) {
-			cairo_matrix_t product;
-
-			gdip_cairo_matrix_copy (&product, &texture->matrix);
-			cairo_matrix_invert (&product);
-			cairo_pattern_set_matrix (pattern, &product);
-		}
-		cairo_set_source (ct, pattern);
-	}
+	gdip_cairo_matrix_copy (&product, &texture->matrix);
+	cairo_matrix_invert (&product);
+	cairo_pattern_set_matrix (texture->pattern, &product);
 
-	return gdip_get_status (cairo_status (ct));
+	cairo_set_source (graphics->ct, texture->pattern);
+	return gdip_get_status (cairo_status (graphics->ct));
 }
 
 GpStatus
@@ -334,6 +334,12 @@
 #define BI_RLE4          2
 #define BI_BITFIELDS     3
 
+/* StretchDIBits raster operations */
+#define SRCCOPY			0x00CC0020
+#define SRCPAINT		0x00EE0086
+#define SRCAND			0x008800C6
+#define SRCINVERT		0x00660046
+
 typedef float REAL;
 
 #if defined(WIN32)
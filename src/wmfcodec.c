@@ -99,10 +99,10 @@ GetColor (WORD w1, WORD w2)
 
 /* http://wvware.sourceforge.net/caolan/Polygon.html */
 static GpStatus
-Polygon (MetafilePlayContext *context, BYTE *data, int len)
+Polygon (MetafileProgram *program, BYTE *data, int len)
 {
+	MetafileOp *op;
 	GpPointF *points, *pt;
-	GpStatus status;
 	int p;
 	/* variable number of parameters */
 	SHORT num = GETS(WP1);
@@ -114,7 +114,11 @@ Polygon (MetafilePlayContext *context, BYTE *data, int len)
 #ifdef DEBUG_WMF
 	printf ("Polygon %d points", num);
 #endif
-	points = (GpPointF*) GdipAlloc (num * sizeof (GpPointF));
+	op = gdip_metafile_program_add (program, MetafileOpPolygon);
+	if (!op)
+		return OutOfMemory;
+
+	points = gdip_metafile_program_add_points (program, op, num);
 	if (!points)
 		return OutOfMemory;
 
@@ -128,18 +132,15 @@ Polygon (MetafilePlayContext *context, BYTE *data, int len)
 		printf ("\n\tpoly to %g,%g", pt->X, pt->Y);
 #endif
 	}
-
-	status = gdip_metafile_Polygon (context, points, num);
-
-	GdipFree (points);
-	return status;
+	return Ok;
 }
 
 /* http://wvware.sourceforge.net/caolan/Polyline.html */
 static GpStatus
-Polyline (MetafilePlayContext *context, BYTE *data)
+Polyline (MetafileProgram *program, BYTE *data)
 {
-	GpStatus status;
+	MetafileOp *op;
+	GpPointF *points, *pt;
 	int p;
 	/* variable number of parameters */
 	SHORT num = GETS(WP1);
@@ -147,24 +148,27 @@ Polyline (MetafilePlayContext *context, BYTE *data)
 #ifdef DEBUG_WMF
 	printf ("Polyline %d points", num);
 #endif
-	SHORT x1 = GETS(WP2);
-	SHORT y1 = GETS(WP3);
-	int n = 4;
-	for (p = 1; p < num; p++) {
-		SHORT x2 = GETS(WP(n));
+	/* nothing is drawn without, at least, one line */
+	if (num < 2)
+		return Ok;
+
+	op = gdip_metafile_program_add (program, MetafileOpPolyline);
+	if (!op)
+		return OutOfMemory;
+
+	points = gdip_metafile_program_add_points (program, op, num);
+	if (!points)
+		return OutOfMemory;
+
+	int n = 2;
+	for (p = 0, pt = points; p < num; p++, pt++) {
+		pt->X = GETS(WP(n));
 		n++;
-		SHORT y2 = GETS(WP(n));
+		pt->Y = GETS(WP(n));
 		n++;
 #ifdef DEBUG_WMF_2
-		printf ("\n\tdraw from %d,%d to %d,%d", x1, y1, x2, y2);
+		printf ("\n\tline to %g,%g", pt->X, pt->Y);
 #endif
-		GpPen *pen = gdip_metafile_GetSelectedPen (context);
-		status = GdipDrawLine (context->graphics, pen, x1, y1, x2, y2);
-		if (status != Ok)
-			return status;
-
-		x1 = x2;
-		y1 = y2;
 	}
 	return Ok;
 }
@@ -172,48 +176,34 @@ Polyline (MetafilePlayContext *context, BYTE *data)
 /* http://wvware.sourceforge.net/caolan/PolyPolygon.html */
 /* storage isn't very efficient, # of polygons, size of each polygon, data for each polygon */
 static GpStatus
-PolyPolygon (MetafilePlayContext *context, BYTE *data)
+PolyPolygon (MetafileProgram *program, BYTE *data)
 {
-	GpStatus status = Ok;
 	/* variable number of parameters */
 	int poly_num = GETW(WP1);
-	int i, j;
-	PointFList *list = GdipAlloc (poly_num * sizeof (PointFList));
-	if (!list) {
-		return OutOfMemory;
-	}
-
-	PointFList *current = list;
+	int i;
 #ifdef DEBUG_WMF
 	printf ("PolyPolygon has %d polygons", poly_num);
 #endif
-	int n = 2;
-	/* read size of each polygon and allocate the required memory */
+	/* points follow the size of each polygon, each polygon becomes its own operation */
+	int n = 2 + poly_num;
 	for (i = 0; i < poly_num; i++) {
-		current->num = GETW(WP(n));
-		n++;
-		current->points = (GpPointF*) GdipAlloc (current->num * sizeof (GpPointF));
-		if (!current->points) {
-			for (j = 0; j < i; j++) {
-				GdipFree (list[j].points);
-			}
-
-			GdipFree (list);
-			return OutOfMemory;
-		}
+		int num = GETW(WP(2 + i));
+		MetafileOp *op;
+		GpPointF *pt;
+		int p;
 
 #ifdef DEBUG_WMF_2
-		printf ("\n\tSub Polygon #%d has %d points", i, current->num);
+		printf ("\n\tSub Polygon #%d has %d points", i, num);
 #endif
-		current++;
-	}
+		op = gdip_metafile_program_add (program, MetafileOpPolygon);
+		if (!op)
+			return OutOfMemory;
 
-	/* read the points for each polygons */
-	current = list;
-	for (i = 0; i < poly_num; i++) {
-		GpPointF *pt = current->points;
-		int p;
-		for (p = 0; p < current->num; p++) {
+		pt = gdip_metafile_program_add_points (program, op, num);
+		if (!pt)
+			return OutOfMemory;
+
+		for (p = 0; p < num; p++) {
 			pt->X = GETW(WP(n));
 			n++;
 			pt->Y = GETW(WP(n));
@@ -223,31 +213,48 @@ PolyPolygon (MetafilePlayContext *context, BYTE *data)
 #endif
 			pt++;
 		}
-
-		GpStatus s = gdip_metafile_Polygon (context, current->points, current->num);
-		if (s != Ok)
-			status = s;
-
-		/* free points */
-		GdipFree (current->points);
-		current++;
 	}
+	return Ok;
+}
 
-	/* all points were freed, after being drawn, so we just have to free the polygon list*/
-	GdipFree (list);
-	return status;
+static GpStatus
+StretchDIBits (MetafileProgram *program, int XDest, int YDest, int nDestWidth, int nDestHeight, 
+	int XSrc, int YSrc, int nSrcWidth, int nSrcHeight, BYTE *dib, int size, UINT iUsage, DWORD dwRop)
+{
+	MetafileOp *op = gdip_metafile_program_add (program, MetafileOpStretchDIBits);
+	if (!op)
+		return OutOfMemory;
+
+	op->args.i [0] = XDest;
+	op->args.i [1] = YDest;
+	op->args.i [2] = nDestWidth;
+	op->args.i [3] = nDestHeight;
+	op->args.i [4] = XSrc;
+	op->args.i [5] = YSrc;
+	op->args.i [6] = nSrcWidth;
+	op->args.i [7] = nSrcHeight;
+	op->args.i [8] = iUsage;
+	op->args.i [9] = dwRop;
+	/* the packed DIB fills the rest of the record */
+	return gdip_metafile_program_add_dib (program, op, dib, size, NULL, 0);
 }
 
+/* The records are compiled into @program, which gdip_metafile_play runs on every draw */
 GpStatus
-gdip_metafile_play_wmf (MetafilePlayContext *context)
+gdip_metafile_compile_wmf (GpMetafile *metafile, MetafileProgram *program)
 {
 	GpStatus status = Ok;
-	GpMetafile *metafile = context->metafile;
+	MetafilePlayContext compiler;
 	BYTE *data = metafile->data;
 	BYTE *end = data + metafile->length;
 #ifdef DEBUG_WMF
 	int i = 1, j;
 #endif
+	/* tracks the state the compilation depends on, and receives the pens and brushes as they are created */
+	memset (&compiler, 0, sizeof (MetafilePlayContext));
+	compiler.metafile = metafile;
+	compiler.map_mode = MM_TWIPS;
+
 	/* reality check - each record is, at minimum, 6 bytes long (4 size + 2 function) */
 	while (data < end - WMF_MIN_RECORD_SIZE) {
 		DWORD size = GETDW(RECORDSIZE);
@@ -269,113 +276,145 @@ gdip_metafile_play_wmf (MetafilePlayContext *context)
 		switch (func) {
 		case META_SAVEDC:
 			WMF_CHECK_PARAMS(0);
-			status = gdip_metafile_SaveDC (context);
+			status = gdip_metafile_program_add_simple (program, MetafileOpSaveDC, 0, 0);
 			break;
 		case META_SETBKMODE:
 			WMF_CHECK_PARAMS(1);
-			status = gdip_metafile_SetBkMode (context, GETW(WP1));
+			status = gdip_metafile_program_add_simple (program, MetafileOpSetBkMode, GETW(WP1), 0);
 			break;
 		case META_SETMAPMODE:
 			WMF_CHECK_PARAMS(1);
-			status = gdip_metafile_SetMapMode (context, GETW(WP1));
+			status = gdip_metafile_program_map_mode (program, &compiler, GETW(WP1));
 			break;
 		case META_SETROP2:
 			WMF_CHECK_PARAMS(1);
-			status = gdip_metafile_SetROP2 (context, GETW(WP1));
+			status = gdip_metafile_program_add_simple (program, MetafileOpSetROP2, GETW(WP1), 0);
 			break;
 		case META_SETRELABS:
 			WMF_CHECK_PARAMS(1);
-			status = gdip_metafile_SetRelabs (context, GETW(WP1));
+			status = gdip_metafile_program_add_simple (program, MetafileOpSetRelabs, GETW(WP1), 0);
 			break;
 		case META_SETPOLYFILLMODE:
 			WMF_CHECK_PARAMS(1);
-			status = gdip_metafile_SetPolyFillMode (context, GETW(WP1));
+			status = gdip_metafile_program_add_simple (program, MetafileOpSetPolyFillMode, GETW(WP1), 0);
 			break;
 		case META_SETSTRETCHBLTMODE:
 			WMF_CHECK_PARAMS(1); /* 2 but second is unused (32bits?) */
-			status = gdip_metafile_SetStretchBltMode (context, GETW(WP1));
+			status = gdip_metafile_program_add_simple (program, MetafileOpSetStretchBltMode, GETW(WP1), 0);
 			break;
 		case META_RESTOREDC:
 			WMF_CHECK_PARAMS(0);
-			status = gdip_metafile_RestoreDC (context);
+			status = gdip_metafile_program_add_simple (program, MetafileOpRestoreDC, 0, 0);
 			break;
 		case META_SELECTOBJECT:
 			WMF_CHECK_PARAMS(1);
-			status = gdip_metafile_SelectObject (context, GETW(WP1));
+			status = gdip_metafile_program_add_simple (program, MetafileOpSelectObject, GETW(WP1), 0);
 			break;
 		case META_SETTEXTALIGN:
 			WMF_CHECK_PARAMS(1);
-			status = gdip_metafile_SetTextAlign (context, GETW(WP1));
+			status = gdip_metafile_program_add_simple (program, MetafileOpSetTextAlign, GETW(WP1), 0);
 			break;
 		case META_DELETEOBJECT:
 			WMF_CHECK_PARAMS(1);
-			status = gdip_metafile_DeleteObject (context, GETW(WP1));
+			status = gdip_metafile_program_add_simple (program, MetafileOpDeleteObject, GETW(WP1), 0);
 			break;
 		case META_SETBKCOLOR:
 			WMF_CHECK_PARAMS(2);
-			status = gdip_metafile_SetBkColor (context, GetColor (GETW(WP1), GETW(WP2)));
+			status = gdip_metafile_program_add_simple (program, MetafileOpSetBkColor, GetColor (GETW(WP1), GETW(WP2)), 0);
 			break;
 		case META_SETWINDOWORG:
 			WMF_CHECK_PARAMS(2);
-			status = gdip_metafile_SetWindowOrg (context, GETS(WP1), GETS(WP2));
+			status = gdip_metafile_program_add_simple (program, MetafileOpSetWindowOrg, GETS(WP1), GETS(WP2));
 			break;
 		case META_SETWINDOWEXT:
 			WMF_CHECK_PARAMS(2);
-			status = gdip_metafile_SetWindowExt (context, GETS(WP1), GETS(WP2));
+			status = gdip_metafile_program_window_ext (program, &compiler, GETS(WP1), GETS(WP2));
 			break;
 		case META_LINETO:
 			WMF_CHECK_PARAMS(2);
-			status = gdip_metafile_LineTo (context, GETS(WP1), GETS(WP2));
+			status = gdip_metafile_program_add_simple (program, MetafileOpLineTo, GETS(WP1), GETS(WP2));
 			break;
 		case META_MOVETO:
 			WMF_CHECK_PARAMS(2);
-			status = gdip_metafile_MoveTo (context, GETS(WP1), GETS(WP2));
+			status = gdip_metafile_program_add_simple (program, MetafileOpMoveTo, GETS(WP1), GETS(WP2));
 			break;
 		case META_CREATEPENINDIRECT:
 			/* note: documented with only 4 parameters, LOGPEN use a POINT to specify width, so y (3) is unused) */
 			WMF_CHECK_PARAMS(5);
-			status = gdip_metafile_CreatePenIndirect (context, GETW(WP1), GETW(WP2), GetColor (GETW(WP4), GETW(WP5)));
+			status = gdip_metafile_CreatePenIndirect (&compiler, GETW(WP1), GETW(WP2), GetColor (GETW(WP4), GETW(WP5)));
+			if (status == Ok)
+				status = gdip_metafile_program_add_created (program, &compiler);
 			break;
 		case META_CREATEBRUSHINDIRECT:
 			WMF_CHECK_PARAMS(4);
-			status = gdip_metafile_CreateBrushIndirect (context, GETW(WP1), GetColor (GETW(WP2), GETW(WP3)), GETW(WP4));
+			status = gdip_metafile_CreateBrushIndirect (&compiler, GETW(WP1), GetColor (GETW(WP2), GETW(WP3)), GETW(WP4));
+			if (status == Ok)
+				status = gdip_metafile_program_add_created (program, &compiler);
 			break;
 		case META_POLYGON:
-			status = Polygon (context, data, params);
+			status = Polygon (program, data, params);
 			break;
 		case META_POLYLINE:
-			status = Polyline (context, data);
+			status = Polyline (program, data);
 			break;
 		case META_POLYPOLYGON:
-			status = PolyPolygon (context, data);
+			status = PolyPolygon (program, data);
 			break;
-		case META_ARC:
+		case META_ARC: {
+			MetafileOp *op;
 			WMF_CHECK_PARAMS(8);
-			status = gdip_metafile_Arc (context, GETS(WP1), GETS(WP2), GETS(WP3), GETS(WP4), GETS(WP5), GETS(WP6),
-				GETS(WP7), GETS(WP8));
+			op = gdip_metafile_program_add (program, MetafileOpArc);
+			if (!op) {
+				status = OutOfMemory;
+				break;
+			}
+			op->args.i [0] = GETS(WP1);
+			op->args.i [1] = GETS(WP2);
+			op->args.i [2] = GETS(WP3);
+			op->args.i [3] = GETS(WP4);
+			op->args.i [4] = GETS(WP5);
+			op->args.i [5] = GETS(WP6);
+			op->args.i [6] = GETS(WP7);
+			op->args.i [7] = GETS(WP8);
 			break;
-		case META_RECTANGLE:
+		}
+		case META_RECTANGLE: {
+			MetafileOp *op;
 			WMF_CHECK_PARAMS (4);
-			status = gdip_metafile_Rectangle (context, GETS (WP1), GETS (WP2), GETS (WP3), GETS (WP4));
+			op = gdip_metafile_program_add (program, MetafileOpRectangle);
+			if (!op) {
+				status = OutOfMemory;
+				break;
+			}
+			op->args.i [0] = GETS (WP1);
+			op->args.i [1] = GETS (WP2);
+			op->args.i [2] = GETS (WP3);
+			op->args.i [3] = GETS (WP4);
 			break;
-		case META_SETPIXEL:
+		}
+		case META_SETPIXEL: {
+			MetafileOp *op;
 			WMF_CHECK_PARAMS (4);
-			status = gdip_metafile_SetPixel (context, GetColor (GETW (WP1), GETW (WP2)), GETW (WP4), GETW (WP3));
+			op = gdip_metafile_program_add (program, MetafileOpSetPixel);
+			if (!op) {
+				status = OutOfMemory;
+				break;
+			}
+			op->args.i [0] = GetColor (GETW (WP1), GETW (WP2));
+			op->args.i [1] = GETW (WP4);
+			op->args.i [2] = GETW (WP3);
 			break;
+		}
 		case META_STRETCHDIB: {
 			WMF_CHECK_PARAMS(14);
-			BITMAPINFO *bmi = (BITMAPINFO*) (data + 14 * sizeof (WORD));
-			void* bits = (void*) (bmi + GETDW(WP12));
-			status = gdip_metafile_StretchDIBits (context, GETS(WP11), GETS(WP10), GETS(WP9), GETS(WP8), GETS(WP7), 
-				GETS(WP6), GETS(WP5), GETS(WP4), bits, bmi, GETW(WP3), GETDW(WP1));
+			status = StretchDIBits (program, GETS(WP11), GETS(WP10), GETS(WP9), GETS(WP8), GETS(WP7), 
+				GETS(WP6), GETS(WP5), GETS(WP4), data + WP12, MIN ((long) size * 2, (long) (end - data)) - WP12, GETW(WP3), GETDW(WP1));
 			break;
 		}
 		case META_DIBSTRETCHBLT: {
 			WMF_CHECK_PARAMS(12);
-			BITMAPINFO *bmi = (BITMAPINFO*) (data + 13 * sizeof (WORD));
-			void* bits = (void*) (bmi + GETDW(WP11));
-			status = gdip_metafile_StretchDIBits (context, GETS(WP10), GETS(WP9), GETS(WP8), GETS(WP7), GETS(WP6), 
-				GETS(WP5), GETS(WP4), GETS(WP3), bits, bmi, 0, GETDW(WP1));
+			status = StretchDIBits (program, GETS(WP10), GETS(WP9), GETS(WP8), GETS(WP7), GETS(WP6), 
+				GETS(WP5), GETS(WP4), GETS(WP3), data + WP11, MIN ((long) size * 2, (long) (end - data)) - WP11, 0, GETDW(WP1));
 			break;
 		}
 		default:
@@ -4876,6 +4876,131 @@ static void test_valid ()
 	GdipDisposeImage (image);
 }
 
+static void test_validImageLarge ()
+{
+	// Enough lines to be read from the file in several blocks.
+	const int width = 256;
+	const int height = 300;
+	const int stride = width * 3;
+	int size = 54 + stride * height;
+	BYTE *buffer = (BYTE *) malloc (size);
+	GpStatus status;
+	ARGB color;
+
+	memset (buffer, 0, 54);
+	buffer[0] = 'B';
+	buffer[1] = 'M';
+	buffer[2] = size & 0xFF;
+	buffer[3] = (size >> 8) & 0xFF;
+	buffer[4] = (size >> 16) & 0xFF;
+	buffer[10] = 54;
+	buffer[14] = 40;
+	buffer[18] = width & 0xFF;
+	buffer[19] = width >> 8;
+	buffer[22] = height & 0xFF;
+	buffer[23] = height >> 8;
+	buffer[26] = 1;
+	buffer[28] = 24;
+
+	// Bottom-up, the first stored line is the last one of the image.
+	for (int y = 0; y < height; y++) {
+		BYTE *line = buffer + 54 + (height - y - 1) * stride;
+		for (int x = 0; x < width; x++) {
+			line[x * 3] = (BYTE) (x + y);
+			line[x * 3 + 1] = (BYTE) y;
+			line[x * 3 + 2] = (BYTE) x;
+		}
+	}
+
+	FILE *f = fopen (file, "wb+");
+	assert (f);
+	fwrite (buffer, sizeof (BYTE), size, f);
+	fclose (f);
+	free (buffer);
+
+	status = GdipLoadImageFromFile (wFile, &image);
+	assertEqualInt (status, Ok);
+	verifyBitmap (image, bmpRawFormat, PixelFormat24bppRGB, width, height, bmpFlags, 0, TRUE);
+
+	for (int y = 0; y < height; y += 13) {
+		for (int x = 0; x < width; x += 51) {
+			GdipBitmapGetPixel ((GpBitmap *) image, x, y, &color);
+			assertEqualARGB (color, 0xFF000000 | (x << 16) | ((y & 0xFF) << 8) | ((x + y) & 0xFF));
+		}
+	}
+
+	GdipDisposeImage (image);
+}
+
+static void test_validImageLargeRle8 ()
+{
+	// Enough compressed lines to go past the decoder's input window.
+	const int width = 64;
+	const int height = 200;
+	const int lineSize = 2 + 2 + 32 + 2;
+	const int offset = 14 + 40 + 256 * 4;
+	int size = offset + lineSize * height + 2;
+	BYTE *buffer = (BYTE *) malloc (size);
+	BYTE *data;
+	GpStatus status;
+	ARGB color;
+
+	memset (buffer, 0, offset);
+	buffer[0] = 'B';
+	buffer[1] = 'M';
+	buffer[2] = size & 0xFF;
+	buffer[3] = (size >> 8) & 0xFF;
+	buffer[10] = offset & 0xFF;
+	buffer[11] = offset >> 8;
+	buffer[14] = 40;
+	buffer[18] = width;
+	buffer[22] = height;
+	buffer[26] = 1;
+	buffer[28] = 8;
+	buffer[30] = BI_RLE8;
+	buffer[47] = 1; // 256 colors
+	for (int i = 0; i < 256; i++) {
+		buffer[54 + i * 4] = i;
+		buffer[54 + i * 4 + 1] = i;
+		buffer[54 + i * 4 + 2] = i;
+	}
+
+	// Each line is a run of 32 pixels followed by 32 absolute pixels, stored bottom-up.
+	data = buffer + offset;
+	for (int y = height - 1; y >= 0; y--) {
+		*data++ = 32;
+		*data++ = (BYTE) y;
+		*data++ = 0;
+		*data++ = 32;
+		for (int x = 32; x < width; x++)
+			*data++ = (BYTE) (x + y);
+		*data++ = 0;
+		*data++ = 0;
+	}
+	*data++ = 0;
+	*data++ = 1;
+
+	FILE *f = fopen (file, "wb+");
+	assert (f);
+	fwrite (buffer, sizeof (BYTE), size, f);
+	fclose (f);
+	free (buffer);
+
+	status = GdipLoadImageFromFile (wFile, &image);
+	assertEqualInt (status, Ok);
+	verifyBitmap (image, bmpRawFormat, PixelFormat8bppIndexed, width, height, bmpFlags, 0, TRUE);
+
+	for (int y = 0; y < height; y += 7) {
+		for (int x = 0; x < width; x += 5) {
+			BYTE value = x < 32 ? (BYTE) y : (BYTE) (x + y);
+			GdipBitmapGetPixel ((GpBitmap *) image, x, y, &color);
+			assertEqualARGB (color, 0xFF000000 | (value << 16) | (value << 8) | value);
+		}
+	}
+
+	GdipDisposeImage (image);
+}
+
 static void test_invalidFileHeader ()
 {
 	BYTE shortSignature[] = {'B'};
@@ -5313,6 +5438,8 @@ main (int argc, char**argv)
 	test_validImage32bppBitmapV4Header ();
 	test_validImage32bppBitmapV5Header ();
 	test_validImage32bppBitfields ();
+	test_validImageLarge ();
+	test_validImageLargeRle8 ();
 	test_invalidFileHeader ();
 	test_invalidHeader ();
 	test_invalidDataSize ();
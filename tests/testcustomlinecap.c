@@ -691,6 +691,62 @@ static void test_getCustomLineCapWidthScale ()
 	GdipDeleteCustomLineCap (cap);
 }
 
+static void test_drawCustomLineCap ()
+{
+	GpStatus status;
+	GpBitmap *bitmap;
+	GpGraphics *graphics;
+	GpPath *fillPath;
+	GpPath *strokePath;
+	GpCustomLineCap *cap;
+	GpCustomLineCap *clonedCap;
+	GpPen *pen;
+	ARGB color;
+
+	GdipCreateBitmapFromScan0 (100, 100, 0, PixelFormat32bppARGB, NULL, &bitmap);
+	GdipGetImageGraphicsContext (bitmap, &graphics);
+
+	GdipCreatePath (FillModeAlternate, &fillPath);
+	GdipAddPathRectangle (fillPath, -2, -2, 4, 4);
+	GdipCreatePath (FillModeAlternate, &strokePath);
+	GdipAddPathLine (strokePath, -3, 0, 3, 0);
+	GdipCreateCustomLineCap (fillPath, strokePath, LineCapFlat, 0, &cap);
+
+	GdipCreatePen1 (0xFF0000FF, 2, UnitPixel, &pen);
+	GdipSetPenCustomStartCap (pen, cap);
+	GdipSetPenCustomEndCap (pen, cap);
+
+	// The cap geometry is reused, and rebuilt when the pen width changes.
+	status = GdipDrawLine (graphics, pen, 20, 50, 80, 50);
+	assertEqualInt (status, Ok);
+	status = GdipDrawLine (graphics, pen, 50, 20, 50, 80);
+	assertEqualInt (status, Ok);
+	GdipSetPenWidth (pen, 3);
+	status = GdipDrawLine (graphics, pen, 20, 20, 80, 80);
+	assertEqualInt (status, Ok);
+
+#if !defined(USE_WINDOWS_GDIPLUS)
+	// The filled square is centered on the end points.
+	GdipBitmapGetPixel (bitmap, 80, 50, &color);
+	assertEqualInt (color, 0xFF0000FF);
+#endif
+
+	// Cloned caps don't share the geometry.
+	status = GdipCloneCustomLineCap (cap, &clonedCap);
+	assertEqualInt (status, Ok);
+	GdipSetPenCustomEndCap (pen, clonedCap);
+	status = GdipDrawLine (graphics, pen, 20, 80, 80, 20);
+	assertEqualInt (status, Ok);
+
+	GdipDeletePen (pen);
+	GdipDeleteCustomLineCap (clonedCap);
+	GdipDeleteCustomLineCap (cap);
+	GdipDeletePath (fillPath);
+	GdipDeletePath (strokePath);
+	GdipDeleteGraphics (graphics);
+	GdipDisposeImage ((GpImage *) bitmap);
+}
+
 int
 main(int argc, char**argv)
 {
@@ -710,6 +766,7 @@ main(int argc, char**argv)
 	test_getCustomLineCapBaseInset ();
 	test_setCustomLineCapWidthScale ();
 	test_getCustomLineCapWidthScale ();
+	test_drawCustomLineCap ();
 
 	SHUTDOWN;
 	return 0;
@@ -228,6 +228,162 @@ static void test_invalidExtensionRecord ()
   createFile (multipleGraphicsControlBlocks, OutOfMemory);
 }
 
+static void test_multipleFrames ()
+{
+  GpStatus status;
+  GUID dimension;
+  UINT count;
+  ARGB firstPixel;
+  ARGB secondPixel;
+  // The second frame is all white, the first one has a black bottom right pixel.
+  BYTE twoFrames[] = {'G', 'I', 'F', '8', '9', 'a', 3, 0, 5, 0, B8(10000000), 0, 0, 0, 0, 0, 255, 255, 255, ',', 0, 0, 0, 0, 3, 0, 5, 0, 0, 0x02, 0x06, 0x84, 0x03, 0x81, 0x9a, 0x06, 0x05, 0x00, ',', 0, 0, 0, 0, 3, 0, 5, 0, 0, 0x02, 0x03, 0x8c, 0x8f, 0x59, 0x00, ';'};
+
+  createFile (twoFrames, Ok);
+
+  status = GdipImageGetFrameDimensionsList (image, &dimension, 1);
+  assertEqualInt (status, Ok);
+  status = GdipImageGetFrameCount (image, &dimension, &count);
+  assertEqualInt (status, Ok);
+  assertEqualInt (count, 2);
+
+  GdipBitmapGetPixel ((GpBitmap *) image, 2, 4, &firstPixel);
+  assertEqualARGB (firstPixel, 0xFF000000);
+
+  // The second frame is decoded when selected.
+  status = GdipImageSelectActiveFrame (image, &dimension, 1);
+  assertEqualInt (status, Ok);
+  verifyBitmap (image, gifRawFormat, PixelFormat8bppIndexed, 3, 5, ImageFlagsColorSpaceRGB | ImageFlagsHasRealDPI | ImageFlagsHasRealPixelSize | ImageFlagsReadOnly, 0, TRUE);
+  GdipBitmapGetPixel ((GpBitmap *) image, 2, 4, &secondPixel);
+  assertEqualARGB (secondPixel, 0xFFFFFFFF);
+  GdipBitmapGetPixel ((GpBitmap *) image, 0, 0, &secondPixel);
+  assertEqualARGB (secondPixel, 0xFFFFFFFF);
+
+  // Going back decodes the first frame again.
+  status = GdipImageSelectActiveFrame (image, &dimension, 0);
+  assertEqualInt (status, Ok);
+  GdipBitmapGetPixel ((GpBitmap *) image, 2, 4, &firstPixel);
+  assertEqualARGB (firstPixel, 0xFF000000);
+
+  GdipDisposeImage (image);
+}
+
+#if !defined(USE_WINDOWS_GDIPLUS)
+static void test_frameDisposal ()
+{
+  GpStatus status;
+  GUID dimension;
+  ARGB color;
+  // A red frame that is kept, a frame with a transparent pixel restored to the previous screen, and a blue pixel.
+  BYTE threeFrames[] = {'G', 'I', 'F', '8', '9', 'a', 3, 0, 1, 0, B8(10000001), 0, 0, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255,
+    '!', 0xF9, 0x04, B8(00000100), 0, 0, 0, 0x00, ',', 0, 0, 0, 0, 3, 0, 1, 0, 0, 0x02, 0x03, 0x4c, 0x98, 0x02, 0x00,
+    '!', 0xF9, 0x04, B8(00001101), 0, 0, 0, 0x00, ',', 1, 0, 0, 0, 2, 0, 1, 0, 0, 0x02, 0x02, 0x84, 0x0a, 0x00,
+    ',', 0, 0, 0, 0, 1, 0, 1, 0, 0, 0x02, 0x02, 0x5c, 0x01, 0x00, ';'};
+
+  createFile (threeFrames, Ok);
+  GdipImageGetFrameDimensionsList (image, &dimension, 1);
+
+  // The transparent pixel shows the first frame.
+  status = GdipImageSelectActiveFrame (image, &dimension, 1);
+  assertEqualInt (status, Ok);
+  GdipBitmapGetPixel ((GpBitmap *) image, 1, 0, &color);
+  assertEqualARGB (color, 0xFFFF0000);
+  GdipBitmapGetPixel ((GpBitmap *) image, 2, 0, &color);
+  assertEqualARGB (color, 0xFF00FF00);
+
+  // The second frame is restored to the first one.
+  status = GdipImageSelectActiveFrame (image, &dimension, 2);
+  assertEqualInt (status, Ok);
+  GdipBitmapGetPixel ((GpBitmap *) image, 0, 0, &color);
+  assertEqualARGB (color, 0xFF0000FF);
+  GdipBitmapGetPixel ((GpBitmap *) image, 2, 0, &color);
+  assertEqualARGB (color, 0xFFFF0000);
+
+  // Going back replays the frames.
+  status = GdipImageSelectActiveFrame (image, &dimension, 0);
+  assertEqualInt (status, Ok);
+  GdipBitmapGetPixel ((GpBitmap *) image, 0, 0, &color);
+  assertEqualARGB (color, 0xFFFF0000);
+  GdipBitmapGetPixel ((GpBitmap *) image, 2, 0, &color);
+  assertEqualARGB (color, 0xFFFF0000);
+
+  GdipDisposeImage (image);
+}
+
+static void test_localPalettes ()
+{
+  GpStatus status;
+  GUID dimension;
+  PixelFormat format;
+  ARGB color;
+  // Red frame kept, a white pixel from a local palette restored to the background, a green pixel with a transparent index.
+  BYTE threeFrames[] = {'G', 'I', 'F', '8', '9', 'a', 3, 0, 1, 0, B8(10000001), 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0,
+    '!', 0xF9, 0x04, B8(00000100), 0, 0, 0, 0x00, ',', 0, 0, 0, 0, 3, 0, 1, 0, 0, 0x02, 0x02, 0x84, 0x0b, 0x00,
+    '!', 0xF9, 0x04, B8(00001000), 0, 0, 0, 0x00, ',', 0, 0, 0, 0, 1, 0, 1, 0, B8(10000000), 255, 255, 255, 0, 0, 0, 0x02, 0x02, 0x44, 0x01, 0x00,
+    '!', 0xF9, 0x04, B8(00000001), 0, 0, 3, 0x00, ',', 2, 0, 0, 0, 1, 0, 1, 0, 0, 0x02, 0x02, 0x4c, 0x01, 0x00, ';'};
+
+  createFile (threeFrames, Ok);
+  GdipImageGetFrameDimensionsList (image, &dimension, 1);
+
+  // The frames stay indexed, the local palette doesn't change the pixels of the first frame.
+  GdipGetImagePixelFormat (image, &format);
+  assertEqualInt (format, PixelFormat8bppIndexed);
+  GdipBitmapGetPixel ((GpBitmap *) image, 0, 0, &color);
+  assertEqualARGB (color, 0xFFFF0000);
+
+  // The pixels left by the first frame get the nearest color of the local palette.
+  status = GdipImageSelectActiveFrame (image, &dimension, 1);
+  assertEqualInt (status, Ok);
+  GdipGetImagePixelFormat (image, &format);
+  assertEqualInt (format, PixelFormat8bppIndexed);
+  GdipBitmapGetPixel ((GpBitmap *) image, 0, 0, &color);
+  assertEqualARGB (color, 0xFFFFFFFF);
+  GdipBitmapGetPixel ((GpBitmap *) image, 1, 0, &color);
+  assertEqualARGB (color, 0xFF000000);
+
+  // The background is transparent, the red pixels are back with the global palette.
+  status = GdipImageSelectActiveFrame (image, &dimension, 2);
+  assertEqualInt (status, Ok);
+  GdipBitmapGetPixel ((GpBitmap *) image, 0, 0, &color);
+  assertEqualARGB (color, 0x00000000);
+  GdipBitmapGetPixel ((GpBitmap *) image, 1, 0, &color);
+  assertEqualARGB (color, 0xFFFF0000);
+  GdipBitmapGetPixel ((GpBitmap *) image, 2, 0, &color);
+  assertEqualARGB (color, 0xFF00FF00);
+
+  GdipDisposeImage (image);
+}
+
+static void test_saveQuantized ()
+{
+  GpStatus status;
+  GpBitmap *bitmap;
+  ARGB color;
+  int x, y;
+  // A few flat colors are kept exactly.
+  ARGB pixels[2][4] = {
+    {0xFFFF0000, 0xFF00FF00, 0xFF0000FF, 0xFF123456},
+    {0xFFFFFFFF, 0xFF000000, 0xFF808080, 0xFFFF0000}
+  };
+
+  status = GdipCreateBitmapFromScan0 (4, 2, 16, PixelFormat32bppARGB, (BYTE *) pixels, &bitmap);
+  assertEqualInt (status, Ok);
+  status = GdipSaveImageToFile (bitmap, wFile, &gifEncoderClsid, NULL);
+  assertEqualInt (status, Ok);
+  GdipDisposeImage (bitmap);
+
+  status = GdipLoadImageFromFile (wFile, &image);
+  assertEqualInt (status, Ok);
+  for (y = 0; y < 2; y++) {
+    for (x = 0; x < 4; x++) {
+      GdipBitmapGetPixel ((GpBitmap *) image, x, y, &color);
+      assertEqualARGB (color, pixels[y][x]);
+    }
+  }
+
+  GdipDisposeImage (image);
+}
+#endif
+
 int
 main (int argc, char**argv)
 {
@@ -237,6 +393,12 @@ main (int argc, char**argv)
   test_invalidHeader ();
   test_invalidImageRecord ();
   test_invalidExtensionRecord ();
+  test_multipleFrames ();
+#if !defined(USE_WINDOWS_GDIPLUS)
+  test_frameDisposal ();
+  test_localPalettes ();
+  test_saveQuantized ();
+#endif
 
   deleteFile (file);
 
@@ -10294,6 +10294,69 @@ static void test_drawPath ()
 	GdipDeletePen (pen);
 }
 
+static void test_drawPathDashed ()
+{
+	GpStatus status;
+	GpImage *image;
+	GpGraphics *graphics;
+	GpPen *pen;
+	GpPath *path;
+	ARGB color;
+
+	GdipCreatePen1 (0xFF00FF00, 4, UnitPixel, &pen);
+	GdipSetPenDashStyle (pen, DashStyleDash);
+	GdipCreatePath (FillModeAlternate, &path);
+	GdipAddPathLine (path, 10, 50, 90, 50);
+
+	// Drawing the same path twice reuses its dashes.
+	for (int i = 0; i < 2; i++) {
+		createImageGraphics (100, 100, &image, &graphics);
+		status = GdipDrawPath (graphics, pen, path);
+		assertEqualInt (status, Ok);
+
+#if !defined(USE_WINDOWS_GDIPLUS)
+		GdipBitmapGetPixel ((GpBitmap *) image, 15, 50, &color);
+		assertEqualInt (color, 0xFF00FF00);
+		GdipBitmapGetPixel ((GpBitmap *) image, 24, 50, &color);
+		assertEqualInt (color, 0);
+#endif
+
+		GdipDeleteGraphics (graphics);
+		GdipDisposeImage (image);
+	}
+
+	// Changing the pen dashes the path again.
+	GdipSetPenDashStyle (pen, DashStyleDot);
+	createImageGraphics (100, 100, &image, &graphics);
+	status = GdipDrawPath (graphics, pen, path);
+	assertEqualInt (status, Ok);
+
+#if !defined(USE_WINDOWS_GDIPLUS)
+	GdipBitmapGetPixel ((GpBitmap *) image, 12, 50, &color);
+	assertEqualInt (color, 0xFF00FF00);
+	GdipBitmapGetPixel ((GpBitmap *) image, 16, 50, &color);
+	assertEqualInt (color, 0);
+#endif
+
+	// So does changing the path.
+	GdipAddPathLine (path, 90, 60, 10, 60);
+	status = GdipDrawPath (graphics, pen, path);
+	assertEqualInt (status, Ok);
+
+#if !defined(USE_WINDOWS_GDIPLUS)
+	// The dots carry on from the first line, so the new one starts 2 pixels into a dot.
+	GdipBitmapGetPixel ((GpBitmap *) image, 82, 60, &color);
+	assertEqualInt (color, 0xFF00FF00);
+	GdipBitmapGetPixel ((GpBitmap *) image, 86, 60, &color);
+	assertEqualInt (color, 0);
+#endif
+
+	GdipDeleteGraphics (graphics);
+	GdipDisposeImage (image);
+	GdipDeletePath (path);
+	GdipDeletePen (pen);
+}
+
 static void test_drawPie ()
 {
 	GpStatus status;
@@ -11574,6 +11637,7 @@ main (int argc, char**argv)
 	test_drawLines ();
 	test_drawLinesI ();
 	test_drawPath ();
+	test_drawPathDashed ();
 	test_drawPie ();
 	test_drawPieI ();
 	test_drawPolygon ();
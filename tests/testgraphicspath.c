@@ -3113,6 +3113,30 @@ static void test_flattenPath ()
 
 	GdipDeletePath (path);
 
+	// Large ellipse - every flattened point lies on the ellipse.
+	GdipCreatePath (FillModeWinding, &path);
+	GdipAddPathEllipse (path, 0, 0, 200, 100);
+
+	status = GdipFlattenPath (path, NULL, 0.25);
+	assertEqualInt (status, Ok);
+	{
+		INT count;
+		PointF *points;
+
+		GdipGetPointCount (path, &count);
+		assert (count > 13);
+		points = (PointF *) malloc (count * sizeof (PointF));
+		GdipGetPathPoints (path, points, count);
+		for (int i = 0; i < count; i++) {
+			float dx = (points[i].X - 100) / 100;
+			float dy = (points[i].Y - 50) / 50;
+			assert (fabs (sqrt (dx * dx + dy * dy) - 1) < 0.01);
+		}
+		free (points);
+	}
+
+	GdipDeletePath (path);
+
 	// Negative tests.
 	status = GdipFlattenPath (NULL, identityMatrix, 1);
 	assertEqualInt (status, InvalidParameter);
@@ -3125,7 +3149,6 @@ static void test_windingModeOutline ()
 {
 	GpStatus status;
 	GpPath *path;
-#if defined(USE_WINDOWS_GDIPLUS)
 	PointF singlePoints[] = {
 		{1, 2}
 	};
@@ -3150,7 +3173,6 @@ static void test_windingModeOutline ()
 		PathPointTypeLine,
 		PathPointTypeLine
 	};
-#endif
 	GpMatrix *identityMatrix;
 	GpMatrix *customMatrix;
 
@@ -3193,7 +3215,6 @@ static void test_windingModeOutline ()
 
 	GdipDeletePath (path);
 
-#if defined(USE_WINDOWS_GDIPLUS)
 	// Single - null.
 	GdipCreatePath2 (singlePoints, singleTypes, 1, FillModeWinding, &path);
 	
@@ -3270,6 +3291,8 @@ static void test_windingModeOutline ()
 	assertEqualInt (status, Ok);
 	verifyPath (path, FillModeAlternate, 1, 2, 3, 4, nonEmptyPoints, nonEmptyTypes, 4);
 
+	GdipDeletePath (path);
+
 	// Non Empty Lines - open.
 	GdipCreatePath2 (nonEmptyPoints, openNonEmptyTypes, 4, FillModeWinding, &path);
 	
@@ -3286,11 +3309,19 @@ static void test_windingModeOutline ()
 
 	status = GdipWindingModeOutline (path, NULL, 1);
 	assertEqualInt (status, Ok);
+	// The outlines follow the flattened ellipse, which differs from GDI+ (see test_flattenPath).
 	PointF circleOneFlatnessPointsExpected[] = {
+#if defined(USE_WINDOWS_GDIPLUS)
 		{4, 4},
 		{2.5, 6},
 		{1, 4},
 		{2.5, 2},
+#else
+		{1, 4},
+		{2.5, 2},
+		{4, 4},
+		{2.5, 6},
+#endif
 		{11, 12},
 		{14, 12},
 		{14, 16},
@@ -3329,6 +3360,7 @@ static void test_windingModeOutline ()
 	status = GdipWindingModeOutline (path, customMatrix, 1);
 	assertEqualInt (status, Ok);
 	PointF circleOneFlatnessTransformedPointsExpected[] = {
+#if defined(USE_WINDOWS_GDIPLUS)
 		{21, 30},
 		{25, 34.75},
 		{25.5, 35},
@@ -3337,6 +3369,14 @@ static void test_windingModeOutline ()
 		{14.25, 19.25},
 		{13.5, 19},
 		{16.5, 23.5},
+#else
+		{13.5, 19},
+		{21, 30},
+		{24.8033, 34.7782},
+		{25.5, 35},
+		{18, 24},
+		{14.1967, 19.2218},
+#endif
 		{52, 76},
 		{55, 82},
 		{67, 98},
@@ -3349,14 +3389,49 @@ static void test_windingModeOutline ()
 		PathPointTypeLine,
 		PathPointTypeLine,
 		PathPointTypeLine,
+#if defined(USE_WINDOWS_GDIPLUS)
+		PathPointTypeLine,
 		PathPointTypeLine,
+#endif
 		PathPointTypeLine | PathPointTypeCloseSubpath,
 		PathPointTypeStart,
 		PathPointTypeLine,
 		PathPointTypeLine,
 		PathPointTypeLine | PathPointTypeCloseSubpath
 	};
-	verifyPath (path, FillModeAlternate, 13.5, 19, 53.5, 79, circleOneFlatnessTransformedPointsExpected, circleOneFlatnessTransformedTypesExpected, 12);
+	verifyPath (path, FillModeAlternate, 13.5, 19, 53.5, 79, circleOneFlatnessTransformedPointsExpected, circleOneFlatnessTransformedTypesExpected, WINDOWS_GDIPLUS ? 12 : 10);
+
+	GdipDeletePath (path);
+
+#if !defined(USE_WINDOWS_GDIPLUS)
+	// Overlapping rectangles - the union outline.
+	GdipCreatePath (FillModeWinding, &path);
+	GdipAddPathRectangle (path, 0, 0, 10, 10);
+	GdipAddPathRectangle (path, 5, 5, 10, 10);
+
+	status = GdipWindingModeOutline (path, NULL, 1);
+	assertEqualInt (status, Ok);
+	PointF unionPointsExpected[] = {
+		{0, 0},
+		{10, 0},
+		{10, 5},
+		{15, 5},
+		{15, 15},
+		{5, 15},
+		{5, 10},
+		{0, 10}
+	};
+	BYTE unionTypesExpected[] = {
+		PathPointTypeStart,
+		PathPointTypeLine,
+		PathPointTypeLine,
+		PathPointTypeLine,
+		PathPointTypeLine,
+		PathPointTypeLine,
+		PathPointTypeLine,
+		PathPointTypeLine | PathPointTypeCloseSubpath
+	};
+	verifyPath (path, FillModeAlternate, 0, 0, 15, 15, unionPointsExpected, unionTypesExpected, 8);
 
 	GdipDeletePath (path);
 #endif
@@ -3365,7 +3440,6 @@ static void test_windingModeOutline ()
 	status = GdipWindingModeOutline (NULL, identityMatrix, 1);
 	assertEqualInt (status, InvalidParameter);
 
-#if defined(USE_WINDOWS_GDIPLUS)	
 	GdipCreatePath (FillModeWinding, &path);
 	GdipAddPathEllipse (path, 1, 2, 3, 4);
 
@@ -3376,7 +3450,6 @@ static void test_windingModeOutline ()
 	assertEqualInt (status, InvalidParameter);
 
 	GdipDeletePath (path);
-#endif
 
 	GdipDeleteMatrix (identityMatrix);
 	GdipDeleteMatrix (customMatrix);
@@ -4194,6 +4267,414 @@ static void test_addPathStringI ()
 	GdipDeleteStringFormat (format);
 }
 
+static void test_isVisiblePathPoint ()
+{
+    GpStatus status;
+    GpPath *path;
+    GpMatrix *matrix;
+    GpPen *pen;
+    BOOL result;
+
+    GdipCreatePath (FillModeAlternate, &path);
+    GdipAddPathRectangle (path, 10, 10, 20, 20);
+    GdipCreatePen1 (0xFF000000, 4, UnitPixel, &pen);
+
+    status = GdipIsVisiblePathPoint (path, 15, 15, NULL, &result);
+    assertEqualInt (status, Ok);
+    assert (result == TRUE);
+
+    status = GdipIsVisiblePathPoint (path, 5, 15, NULL, &result);
+    assertEqualInt (status, Ok);
+    assert (result == FALSE);
+
+    status = GdipIsOutlineVisiblePathPoint (path, 20, 10, pen, NULL, &result);
+    assertEqualInt (status, Ok);
+    assert (result == TRUE);
+
+    status = GdipIsOutlineVisiblePathPoint (path, 20, 20, pen, NULL, &result);
+    assertEqualInt (status, Ok);
+    assert (result == FALSE);
+
+    // Modifying the path must be reflected by the next hit-test.
+    GdipCreateMatrix2 (1, 0, 0, 1, 100, 0, &matrix);
+    GdipTransformPath (path, matrix);
+
+    status = GdipIsVisiblePathPoint (path, 15, 15, NULL, &result);
+    assertEqualInt (status, Ok);
+    assert (result == FALSE);
+
+    status = GdipIsVisiblePathPoint (path, 115, 15, NULL, &result);
+    assertEqualInt (status, Ok);
+    assert (result == TRUE);
+
+    GdipAddPathEllipse (path, 0, 0, 10, 10);
+    status = GdipIsVisiblePathPoint (path, 4, 4, NULL, &result);
+    assertEqualInt (status, Ok);
+    assert (result == TRUE);
+
+#if !defined(USE_WINDOWS_GDIPLUS)
+    GpPointF points[] = { {115, 15}, {15, 15}, {4, 4} };
+    BOOL results[3];
+    GpPath *otherPath;
+    GpPath *paths[2];
+
+    status = GdipIsVisiblePathPoints_linux (path, points, 3, results);
+    assertEqualInt (status, Ok);
+    assert (results[0] == TRUE);
+    assert (results[1] == FALSE);
+    assert (results[2] == TRUE);
+
+    GdipCreatePath (FillModeAlternate, &otherPath);
+    GdipAddPathRectangle (otherPath, 10, 10, 20, 20);
+    paths[0] = path;
+    paths[1] = otherPath;
+
+    status = GdipIsVisiblePathsPoint_linux (paths, 2, 15, 15, results);
+    assertEqualInt (status, Ok);
+    assert (results[0] == FALSE);
+    assert (results[1] == TRUE);
+
+    status = GdipIsVisiblePathsPoint_linux (NULL, 2, 15, 15, results);
+    assertEqualInt (status, InvalidParameter);
+
+    GdipDeletePath (otherPath);
+#endif
+
+    GdipDeletePath (path);
+    GdipDeleteMatrix (matrix);
+    GdipDeletePen (pen);
+}
+
+static void test_widenPath ()
+{
+    GpStatus status;
+    GpPath *path;
+    GpPen *pen;
+    GpRectF bounds;
+    INT count;
+#if !defined(USE_WINDOWS_GDIPLUS)
+    GpFillMode fillMode;
+    GpBitmap *bitmap;
+    GpGraphics *graphics;
+    GpSolidFill *brush;
+    ARGB color;
+#endif
+
+    GdipCreatePath (FillModeWinding, &path);
+    GdipAddPathLine (path, 0, 0, 10, 0);
+    GdipCreatePen1 (0xFF000000, 4, UnitPixel, &pen);
+
+    status = GdipWidenPath (path, pen, NULL, 0.25f);
+    assertEqualInt (status, Ok);
+
+    status = GdipGetPathWorldBounds (path, &bounds, NULL, NULL);
+    assertEqualInt (status, Ok);
+    assertEqualRectFInline (bounds, 0, -2, 10, 4);
+
+#if !defined(USE_WINDOWS_GDIPLUS)
+    PointF expectedPoints[] = {
+        {0, 2},
+        {10, 2},
+        {10, -2},
+        {0, -2}
+    };
+    BYTE expectedTypes[] = {
+        PathPointTypeStart,
+        PathPointTypeLine,
+        PathPointTypeLine,
+        PathPointTypeLine | PathPointTypeCloseSubpath
+    };
+    verifyPath (path, FillModeWinding, 0, -2, 10, 4, expectedPoints, expectedTypes, sizeof (expectedPoints) / sizeof (PointF));
+
+    // Each dash becomes its own figure.
+    GdipResetPath (path);
+    GdipAddPathLine (path, 0, 0, 30, 0);
+    GdipSetPenDashStyle (pen, DashStyleDash);
+
+    status = GdipWidenPath (path, pen, NULL, 0.25f);
+    assertEqualInt (status, Ok);
+
+    status = GdipGetPointCount (path, &count);
+    assertEqualInt (status, Ok);
+    assertEqualInt (count, 8);
+
+    // The outline overlaps itself inside sharp turns and under anchor caps, it's filled without holes there.
+    GdipDeletePath (path);
+    GdipCreatePath (FillModeAlternate, &path);
+    GdipAddPathLine (path, 10, 50, 90, 50);
+    GdipAddPathLine (path, 90, 50, 20, 60);
+    GdipStartPathFigure (path);
+    GdipAddPathLine (path, 10, 80, 60, 80);
+    GdipSetPenDashStyle (pen, DashStyleSolid);
+    GdipSetPenWidth (pen, 10);
+    GdipSetPenStartCap (pen, LineCapRoundAnchor);
+
+    status = GdipWidenPath (path, pen, NULL, 0.25f);
+    assertEqualInt (status, Ok);
+    status = GdipGetPathFillMode (path, &fillMode);
+    assertEqualInt (status, Ok);
+    assertEqualInt (fillMode, FillModeWinding);
+
+    GdipCreateBitmapFromScan0 (100, 100, 0, PixelFormat32bppARGB, NULL, &bitmap);
+    GdipGetImageGraphicsContext ((GpImage *) bitmap, &graphics);
+    GdipCreateSolidFill (0xFF0000FF, &brush);
+    status = GdipFillPath (graphics, (GpBrush *) brush, path);
+    assertEqualInt (status, Ok);
+
+    GdipBitmapGetPixel (bitmap, 50, 50, &color);
+    assertEqualARGB (color, 0xFF0000FF);
+    GdipBitmapGetPixel (bitmap, 80, 53, &color);
+    assertEqualARGB (color, 0xFF0000FF);
+    GdipBitmapGetPixel (bitmap, 12, 80, &color);
+    assertEqualARGB (color, 0xFF0000FF);
+    GdipBitmapGetPixel (bitmap, 50, 30, &color);
+    assertEqualARGB (color, 0x00000000);
+
+    GdipDeleteBrush ((GpBrush *) brush);
+    GdipDeleteGraphics (graphics);
+    GdipDisposeImage ((GpImage *) bitmap);
+#endif
+
+    GdipDeletePath (path);
+    GdipDeletePen (pen);
+}
+
+static void test_getPathWorldBounds ()
+{
+    GpStatus status;
+    GpPath *path;
+    GpPen *pen;
+    GpMatrix *matrix;
+    GpRectF bounds;
+
+    GdipCreatePath (FillModeWinding, &path);
+    GdipAddPathBezier (path, 0, 0, 0, 10, 10, 10, 10, 0);
+
+    // Beziers are bounded by their extrema, not their control points.
+    status = GdipGetPathWorldBounds (path, &bounds, NULL, NULL);
+    assertEqualInt (status, Ok);
+    assertEqualRectFInline (bounds, 0, 0, 10, 7.5);
+
+    GdipCreateMatrix2 (1, 0, 0, 1, 5, 5, &matrix);
+    status = GdipGetPathWorldBounds (path, &bounds, matrix, NULL);
+    assertEqualInt (status, Ok);
+    assertEqualRectFInline (bounds, 5, 5, 10, 7.5);
+
+    GdipCreatePen1 (0xFF000000, 2, UnitWorld, &pen);
+
+#if !defined(USE_WINDOWS_GDIPLUS)
+    // Caps extending past the half width.
+    GdipResetPath (path);
+    GdipAddPathLine (path, 0, 0, 10, 0);
+    GdipSetPenStartCap (pen, LineCapSquare);
+    GdipSetPenEndCap (pen, LineCapSquareAnchor);
+
+    status = GdipGetPathWorldBounds (path, &bounds, NULL, pen);
+    assertEqualInt (status, Ok);
+    assertEqualRectFInline (bounds, -1, -2, 13, 4);
+
+    // Miter joins.
+    GdipResetPath (path);
+    GdipAddPathLine (path, 0, 0, 10, 0);
+    GdipAddPathLine (path, 10, 0, 0, 10);
+    GdipSetPenStartCap (pen, LineCapFlat);
+    GdipSetPenEndCap (pen, LineCapFlat);
+
+    status = GdipGetPathWorldBounds (path, &bounds, NULL, pen);
+    assertEqualInt (status, Ok);
+    assertEqualRectFInline (bounds, -1, -1, 13.414214f, 12);
+
+    GdipSetPenLineJoin (pen, LineJoinBevel);
+    status = GdipGetPathWorldBounds (path, &bounds, NULL, pen);
+    assertEqualInt (status, Ok);
+    assertEqualRectFInline (bounds, -1, -1, 12, 12);
+#endif
+
+    // Negative tests.
+    status = GdipGetPathWorldBounds (NULL, &bounds, NULL, NULL);
+    assertEqualInt (status, InvalidParameter);
+
+    status = GdipGetPathWorldBounds (path, NULL, NULL, NULL);
+    assertEqualInt (status, InvalidParameter);
+
+    GdipDeletePath (path);
+    GdipDeletePen (pen);
+    GdipDeleteMatrix (matrix);
+}
+
+static void test_warpPath ()
+{
+    GpStatus status;
+    GpPath *path;
+    PointF destination[] = {
+        {0, 0},
+        {20, 0},
+        {5, 10},
+        {15, 10}
+    };
+    PointF expectedPoints[] = {
+        {0, 0},
+        {20, 0},
+        {15, 10},
+        {5, 10}
+    };
+    BYTE expectedTypes[] = {
+        PathPointTypeStart,
+        PathPointTypeLine,
+        PathPointTypeLine,
+        PathPointTypeLine | PathPointTypeCloseSubpath
+    };
+
+    GdipCreatePath (FillModeAlternate, &path);
+
+    // The corners of the source rectangle are mapped to the destination points.
+    GdipAddPathRectangle (path, 0, 0, 10, 10);
+    status = GdipWarpPath (path, NULL, destination, 4, 0, 0, 10, 10, WarpModePerspective, 0.25f);
+    assertEqualInt (status, Ok);
+    verifyPath (path, FillModeAlternate, 0, 0, 20, 10, expectedPoints, expectedTypes, 4);
+
+    GdipResetPath (path);
+    GdipAddPathRectangle (path, 0, 0, 10, 10);
+    status = GdipWarpPath (path, NULL, destination, 4, 0, 0, 10, 10, WarpModeBilinear, 0.25f);
+    assertEqualInt (status, Ok);
+    verifyPath (path, FillModeAlternate, 0, 0, 20, 10, expectedPoints, expectedTypes, 4);
+
+#if !defined(USE_WINDOWS_GDIPLUS)
+    // Three points define a parallelogram.
+    PointF parallelogram[] = {
+        {0, 0},
+        {20, 0},
+        {5, 10}
+    };
+    PointF expectedParallelogramPoints[] = {
+        {0, 0},
+        {20, 0},
+        {25, 10},
+        {5, 10}
+    };
+
+    GdipResetPath (path);
+    GdipAddPathRectangle (path, 0, 0, 10, 10);
+    status = GdipWarpPath (path, NULL, parallelogram, 3, 0, 0, 10, 10, WarpModePerspective, 0.25f);
+    assertEqualInt (status, Ok);
+    verifyPath (path, FillModeAlternate, 0, 0, 25, 10, expectedParallelogramPoints, expectedTypes, 4);
+#endif
+
+    // Negative tests.
+    status = GdipWarpPath (NULL, NULL, destination, 4, 0, 0, 10, 10, WarpModePerspective, 0.25f);
+    assertEqualInt (status, InvalidParameter);
+
+    status = GdipWarpPath (path, NULL, NULL, 4, 0, 0, 10, 10, WarpModePerspective, 0.25f);
+    assertEqualInt (status, InvalidParameter);
+
+    status = GdipWarpPath (path, NULL, destination, 0, 0, 0, 10, 10, WarpModePerspective, 0.25f);
+    assertEqualInt (status, InvalidParameter);
+
+    GdipDeletePath (path);
+}
+
+static void test_pathIterSubpaths ()
+{
+    GpStatus status;
+    GpPath *path;
+    GpPath *linesPath;
+    GpPath *subpath;
+    GpPathIterator *iterator;
+    INT count;
+    INT resultCount;
+    INT startIndex;
+    INT endIndex;
+    BOOL isClosed;
+    BOOL hasCurve;
+    PointF points[] = {
+        {0, 0}, {10, 0}, {10, 10},
+        {20, 20}, {30, 20}, {30, 30}, {20, 30},
+        {40, 40}, {50, 50}
+    };
+    BYTE types[] = {
+        PathPointTypeStart, PathPointTypeLine, PathPointTypeLine | PathPointTypeCloseSubpath,
+        PathPointTypeStart, PathPointTypeBezier, PathPointTypeBezier, PathPointTypeBezier,
+        PathPointTypeStart, PathPointTypeLine
+    };
+
+    GdipCreatePath2 (points, types, 9, FillModeAlternate, &path);
+    GdipCreatePath (FillModeAlternate, &subpath);
+    GdipCreatePathIter (&iterator, path);
+
+    status = GdipPathIterGetSubpathCount (iterator, &count);
+    assertEqualInt (status, Ok);
+    assertEqualInt (count, 3);
+
+    status = GdipPathIterHasCurve (iterator, &hasCurve);
+    assertEqualInt (status, Ok);
+    assert (hasCurve == TRUE);
+
+    status = GdipPathIterNextSubpath (iterator, &resultCount, &startIndex, &endIndex, &isClosed);
+    assertEqualInt (status, Ok);
+    assertEqualInt (resultCount, 3);
+    assertEqualInt (startIndex, 0);
+    assertEqualInt (endIndex, 2);
+    assert (isClosed == TRUE);
+
+    status = GdipPathIterNextSubpath (iterator, &resultCount, &startIndex, &endIndex, &isClosed);
+    assertEqualInt (status, Ok);
+    assertEqualInt (resultCount, 4);
+    assertEqualInt (startIndex, 3);
+    assertEqualInt (endIndex, 6);
+    assert (isClosed == FALSE);
+
+    status = GdipPathIterNextSubpath (iterator, &resultCount, &startIndex, &endIndex, &isClosed);
+    assertEqualInt (status, Ok);
+    assertEqualInt (resultCount, 2);
+    assertEqualInt (startIndex, 7);
+    assertEqualInt (endIndex, 8);
+    assert (isClosed == FALSE);
+
+    // All the figures were returned.
+    status = GdipPathIterNextSubpath (iterator, &resultCount, &startIndex, &endIndex, &isClosed);
+    assertEqualInt (status, Ok);
+    assertEqualInt (resultCount, 0);
+
+    // Rewind starts over from the first figure.
+    status = GdipPathIterRewind (iterator);
+    assertEqualInt (status, Ok);
+
+    status = GdipPathIterNextSubpathPath (iterator, &resultCount, subpath, &isClosed);
+    assertEqualInt (status, Ok);
+    assertEqualInt (resultCount, 3);
+    assert (isClosed == TRUE);
+    GdipGetPointCount (subpath, &count);
+    assertEqualInt (count, 3);
+
+    status = GdipPathIterNextSubpathPath (iterator, &resultCount, subpath, &isClosed);
+    assertEqualInt (status, Ok);
+    assertEqualInt (resultCount, 4);
+    assert (isClosed == FALSE);
+    GdipGetPointCount (subpath, &count);
+    assertEqualInt (count, 4);
+
+    GdipDeletePathIter (iterator);
+
+    // A path without beziers has no curve.
+    GdipCreatePath (FillModeAlternate, &linesPath);
+    GdipAddPathLine (linesPath, 0, 0, 10, 10);
+    GdipAddPathRectangle (linesPath, 20, 20, 10, 10);
+    GdipCreatePathIter (&iterator, linesPath);
+
+    status = GdipPathIterGetSubpathCount (iterator, &count);
+    assertEqualInt (status, Ok);
+    assertEqualInt (count, 2);
+
+    status = GdipPathIterHasCurve (iterator, &hasCurve);
+    assertEqualInt (status, Ok);
+    assert (hasCurve == FALSE);
+
+    GdipDeletePathIter (iterator);
+    GdipDeletePath (linesPath);
+    GdipDeletePath (subpath);
+    GdipDeletePath (path);
+}
+
 int
 main (int argc, char**argv)
 {
@@ -4228,6 +4709,11 @@ main (int argc, char**argv)
 	test_addPathPieI ();
 	test_addPathString ();
 	test_addPathStringI ();
+	test_isVisiblePathPoint ();
+	test_widenPath ();
+	test_getPathWorldBounds ();
+	test_warpPath ();
+	test_pathIterSubpaths ();
 
 	SHUTDOWN;
 	return 0;
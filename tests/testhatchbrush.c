@@ -172,6 +172,44 @@ static void test_getBackgroundColor ()
     GdipDeleteBrush ((GpBrush *) brush);
 }
 
+static void test_fillHatch ()
+{
+    GpStatus status;
+    GpBitmap *bitmap;
+    GpGraphics *graphics;
+    GpHatch *brush1;
+    GpHatch *brush2;
+    ARGB pixel;
+
+    status = GdipCreateBitmapFromScan0 (16, 16, 0, PixelFormat32bppARGB, NULL, &bitmap);
+    assertEqualInt (status, Ok);
+    status = GdipGetImageGraphicsContext ((GpImage *) bitmap, &graphics);
+    assertEqualInt (status, Ok);
+
+    // Brushes with the same style and colors render the same 8x8 tile.
+    GdipCreateHatchBrush (HatchStyleVertical, 0xFFFF0000, 0xFF0000FF, &brush1);
+    GdipCreateHatchBrush (HatchStyleVertical, 0xFFFF0000, 0xFF0000FF, &brush2);
+
+    status = GdipFillRectangle (graphics, (GpBrush *) brush1, 0, 0, 16, 8);
+    assertEqualInt (status, Ok);
+    status = GdipFillRectangle (graphics, (GpBrush *) brush2, 0, 8, 16, 8);
+    assertEqualInt (status, Ok);
+
+    GdipBitmapGetPixel (bitmap, 4, 0, &pixel);
+    assertEqualARGB (pixel, 0xFFFF0000);
+    GdipBitmapGetPixel (bitmap, 0, 0, &pixel);
+    assertEqualARGB (pixel, 0xFF0000FF);
+    GdipBitmapGetPixel (bitmap, 12, 12, &pixel);
+    assertEqualARGB (pixel, 0xFFFF0000);
+    GdipBitmapGetPixel (bitmap, 13, 12, &pixel);
+    assertEqualARGB (pixel, 0xFF0000FF);
+
+    GdipDeleteBrush ((GpBrush *) brush1);
+    GdipDeleteBrush ((GpBrush *) brush2);
+    GdipDeleteGraphics (graphics);
+    GdipDisposeImage ((GpImage *) bitmap);
+}
+
 int
 main (int argc, char**argv)
 {
@@ -183,6 +221,7 @@ main (int argc, char**argv)
     test_getHatchStyle ();
     test_getForegroundColor ();
     test_getBackgroundColor ();
+    test_fillHatch ();
 
     SHUTDOWN;
     return 0;
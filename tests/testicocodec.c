@@ -100,6 +100,113 @@ static void test_getPixel ()
   GdipDisposeImage (bitmap);
 }
 
+#if !defined(USE_WINDOWS_GDIPLUS)
+// A red 2x2 and a blue 1x1 32bpp entry.
+static BYTE twoEntries[] = {
+  0, 0, 1, 0, 2, 0,
+  2, 2, 0, 0, 1, 0, 32, 0, 64, 0, 0, 0, 38, 0, 0, 0,
+  1, 1, 0, 0, 1, 0, 32, 0, 48, 0, 0, 0, 102, 0, 0, 0,
+  40, 0, 0, 0, 2, 0, 0, 0, 4, 0, 0, 0, 1, 0, 32, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 255, 255, 0, 0, 255, 255, 0, 0, 255, 255, 0, 0, 255, 255,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  40, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 32, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  255, 0, 0, 255,
+  0, 0, 0, 0
+};
+
+static void test_multipleResolutions ()
+{
+  GpStatus status;
+  GUID dimension;
+  UINT count;
+  UINT width;
+  ARGB color;
+  GpImage *thumbnail;
+  GUID resolutionDimension = {0x84236f7b, 0x3bd3, 0x428f, {0x8d, 0xab, 0x4e, 0xa1, 0x43, 0x9c, 0xa3, 0x15}};
+
+  createFile (twoEntries, Ok);
+
+  // Every entry is a frame, the last one is active.
+  status = GdipImageGetFrameDimensionsList (image, &dimension, 1);
+  assertEqualInt (status, Ok);
+  assert (memcmp (&dimension, &resolutionDimension, sizeof (GUID)) == 0);
+  status = GdipImageGetFrameCount (image, &dimension, &count);
+  assertEqualInt (status, Ok);
+  assertEqualInt (count, 2);
+  GdipGetImageWidth (image, &width);
+  assertEqualInt (width, 1);
+  GdipBitmapGetPixel ((GpBitmap *) image, 0, 0, &color);
+  assertEqualARGB (color, 0xFF0000FF);
+
+  // The thumbnail uses the entry fitting its size and keeps the active one.
+  status = GdipGetImageThumbnail (image, 2, 2, &thumbnail, NULL, NULL);
+  assertEqualInt (status, Ok);
+  GdipBitmapGetPixel ((GpBitmap *) thumbnail, 0, 0, &color);
+  assertEqualARGB (color, 0xFFFF0000);
+  GdipDisposeImage (thumbnail);
+  GdipGetImageWidth (image, &width);
+  assertEqualInt (width, 1);
+
+  status = GdipImageSelectActiveFrame (image, &dimension, 0);
+  assertEqualInt (status, Ok);
+  GdipGetImageWidth (image, &width);
+  assertEqualInt (width, 2);
+  GdipBitmapGetPixel ((GpBitmap *) image, 1, 1, &color);
+  assertEqualARGB (color, 0xFFFF0000);
+
+  GdipDisposeImage (image);
+}
+
+static void test_saveMultipleResolutions ()
+{
+  GpStatus status;
+  GpImage *tiff;
+  UINT count;
+  UINT width;
+  ARGB color;
+  const char *tiffFile = "temp_asset.tif";
+  WCHAR wTiffFile[] = {'t', 'e', 'm', 'p', '_', 'a', 's', 's', 'e', 't', '.', 't', 'i', 'f', 0};
+  GUID pageDimension = {0x7462dc86, 0x6180, 0x4c7e, {0x8e, 0x3f, 0xee, 0x73, 0x33, 0xa7, 0xa4, 0x83}};
+  GUID resolutionDimension = {0x84236f7b, 0x3bd3, 0x428f, {0x8d, 0xab, 0x4e, 0xa1, 0x43, 0x9c, 0xa3, 0x15}};
+
+  createFile (twoEntries, Ok);
+
+  // The entry that was never selected is written too.
+  status = GdipSaveImageToFile (image, wTiffFile, &tifEncoderClsid, NULL);
+  assertEqualInt (status, Ok);
+
+  status = GdipLoadImageFromFile (wTiffFile, &tiff);
+  assertEqualInt (status, Ok);
+  status = GdipImageGetFrameCount (tiff, &pageDimension, &count);
+  assertEqualInt (status, Ok);
+  assertEqualInt (count, 2);
+
+  status = GdipImageSelectActiveFrame (tiff, &pageDimension, 0);
+  assertEqualInt (status, Ok);
+  GdipGetImageWidth (tiff, &width);
+  assertEqualInt (width, 2);
+  GdipBitmapGetPixel ((GpBitmap *) tiff, 1, 1, &color);
+  assertEqualARGB (color, 0xFFFF0000);
+
+  status = GdipImageSelectActiveFrame (tiff, &pageDimension, 1);
+  assertEqualInt (status, Ok);
+  GdipGetImageWidth (tiff, &width);
+  assertEqualInt (width, 1);
+  GdipBitmapGetPixel ((GpBitmap *) tiff, 0, 0, &color);
+  assertEqualARGB (color, 0xFF0000FF);
+  GdipDisposeImage (tiff);
+
+  // The icon keeps its entries after the save.
+  status = GdipImageSelectActiveFrame (image, &resolutionDimension, 0);
+  assertEqualInt (status, Ok);
+  GdipBitmapGetPixel ((GpBitmap *) image, 0, 0, &color);
+  assertEqualARGB (color, 0xFFFF0000);
+
+  GdipDisposeImage (image);
+  deleteFile (tiffFile);
+}
+#endif
+
 int
 main (int argc, char**argv)
 {
@@ -109,6 +216,10 @@ main (int argc, char**argv)
   test_invalidEntry ();
   test_invalidImage ();
   test_getPixel ();
+#if !defined(USE_WINDOWS_GDIPLUS)
+  test_multipleResolutions ();
+  test_saveMultipleResolutions ();
+#endif
 
   deleteFile (file);
 
@@ -1721,6 +1721,56 @@ static void test_delete ()
     assertEqualInt (status, Ok);
 }
 
+static void test_fillLineGradient ()
+{
+    GpStatus status;
+    GpBitmap *bitmap;
+    GpGraphics *graphics;
+    GpLineGradient *brush;
+    GpPointF point1 = { 0, 0 };
+    GpPointF point2 = { 256, 0 };
+    ARGB start;
+    ARGB middle;
+    ARGB end;
+    ARGB gammaMiddle;
+
+    GdipCreateBitmapFromScan0 (256, 4, 0, PixelFormat32bppARGB, NULL, &bitmap);
+    GdipGetImageGraphicsContext ((GpImage *) bitmap, &graphics);
+    GdipCreateLineBrush (&point1, &point2, 0xFFFF0000, 0xFF0000FF, WrapModeTile, &brush);
+
+    status = GdipFillRectangle (graphics, (GpBrush *) brush, 0, 0, 256, 4);
+    assertEqualInt (status, Ok);
+    GdipBitmapGetPixel (bitmap, 0, 2, &start);
+    GdipBitmapGetPixel (bitmap, 128, 2, &middle);
+    GdipBitmapGetPixel (bitmap, 255, 2, &end);
+    assert ((start & 0xFF0000) >= 0xFC0000 && (start & 0xFF) <= 0x03);
+    assert ((middle & 0xFF0000) >= 0x7C0000 && (middle & 0xFF0000) <= 0x830000);
+    assert ((end & 0xFF0000) <= 0x030000 && (end & 0xFF) >= 0xFC);
+
+    // Gamma correction interpolates in linear light, so the middle of the ramp is brighter.
+    status = GdipSetLineGammaCorrection (brush, TRUE);
+    assertEqualInt (status, Ok);
+    status = GdipFillRectangle (graphics, (GpBrush *) brush, 0, 0, 256, 4);
+    assertEqualInt (status, Ok);
+    GdipBitmapGetPixel (bitmap, 128, 2, &gammaMiddle);
+    assert ((gammaMiddle & 0xFF0000) > (middle & 0xFF0000));
+    assert ((gammaMiddle & 0xFF) > (middle & 0xFF));
+
+    // The seam between two tiles stays sharp, the first pixel isn't blended with the last one.
+    status = GdipSetLineGammaCorrection (brush, FALSE);
+    assertEqualInt (status, Ok);
+    status = GdipTranslateLineTransform (brush, 0.25f, 0, MatrixOrderAppend);
+    assertEqualInt (status, Ok);
+    status = GdipFillRectangle (graphics, (GpBrush *) brush, 0, 0, 256, 4);
+    assertEqualInt (status, Ok);
+    GdipBitmapGetPixel (bitmap, 0, 2, &start);
+    assert ((start & 0xFF0000) >= 0xFC0000 && (start & 0xFF) <= 0x03);
+
+    GdipDeleteBrush ((GpBrush *) brush);
+    GdipDeleteGraphics (graphics);
+    GdipDisposeImage ((GpImage *) bitmap);
+}
+
 int
 main (int argc, char**argv)
 {
@@ -1757,6 +1807,7 @@ main (int argc, char**argv)
     test_rotateLineTransform ();
     test_clone ();
     test_delete ();
+    test_fillLineGradient ();
 
     SHUTDOWN;
     return 0;
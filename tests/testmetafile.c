@@ -656,6 +656,557 @@ static void test_recordMetafile ()
     GdipDeleteGraphics (graphics);
 }
 
+static GpBitmap *drawMetafileWith (GpImage *metafile, InterpolationMode interpolation, TextRenderingHint hint)
+{
+    GpStatus status;
+    GpBitmap *bitmap;
+    GpGraphics *graphics;
+
+    GdipCreateBitmapFromScan0 (100, 100, 0, PixelFormat32bppARGB, NULL, &bitmap);
+    GdipGetImageGraphicsContext ((GpImage *) bitmap, &graphics);
+    GdipSetInterpolationMode (graphics, interpolation);
+    GdipSetTextRenderingHint (graphics, hint);
+    status = GdipDrawImageRectI (graphics, metafile, 0, 0, 100, 100);
+    assertEqualInt (status, Ok);
+    GdipDeleteGraphics (graphics);
+    return bitmap;
+}
+
+static GpBitmap *drawMetafile (GpImage *metafile)
+{
+    return drawMetafileWith (metafile, InterpolationModeDefault, TextRenderingHintSystemDefault);
+}
+
+static void assertSameDrawing (GpBitmap *first, GpBitmap *second)
+{
+    BitmapData firstData;
+    BitmapData secondData;
+    GpRect rect = {0, 0, 100, 100};
+    int y;
+
+    GdipBitmapLockBits (first, &rect, ImageLockModeRead, PixelFormat32bppARGB, &firstData);
+    GdipBitmapLockBits (second, &rect, ImageLockModeRead, PixelFormat32bppARGB, &secondData);
+    for (y = 0; y < 100; y++) {
+        assert (memcmp ((BYTE *) firstData.Scan0 + y * firstData.Stride, (BYTE *) secondData.Scan0 + y * secondData.Stride, 100 * 4) == 0);
+    }
+    GdipBitmapUnlockBits (first, &firstData);
+    GdipBitmapUnlockBits (second, &secondData);
+}
+
+static void drawMetafileTwice (GpImage *metafile)
+{
+    GpBitmap *first;
+    GpBitmap *second;
+
+    // The second draw replays the program compiled by the first one.
+    first = drawMetafile (metafile);
+    second = drawMetafile (metafile);
+    assertSameDrawing (first, second);
+
+    GdipDisposeImage ((GpImage *) first);
+    GdipDisposeImage ((GpImage *) second);
+}
+
+static void test_drawMetafileTwice ()
+{
+    GpMetafile *wmfMetafile;
+    GpMetafile *emfMetafile;
+
+    GdipCreateMetafileFromFile (wmfFilePath, &wmfMetafile);
+    GdipCreateMetafileFromFile (emfFilePath, &emfMetafile);
+
+    drawMetafileTwice ((GpImage *) wmfMetafile);
+    drawMetafileTwice ((GpImage *) emfMetafile);
+
+    GdipDisposeImage ((GpImage *) wmfMetafile);
+    GdipDisposeImage ((GpImage *) emfMetafile);
+}
+
+static void assertStretchedDIBs (GpImage *metafile)
+{
+    GpBitmap *bitmap;
+    ARGB color;
+
+    // Each DIB pixel covers a quarter of the bitmap. The inverted black pixels keep the bottom-up SRCCOPY colors,
+    // the inverted white ones turn blue into yellow and green into magenta.
+    bitmap = drawMetafileWith (metafile, InterpolationModeNearestNeighbor, TextRenderingHintSystemDefault);
+    GdipBitmapGetPixel (bitmap, 25, 25, &color);
+    assertEqualARGB (color, 0xFFFFFF00);
+    GdipBitmapGetPixel (bitmap, 75, 25, &color);
+    assertEqualARGB (color, 0xFFFFFFFF);
+    GdipBitmapGetPixel (bitmap, 25, 75, &color);
+    assertEqualARGB (color, 0xFFFF0000);
+    GdipBitmapGetPixel (bitmap, 75, 75, &color);
+    assertEqualARGB (color, 0xFFFF00FF);
+    GdipDisposeImage ((GpImage *) bitmap);
+
+    drawMetafileTwice (metafile);
+}
+
+static void test_drawStretchDIBits ()
+{
+    GpStatus status;
+    GpMetafile *metafile;
+    FILE *f;
+    WCHAR wmfPath[] = {'t', 'e', 'm', 'p', '_', 'a', 's', 's', 'e', 't', '.', 'w', 'm', 'f', 0};
+    WCHAR emfPath[] = {'t', 'e', 'm', 'p', '_', 'a', 's', 's', 'e', 't', '.', 'e', 'm', 'f', 0};
+    BYTE wmf[] = {
+        /* Placeable Header */  0xD7, 0xCD, 0xC6, 0x9A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x02, 0x00, 0xA0, 0x05, 0x00, 0x00, 0x00, 0x00, 0xB1, 0x52,
+        /* Metafile Header */   0x01, 0x00, 0x09, 0x00, 0x00, 0x03, 0x69, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2A, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* META_SETMAPMODE */   0x04, 0x00, 0x00, 0x00, 0x03, 0x01, 0x08, 0x00,
+        /* META_SETWINDOWEXT */ 0x05, 0x00, 0x00, 0x00, 0x0C, 0x02, 0x02, 0x00, 0x02, 0x00,
+        /* META_STRETCHDIB */   0x2A, 0x00, 0x00, 0x00, 0x43, 0x0F, 0x20, 0x00, 0xCC, 0x00, 0x00, 0x00, 0x02, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 2x2 32bpp DIB */     0x28, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0x00,
+        /* META_STRETCHDIB */   0x2A, 0x00, 0x00, 0x00, 0x43, 0x0F, 0x46, 0x00, 0x66, 0x00, 0x00, 0x00, 0x02, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 2x2 8bpp DIB */      0x28, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+        /* META_EOF */          0x03, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+    BYTE emf[] = {
+        /* EMR_HEADER */          0x01, 0x00, 0x00, 0x00, 0x58, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x63, 0x00, 0x00, 0x00, 0x63, 0x00, 0x00, 0x00,
+                                  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD3, 0x09, 0x00, 0x00, 0xD3, 0x09, 0x00, 0x00, 0x20, 0x45, 0x4D, 0x46, 0x00, 0x00, 0x01, 0x00,
+                                  0x7C, 0x01, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                  0xE8, 0x03, 0x00, 0x00, 0xE8, 0x03, 0x00, 0x00, 0xFE, 0x00, 0x00, 0x00, 0xFE, 0x00, 0x00, 0x00,
+        /* EMR_STRETCHDIBITS */   0x51, 0x00, 0x00, 0x00, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x63, 0x00, 0x00, 0x00, 0x63, 0x00, 0x00, 0x00,
+                                  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+                                  0x50, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x78, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0xCC, 0x00,
+                                  0x64, 0x00, 0x00, 0x00, 0x64, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x20, 0x00,
+                                  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                  0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0x00,
+        /* EMR_STRETCHDIBITS */   0x51, 0x00, 0x00, 0x00, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x63, 0x00, 0x00, 0x00, 0x63, 0x00, 0x00, 0x00,
+                                  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+                                  0x50, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46, 0x00, 0x66, 0x00,
+                                  0x64, 0x00, 0x00, 0x00, 0x64, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x08, 0x00,
+                                  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                  0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+        /* EMR_EOF */             0x0E, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00
+    };
+
+    // A SRCCOPY of bottom-up 32bpp blue, white over red, green pixels, then a SRCINVERT of a paletted DIB of
+    // white, black over black, white pixels.
+    f = fopen ("temp_asset.wmf", "wb+");
+    assert (f);
+    fwrite ((void *) wmf, sizeof (BYTE), sizeof (wmf), f);
+    fclose (f);
+
+    status = GdipCreateMetafileFromFile (wmfPath, &metafile);
+    assertEqualInt (status, Ok);
+    assertStretchedDIBs ((GpImage *) metafile);
+    GdipDisposeImage ((GpImage *) metafile);
+    deleteFile ("temp_asset.wmf");
+
+    // The same DIBs in EMR_STRETCHDIBITS records, which locate the header and the pixels by their offsets.
+    f = fopen ("temp_asset.emf", "wb+");
+    assert (f);
+    fwrite ((void *) emf, sizeof (BYTE), sizeof (emf), f);
+    fclose (f);
+
+    status = GdipCreateMetafileFromFile (emfPath, &metafile);
+    assertEqualInt (status, Ok);
+    assertStretchedDIBs ((GpImage *) metafile);
+    GdipDisposeImage ((GpImage *) metafile);
+    deleteFile ("temp_asset.emf");
+}
+
+#if !defined(USE_WINDOWS_GDIPLUS)
+static void test_setMetafileRasterCacheSize ()
+{
+    GpStatus status;
+    GpMetafile *emfMetafile;
+    GpImage *bitmap;
+    GpBitmap *played;
+    GpBitmap *playedNearest;
+    GpBitmap *cached;
+
+    GdipCreateMetafileFromFile (emfFilePath, &emfMetafile);
+    GdipCreateBitmapFromScan0 (10, 10, 0, PixelFormat32bppRGB, NULL, (GpBitmap **) &bitmap);
+
+    // Without a cache the records are played.
+    played = drawMetafile ((GpImage *) emfMetafile);
+    playedNearest = drawMetafileWith ((GpImage *) emfMetafile, InterpolationModeNearestNeighbor, TextRenderingHintAntiAlias);
+
+    status = GdipSetMetafileRasterCacheSize_linux (emfMetafile, 4 * 1024 * 1024);
+    assertEqualInt (status, Ok);
+
+    // The first draw rasterizes, the second one paints the cached raster, both match the played records.
+    drawMetafileTwice ((GpImage *) emfMetafile);
+    cached = drawMetafile ((GpImage *) emfMetafile);
+    assertSameDrawing (played, cached);
+    GdipDisposeImage ((GpImage *) cached);
+
+    // Other interpolation and text rendering settings get a raster of their own.
+    cached = drawMetafileWith ((GpImage *) emfMetafile, InterpolationModeNearestNeighbor, TextRenderingHintAntiAlias);
+    assertSameDrawing (playedNearest, cached);
+    GdipDisposeImage ((GpImage *) cached);
+
+    // Too small to hold any raster, the records are played.
+    status = GdipSetMetafileRasterCacheSize_linux (emfMetafile, 16);
+    assertEqualInt (status, Ok);
+    cached = drawMetafile ((GpImage *) emfMetafile);
+    assertSameDrawing (played, cached);
+    GdipDisposeImage ((GpImage *) cached);
+
+    status = GdipSetMetafileRasterCacheSize_linux (emfMetafile, 0);
+    assertEqualInt (status, Ok);
+    GdipDisposeImage ((GpImage *) played);
+    GdipDisposeImage ((GpImage *) playedNearest);
+
+    // Negative tests.
+    status = GdipSetMetafileRasterCacheSize_linux (NULL, 0);
+    assertEqualInt (status, InvalidParameter);
+
+    status = GdipSetMetafileRasterCacheSize_linux ((GpMetafile *) bitmap, 0);
+    assertEqualInt (status, InvalidParameter);
+
+    GdipDisposeImage ((GpImage *) emfMetafile);
+    GdipDisposeImage (bitmap);
+}
+#endif
+
+static void test_recordMetafileDrawing ()
+{
+    GpStatus status;
+    GpImage *bitmap;
+    GpGraphics *bitmapGraphics;
+    GpGraphics *graphics;
+    GpSolidFill *brush;
+    GpPen *pen;
+    HDC hdc;
+    GpRectF rect = {0, 0, 100, 100};
+    GpMetafile *metafile;
+    MetafileHeader header;
+    GraphicsState state;
+
+    GdipCreateBitmapFromScan0 (10, 10, 0, PixelFormat32bppRGB, NULL, (GpBitmap **) &bitmap);
+    GdipGetImageGraphicsContext (bitmap, &bitmapGraphics);
+    GdipGetDC (bitmapGraphics, &hdc);
+
+    status = GdipRecordMetafile (hdc, EmfTypeEmfPlusOnly, &rect, MetafileFrameUnitPixel, NULL, &metafile);
+    assertEqualInt (status, Ok);
+
+    status = GdipGetImageGraphicsContext ((GpImage *) metafile, &graphics);
+    assertEqualInt (status, Ok);
+
+    GdipCreateSolidFill (0xFFFF0000, &brush);
+    GdipCreatePen1 (0xFF0000FF, 2, UnitPixel, &pen);
+
+    status = GdipSaveGraphics (graphics, &state);
+    assertEqualInt (status, Ok);
+    status = GdipTranslateWorldTransform (graphics, 10, 10, MatrixOrderPrepend);
+    assertEqualInt (status, Ok);
+    status = GdipFillRectangle (graphics, (GpBrush *) brush, 0, 0, 50, 50);
+    assertEqualInt (status, Ok);
+    status = GdipRestoreGraphics (graphics, state);
+    assertEqualInt (status, Ok);
+    status = GdipDrawLine (graphics, pen, 0, 0, 100, 100);
+    assertEqualInt (status, Ok);
+
+    // Recording stops with the graphics.
+    GdipDeleteGraphics (graphics);
+
+    status = GdipGetMetafileHeaderFromMetafile (metafile, &header);
+    assertEqualInt (status, Ok);
+    assertEqualInt (header.Type, MetafileTypeEmfPlusOnly);
+    assertEqualInt (header.EmfPlusHeaderSize, 28);
+    assertEqualInt (header.Width, 100);
+    assertEqualInt (header.Height, 100);
+    assert (header.Size > 88);
+
+    GdipDeleteBrush ((GpBrush *) brush);
+    GdipDeletePen (pen);
+    GdipDisposeImage ((GpImage *) metafile);
+    GdipReleaseDC (bitmapGraphics, hdc);
+    GdipDeleteGraphics (bitmapGraphics);
+    GdipDisposeImage (bitmap);
+}
+
+static void test_playRecordedMetafile ()
+{
+    GpStatus status;
+    GpImage *bitmap;
+    GpGraphics *bitmapGraphics;
+    GpGraphics *graphics;
+    GpSolidFill *redBrush;
+    GpSolidFill *blueBrush;
+    HDC hdc;
+    GpRectF rect = {0, 0, 100, 100};
+    GpMetafile *metafile;
+    ARGB color;
+
+    GdipCreateBitmapFromScan0 (100, 100, 0, PixelFormat32bppARGB, NULL, (GpBitmap **) &bitmap);
+    GdipGetImageGraphicsContext (bitmap, &bitmapGraphics);
+    GdipGetDC (bitmapGraphics, &hdc);
+
+    status = GdipRecordMetafile (hdc, EmfTypeEmfPlusOnly, &rect, MetafileFrameUnitPixel, NULL, &metafile);
+    assertEqualInt (status, Ok);
+    GdipReleaseDC (bitmapGraphics, hdc);
+
+    status = GdipGetImageGraphicsContext ((GpImage *) metafile, &graphics);
+    assertEqualInt (status, Ok);
+
+    GdipCreateSolidFill (0xFFFF0000, &redBrush);
+    GdipCreateSolidFill (0xFF0000FF, &blueBrush);
+    GdipFillRectangle (graphics, (GpBrush *) redBrush, 0, 0, 100, 100);
+    GdipSetClipRect (graphics, 0, 0, 50, 100, CombineModeReplace);
+    GdipFillRectangle (graphics, (GpBrush *) blueBrush, 0, 0, 100, 100);
+    GdipDeleteGraphics (graphics);
+
+    // The EMF+ records are played: the objects, the drawing and the clip.
+    status = GdipDrawImageRectI (bitmapGraphics, (GpImage *) metafile, 0, 0, 100, 100);
+    assertEqualInt (status, Ok);
+
+    GdipBitmapGetPixel ((GpBitmap *) bitmap, 25, 50, &color);
+    assertEqualARGB (color, 0xFF0000FF);
+    GdipBitmapGetPixel ((GpBitmap *) bitmap, 75, 50, &color);
+    assertEqualARGB (color, 0xFFFF0000);
+
+    GdipDeleteBrush ((GpBrush *) redBrush);
+    GdipDeleteBrush ((GpBrush *) blueBrush);
+    GdipDisposeImage ((GpImage *) metafile);
+    GdipDeleteGraphics (bitmapGraphics);
+    GdipDisposeImage (bitmap);
+}
+
+static void test_playDualMetafile ()
+{
+    GpStatus status;
+    GpMetafile *metafile;
+    GpImage *bitmap;
+    GpGraphics *graphics;
+    ARGB color;
+    FILE *f;
+    WCHAR filePath[] = {'t', 'e', 'm', 'p', '_', 'a', 's', 's', 'e', 't', '.', 'e', 'm', 'f', 0};
+    BYTE emf[] = {
+        /* EMR_HEADER */              0x01, 0x00, 0x00, 0x00, 0x58, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x63, 0x00, 0x00, 0x00, 0x63, 0x00, 0x00, 0x00,
+                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD3, 0x09, 0x00, 0x00, 0xD3, 0x09, 0x00, 0x00, 0x20, 0x45, 0x4D, 0x46, 0x00, 0x00, 0x01, 0x00,
+                                      0x58, 0x01, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                      0xE8, 0x03, 0x00, 0x00, 0xE8, 0x03, 0x00, 0x00, 0xFE, 0x00, 0x00, 0x00, 0xFE, 0x00, 0x00, 0x00,
+        /* EMR_GDICOMMENT */          0x46, 0x00, 0x00, 0x00, 0x5C, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00, 0x00, 0x45, 0x4D, 0x46, 0x2B, 0x01, 0x40, 0x01, 0x00, 0x1C, 0x00, 0x00, 0x00,
+                                      0x10, 0x00, 0x00, 0x00, 0x02, 0x10, 0xC0, 0xDB, 0x01, 0x00, 0x00, 0x00, 0x64, 0x00, 0x00, 0x00, 0x64, 0x00, 0x00, 0x00, 0x0A, 0x40, 0x00, 0x80,
+                                      0x24, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                      0x00, 0x00, 0x48, 0x42, 0x00, 0x00, 0xC8, 0x42, 0x04, 0x40, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* EMR_CREATEBRUSHINDIRECT */ 0x27, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* EMR_SELECTOBJECT */        0x25, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+        /* EMR_SELECTOBJECT */        0x25, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x80,
+        /* EMR_POLYGON16 */           0x56, 0x00, 0x00, 0x00, 0x2C, 0x00, 0x00, 0x00, 0x32, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x64, 0x00, 0x00, 0x00, 0x64, 0x00, 0x00, 0x00,
+                                      0x04, 0x00, 0x00, 0x00, 0x32, 0x00, 0x00, 0x00, 0x64, 0x00, 0x00, 0x00, 0x64, 0x00, 0x64, 0x00, 0x32, 0x00, 0x64, 0x00,
+        /* EMR_GDICOMMENT */          0x46, 0x00, 0x00, 0x00, 0x34, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x45, 0x4D, 0x46, 0x2B, 0x0A, 0x40, 0x00, 0x80, 0x24, 0x00, 0x00, 0x00,
+                                      0x18, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x48, 0x42, 0x00, 0x00, 0x48, 0x42,
+                                      0x00, 0x00, 0x48, 0x42,
+        /* EMR_EOF */                 0x0E, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00
+    };
+
+    // EMF+ fills on the left, a GDI polygon drawn after a GetDC record on the right, then another EMF+ fill.
+    f = fopen ("temp_asset.emf", "wb+");
+    assert (f);
+    fwrite ((void *) emf, sizeof (BYTE), sizeof (emf), f);
+    fclose (f);
+
+    status = GdipCreateMetafileFromFile (filePath, &metafile);
+    assertEqualInt (status, Ok);
+
+    // Drawn at half size, the GDI records keep the destination transform between the EMF+ blocks.
+    GdipCreateBitmapFromScan0 (100, 100, 0, PixelFormat32bppARGB, NULL, (GpBitmap **) &bitmap);
+    GdipGetImageGraphicsContext (bitmap, &graphics);
+    status = GdipDrawImageRectI (graphics, (GpImage *) metafile, 0, 0, 50, 50);
+    assertEqualInt (status, Ok);
+
+    GdipBitmapGetPixel ((GpBitmap *) bitmap, 12, 12, &color);
+    assertEqualARGB (color, 0xFF00FF00);
+    GdipBitmapGetPixel ((GpBitmap *) bitmap, 12, 37, &color);
+    assertEqualARGB (color, 0xFF0000FF);
+    GdipBitmapGetPixel ((GpBitmap *) bitmap, 37, 12, &color);
+    assertEqualARGB (color, 0xFFFF0000);
+    GdipBitmapGetPixel ((GpBitmap *) bitmap, 37, 37, &color);
+    assertEqualARGB (color, 0xFFFF0000);
+    GdipBitmapGetPixel ((GpBitmap *) bitmap, 75, 25, &color);
+    assertEqualARGB (color, 0x00000000);
+    GdipBitmapGetPixel ((GpBitmap *) bitmap, 25, 75, &color);
+    assertEqualARGB (color, 0x00000000);
+
+    GdipDeleteGraphics (graphics);
+    GdipDisposeImage (bitmap);
+    GdipDisposeImage ((GpImage *) metafile);
+    deleteFile ("temp_asset.emf");
+}
+
+static void test_playCompressedPath ()
+{
+    GpStatus status;
+    GpMetafile *metafile;
+    GpImage *bitmap;
+    GpGraphics *graphics;
+    ARGB color;
+    FILE *f;
+    WCHAR filePath[] = {'t', 'e', 'm', 'p', '_', 'a', 's', 's', 'e', 't', '.', 'e', 'm', 'f', 0};
+    BYTE emf[] = {
+        /* EMR_HEADER */          0x01, 0x00, 0x00, 0x00, 0x58, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x63, 0x00, 0x00, 0x00, 0x63, 0x00, 0x00, 0x00,
+                                  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD3, 0x09, 0x00, 0x00, 0xD3, 0x09, 0x00, 0x00, 0x20, 0x45, 0x4D, 0x46, 0x00, 0x00, 0x01, 0x00,
+                                  0x14, 0x01, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                  0xE8, 0x03, 0x00, 0x00, 0xE8, 0x03, 0x00, 0x00, 0xFE, 0x00, 0x00, 0x00, 0xFE, 0x00, 0x00, 0x00,
+        /* EMR_GDICOMMENT */      0x46, 0x00, 0x00, 0x00, 0xA8, 0x00, 0x00, 0x00, 0x9C, 0x00, 0x00, 0x00, 0x45, 0x4D, 0x46, 0x2B, 0x01, 0x40, 0x00, 0x00, 0x1C, 0x00, 0x00, 0x00,
+                                  0x10, 0x00, 0x00, 0x00, 0x02, 0x10, 0xC0, 0xDB, 0x00, 0x00, 0x00, 0x00, 0x64, 0x00, 0x00, 0x00, 0x64, 0x00, 0x00, 0x00,
+        /* EmfPlusObject */       0x08, 0x40, 0x00, 0x03, 0x60, 0x00, 0x00, 0x00, 0x54, 0x00, 0x00, 0x00, 0x02, 0x10, 0xC0, 0xDB, 0x10, 0x00, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00,
+                                  0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x30, 0x00, 0x0C, 0x00,
+                                  0x30, 0x00, 0x18, 0x00, 0x30, 0x00, 0x24, 0x00, 0x30, 0x00, 0x30, 0x00, 0x24, 0x00, 0x30, 0x00, 0x18, 0x00, 0x30, 0x00, 0x0C, 0x00, 0x30, 0x00,
+                                  0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x01, 0x00, 0x0E, 0x01, 0x01, 0x81, 0x00, 0x00,
+        /* EmfPlusFillPath */     0x14, 0x40, 0x00, 0x80, 0x10, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF,
+        /* EmfPlusEndOfFile */    0x02, 0x40, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* EMR_EOF */             0x0E, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00
+    };
+
+    // A path object of 16 points with 16 bits coordinates and run-length encoded types, filled in blue.
+    f = fopen ("temp_asset.emf", "wb+");
+    assert (f);
+    fwrite ((void *) emf, sizeof (BYTE), sizeof (emf), f);
+    fclose (f);
+
+    status = GdipCreateMetafileFromFile (filePath, &metafile);
+    assertEqualInt (status, Ok);
+
+    GdipCreateBitmapFromScan0 (100, 100, 0, PixelFormat32bppARGB, NULL, (GpBitmap **) &bitmap);
+    GdipGetImageGraphicsContext (bitmap, &graphics);
+    status = GdipDrawImageRectI (graphics, (GpImage *) metafile, 0, 0, 100, 100);
+    assertEqualInt (status, Ok);
+
+    // The three runs of types describe a closed square.
+    GdipBitmapGetPixel ((GpBitmap *) bitmap, 24, 24, &color);
+    assertEqualARGB (color, 0xFF0000FF);
+    GdipBitmapGetPixel ((GpBitmap *) bitmap, 75, 75, &color);
+    assertEqualARGB (color, 0x00000000);
+
+    GdipDeleteGraphics (graphics);
+    GdipDisposeImage (bitmap);
+    GdipDisposeImage ((GpImage *) metafile);
+    deleteFile ("temp_asset.emf");
+}
+
+#if !defined(USE_WINDOWS_GDIPLUS)
+static BYTE *recordedBytes;
+static int recordedLength;
+
+static int recordedPutBytes (BYTE *buffer, int size)
+{
+    recordedBytes = realloc (recordedBytes, recordedLength + size);
+    memcpy (recordedBytes + recordedLength, buffer, size);
+    recordedLength += size;
+    return size;
+}
+#endif
+
+static void recordTextureAndWindingFill (GpMetafile *metafile)
+{
+    GpStatus status;
+    GpGraphics *graphics;
+    GpBitmap *texture;
+    GpGraphics *textureGraphics;
+    GpTexture *textureBrush;
+    GpSolidFill *brush;
+    GpPath *path;
+
+    // Over 64KB of pixels, the texture brush object is split into continued records.
+    GdipCreateBitmapFromScan0 (200, 100, 0, PixelFormat32bppARGB, NULL, &texture);
+    GdipGetImageGraphicsContext ((GpImage *) texture, &textureGraphics);
+    GdipGraphicsClear (textureGraphics, 0xFF00FF00);
+    GdipDeleteGraphics (textureGraphics);
+    GdipCreateTexture ((GpImage *) texture, WrapModeTile, &textureBrush);
+
+    // Two rectangles going the same way, their overlap is only filled in winding mode.
+    GdipCreateSolidFill (0xFFFF0000, &brush);
+    GdipCreatePath (FillModeWinding, &path);
+    GdipAddPathRectangle (path, 10, 60, 60, 30);
+    GdipAddPathRectangle (path, 40, 60, 50, 30);
+
+    status = GdipGetImageGraphicsContext ((GpImage *) metafile, &graphics);
+    assertEqualInt (status, Ok);
+    status = GdipFillRectangle (graphics, (GpBrush *) textureBrush, 0, 0, 100, 50);
+    assertEqualInt (status, Ok);
+    status = GdipFillPath (graphics, (GpBrush *) brush, path);
+    assertEqualInt (status, Ok);
+    GdipDeleteGraphics (graphics);
+
+    GdipDeletePath (path);
+    GdipDeleteBrush ((GpBrush *) brush);
+    GdipDeleteBrush ((GpBrush *) textureBrush);
+    GdipDisposeImage ((GpImage *) texture);
+}
+
+static void test_recordMetafileToFile ()
+{
+    GpStatus status;
+    GpImage *bitmap;
+    GpGraphics *bitmapGraphics;
+    HDC hdc;
+    GpRectF rect = {0, 0, 100, 100};
+    GpMetafile *metafile;
+    MetafileHeader header;
+    ARGB color;
+    WCHAR *filePath;
+#if !defined(USE_WINDOWS_GDIPLUS)
+    BYTE *fileBytes;
+    FILE *f;
+#endif
+
+    filePath = createWchar ("temp_asset.emf");
+    GdipCreateBitmapFromScan0 (100, 100, 0, PixelFormat32bppARGB, NULL, (GpBitmap **) &bitmap);
+    GdipGetImageGraphicsContext (bitmap, &bitmapGraphics);
+    GdipGetDC (bitmapGraphics, &hdc);
+
+    status = GdipRecordMetafileFileName (filePath, hdc, EmfTypeEmfPlusOnly, &rect, MetafileFrameUnitPixel, NULL, &metafile);
+    assertEqualInt (status, Ok);
+    recordTextureAndWindingFill (metafile);
+    GdipDisposeImage ((GpImage *) metafile);
+
+#if !defined(USE_WINDOWS_GDIPLUS)
+    // The same records are written through the delegate.
+    recordedBytes = NULL;
+    recordedLength = 0;
+    status = GdipRecordMetafileFromDelegate_linux (NULL, NULL, recordedPutBytes, NULL, NULL, NULL, hdc, EmfTypeEmfPlusOnly, &rect, MetafileFrameUnitPixel, NULL, &metafile);
+    assertEqualInt (status, Ok);
+    recordTextureAndWindingFill (metafile);
+    GdipDisposeImage ((GpImage *) metafile);
+
+    f = fopen ("temp_asset.emf", "rb");
+    assert (f);
+    fileBytes = malloc (recordedLength + 1);
+    assertEqualInt (fread (fileBytes, 1, recordedLength + 1, f), recordedLength);
+    assert (memcmp (fileBytes, recordedBytes, recordedLength) == 0);
+    fclose (f);
+    free (fileBytes);
+    free (recordedBytes);
+#endif
+    GdipReleaseDC (bitmapGraphics, hdc);
+
+    // Played back from the file.
+    status = GdipCreateMetafileFromFile (filePath, &metafile);
+    assertEqualInt (status, Ok);
+    status = GdipGetMetafileHeaderFromMetafile (metafile, &header);
+    assertEqualInt (status, Ok);
+    assertEqualInt (header.Type, MetafileTypeEmfPlusOnly);
+    assert (header.Size > 200 * 100 * 4);
+
+    status = GdipDrawImageRectI (bitmapGraphics, (GpImage *) metafile, 0, 0, 100, 100);
+    assertEqualInt (status, Ok);
+
+    GdipBitmapGetPixel ((GpBitmap *) bitmap, 50, 25, &color);
+    assertEqualARGB (color, 0xFF00FF00);
+    GdipBitmapGetPixel ((GpBitmap *) bitmap, 20, 75, &color);
+    assertEqualARGB (color, 0xFFFF0000);
+    GdipBitmapGetPixel ((GpBitmap *) bitmap, 55, 75, &color);
+    assertEqualARGB (color, 0xFFFF0000);
+    GdipBitmapGetPixel ((GpBitmap *) bitmap, 80, 75, &color);
+    assertEqualARGB (color, 0xFFFF0000);
+    GdipBitmapGetPixel ((GpBitmap *) bitmap, 50, 95, &color);
+    assertEqualARGB (color, 0x00000000);
+
+    GdipDisposeImage ((GpImage *) metafile);
+    GdipDeleteGraphics (bitmapGraphics);
+    GdipDisposeImage (bitmap);
+    deleteFile ("temp_asset.emf");
+    freeWchar (filePath);
+}
+
 int
 main (int argc, char**argv)
 {
@@ -675,6 +1226,16 @@ main (int argc, char**argv)
     test_setMetafileDownLevelRasterizationLimit ();
     test_playMetafileRecord ();
     test_recordMetafile ();
+    test_recordMetafileDrawing ();
+    test_playRecordedMetafile ();
+    test_playDualMetafile ();
+    test_playCompressedPath ();
+    test_recordMetafileToFile ();
+    test_drawMetafileTwice ();
+    test_drawStretchDIBits ();
+#if !defined(USE_WINDOWS_GDIPLUS)
+    test_setMetafileRasterCacheSize ();
+#endif
 
     SHUTDOWN;
     return 0;
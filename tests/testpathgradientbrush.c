@@ -2374,6 +2374,75 @@ static void test_cloneWithPath ()
     GdipDeleteMatrix (matrix);
 }
 
+static void test_fillPathGradient ()
+{
+    GpStatus status;
+    GpBitmap *bitmap;
+    GpGraphics *graphics;
+    GpPathGradient *brush;
+    ARGB pixel;
+    ARGB tiledPixel;
+    GpPointF square[4] =
+    {
+        {0, 0},
+        {40, 0},
+        {40, 40},
+        {0, 40}
+    };
+    ARGB surroundColors[4] = {0xFF0000FF, 0xFF0000FF, 0xFF00FF00, 0xFF00FF00};
+    INT surroundCount = 4;
+
+    status = GdipCreateBitmapFromScan0 (48, 48, 0, PixelFormat32bppARGB, NULL, &bitmap);
+    assertEqualInt (status, Ok);
+    status = GdipGetImageGraphicsContext ((GpImage *) bitmap, &graphics);
+    assertEqualInt (status, Ok);
+
+    GdipCreatePathGradient (square, 4, WrapModeClamp, &brush);
+    GdipSetPathGradientCenterColor (brush, 0xFFFF0000);
+    status = GdipSetPathGradientSurroundColorsWithCount (brush, surroundColors, &surroundCount);
+    assertEqualInt (status, Ok);
+
+    status = GdipFillRectangle (graphics, (GpBrush *) brush, 0, 0, 48, 48);
+    assertEqualInt (status, Ok);
+
+    // The center gets the center color.
+    GdipBitmapGetPixel (bitmap, 20, 20, &pixel);
+    assert ((pixel & 0x00FF0000) > 0x00E00000);
+
+    // Each edge gets its own surround color, following the boundary shape.
+    GdipBitmapGetPixel (bitmap, 20, 1, &pixel);
+    assert ((pixel & 0x000000FF) > 0x000000C0 && (pixel & 0x0000FF00) < 0x00004000);
+    GdipBitmapGetPixel (bitmap, 20, 38, &pixel);
+    assert ((pixel & 0x0000FF00) > 0x0000C000 && (pixel & 0x000000FF) < 0x00000040);
+
+    // Nothing is painted outside of the boundary.
+    GdipBitmapGetPixel (bitmap, 44, 44, &pixel);
+    assertEqualARGB (pixel, 0x00000000);
+
+    // The other wrap modes repeat the bounding rectangle.
+    status = GdipSetPathGradientWrapMode (brush, WrapModeTile);
+    assertEqualInt (status, Ok);
+    status = GdipFillRectangle (graphics, (GpBrush *) brush, 0, 0, 48, 48);
+    assertEqualInt (status, Ok);
+    GdipBitmapGetPixel (bitmap, 4, 20, &pixel);
+    GdipBitmapGetPixel (bitmap, 44, 20, &tiledPixel);
+    assertEqualARGB (tiledPixel, pixel);
+    GdipBitmapGetPixel (bitmap, 44, 44, &tiledPixel);
+    assert ((tiledPixel & 0xFF000000) == 0xFF000000);
+
+    status = GdipSetPathGradientWrapMode (brush, WrapModeTileFlipX);
+    assertEqualInt (status, Ok);
+    status = GdipFillRectangle (graphics, (GpBrush *) brush, 0, 0, 48, 48);
+    assertEqualInt (status, Ok);
+    GdipBitmapGetPixel (bitmap, 35, 20, &pixel);
+    GdipBitmapGetPixel (bitmap, 44, 20, &tiledPixel);
+    assertEqualARGB (tiledPixel, pixel);
+
+    GdipDeleteBrush ((GpBrush *) brush);
+    GdipDeleteGraphics (graphics);
+    GdipDisposeImage ((GpImage *) bitmap);
+}
+
 static void test_delete ()
 {
     GpStatus status;
@@ -2430,6 +2499,7 @@ main (int argc, char**argv)
     test_setPathGradientFocusScales ();
     test_cloneWithPoints ();
     test_cloneWithPath ();
+    test_fillPathGradient ();
     test_delete ();
 
     SHUTDOWN;
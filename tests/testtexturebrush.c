@@ -2049,6 +2049,66 @@ static void test_rotateTextureTransform ()
     GdipDeleteMatrix (transform);
 }
 
+static void test_fillTextureWrapModes ()
+{
+    GpStatus status;
+    GpBitmap *source;
+    GpBitmap *bitmap;
+    GpGraphics *graphics;
+    GpTexture *brush;
+    ARGB pixel;
+    ARGB sourcePixels[] = {
+        0xFFFF0000, 0xFF00FF00,
+        0xFF0000FF, 0xFFFFFFFF
+    };
+
+    GdipCreateBitmapFromScan0 (2, 2, 8, PixelFormat32bppARGB, (BYTE *) sourcePixels, &source);
+    GdipCreateBitmapFromScan0 (4, 4, 0, PixelFormat32bppARGB, NULL, &bitmap);
+    GdipGetImageGraphicsContext ((GpImage *) bitmap, &graphics);
+
+    // WrapModeTileFlipX mirrors every other tile horizontally.
+    GdipCreateTexture ((GpImage *) source, WrapModeTileFlipX, &brush);
+    status = GdipFillRectangle (graphics, (GpBrush *) brush, 0, 0, 4, 4);
+    assertEqualInt (status, Ok);
+    GdipBitmapGetPixel (bitmap, 3, 0, &pixel);
+    assertEqualARGB (pixel, 0xFFFF0000);
+    GdipBitmapGetPixel (bitmap, 2, 2, &pixel);
+    assertEqualARGB (pixel, 0xFF00FF00);
+
+    // Changing the transform only moves the pattern.
+    status = GdipTranslateTextureTransform (brush, -1, 0, MatrixOrderAppend);
+    assertEqualInt (status, Ok);
+    status = GdipFillRectangle (graphics, (GpBrush *) brush, 0, 0, 4, 4);
+    assertEqualInt (status, Ok);
+    GdipBitmapGetPixel (bitmap, 0, 0, &pixel);
+    assertEqualARGB (pixel, 0xFF00FF00);
+    GdipDeleteBrush ((GpBrush *) brush);
+
+    // WrapModeTileFlipY mirrors every other tile vertically.
+    GdipCreateTexture ((GpImage *) source, WrapModeTileFlipY, &brush);
+    status = GdipFillRectangle (graphics, (GpBrush *) brush, 0, 0, 4, 4);
+    assertEqualInt (status, Ok);
+    GdipBitmapGetPixel (bitmap, 0, 3, &pixel);
+    assertEqualARGB (pixel, 0xFFFF0000);
+    GdipBitmapGetPixel (bitmap, 2, 2, &pixel);
+    assertEqualARGB (pixel, 0xFF0000FF);
+    GdipDeleteBrush ((GpBrush *) brush);
+
+    // WrapModeTileFlipXY mirrors in both directions.
+    GdipCreateTexture ((GpImage *) source, WrapModeTileFlipXY, &brush);
+    status = GdipFillRectangle (graphics, (GpBrush *) brush, 0, 0, 4, 4);
+    assertEqualInt (status, Ok);
+    GdipBitmapGetPixel (bitmap, 3, 3, &pixel);
+    assertEqualARGB (pixel, 0xFFFF0000);
+    GdipBitmapGetPixel (bitmap, 2, 0, &pixel);
+    assertEqualARGB (pixel, 0xFF00FF00);
+    GdipDeleteBrush ((GpBrush *) brush);
+
+    GdipDeleteGraphics (graphics);
+    GdipDisposeImage ((GpImage *) bitmap);
+    GdipDisposeImage ((GpImage *) source);
+}
+
 int
 main (int argc, char**argv)
 {
@@ -2071,6 +2131,7 @@ main (int argc, char**argv)
     test_translateTextureTransform ();
     test_scaleTextureTransform ();
     test_rotateTextureTransform ();
+    test_fillTextureWrapModes ();
 
     SHUTDOWN;
     return 0;